@@ -126,6 +126,7 @@ def convert_model(model: 'chainer.Chain', args=[]):
     add_chainer_function(F.arctan)
     add_chainer_function(F.exp)
     add_chainer_function(F.log)
+    add_chainer_function(F.sqrt)
     
     values.function_converters[F.argmax] = values.FuncValue(functions_builtin.ChainerArgminmaxFunction(F.argmax), None)
     values.function_converters[F.argmin] = values.FuncValue(functions_builtin.ChainerArgminmaxFunction(F.argmin), None)
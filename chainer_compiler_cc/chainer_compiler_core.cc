@@ -1,4 +1,5 @@
 #include <memory>
+#include <sstream>
 
 #include <compiler/onnx.h>
 
@@ -12,6 +13,7 @@
 #include <common/protoutil.h>
 #include <compiler/chxvm/emitter.h>
 #include <compiler/computation_order/core.h>
+#include <compiler/computation_order/policy_auto.h>
 #include <compiler/custom_onnx_ops.h>
 #include <compiler/flags.h>
 #include <compiler/flops.h>
@@ -25,6 +27,7 @@
 #include <runtime/chrome_tracing.h>
 #include <runtime/chxvm.h>
 #include <runtime/chxvm.pb.h>
+#include <runtime/chxvm_profiler.h>
 #include <runtime/chxvm_state.h>
 #include <runtime/chxvm_var.h>
 #include <runtime/meminfo.h>
@@ -114,11 +117,27 @@ std::pair<std::shared_ptr<Graph>, std::shared_ptr<Graph>> GenerateBackwardTo(
     return std::make_pair(graph, backprop);
 }
 
+// `memory_limit_mb` overrides --computation_order_memory_limit, which
+// is also in MB.
 std::pair<std::shared_ptr<Graph>, std::shared_ptr<Graph>> GenerateBackwardToWithOrder(
-        const std::shared_ptr<Graph>& graph, const std::string& computation_order) {
+        const std::shared_ptr<Graph>& graph, const std::string& computation_order, int64_t memory_limit_mb) {
+    if (computation_order == "auto") {
+        CHECK(memory_limit_mb > 0 || g_computation_order_memory_limit > 0)
+                << "backward_to_with_order(computation_order='auto') requires memory_limit in MB or "
+                << "computation_order_memory_limit in compiler_kwargs";
+    }
     auto backprop = std::make_shared<Graph>(graph->name() + "_backprop");
     RunDefaultPassesBeforeGradient(graph.get());
-    auto orders = GetComputationOrder(*graph.get(), computation_order);
+    std::vector<Order> orders;
+    if (computation_order == "auto" && memory_limit_mb > 0) {
+        const int64_t memory_limit = memory_limit_mb * 1000000LL;
+        std::vector<ComputationOrderCandidate> candidates;
+        int chosen;
+        orders = AutoPolicy(*graph, memory_limit, &candidates, &chosen);
+        ShowComputationOrderCandidates(candidates, chosen, memory_limit);
+    } else {
+        orders = GetComputationOrder(*graph.get(), computation_order);
+    }
     AddGradientNodesForTrainingWithOrders(graph.get(), backprop.get(), orders);
     return std::make_pair(graph, backprop);
 }
@@ -131,6 +150,10 @@ int64_t GetPeakMemoryUsage(const std::shared_ptr<Graph>& graph) {
     return SimulateMemoryUsage(*graph).peak;
 }
 
+int64_t GetPeakInPlaceMemoryUsage(const std::shared_ptr<Graph>& graph) {
+    return SimulateMemoryUsage(*graph).peak_inplace;
+}
+
 int64_t GetAllMemoryUsage(const std::shared_ptr<Graph>& graph) {
     return SimulateMemoryUsage(*graph).all;
 }
@@ -154,9 +177,13 @@ void InitGraph(py::module& m) {
     c.def("backward_to", &GenerateBackwardTo, "Generate a pair of graphs for forward and back propagation");
     c.def("backward_to_with_order",
           &GenerateBackwardToWithOrder,
-          "Generate a pair of graphs for forward and back propagation with specified computation order policy");
+          "Generate a pair of graphs for forward and back propagation with specified computation order policy. "
+          "memory_limit is in MB",
+          "computation_order"_a,
+          "memory_limit"_a = 0);
     c.def("flops", &GetFlops, "Get estimated flops");
     c.def("peak_memory_usage", &GetPeakMemoryUsage, "Get estimated peak memory usage");
+    c.def("peak_inplace_memory_usage", &GetPeakInPlaceMemoryUsage, "Get estimated peak memory usage with in-place ops");
     c.def("all_memory_usage", &GetAllMemoryUsage, "Get estimated all memory usage");
     c.def("param_memory_usage", &GetParamMemoryUsage, "Get estimated param memory usage");
     c.def("dump", &Dump, "Dump a model to a string");
@@ -173,7 +200,8 @@ runtime::ChxVMOptions CreateOptions(
         int64_t base_memory_usage,
         const std::string& chrome_tracing,
         const std::string& dump_outputs_dir,
-        const std::map<std::string, py::function>& custom_funcs) {
+        const std::map<std::string, py::function>& custom_funcs,
+        runtime::ChxVMProfiler* profiler) {
     runtime::ChxVMOptions chxvm_opts;
     if (trace) chxvm_opts.trace_level = 1;
     if (verbose) chxvm_opts.trace_level = 2;
@@ -190,6 +218,7 @@ runtime::ChxVMOptions CreateOptions(
         chxvm_opts.chrome_tracing = new runtime::ChromeTracingEmitter();
     }
     chxvm_opts.dump_outputs_dir = dump_outputs_dir;
+    chxvm_opts.profiler = profiler;
 
     for (const auto& p : custom_funcs) {
         const std::string& name = p.first;
@@ -230,7 +259,8 @@ std::shared_ptr<runtime::ChxVMState> Prepare(
         int64_t base_memory_usage,
         const std::string& chrome_tracing,
         const std::string& dump_outputs_dir,
-        const std::map<std::string, py::function>& custom_funcs) {
+        const std::map<std::string, py::function>& custom_funcs,
+        runtime::ChxVMProfiler* profiler) {
     runtime::ChxVMOptions chxvm_opts = CreateOptions(
             trace,
             verbose,
@@ -242,7 +272,8 @@ std::shared_ptr<runtime::ChxVMState> Prepare(
             base_memory_usage,
             chrome_tracing,
             dump_outputs_dir,
-            custom_funcs);
+            custom_funcs,
+            profiler);
 
     std::shared_ptr<runtime::ChxVMState> state(chxvm->Prepare(inputs, chxvm_opts));
     return state;
@@ -261,7 +292,8 @@ std::map<std::string, VarPtr> Run(
         int64_t base_memory_usage,
         const std::string& chrome_tracing,
         const std::string& dump_outputs_dir,
-        const std::map<std::string, py::function>& custom_funcs) {
+        const std::map<std::string, py::function>& custom_funcs,
+        runtime::ChxVMProfiler* profiler) {
     runtime::ChxVMOptions chxvm_opts = CreateOptions(
             trace,
             verbose,
@@ -273,7 +305,8 @@ std::map<std::string, VarPtr> Run(
             base_memory_usage,
             chrome_tracing,
             dump_outputs_dir,
-            custom_funcs);
+            custom_funcs,
+            profiler);
 
     runtime::InOuts outputs(chxvm->Run(inputs, chxvm_opts));
 
@@ -283,6 +316,13 @@ std::map<std::string, VarPtr> Run(
     return outputs;
 }
 
+void BindInputs(
+        const std::shared_ptr<runtime::ChxVM>& chxvm,
+        const std::shared_ptr<runtime::ChxVMState>& state,
+        const std::map<std::string, VarPtr>& inputs) {
+    chxvm->BindInputs(state.get(), inputs);
+}
+
 std::map<std::string, VarPtr> RunState(const std::shared_ptr<runtime::ChxVM>& chxvm, const std::shared_ptr<runtime::ChxVMState>& state) {
     chxvm->Run(state.get());
     // TODO(hamaji): Revive this.
@@ -298,9 +338,11 @@ std::map<std::string, VarPtr> RunState(const std::shared_ptr<runtime::ChxVM>& ch
 void InitChxVM(py::module& m) {
     py::class_<runtime::ChxVM, std::shared_ptr<runtime::ChxVM>> c{m, "ChxVM"};
     // TODO(hamaji): Expose ChxVMOptions to Python.
+    // The returned state refers to the profiler (the 14th argument).
     c.def("prepare",
           &Prepare,
           "Prepare the model",
+          py::keep_alive<0, 14>(),
           "inputs"_a,
           "trace"_a = false,
           "verbose"_a = false,
@@ -312,7 +354,8 @@ void InitChxVM(py::module& m) {
           "base_memory_usage"_a = -1,
           "chrome_tracing"_a = "",
           "dump_outputs_dir"_a = "",
-          "custom_funcs"_a = py::dict());
+          "custom_funcs"_a = py::dict(),
+          "profiler"_a = nullptr);
     c.def("run",
           &Run,
           "Run the model",
@@ -327,10 +370,27 @@ void InitChxVM(py::module& m) {
           "base_memory_usage"_a = -1,
           "chrome_tracing"_a = "",
           "dump_outputs_dir"_a = "",
-          "custom_funcs"_a = py::dict());
+          "custom_funcs"_a = py::dict(),
+          "profiler"_a = nullptr);
+    c.def("bind_inputs", &BindInputs, "Bind inputs of a prepared state for the next run", "state"_a, "inputs"_a);
     c.def("run", &RunState, "Run the model", "state"_a);
 }
 
+std::string ShowProfile(const runtime::ChxVMProfiler& profiler, int max_rows) {
+    std::ostringstream oss;
+    profiler.Show(oss, max_rows);
+    return oss.str();
+}
+
+void InitChxVMProfiler(py::module& m) {
+    py::class_<runtime::ChxVMProfiler, std::shared_ptr<runtime::ChxVMProfiler>> c{m, "ChxVMProfiler"};
+    c.def(py::init<>());
+    c.def("reset", &runtime::ChxVMProfiler::Reset, "Clear all counters");
+    c.def("num_runs", &runtime::ChxVMProfiler::num_runs, "The number of profiled runs");
+    c.def("summary", &ShowProfile, "Get a table of the slowest ops", "max_rows"_a = 20);
+    c.def("report_json", &runtime::ChxVMProfiler::ToJSON, "Get statistics of ops and instructions in a JSON");
+}
+
 void InitChxVMState(py::module& m) {
     py::class_<runtime::ChxVMState, std::shared_ptr<runtime::ChxVMState>> c{m, "ChxVMState"};
 }
@@ -390,6 +450,8 @@ PYBIND11_MODULE(_chainer_compiler_core, m) {  // NOLINT
 
     InitChxVMState(m);
 
+    InitChxVMProfiler(m);
+
     m.def("load", &LoadGraph, "Load an ONNX model");
     m.def("configure", &Configure, "Configure global variables in chainer compiler",
 #include "chainer_compiler_cc/pybind_args.inc"
@@ -1,5 +1,7 @@
 #include "strutil.h"
 
+#include <iomanip>
+
 #if defined(_MSC_VER)
 #include <BaseTsd.h>
 typedef SSIZE_T ssize_t;
@@ -36,4 +38,28 @@ std::string Basename(const std::string& str) {
     return str.substr(found + 1);
 }
 
+std::string EscapeJSON(const std::string& str) {
+    std::ostringstream oss;
+    for (char c : str) {
+        switch (c) {
+            case '"':
+                oss << "\\\"";
+                break;
+            case '\\':
+                oss << "\\\\";
+                break;
+            case '\n':
+                oss << "\\n";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    oss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+                } else {
+                    oss << c;
+                }
+        }
+    }
+    return oss.str();
+}
+
 }  // namespace chainer_compiler
@@ -54,4 +54,7 @@ bool HasSuffix(const std::string& str, const std::string& suffix);
 
 std::string Basename(const std::string& str);
 
+// Escapes `str` so it can be put in a JSON string literal.
+std::string EscapeJSON(const std::string& str);
+
 }  // namespace chainer_compiler
@@ -28,5 +28,11 @@ TEST(StrUtilTest, JoinString) {
     EXPECT_EQ("", JoinString({}, ", "));
 }
 
+TEST(StrUtilTest, EscapeJSON) {
+    EXPECT_EQ("foo", EscapeJSON("foo"));
+    EXPECT_EQ("a\\\"b\\\\c\\n", EscapeJSON("a\"b\\c\n"));
+    EXPECT_EQ("\\u0001", EscapeJSON("\x01"));
+}
+
 }  // namespace
 }  // namespace chainer_compiler
@@ -0,0 +1,209 @@
+#include "compiler/bytecode_builder.h"
+
+#include <map>
+#include <queue>
+#include <set>
+
+#include <common/log.h>
+#include <compiler/fusion.h>
+#include <compiler/node.h>
+#include <compiler/tensor.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+#include <runtime/elementwise_bytecode.h>
+
+namespace chainer_compiler {
+
+using runtime::BytecodeOp;
+
+namespace {
+
+BytecodeOp GetBytecodeOp(const Node& node) {
+    switch (node.op_type()) {
+        case Node::kIdentity:
+            return BytecodeOp::kCopy;
+        case Node::kNeg:
+            return BytecodeOp::kNeg;
+        case Node::kRelu:
+            return BytecodeOp::kRelu;
+        case Node::kSqrt:
+            return BytecodeOp::kSqrt;
+        case Node::kExp:
+            return BytecodeOp::kExp;
+        case Node::kTanh:
+            return BytecodeOp::kTanh;
+        case Node::kSigmoid:
+            return BytecodeOp::kSigmoid;
+        case Node::kLog:
+            return BytecodeOp::kLog;
+        case Node::kAdd:
+            return BytecodeOp::kAdd;
+        case Node::kSub:
+            return BytecodeOp::kSub;
+        case Node::kMul:
+            return BytecodeOp::kMul;
+        case Node::kDiv:
+            return BytecodeOp::kDiv;
+        case Node::kPow:
+            return BytecodeOp::kPow;
+        case Node::kClip:
+            return BytecodeOp::kClip;
+        case Node::kWhere:
+            return BytecodeOp::kWhere;
+        // Fusion groups made by FuseReductionOperations reduce or
+        // normalize only the last axis.
+        case Node::kReduceSum:
+            return BytecodeOp::kReduceSum;
+        case Node::kReduceSumSquare:
+            return BytecodeOp::kReduceSumSquare;
+        case Node::kReduceMean:
+            return BytecodeOp::kReduceMean;
+        case Node::kReduceMax:
+            return BytecodeOp::kReduceMax;
+        case Node::kSoftmax:
+            return BytecodeOp::kSoftmax;
+        case Node::kLogSoftmax:
+            return BytecodeOp::kLogSoftmax;
+        default:
+            CHECK(false) << "Cannot build bytecode for: " << node.ToString();
+    }
+    return BytecodeOp::kNumOps;
+}
+
+// Returns nodes in a topological order.
+std::vector<Node*> SortNodes(const std::vector<Node*>& nodes, const std::vector<Value*>& inputs) {
+    std::map<Node*, int> input_counts;
+    for (Node* node : nodes) {
+        if (node->op_type() == Node::kConstant) continue;
+        CHECK(input_counts.emplace(node, node->GetNumActualInputs()).second);
+    }
+
+    std::queue<Value*> q;
+    for (Value* value : inputs) {
+        q.push(value);
+    }
+    for (Node* node : nodes) {
+        if (node->op_type() == Node::kConstant) q.push(node->output(0));
+    }
+
+    std::vector<Node*> sorted;
+    while (!q.empty()) {
+        Value* value = q.front();
+        q.pop();
+        for (Node* node : value->users()) {
+            auto found = input_counts.find(node);
+            if (found == input_counts.end()) continue;
+            if (--found->second != 0) continue;
+            sorted.push_back(node);
+            for (Value* output : node->outputs()) q.push(output);
+        }
+    }
+    CHECK_EQ(input_counts.size(), sorted.size());
+    return sorted;
+}
+
+}  // namespace
+
+void BuildElementWiseBytecode(
+        const std::vector<Node*>& nodes, const std::vector<Value*>& inputs, const std::vector<Value*>& outputs, ElementWiseBytecode* bytecode) {
+    // Conditions of Where are converted to the dtype of outputs.
+    bytecode->dtype = Dtype::kUnknown;
+    for (Value* value : outputs) {
+        Dtype dt = value->type().dtype();
+        if (dt == Dtype::kUnknown) continue;
+        if (bytecode->dtype != Dtype::kUnknown) {
+            CHECK_EQ(bytecode->dtype, dt);
+        }
+        bytecode->dtype = dt;
+    }
+    if (bytecode->dtype == Dtype::kUnknown) {
+        bytecode->dtype = Dtype::kFloat32;
+    }
+
+    std::map<Value*, int> regs;
+    int num_regs = 0;
+    for (Value* value : inputs) {
+        CHECK(regs.emplace(value, num_regs++).second);
+    }
+    for (Value* value : outputs) {
+        CHECK(regs.emplace(value, num_regs++).second) << "Output is also an input: " << value->ToString();
+    }
+
+    // Constants including bounds of Clip.
+    auto add_constant = [bytecode, &num_regs](double value) {
+        bytecode->constants.push_back(value);
+        return num_regs++;
+    };
+    std::map<Node*, std::pair<int, int>> clip_bounds;
+    for (Node* node : nodes) {
+        if (node->op_type() == Node::kConstant) {
+            CHECK(regs.emplace(node->output(0), add_constant(GetScalarConstant(*node))).second);
+        } else if (node->op_type() == Node::kClip) {
+            clip_bounds.emplace(node, std::make_pair(add_constant(node->min()), add_constant(node->max())));
+        }
+    }
+    const int first_temp = num_regs;
+
+    const std::vector<Node*> sorted = SortNodes(nodes, inputs);
+    std::map<Value*, size_t> last_uses;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        for (Value* value : sorted[i]->inputs()) {
+            last_uses[value] = i;
+        }
+    }
+
+    std::vector<int> free_regs;
+    auto release = [&regs, &free_regs, first_temp](Value* value) {
+        const int reg = regs[value];
+        if (reg >= first_temp) free_regs.push_back(reg);
+    };
+
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        Node* node = sorted[i];
+        std::vector<int> srcs;
+        for (Value* value : node->inputs()) {
+            auto found = regs.find(value);
+            CHECK(found != regs.end()) << value->ToString();
+            srcs.push_back(found->second);
+        }
+        if (node->op_type() == Node::kClip) {
+            CHECK_EQ(1, srcs.size());
+            srcs.push_back(clip_bounds[node].first);
+            srcs.push_back(clip_bounds[node].second);
+        }
+        CHECK_GE(3, srcs.size());
+        srcs.resize(3, -1);
+
+        // Registers of dead values can be the destination since
+        // element-wise operations can be done in place.
+        std::set<Value*> dead;
+        for (Value* value : node->inputs()) {
+            if (last_uses[value] == i && dead.insert(value).second) release(value);
+        }
+
+        CHECK_EQ(1, node->outputs().size());
+        Value* output = node->output(0);
+        int dst;
+        auto found = regs.find(output);
+        if (found != regs.end()) {
+            dst = found->second;
+        } else if (!free_regs.empty()) {
+            dst = free_regs.back();
+            free_regs.pop_back();
+            regs.emplace(output, dst);
+        } else {
+            dst = num_regs++;
+            regs.emplace(output, dst);
+        }
+
+        bytecode->program.push_back(static_cast<int64_t>(GetBytecodeOp(*node)));
+        bytecode->program.push_back(dst);
+        bytecode->program.insert(bytecode->program.end(), srcs.begin(), srcs.end());
+
+        if (!last_uses.count(output)) release(output);
+    }
+    CHECK_EQ(sorted.size() * runtime::kBytecodeInstructionSize, bytecode->program.size());
+    bytecode->num_registers = num_regs;
+}
+
+}  // namespace chainer_compiler
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <compiler/dtype.h>
+
+namespace chainer_compiler {
+
+class Node;
+class Value;
+
+// A fusion group compiled for ElementWiseInterpreterOp. See
+// runtime/elementwise_bytecode.h for the format.
+struct ElementWiseBytecode {
+    std::vector<int64_t> program;
+    std::vector<double> constants;
+    int num_registers{0};
+    Dtype dtype;
+};
+
+// Compiles element-wise `nodes` which compute `outputs` from `inputs`.
+// Registers of temporary values are reused after their last uses.
+void BuildElementWiseBytecode(
+        const std::vector<Node*>& nodes, const std::vector<Value*>& inputs, const std::vector<Value*>& outputs, ElementWiseBytecode* bytecode);
+
+}  // namespace chainer_compiler
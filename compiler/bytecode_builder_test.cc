@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+
+#include <compiler/bytecode_builder.h>
+#include <compiler/graph.h>
+#include <compiler/graph_builder.h>
+#include <compiler/node.h>
+#include <compiler/value.h>
+#include <runtime/elementwise_bytecode.h>
+
+namespace chainer_compiler {
+namespace {
+
+using runtime::BytecodeOp;
+
+TEST(BytecodeBuilderTest, ReuseRegisters) {
+    Type type(Dtype::kFloat32, {2, 3});
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", type);
+    Value* y = graph.AddOutputValue("y", type);
+    {
+        GraphBuilder gb(&graph, "test", y);
+        Value* t = gb.Op(Node::kTanh, {x});
+        t = gb.Op(Node::kMul, {t, x});
+        gb.Op(Node::kClip, {t}, y)->producer()->set_min(0)->set_max(6);
+    }
+
+    ElementWiseBytecode bytecode;
+    BuildElementWiseBytecode(graph.nodes(), graph.input_values(), graph.output_values(), &bytecode);
+
+    // x, y, the bounds of Clip, and a temporary value, which is
+    // computed in place by Mul.
+    const int64_t kTanh = static_cast<int64_t>(BytecodeOp::kTanh);
+    const int64_t kMul = static_cast<int64_t>(BytecodeOp::kMul);
+    const int64_t kClip = static_cast<int64_t>(BytecodeOp::kClip);
+    const std::vector<int64_t> expected = {kTanh, 4, 0, -1, -1, kMul, 4, 4, 0, -1, kClip, 1, 4, 2, 3};
+    EXPECT_EQ(expected, bytecode.program);
+    EXPECT_EQ(std::vector<double>({0, 6}), bytecode.constants);
+    EXPECT_EQ(5, bytecode.num_registers);
+    EXPECT_EQ(Dtype::kFloat32, bytecode.dtype);
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -6,7 +6,10 @@
 
 #include <common/log.h>
 #include <common/strutil.h>
+#include <compiler/bytecode_builder.h>
+#include <compiler/chxvm/memory_planner.h>
 #include <compiler/chxvm/value_id_manager.h>
+#include <compiler/cpu_fusion_builder.h>
 #include <compiler/flags.h>
 #include <compiler/flops.h>
 #include <compiler/gen_chxvm_codegen.h>
@@ -59,6 +62,10 @@ void FillOpInfo(const Node& node, const std::string& debug_info, ChxVMProgramPro
     inst->set_debug_info(debug_info);
     inst->set_id(node.chainer_order());
     inst->set_flops(CalculateFlops(node));
+    if (node.chainer_stream() >= 0) {
+        inst->set_stream(node.chainer_stream());
+        for (int64_t id : node.chainer_stream_waits()) inst->add_wait_ids(id);
+    }
 }
 
 class ChxVMEmitter {
@@ -252,6 +259,10 @@ private:
             EMIT(Linear, out(0), in(0), in(1), oin(2), node.n_batch_axes());
         } else if (node.op_type() == Node::kChainerLinearGradWeight) {
             EMIT(LinearGradWeight, out(0), in(0), in(1));
+        } else if (node.op_type() == Node::kChainerFusedLinear) {
+            EMIT(LinearActivation, out(0), in(0), in(1), oin(2), node.activation());
+        } else if (node.op_type() == Node::kChainerFusedLinearGradWeight) {
+            EMIT(LinearActivationGradWeight, out(0), out(1), in(0), in(1), in(2), node.activation());
         } else if (node.op_type() == Node::kConv) {
             CHECK_LE(2UL, node.inputs().size());
             CHECK_GE(3UL, node.inputs().size());
@@ -261,6 +272,80 @@ private:
             // Support auto_pad only for MNIST
             CHECK(node.auto_pad() == "NOTSET" || node.auto_pad() == "SAME_UPPER");
             EMIT(Conv, out(0), in(0), in(1), oin(2), strides(), pads(), node.group(), node.auto_pad());
+        } else if (node.op_type() == Node::kChainerFusedConv) {
+            CHECK_EQ(1UL, node.outputs().size());
+            for (int d : node.dilations()) CHECK_EQ(d, 1) << "Dilation is not supported yet";
+            CHECK(node.auto_pad() == "NOTSET" || node.auto_pad() == "SAME_UPPER");
+            EMIT(FusedConv,
+                 out(0),
+                 in(0),
+                 in(1),
+                 oin(2),
+                 oin(3),
+                 strides(),
+                 pads(),
+                 node.group(),
+                 node.auto_pad(),
+                 node.activation(),
+                 node.alpha(),
+                 node.min(),
+                 node.max());
+        } else if (node.op_type() == Node::kChainerPackConvWeight) {
+            EMIT(PackConvWeight, out(0), in(0), node.input_shape(), strides(), pads(), node.group());
+        } else if (node.op_type() == Node::kChainerPackMatrixWeight) {
+            EMIT(PackMatrixWeight, out(0), in(0), node.trans_b());
+        } else if (node.op_type() == Node::kChainerPackedConv) {
+            CHECK_EQ(1UL, node.outputs().size());
+            for (int d : node.dilations()) CHECK_EQ(d, 1) << "Dilation is not supported yet";
+            CHECK(node.auto_pad() == "NOTSET");
+            EMIT(PackedConv,
+                 out(0),
+                 in(0),
+                 in(1),
+                 oin(2),
+                 oin(3),
+                 strides(),
+                 pads(),
+                 node.group(),
+                 node.activation(),
+                 node.alpha(),
+                 node.min(),
+                 node.max());
+        } else if (node.op_type() == Node::kChainerPackedLinear) {
+            EMIT(PackedLinear, out(0), in(0), in(1), oin(2), node.n_batch_axes(), node.activation());
+        } else if (node.op_type() == Node::kChainerLayoutConvert) {
+            EMIT(LayoutConvert, out(0), in(0), node.src_layout(), node.dst_layout(), node.channels());
+        } else if (
+                node.op_type() == Node::kChainerLayoutConv || node.op_type() == Node::kChainerLayoutMaxPool ||
+                node.op_type() == Node::kChainerLayoutAveragePool) {
+            // Images in other layouts have paddings for both beginnings
+            // and ends of the two spatial axes.
+            std::vector<int64_t> strides = node.strides();
+            if (strides.empty()) strides = {1, 1};
+            std::vector<int64_t> pads = node.pads();
+            if (pads.empty()) pads.resize(4);
+            CHECK_EQ(2UL, strides.size());
+            CHECK_EQ(4UL, pads.size());
+            if (node.op_type() == Node::kChainerLayoutConv) {
+                EMIT(LayoutConv,
+                     out(0),
+                     in(0),
+                     in(1),
+                     oin(2),
+                     oin(3),
+                     strides,
+                     pads,
+                     node.group(),
+                     node.layout(),
+                     node.activation(),
+                     node.alpha(),
+                     node.min(),
+                     node.max());
+            } else if (node.op_type() == Node::kChainerLayoutMaxPool) {
+                EMIT(LayoutMaxPool, out(0), in(0), node.kernel_shape(), strides, pads, node.chainer_cover_all(), node.layout());
+            } else {
+                EMIT(LayoutAveragePool, out(0), in(0), node.kernel_shape(), strides, pads, node.count_include_pad(), node.layout());
+            }
         } else if (node.op_type() == Node::kConvTranspose) {
             CHECK_LE(2UL, node.inputs().size());
             CHECK_GE(3UL, node.inputs().size());
@@ -1012,6 +1097,55 @@ private:
             return;
         }
 
+        if (g_use_fusion_interpreter && node.fusion_type() == "interpreter") {
+            ElementWiseBytecode bytecode;
+            BuildElementWiseBytecode(body.nodes(), body.input_values(), body.output_values(), &bytecode);
+            if (g_compiler_log) {
+                CLOG() << "Fusion group (interpreter) " << GetFusionGroupSummary(node) << " => " << bytecode.program.size()
+                       << " words with " << bytecode.num_registers << " registers" << std::endl;
+            }
+
+            std::vector<int> inputs;
+            std::vector<ChxVMValue> outputs;
+            for (Value* value : node.inputs()) {
+                inputs.push_back(GetValueId(value));
+            }
+            for (Value* value : node.outputs()) {
+                outputs.emplace_back(GetValueId(value), value);
+            }
+            EMIT(ElementWiseInterpreter,
+                 outputs,
+                 inputs,
+                 outputs.size(),
+                 bytecode.program,
+                 bytecode.constants,
+                 bytecode.num_registers,
+                 bytecode.dtype);
+            return;
+        }
+
+        if (g_use_cpu_codegen && node.fusion_type() == "cpu") {
+            std::string code;
+            Dtype dtype;
+            BuildCpuFusionProgram(body.nodes(), body.input_values(), body.output_values(), &code, &dtype);
+            const std::string dso_filename = CompileCpuFusionProgram(code);
+            if (g_compiler_log) {
+                CLOG() << "Fusion group (CPU) " << GetFusionGroupSummary(node) << " => " << dso_filename << std::endl;
+                CLOG() << code;
+            }
+
+            std::vector<int> inputs;
+            std::vector<ChxVMValue> outputs;
+            for (Value* value : node.inputs()) {
+                inputs.push_back(GetValueId(value));
+            }
+            for (Value* value : node.outputs()) {
+                outputs.emplace_back(GetValueId(value), value);
+            }
+            EMIT(ElementWiseCpu, outputs, inputs, outputs.size(), dso_filename, dtype);
+            return;
+        }
+
         AssignValueIds(body);
 
         for (size_t i = 0; i < node.inputs().size(); ++i) {
@@ -1318,6 +1452,15 @@ void Emit(const Model& model, ChxVMProgramProto* program, bool dump_value_names)
 void Emit(const Graph& graph, ChxVMProgramProto* program, bool dump_value_names) {
     ChxVMEmitter emitter;
     emitter.EmitModel(graph, program, dump_value_names);
+    if (!g_skip_inplace_ops) {
+        int num_inplace = MarkInPlaceOutputs(program);
+        CLOG() << "In-place ops: " << num_inplace << std::endl;
+    }
+    if (g_plan_memory) {
+        MemoryPlanStats stats = PlanMemory(program);
+        CLOG() << "Memory plan: " << stats.num_planned_arrays << " arrays arena=" << stats.arena_size
+               << " naive_peak=" << stats.naive_peak_size << " total=" << stats.total_size << std::endl;
+    }
 }
 
 void Emit(const Model& model, std::ostream& out, bool dump_value_names) {
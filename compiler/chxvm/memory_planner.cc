@@ -0,0 +1,489 @@
+#include "compiler/chxvm/memory_planner.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include <common/log.h>
+#include <compiler/dtype.h>
+#include <runtime/chxvm.pb.h>
+
+namespace chainer_compiler {
+namespace chxvm {
+namespace {
+
+using runtime::ChxVMInstructionProto;
+using runtime::ChxVMTypeProto;
+using runtime::ChxVMValueProto;
+
+// Offsets in the arena are aligned to this value.
+constexpr int64_t kAlignment = 64;
+
+bool IsJump(ChxVMInstructionProto::Op op) {
+    return op == ChxVMInstructionProto::Jmp || op == ChxVMInstructionProto::JmpTrue || op == ChxVMInstructionProto::JmpFalse;
+}
+
+// Ops whose runtime implementation writes its first output to the
+// buffer assigned by the memory planner.
+bool IsPlannable(ChxVMInstructionProto::Op op) {
+    switch (op) {
+        case ChxVMInstructionProto::Add:
+        case ChxVMInstructionProto::Sub:
+        case ChxVMInstructionProto::Mul:
+        case ChxVMInstructionProto::Conv:
+        case ChxVMInstructionProto::ConvGradWeight:
+        case ChxVMInstructionProto::FusedConv:
+        case ChxVMInstructionProto::LinearActivation:
+        case ChxVMInstructionProto::LinearActivationGradWeight:
+        case ChxVMInstructionProto::PackedConv:
+        case ChxVMInstructionProto::PackedLinear:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Plannable ops which use the planned buffer only when no
+// broadcasting or type coercion is needed.
+bool IsElementwise(ChxVMInstructionProto::Op op) {
+    return op == ChxVMInstructionProto::Add || op == ChxVMInstructionProto::Sub || op == ChxVMInstructionProto::Mul;
+}
+
+// Ops whose outputs are always newly allocated and which do not keep
+// references to their inputs. Outputs of other ops may be views of
+// their inputs.
+bool HasFreshOutputs(ChxVMInstructionProto::Op op) {
+    switch (op) {
+        case ChxVMInstructionProto::Add:
+        case ChxVMInstructionProto::Sub:
+        case ChxVMInstructionProto::Mul:
+        case ChxVMInstructionProto::Div:
+        case ChxVMInstructionProto::Pow:
+        case ChxVMInstructionProto::Neg:
+        case ChxVMInstructionProto::Reciprocal:
+        case ChxVMInstructionProto::Exp:
+        case ChxVMInstructionProto::Log:
+        case ChxVMInstructionProto::Sqrt:
+        case ChxVMInstructionProto::Abs:
+        case ChxVMInstructionProto::Tanh:
+        case ChxVMInstructionProto::Erf:
+        case ChxVMInstructionProto::Sigmoid:
+        case ChxVMInstructionProto::Floor:
+        case ChxVMInstructionProto::Ceil:
+        case ChxVMInstructionProto::Relu:
+        case ChxVMInstructionProto::ReluGrad:
+        case ChxVMInstructionProto::Selu:
+        case ChxVMInstructionProto::LeakyRelu:
+        case ChxVMInstructionProto::Elu:
+        case ChxVMInstructionProto::Softplus:
+        case ChxVMInstructionProto::Softmax:
+        case ChxVMInstructionProto::LogSoftmax:
+        case ChxVMInstructionProto::Linear:
+        case ChxVMInstructionProto::LinearGradWeight:
+        case ChxVMInstructionProto::LinearActivation:
+        case ChxVMInstructionProto::LinearActivationGradWeight:
+        case ChxVMInstructionProto::MatMul:
+        case ChxVMInstructionProto::Gemm:
+        case ChxVMInstructionProto::Conv:
+        case ChxVMInstructionProto::ConvTranspose:
+        case ChxVMInstructionProto::ConvGradWeight:
+        case ChxVMInstructionProto::FusedConv:
+        case ChxVMInstructionProto::PackedConv:
+        case ChxVMInstructionProto::PackedLinear:
+        case ChxVMInstructionProto::FixedBatchNormalization:
+        case ChxVMInstructionProto::Pad:
+        case ChxVMInstructionProto::Clip:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Element-wise ops whose runtime implementation can write its output
+// to the buffer of an input of the same type.
+bool CanRunInPlace(ChxVMInstructionProto::Op op) {
+    switch (op) {
+        case ChxVMInstructionProto::Add:
+        case ChxVMInstructionProto::Mul:
+        case ChxVMInstructionProto::Relu:
+        case ChxVMInstructionProto::ReluGrad:
+        case ChxVMInstructionProto::Sigmoid:
+        case ChxVMInstructionProto::Tanh:
+        case ChxVMInstructionProto::Clip:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Outputs of in-place instructions are views of their inputs.
+bool MayAliasInputs(const ChxVMInstructionProto& inst) {
+    return !HasFreshOutputs(inst.op()) || inst.inplace_input() >= 0;
+}
+
+void CollectInputIds(const ChxVMInstructionProto& inst, std::vector<int>* ids) {
+    for (const ChxVMValueProto& input : inst.inputs()) {
+        switch (input.type()) {
+            case ChxVMValueProto::ARRAY:
+            case ChxVMValueProto::OPTIONAL_ARRAY:
+                ids->push_back(input.array());
+                break;
+            case ChxVMValueProto::ARRAY_LIST:
+                ids->insert(ids->end(), input.array_list().begin(), input.array_list().end());
+                break;
+            case ChxVMValueProto::SEQUENCE:
+                ids->push_back(input.sequence());
+                break;
+            case ChxVMValueProto::OPAQUE:
+                ids->push_back(input.opaque());
+                break;
+            case ChxVMValueProto::SHAPE:
+                ids->push_back(input.shape());
+                break;
+            case ChxVMValueProto::SCALAR:
+            case ChxVMValueProto::OPTIONAL_SCALAR:
+                ids->push_back(input.scalar());
+                break;
+            default:
+                break;
+        }
+    }
+    ids->erase(std::remove_if(ids->begin(), ids->end(), [](int id) { return id < 0; }), ids->end());
+}
+
+// Returns -1 if the size is not known statically.
+int64_t GetByteSize(const ChxVMTypeProto& type) {
+    if (type.dtype() <= 0) {
+        return -1;
+    }
+    int64_t size = Dtype(static_cast<Dtype::DataType>(type.dtype())).SizeOf();
+    for (int d : type.shape()) {
+        if (d < 0) {
+            return -1;
+        }
+        size *= d;
+    }
+    return size;
+}
+
+bool IsSameType(const ChxVMTypeProto& a, const ChxVMTypeProto& b) {
+    return a.dtype() == b.dtype() && std::equal(a.shape().begin(), a.shape().end(), b.shape().begin(), b.shape().end());
+}
+
+class UnionFind {
+public:
+    explicit UnionFind(int n) : parents_(n) {
+        std::iota(parents_.begin(), parents_.end(), 0);
+    }
+
+    int Find(int x) {
+        while (parents_[x] != x) {
+            parents_[x] = parents_[parents_[x]];
+            x = parents_[x];
+        }
+        return x;
+    }
+
+    void Union(int x, int y) {
+        parents_[Find(x)] = Find(y);
+    }
+
+private:
+    std::vector<int> parents_;
+};
+
+// For each instruction in a region which may be executed by jumps,
+// returns the last pc of the region. -1 for other instructions.
+std::vector<int> GetRegionEnds(const runtime::ChxVMProgramProto& program) {
+    const int num_insts = program.instructions_size();
+    std::vector<int> region_ends(num_insts, -1);
+    for (int pc = 0; pc < num_insts; ++pc) {
+        const ChxVMInstructionProto& inst = program.instructions(pc);
+        if (!IsJump(inst.op())) continue;
+        CHECK_LT(0, inst.inputs_size());
+        const int target = inst.inputs(inst.inputs_size() - 1).i();
+        const int begin = std::max(0, std::min(pc, target));
+        const int end = std::min(num_insts - 1, std::max(pc, target));
+        for (int i = begin; i <= end; ++i) {
+            region_ends[i] = std::max(region_ends[i], end);
+        }
+    }
+    // Propagate ends of overlapping regions.
+    for (int pc = num_insts - 2; pc >= 0; --pc) {
+        if (region_ends[pc] >= 0 && region_ends[pc + 1] >= 0) {
+            region_ends[pc] = std::max(region_ends[pc], region_ends[pc + 1]);
+        }
+    }
+    return region_ends;
+}
+
+// Lifetimes of variables in a ChxVM program. Variables which may
+// share a buffer (e.g., the input and the output of Reshape) are put
+// into the same alias group and a buffer is alive while any variable
+// in its group is used.
+class ValueLifetimes {
+public:
+    explicit ValueLifetimes(const runtime::ChxVMProgramProto& program) : region_ends_(GetRegionEnds(program)) {
+        const int num_insts = program.instructions_size();
+        int num_variables = 0;
+        for (const ChxVMInstructionProto& inst : program.instructions()) {
+            std::vector<int> ids;
+            CollectInputIds(inst, &ids);
+            ids.insert(ids.end(), inst.outputs().begin(), inst.outputs().end());
+            for (int id : ids) num_variables = std::max(num_variables, id + 1);
+        }
+
+        UnionFind aliases(num_variables);
+        std::vector<int> last_uses(num_variables, -1);
+        std::vector<int> last_reads(num_variables, -1);
+        std::vector<bool> escaped(num_variables, false);
+        num_defs_.resize(num_variables);
+        fresh_.resize(num_variables);
+        types_.resize(num_variables);
+
+        for (int pc = 0; pc < num_insts; ++pc) {
+            const ChxVMInstructionProto& inst = program.instructions(pc);
+            std::vector<int> ids;
+            CollectInputIds(inst, &ids);
+            const size_t num_inputs = ids.size();
+            for (int i = 0; i < inst.outputs_size(); ++i) {
+                const int id = inst.outputs(i);
+                if (id < 0) continue;
+                ids.push_back(id);
+                ++num_defs_[id];
+                if (i < inst.output_types_size()) types_[id] = &inst.output_types(i);
+                fresh_[id] = HasFreshOutputs(inst.op());
+            }
+
+            // Values used in a loop stay alive until the end of the loop.
+            const int use = InRegion(pc) ? region_ends_[pc] : pc;
+            for (int id : ids) {
+                last_uses[id] = std::max(last_uses[id], use);
+                if (inst.op() != ChxVMInstructionProto::Free) last_reads[id] = std::max(last_reads[id], use);
+            }
+
+            if (inst.op() == ChxVMInstructionProto::Out) {
+                for (size_t i = 0; i < num_inputs; ++i) escaped[ids[i]] = true;
+            }
+            if (MayAliasInputs(inst)) {
+                for (size_t i = 1; i < ids.size(); ++i) aliases.Union(ids[0], ids[i]);
+            }
+        }
+
+        groups_.resize(num_variables);
+        group_ends_.resize(num_variables, -1);
+        group_last_reads_.resize(num_variables, -1);
+        group_escaped_.resize(num_variables, false);
+        for (int id = 0; id < num_variables; ++id) {
+            const int root = aliases.Find(id);
+            groups_[id] = root;
+            group_ends_[root] = std::max(group_ends_[root], last_uses[id]);
+            group_last_reads_[root] = std::max(group_last_reads_[root], last_reads[id]);
+            if (escaped[id]) group_escaped_[root] = true;
+        }
+    }
+
+    bool InRegion(int pc) const {
+        return region_ends_[pc] >= 0;
+    }
+
+    int num_defs(int id) const {
+        return num_defs_[id];
+    }
+
+    // The type of `id` given by its definition, or nullptr.
+    const ChxVMTypeProto* type(int id) const {
+        return types_[id];
+    }
+
+    // The last instruction which uses the buffer of `id`, including
+    // `Free` instructions.
+    int GetBufferEnd(int id) const {
+        return group_ends_[groups_[id]];
+    }
+
+    // The last instruction which reads or writes the buffer of `id`.
+    int GetLastRead(int id) const {
+        return group_last_reads_[groups_[id]];
+    }
+
+    // Returns true if the buffer of `id` may be a program output.
+    bool Escapes(int id) const {
+        return group_escaped_[groups_[id]];
+    }
+
+    // Returns true if `id` is defined by an op which allocates a new
+    // buffer, i.e., `id` is not a program input, a cached constant, or
+    // a view of another value.
+    bool HasFreshBuffer(int id) const {
+        return fresh_[id];
+    }
+
+private:
+    std::vector<int> region_ends_;
+    std::vector<int> num_defs_;
+    std::vector<bool> fresh_;
+    std::vector<const ChxVMTypeProto*> types_;
+    std::vector<int> groups_;
+    std::vector<int> group_ends_;
+    std::vector<int> group_last_reads_;
+    std::vector<bool> group_escaped_;
+};
+
+struct Buffer {
+    int pc;
+    // The range of instructions [begin, end] during which the buffer
+    // must not be overwritten.
+    int begin;
+    int end;
+    int64_t size;
+    int64_t offset;
+};
+
+// Assigns the lowest offset which fits `buffer` among the gaps left by
+// `placed` buffers with overlapping lifetimes. The smallest gap wins.
+int64_t FindBestFit(const Buffer& buffer, const std::vector<const Buffer*>& placed) {
+    std::vector<const Buffer*> live;
+    for (const Buffer* b : placed) {
+        if (b->begin <= buffer.end && buffer.begin <= b->end) live.push_back(b);
+    }
+    std::sort(live.begin(), live.end(), [](const Buffer* a, const Buffer* b) { return a->offset < b->offset; });
+
+    int64_t best_offset = -1;
+    int64_t best_gap = std::numeric_limits<int64_t>::max();
+    int64_t current = 0;
+    for (const Buffer* b : live) {
+        const int64_t gap = b->offset - current;
+        if (gap >= buffer.size && gap < best_gap) {
+            best_gap = gap;
+            best_offset = current;
+        }
+        current = std::max(current, b->offset + b->size);
+    }
+    return best_offset >= 0 ? best_offset : current;
+}
+
+// Indices of `inputs` whose buffers the output of `inst` may reuse.
+std::vector<int> GetInPlaceCandidates(const ChxVMInstructionProto& inst) {
+    switch (inst.op()) {
+        case ChxVMInstructionProto::Add:
+        case ChxVMInstructionProto::Mul:
+            return {0, 1};
+        case ChxVMInstructionProto::ReluGrad:
+            // Prefer `gy`, which is typically the end of a chain of
+            // gradients.
+            return {1, 0};
+        case ChxVMInstructionProto::Relu:
+        case ChxVMInstructionProto::Sigmoid:
+        case ChxVMInstructionProto::Tanh:
+        case ChxVMInstructionProto::Clip:
+            return {0};
+        default:
+            return {};
+    }
+}
+
+}  // namespace
+
+int MarkInPlaceOutputs(runtime::ChxVMProgramProto* program) {
+    const int num_insts = program->instructions_size();
+    const ValueLifetimes lifetimes(*program);
+
+    int num_marked = 0;
+    for (int pc = 0; pc < num_insts; ++pc) {
+        ChxVMInstructionProto* inst = program->mutable_instructions(pc);
+        if (lifetimes.InRegion(pc) || !CanRunInPlace(inst->op())) continue;
+        if (inst->outputs_size() != 1 || inst->output_types_size() != 1) continue;
+        const ChxVMTypeProto& type = inst->output_types(0);
+        if (GetByteSize(type) < 0) continue;
+
+        for (int index : GetInPlaceCandidates(*inst)) {
+            CHECK_LT(index, inst->inputs_size());
+            const ChxVMValueProto& input = inst->inputs(index);
+            if (input.type() != ChxVMValueProto::ARRAY || input.array() < 0) continue;
+            const int id = input.array();
+            // The buffer must be allocated by the program and must not
+            // be read after this instruction.
+            if (lifetimes.num_defs(id) != 1 || !lifetimes.HasFreshBuffer(id) || lifetimes.Escapes(id)) continue;
+            if (lifetimes.GetLastRead(id) != pc) continue;
+            if (!lifetimes.type(id) || !IsSameType(*lifetimes.type(id), type)) continue;
+            inst->set_inplace_input(index);
+            ++num_marked;
+            break;
+        }
+    }
+    return num_marked;
+}
+
+MemoryPlanStats PlanMemory(runtime::ChxVMProgramProto* program) {
+    const int num_insts = program->instructions_size();
+    const ValueLifetimes lifetimes(*program);
+
+    std::vector<Buffer> buffers;
+    for (int pc = 0; pc < num_insts; ++pc) {
+        const ChxVMInstructionProto& inst = program->instructions(pc);
+        if (lifetimes.InRegion(pc) || !IsPlannable(inst.op()) || inst.inplace_input() >= 0) continue;
+        if (inst.outputs_size() == 0 || inst.output_types_size() == 0) continue;
+        const int id = inst.outputs(0);
+        if (id < 0 || lifetimes.num_defs(id) != 1 || lifetimes.Escapes(id)) continue;
+        const ChxVMTypeProto& type = inst.output_types(0);
+        const int64_t size = GetByteSize(type);
+        if (size <= 0) continue;
+
+        if (IsElementwise(inst.op())) {
+            std::vector<int> inputs;
+            CollectInputIds(inst, &inputs);
+            bool same_types = true;
+            for (int input : inputs) {
+                if (!lifetimes.type(input) || !IsSameType(*lifetimes.type(input), type)) same_types = false;
+            }
+            if (!same_types) continue;
+        }
+
+        const int64_t aligned_size = (size + kAlignment - 1) / kAlignment * kAlignment;
+        buffers.push_back(Buffer{pc, pc, lifetimes.GetBufferEnd(id), aligned_size, -1});
+    }
+
+    // Larger buffers first. Ties are broken by the definition order
+    // so the result is deterministic.
+    std::vector<Buffer*> order;
+    for (Buffer& buffer : buffers) order.push_back(&buffer);
+    std::stable_sort(order.begin(), order.end(), [](const Buffer* a, const Buffer* b) { return a->size > b->size; });
+
+    MemoryPlanStats stats;
+    std::vector<const Buffer*> placed;
+    for (Buffer* buffer : order) {
+        buffer->offset = FindBestFit(*buffer, placed);
+        placed.push_back(buffer);
+        stats.arena_size = std::max(stats.arena_size, buffer->offset + buffer->size);
+    }
+
+    std::vector<int64_t> deltas(num_insts + 1);
+    for (const Buffer& buffer : buffers) {
+        ChxVMInstructionProto* inst = program->mutable_instructions(buffer.pc);
+        if (inst->output_offsets_size() == 0) {
+            for (int i = 0; i < inst->outputs_size(); ++i) inst->add_output_offsets(-1);
+        }
+        inst->set_output_offsets(0, buffer.offset);
+
+        deltas[buffer.begin] += buffer.size;
+        deltas[buffer.end + 1] -= buffer.size;
+        stats.total_size += buffer.size;
+        ++stats.num_planned_arrays;
+    }
+
+    int64_t live_size = 0;
+    for (int64_t delta : deltas) {
+        live_size += delta;
+        stats.naive_peak_size = std::max(stats.naive_peak_size, live_size);
+    }
+
+    program->set_arena_size(stats.arena_size);
+    program->set_naive_peak_size(stats.naive_peak_size);
+    return stats;
+}
+
+}  // namespace chxvm
+}  // namespace chainer_compiler
+
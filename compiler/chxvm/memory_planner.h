@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+namespace chainer_compiler {
+
+namespace runtime {
+class ChxVMProgramProto;
+}
+
+namespace chxvm {
+
+struct MemoryPlanStats {
+    int num_planned_arrays{0};
+    // The size of the arena, i.e., the planned peak.
+    int64_t arena_size{0};
+    // The peak of the total size of live planned arrays when each of
+    // them is allocated separately.
+    int64_t naive_peak_size{0};
+    // The total size of planned arrays without any reuse.
+    int64_t total_size{0};
+};
+
+// Marks element-wise instructions (e.g., Relu and Add) which can write
+// their outputs to the buffer of an input. An input qualifies when it
+// has the same type as the output, is newly allocated by an earlier
+// instruction, is not a program output, and is not read by any later
+// instruction, including through views.
+// Instructions in regions executed by jumps are not marked.
+//
+// The index of the input is stored in `inplace_input` of each
+// instruction. Returns the number of marked instructions.
+int MarkInPlaceOutputs(runtime::ChxVMProgramProto* program);
+
+// Assigns byte offsets in a single arena to statically shaped
+// intermediate arrays of `program`. Lifetimes are computed from the
+// emitted schedule (from the definition to the last instruction which
+// touches the array or any value which may alias it) and offsets are
+// assigned by a greedy best-fit over arrays sorted by size. Arrays
+// which escape as program outputs or are defined in regions executed
+// by jumps are not planned.
+//
+// The result is stored in `output_offsets` of each instruction and
+// `arena_size` of `program`.
+MemoryPlanStats PlanMemory(runtime::ChxVMProgramProto* program);
+
+}  // namespace chxvm
+}  // namespace chainer_compiler
@@ -0,0 +1,236 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <compiler/chxvm/memory_planner.h>
+#include <compiler/dtype.h>
+#include <runtime/chxvm.pb.h>
+
+namespace chainer_compiler {
+namespace {
+
+using runtime::ChxVMInstructionProto;
+using runtime::ChxVMProgramProto;
+using runtime::ChxVMValueProto;
+
+class ProgramBuilder {
+public:
+    ProgramBuilder& In(const std::string& name, int output) {
+        ChxVMInstructionProto* inst = Add(ChxVMInstructionProto::In, {}, {output});
+        ChxVMValueProto* input = inst->add_inputs();
+        input->set_type(ChxVMValueProto::STRING);
+        input->set_s(name);
+        return *this;
+    }
+
+    ProgramBuilder& Out(const std::string& name, int input) {
+        ChxVMInstructionProto* inst = Add(ChxVMInstructionProto::Out, {}, {});
+        ChxVMValueProto* value = inst->add_inputs();
+        value->set_type(ChxVMValueProto::STRING);
+        value->set_s(name);
+        AddArrayInput(inst, input);
+        return *this;
+    }
+
+    ProgramBuilder& Transpose(int input, int output) {
+        ChxVMInstructionProto* inst = Add(ChxVMInstructionProto::Transpose, {input}, {output});
+        ChxVMValueProto* perm = inst->add_inputs();
+        perm->set_type(ChxVMValueProto::INTS);
+        perm->add_ints(0);
+        perm->add_ints(1);
+        return *this;
+    }
+
+    ProgramBuilder& Op(ChxVMInstructionProto::Op op, const std::vector<int>& inputs, const std::vector<int>& outputs) {
+        Add(op, inputs, outputs);
+        return *this;
+    }
+
+    ChxVMProgramProto* program() {
+        return &program_;
+    }
+
+private:
+    static void AddArrayInput(ChxVMInstructionProto* inst, int id) {
+        ChxVMValueProto* input = inst->add_inputs();
+        input->set_type(ChxVMValueProto::ARRAY);
+        input->set_array(id);
+    }
+
+    ChxVMInstructionProto* Add(ChxVMInstructionProto::Op op, const std::vector<int>& inputs, const std::vector<int>& outputs) {
+        ChxVMInstructionProto* inst = program_.add_instructions();
+        inst->set_op(op);
+        for (int id : inputs) AddArrayInput(inst, id);
+        for (int id : outputs) {
+            inst->add_outputs(id);
+            runtime::ChxVMTypeProto* type = inst->add_output_types();
+            type->set_dtype(Dtype::kFloat32);
+            type->add_shape(2);
+            type->add_shape(3);
+        }
+        return inst;
+    }
+
+    ChxVMProgramProto program_;
+};
+
+TEST(MemoryPlannerTest, ReuseDeadBuffer) {
+    ProgramBuilder b;
+    b.In("a", 1)
+            .In("b", 2)
+            .Op(ChxVMInstructionProto::Add, {1, 2}, {3})
+            .Op(ChxVMInstructionProto::Mul, {3, 2}, {4})
+            .Op(ChxVMInstructionProto::Free, {3}, {})
+            .Op(ChxVMInstructionProto::Sub, {4, 2}, {5})
+            .Op(ChxVMInstructionProto::Free, {4}, {})
+            .Op(ChxVMInstructionProto::Add, {5, 1}, {6})
+            .Op(ChxVMInstructionProto::Free, {5}, {})
+            .Out("y", 6)
+            .Op(ChxVMInstructionProto::Free, {6}, {});
+    ChxVMProgramProto* program = b.program();
+
+    chxvm::MemoryPlanStats stats = chxvm::PlanMemory(program);
+    EXPECT_EQ(3, stats.num_planned_arrays);
+    // Each buffer of 24 bytes is aligned to 64 bytes.
+    EXPECT_EQ(128, stats.arena_size);
+    EXPECT_EQ(128, stats.naive_peak_size);
+    EXPECT_EQ(192, stats.total_size);
+    EXPECT_EQ(128, program->arena_size());
+
+    const int64_t offset_3 = program->instructions(2).output_offsets(0);
+    const int64_t offset_4 = program->instructions(3).output_offsets(0);
+    const int64_t offset_5 = program->instructions(5).output_offsets(0);
+    EXPECT_NE(offset_3, offset_4);
+    EXPECT_NE(offset_4, offset_5);
+    // $3 is dead when $5 is computed.
+    EXPECT_EQ(offset_3, offset_5);
+    // $6 is a program output.
+    EXPECT_EQ(0, program->instructions(7).output_offsets_size());
+}
+
+TEST(MemoryPlannerTest, PlanPackedOps) {
+    ProgramBuilder b;
+    b.In("x", 1)
+            .In("packed", 2)
+            .Op(ChxVMInstructionProto::PackedConv, {1, 2}, {3})
+            .Op(ChxVMInstructionProto::PackedLinear, {3, 2}, {4})
+            .Op(ChxVMInstructionProto::Free, {3}, {})
+            .Op(ChxVMInstructionProto::Mul, {4, 1}, {5})
+            .Op(ChxVMInstructionProto::Free, {4}, {})
+            .Out("y", 5)
+            .Op(ChxVMInstructionProto::Free, {5}, {});
+    ChxVMProgramProto* program = b.program();
+
+    chxvm::MemoryPlanStats stats = chxvm::PlanMemory(program);
+    EXPECT_EQ(2, stats.num_planned_arrays);
+    ASSERT_EQ(1, program->instructions(2).output_offsets_size());
+    ASSERT_EQ(1, program->instructions(3).output_offsets_size());
+    // $3 is read by PackedLinear, which writes $4.
+    EXPECT_NE(program->instructions(2).output_offsets(0), program->instructions(3).output_offsets(0));
+    EXPECT_EQ(128, stats.arena_size);
+}
+
+TEST(MemoryPlannerTest, KeepAliasedBuffer) {
+    ProgramBuilder b;
+    b.In("a", 1)
+            .In("b", 2)
+            .Op(ChxVMInstructionProto::Add, {1, 2}, {3})
+            .Transpose(3, 4)
+            .Op(ChxVMInstructionProto::Free, {3}, {})
+            .Op(ChxVMInstructionProto::Mul, {1, 2}, {5})
+            .Op(ChxVMInstructionProto::Sub, {5, 4}, {6})
+            .Op(ChxVMInstructionProto::Free, {4}, {})
+            .Op(ChxVMInstructionProto::Free, {5}, {})
+            .Out("y", 6)
+            .Op(ChxVMInstructionProto::Free, {6}, {});
+    ChxVMProgramProto* program = b.program();
+
+    chxvm::MemoryPlanStats stats = chxvm::PlanMemory(program);
+    EXPECT_EQ(2, stats.num_planned_arrays);
+    // $4 may be a view of $3 so $3 is alive until $4 is freed.
+    EXPECT_NE(program->instructions(2).output_offsets(0), program->instructions(5).output_offsets(0));
+    EXPECT_EQ(128, stats.arena_size);
+}
+
+TEST(MemoryPlannerTest, SkipLoop) {
+    ProgramBuilder b;
+    b.In("a", 1).In("b", 2).Op(ChxVMInstructionProto::Add, {1, 2}, {3});
+    ChxVMInstructionProto* jmp = b.program()->add_instructions();
+    jmp->set_op(ChxVMInstructionProto::Jmp);
+    ChxVMValueProto* pc = jmp->add_inputs();
+    pc->set_type(ChxVMValueProto::INT);
+    pc->set_i(2);
+    b.Op(ChxVMInstructionProto::Free, {3}, {});
+
+    chxvm::MemoryPlanStats stats = chxvm::PlanMemory(b.program());
+    EXPECT_EQ(0, stats.num_planned_arrays);
+    EXPECT_EQ(0, b.program()->arena_size());
+}
+
+TEST(MemoryPlannerTest, MarkInPlaceOutputs) {
+    ProgramBuilder b;
+    b.In("a", 1)
+            .In("b", 2)
+            .Op(ChxVMInstructionProto::Add, {1, 2}, {3})
+            .Op(ChxVMInstructionProto::Relu, {3}, {4})
+            .Op(ChxVMInstructionProto::Free, {3}, {})
+            .Op(ChxVMInstructionProto::Mul, {2, 4}, {5})
+            .Op(ChxVMInstructionProto::Free, {4}, {})
+            .Out("y", 5)
+            .Op(ChxVMInstructionProto::Free, {5}, {});
+    ChxVMProgramProto* program = b.program();
+
+    EXPECT_EQ(2, chxvm::MarkInPlaceOutputs(program));
+    // Program inputs must not be overwritten.
+    EXPECT_EQ(-1, program->instructions(2).inplace_input());
+    EXPECT_EQ(0, program->instructions(3).inplace_input());
+    EXPECT_EQ(1, program->instructions(5).inplace_input());
+}
+
+TEST(MemoryPlannerTest, KeepLiveInput) {
+    ProgramBuilder b;
+    b.In("a", 1)
+            .In("b", 2)
+            .Op(ChxVMInstructionProto::Add, {1, 2}, {3})
+            .Transpose(3, 4)
+            .Op(ChxVMInstructionProto::Relu, {3}, {5})
+            .Op(ChxVMInstructionProto::Free, {3}, {})
+            .Op(ChxVMInstructionProto::Mul, {4, 5}, {6})
+            .Op(ChxVMInstructionProto::Free, {4}, {})
+            .Op(ChxVMInstructionProto::Free, {5}, {})
+            .Out("y", 6)
+            .Op(ChxVMInstructionProto::Free, {6}, {});
+    ChxVMProgramProto* program = b.program();
+
+    EXPECT_EQ(1, chxvm::MarkInPlaceOutputs(program));
+    // $3 is still read through its view $4.
+    EXPECT_EQ(-1, program->instructions(4).inplace_input());
+    // $4 is a view and $5 is written in-place.
+    EXPECT_EQ(1, program->instructions(6).inplace_input());
+}
+
+TEST(MemoryPlannerTest, PlanInPlaceChain) {
+    ProgramBuilder b;
+    b.In("a", 1)
+            .In("b", 2)
+            .Op(ChxVMInstructionProto::Add, {1, 2}, {3})
+            .Op(ChxVMInstructionProto::Relu, {3}, {4})
+            .Op(ChxVMInstructionProto::Free, {3}, {})
+            .Op(ChxVMInstructionProto::Mul, {1, 2}, {5})
+            .Op(ChxVMInstructionProto::Sub, {4, 5}, {6})
+            .Op(ChxVMInstructionProto::Free, {4}, {})
+            .Op(ChxVMInstructionProto::Free, {5}, {})
+            .Out("y", 6)
+            .Op(ChxVMInstructionProto::Free, {6}, {});
+    ChxVMProgramProto* program = b.program();
+
+    EXPECT_EQ(1, chxvm::MarkInPlaceOutputs(program));
+    chxvm::MemoryPlanStats stats = chxvm::PlanMemory(program);
+    EXPECT_EQ(2, stats.num_planned_arrays);
+    // The buffer of $3 is alive as $4 until the Sub.
+    EXPECT_NE(program->instructions(2).output_offsets(0), program->instructions(5).output_offsets(0));
+}
+
+}  // namespace
+}  // namespace chainer_compiler
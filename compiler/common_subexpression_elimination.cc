@@ -0,0 +1,129 @@
+#include "compiler/common_subexpression_elimination.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <compiler/onnx.h>
+
+#include <common/log.h>
+#include <compiler/graph.h>
+#include <compiler/graph_builder.h>
+#include <compiler/log.h>
+#include <compiler/node.h>
+#include <compiler/tensor.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+// Larger constants are not compared as their contents would be
+// copied to keys.
+const int64_t kMaxConstantElementsForCSE = 64;
+
+bool CanEliminate(const Node& node) {
+    if (node.outputs().empty() || !node.GetSubGraphs().empty()) {
+        return false;
+    }
+    switch (node.op_type()) {
+        // Random or stateful ops.
+        case Node::kDropout:
+        case Node::kBatchNormalization:
+        case Node::kChainerPrint:
+        case Node::kChainerDoSomething:
+        case Node::kChainerSequenceConstants:
+            return false;
+
+        case Node::kConstant:
+            return node.tensor_value()->NumElements() <= kMaxConstantElementsForCSE;
+
+        default:
+            return true;
+    }
+}
+
+bool IsCommutative(const Node& node) {
+    switch (node.op_type()) {
+        case Node::kAdd:
+        case Node::kMul:
+        case Node::kSum:
+        case Node::kMax:
+        case Node::kMin:
+        case Node::kAnd:
+        case Node::kOr:
+        case Node::kXor:
+        case Node::kEqual:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Serializes everything of `node` but its name and values.
+std::string GetAttributeKey(const Node& node) {
+    onnx::NodeProto xnode;
+    node.ToONNX(&xnode);
+    xnode.clear_input();
+    xnode.clear_output();
+    xnode.clear_name();
+    xnode.clear_doc_string();
+    // Attributes used only for scheduling.
+    auto* attributes = xnode.mutable_attribute();
+    for (auto it = attributes->begin(); it != attributes->end();) {
+        if (it->name() == "chainer_order" || it->name() == "chainer_fusion_group" || it->name() == "chainer_stream" ||
+            it->name() == "chainer_stream_waits") {
+            it = attributes->erase(it);
+        } else {
+            ++it;
+        }
+    }
+    std::string key = xnode.SerializeAsString();
+    // Null outputs must match, too.
+    for (const Value* output : node.outputs()) {
+        key += output->IsNull() ? '0' : '1';
+    }
+    return key;
+}
+
+void ReplaceNode(Graph* graph, Node* node, Node* replacement) {
+    CLOG() << "CSE " << node->ToString() << " => " << replacement->ToString() << std::endl;
+    std::vector<Value*> outputs = node->outputs();
+    graph->DetachNode(node);
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        Value* from = outputs[i];
+        Value* to = replacement->output(i);
+        if (from->IsNull()) continue;
+        to->mutable_type()->Merge(from->type());
+        const std::vector<Node*> users = from->users();
+        for (Node* user : users) {
+            user->ReplaceInput(from, to);
+        }
+        if (from->IsOutput()) {
+            GraphBuilder gb(graph, "CSE", from);
+            gb.Op(Node::kIdentity, {to}, from);
+        }
+    }
+}
+
+}  // namespace
+
+void EliminateCommonSubexpressions(Graph* graph) {
+    std::map<std::pair<std::vector<Value*>, std::string>, Node*> canonical_nodes;
+    // Users are visited after their inputs are replaced by canonical
+    // values, so a single pass also merges chains of nodes.
+    for (Node* node : graph->GetTopologicallySortedNodes()) {
+        if (!CanEliminate(*node)) continue;
+        std::vector<Value*> inputs = node->inputs();
+        if (IsCommutative(*node)) std::sort(inputs.begin(), inputs.end());
+        auto p = canonical_nodes.emplace(std::make_pair(inputs, GetAttributeKey(*node)), node);
+        if (!p.second) {
+            ReplaceNode(graph, node, p.first->second);
+        }
+    }
+}
+
+}  // namespace chainer_compiler
@@ -0,0 +1,12 @@
+#pragma once
+
+namespace chainer_compiler {
+
+class Graph;
+
+// Merges nodes which compute the same values, i.e., nodes with the
+// same op type, attributes, and inputs. Nodes with side effects or
+// subgraphs are kept.
+void EliminateCommonSubexpressions(Graph* graph);
+
+}  // namespace chainer_compiler
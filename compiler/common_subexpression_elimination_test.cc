@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <compiler/common_subexpression_elimination.h>
+#include <compiler/graph.h>
+#include <compiler/graph_builder.h>
+#include <compiler/node.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+TEST(CommonSubexpressionEliminationTest, Chain) {
+    Type type(Dtype::kFloat32, {2, 3});
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", type);
+    Value* y = graph.AddInputValue("y", type);
+    Value* output = graph.AddOutputValue("output", type);
+    {
+        GraphBuilder gb(&graph, "test", output);
+        Value* t0 = gb.Op(Node::kTranspose, {x});
+        Value* t1 = gb.Op(Node::kTranspose, {x});
+        Value* a0 = gb.Op(Node::kAdd, {t0, y});
+        Value* a1 = gb.Op(Node::kAdd, {y, t1});
+        gb.Op(Node::kMul, {a0, a1}, output);
+    }
+
+    EliminateCommonSubexpressions(&graph);
+    graph.DeleteDetached();
+
+    ASSERT_EQ(3, graph.nodes().size());
+    Node* mul = output->producer();
+    ASSERT_EQ(Node::kMul, mul->op_type());
+    EXPECT_EQ(mul->input(0), mul->input(1));
+    graph.CheckSanity("cse");
+}
+
+TEST(CommonSubexpressionEliminationTest, DifferentAttributes) {
+    Type type(Dtype::kFloat32, {2, 3});
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", type);
+    Value* output = graph.AddOutputValue("output", type);
+    Value* other = graph.AddOutputValue("other", Type());
+    {
+        GraphBuilder gb(&graph, "test", output);
+        Value* r0 = gb.Op(Node::kReduceSum, {x});
+        r0->producer()->set_axes({0});
+        Value* r1 = gb.Op(Node::kReduceSum, {x});
+        r1->producer()->set_axes({1});
+        gb.Op(Node::kAdd, {r0, r1}, output);
+        gb.Op(Node::kReduceSum, {x}, other)->producer()->set_axes({0});
+    }
+
+    EliminateCommonSubexpressions(&graph);
+    graph.DeleteDetached();
+
+    // The third ReduceSum is replaced by an Identity as its output is
+    // a graph output.
+    ASSERT_EQ(4, graph.nodes().size());
+    EXPECT_EQ(Node::kIdentity, other->producer()->op_type());
+    EXPECT_EQ(output->producer()->input(0), other->producer()->input(0));
+    graph.CheckSanity("cse");
+}
+
+}  // namespace
+}  // namespace chainer_compiler
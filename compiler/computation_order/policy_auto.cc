@@ -0,0 +1,176 @@
+#include "compiler/computation_order/policy_auto.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <tuple>
+
+#include <common/log.h>
+#include <compiler/computation_order/policy_chen.h>
+#include <compiler/computation_order/policy_gt.h>
+#include <compiler/flags.h>
+#include <compiler/flops.h>
+#include <compiler/gradient_with_order.h>
+#include <compiler/graph.h>
+#include <compiler/memory_simulator.h>
+#include <compiler/node.h>
+#include <compiler/onnx.h>
+#include <compiler/shape_inference.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+// The number of budgets of Chen's policy, which are spaced
+// logarithmically from the total size of values to the total size
+// divided by the number of nodes.
+constexpr int kNumChenBudgets = 12;
+
+// Budgets of GT policy in tenths of the memory limit minus parameters,
+// as GT policy does not account for parameters.
+constexpr int kGTBudgetRatios[] = {10, 8, 6, 4, 2};
+
+std::vector<Order> NoRecomputePolicy(const Graph& graph) {
+    std::vector<Order> orders;
+    const std::vector<Node*> nodes = graph.GetTopologicallySortedNodes();
+    for (Node* node : nodes) {
+        orders.emplace_back(Order::kComputeForward, node, nullptr);
+    }
+    for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+        orders.emplace_back(Order::kComputeBackward, *it, nullptr);
+    }
+    return orders;
+}
+
+std::vector<Order> RunPolicy(const Graph& graph, const ComputationOrderCandidate& candidate) {
+    if (candidate.policy == "none") {
+        return NoRecomputePolicy(graph);
+    } else if (candidate.policy == "chen") {
+        return ChenPolicy(graph, candidate.budget);
+    } else if (candidate.policy == "gt") {
+        return GTPolicy(graph, candidate.budget);
+    }
+    CHECK(false) << "Unknown policy: " << candidate.policy;
+    return {};
+}
+
+// Adds gradient nodes to a copy of `xgraph` with the order of
+// `candidate` and fills its estimated peak and flops. Returns false
+// if the policy has no order for the budget.
+bool EvaluateCandidate(const onnx::GraphProto& xgraph, ComputationOrderCandidate* candidate) {
+    Graph graph(xgraph);
+    const std::vector<Order> orders = RunPolicy(graph, *candidate);
+    if (orders.empty() || !AddGradientNodesForTrainingWithOrders(&graph, orders)) {
+        return false;
+    }
+    InferAllShapes(&graph);
+    candidate->peak = SimulateMemoryUsage(graph).peak;
+    candidate->flops = CalculateTotalFlops(graph);
+    return true;
+}
+
+std::vector<ComputationOrderCandidate> ListCandidates(const Graph& graph, int64_t memory_limit) {
+    std::vector<ComputationOrderCandidate> candidates;
+    candidates.push_back({"none", 0, -1, -1});
+
+    int64_t total = 0;
+    for (const Node* node : graph.nodes()) {
+        for (const Value* value : node->outputs()) {
+            total += std::max<int64_t>(value->GetNBytes(), 0);
+        }
+    }
+    const double num_nodes = std::max<size_t>(graph.nodes().size(), 2);
+    for (int i = 0; i < kNumChenBudgets; ++i) {
+        const double scale = std::pow(num_nodes, -static_cast<double>(i) / (kNumChenBudgets - 1));
+        const int64_t budget = static_cast<int64_t>(total * scale);
+        if (budget > 0 && budget != candidates.back().budget) {
+            candidates.push_back({"chen", budget, -1, -1});
+        }
+    }
+
+    const int64_t activation_limit = memory_limit - SimulateMemoryUsage(graph).param;
+    if (activation_limit > 0) {
+        for (int ratio : kGTBudgetRatios) {
+            candidates.push_back({"gt", activation_limit * ratio / 10, -1, -1});
+        }
+    }
+    return candidates;
+}
+
+}  // namespace
+
+std::vector<Order> AutoPolicy(
+        const Graph& graph, int64_t memory_limit, std::vector<ComputationOrderCandidate>* candidates, int* chosen) {
+    onnx::GraphProto xgraph;
+    graph.ToONNX(&xgraph);
+
+    std::vector<ComputationOrderCandidate> evaluated;
+    for (ComputationOrderCandidate candidate : ListCandidates(graph, memory_limit)) {
+        if (EvaluateCandidate(xgraph, &candidate)) {
+            evaluated.push_back(candidate);
+        }
+    }
+    CHECK(!evaluated.empty()) << "Computation order is not supported in this graph.";
+
+    // Prefers fitting candidates with less flops, and then ones with
+    // lower peaks.
+    auto key = [memory_limit](const ComputationOrderCandidate& c) {
+        const bool fits = c.peak <= memory_limit;
+        return std::make_tuple(!fits, fits ? c.flops : c.peak, fits ? c.peak : c.flops);
+    };
+    int best = 0;
+    for (size_t i = 1; i < evaluated.size(); ++i) {
+        if (key(evaluated[i]) < key(evaluated[best])) best = i;
+    }
+
+    const ComputationOrderCandidate& best_candidate = evaluated[best];
+    if (best_candidate.peak > memory_limit) {
+        std::cerr << "WARNING: No computation order fits in " << memory_limit << " bytes. The lowest peak is " << best_candidate.peak
+                  << " bytes." << std::endl;
+    }
+
+    const std::vector<Order> orders = RunPolicy(graph, best_candidate);
+    if (candidates) *candidates = evaluated;
+    if (chosen) *chosen = best;
+    return orders;
+}
+
+std::vector<Order> AutoPolicy(const Graph& graph) {
+    CHECK_LT(0, g_computation_order_memory_limit) << "--computation_order_memory_limit is required for --computation_order=auto";
+    const int64_t memory_limit = g_computation_order_memory_limit * 1000000LL;
+    std::vector<ComputationOrderCandidate> candidates;
+    int chosen;
+    const std::vector<Order> orders = AutoPolicy(graph, memory_limit, &candidates, &chosen);
+    ShowComputationOrderCandidates(candidates, chosen, memory_limit);
+    return orders;
+}
+
+void ShowComputationOrderCandidates(const std::vector<ComputationOrderCandidate>& candidates, int chosen, int64_t memory_limit) {
+    // The overhead of recomputation is relative to the order without
+    // recomputation, or the one with the least flops if it is missing.
+    int64_t base_flops = -1;
+    for (const ComputationOrderCandidate& c : candidates) {
+        if (c.policy == "none") {
+            base_flops = c.flops;
+            break;
+        }
+        if (base_flops < 0 || c.flops < base_flops) base_flops = c.flops;
+    }
+
+    std::cerr << "Computation order candidates for memory limit=" << memory_limit / 1000000LL << "MB:" << std::endl;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const ComputationOrderCandidate& c = candidates[i];
+        const double overhead = base_flops > 0 ? 100.0 * (c.flops - base_flops) / base_flops : 0.0;
+        std::ostringstream oss;
+        oss << (static_cast<int>(i) == chosen ? " * " : "   ") << std::setw(4) << std::left << c.policy << std::right;
+        oss << " budget=" << std::setw(6) << c.budget / 1000000LL << "MB peak=" << std::setw(6) << c.peak / 1000000LL
+            << "MB flops=" << c.flops << " recompute=" << std::fixed << std::setprecision(1) << std::showpos << overhead << "%";
+        if (c.peak > memory_limit) oss << " (over limit)";
+        std::cerr << oss.str() << std::endl;
+    }
+}
+
+}  // namespace chainer_compiler
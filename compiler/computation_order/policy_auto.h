@@ -0,0 +1,42 @@
+#pragma once
+
+#include "compiler/computation_order/core.h"
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace chainer_compiler {
+
+// A computation order evaluated by `AutoPolicy`. `peak` and `flops`
+// are estimated by `SimulateMemoryUsage` and `CalculateTotalFlops` of
+// the graph with gradient nodes.
+struct ComputationOrderCandidate {
+    // "none" (no recomputation), "chen", or "gt".
+    std::string policy;
+    // The budget passed to the policy in bytes, or zero for "none".
+    int64_t budget;
+    int64_t peak;
+    int64_t flops;
+};
+
+// Searches budgets of Chen's and GT policies for the order whose peak
+// memory usage fits in `memory_limit` bytes with the least flops. The
+// order with the lowest peak is used if nothing fits. Evaluated
+// candidates are stored to `candidates` in the order they were tried
+// and the index of the chosen one to `chosen` if they are non-null.
+std::vector<Order> AutoPolicy(
+        const Graph& graph,
+        int64_t memory_limit,
+        std::vector<ComputationOrderCandidate>* candidates = nullptr,
+        int* chosen = nullptr);
+
+// Uses `g_computation_order_memory_limit`.
+std::vector<Order> AutoPolicy(const Graph& graph);
+
+// Outputs the trade-off between the peak memory usage and flops of
+// `candidates` to stderr.
+void ShowComputationOrderCandidates(const std::vector<ComputationOrderCandidate>& candidates, int chosen, int64_t memory_limit);
+
+}  // namespace chainer_compiler
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <chainerx/testing/context_session.h>
+
+#include <compiler/computation_order/policy_auto.h>
+#include <compiler/graph.h>
+#include <compiler/node.h>
+#include <compiler/tensor.h>
+#include <compiler/type.h>
+
+namespace chainer_compiler {
+namespace {
+
+// out = Relu(Relu(...Relu(x * w)))
+void BuildReluChain(Graph* graph) {
+    const Type type(Dtype::kFloat32, {1000});
+    Value* x = graph->AddInputValue("x", type);
+    Value* w = graph->AddInputValue("w", type);
+    w->ResetInitializer(std::make_unique<Tensor>("w", Dtype::kFloat32, std::vector<int64_t>{1000}, std::vector<float>(1000, 1.0)));
+    Value* h = graph->AddValue("h0", type);
+    graph->AddNode(Node::kMul, {x, w}, {h});
+    for (int i = 1; i < 8; ++i) {
+        Value* next = graph->AddValue("h" + std::to_string(i), type);
+        graph->AddNode(Node::kRelu, {h}, {next});
+        h = next;
+    }
+    graph->AddNode(Node::kRelu, {h}, {graph->AddOutputValue("out", type)});
+}
+
+TEST(PolicyAutoTest, ChooseLeastFlops) {
+    chainerx::testing::ContextSession sess;
+
+    Graph graph("test");
+    BuildReluChain(&graph);
+    std::vector<ComputationOrderCandidate> candidates;
+    int chosen = -1;
+    AutoPolicy(graph, 1LL << 40, &candidates, &chosen);
+
+    ASSERT_LT(1, candidates.size());
+    ASSERT_EQ("none", candidates[0].policy);
+    ASSERT_LE(0, chosen);
+    ASSERT_GT(candidates.size(), chosen);
+    // Everything fits so no recomputation is necessary.
+    EXPECT_EQ(candidates[0].flops, candidates[chosen].flops);
+    for (const ComputationOrderCandidate& c : candidates) {
+        EXPECT_LE(candidates[0].flops, c.flops);
+        EXPECT_LT(0, c.peak);
+    }
+}
+
+TEST(PolicyAutoTest, FitMemoryLimit) {
+    chainerx::testing::ContextSession sess;
+
+    int64_t min_peak = -1;
+    int64_t none_peak = -1;
+    int64_t none_flops = -1;
+    {
+        Graph graph("test");
+        BuildReluChain(&graph);
+        std::vector<ComputationOrderCandidate> candidates;
+        AutoPolicy(graph, 1LL << 40, &candidates, nullptr);
+        none_peak = candidates[0].peak;
+        none_flops = candidates[0].flops;
+        for (const ComputationOrderCandidate& c : candidates) {
+            if (min_peak < 0 || c.peak < min_peak) min_peak = c.peak;
+        }
+    }
+    // Recomputation saves activations of the chain.
+    ASSERT_GT(none_peak, min_peak);
+
+    Graph graph("test");
+    BuildReluChain(&graph);
+    std::vector<ComputationOrderCandidate> candidates;
+    int chosen = -1;
+    AutoPolicy(graph, min_peak, &candidates, &chosen);
+    ASSERT_LE(0, chosen);
+    EXPECT_NE("none", candidates[chosen].policy);
+    EXPECT_GE(min_peak, candidates[chosen].peak);
+    EXPECT_LT(none_flops, candidates[chosen].flops);
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -1,106 +1,157 @@
 // In this code, we implement sublinear memory cost policy proposed in `https://arxiv.org/abs/1604.06174`.
 #include "compiler/computation_order/policy_chen.h"
+#include "compiler/computation_order/policy_chen_internal.h"
 
 #include <algorithm>
-#include <cmath>
 #include <iostream>
 #include <map>
-#include <numeric>
-#include <queue>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 #include <compiler/flags.h>
 #include <compiler/graph.h>
+#include <compiler/log.h>
 #include <compiler/node.h>
 
 namespace chainer_compiler {
 
-std::set<Node*> FindArticulationPoints(const Graph& graph) {
+// Tarjan's algorithm. The DFS uses an explicit stack for deep graphs.
+std::vector<char> FindArticulationPoints(const std::vector<Node*>& nodes) {
     // Convert to consise representation (undirected graph)
-    std::vector<Node*> nodes = graph.nodes();
     const size_t n = nodes.size();
-    std::map<Node*, size_t> node_ids;
+    std::unordered_map<Node*, size_t> node_ids;
     for (size_t i = 0; i < n; ++i) {
         node_ids.emplace(nodes[i], i);
     }
     std::vector<std::vector<size_t>> adj(n);
-
-    for (Node* node : graph.nodes()) {
-        for (Value* output : node->outputs()) {
+    for (size_t i = 0; i < n; ++i) {
+        for (Value* output : nodes[i]->outputs()) {
             for (Node* user : output->users()) {
                 // There is an edge (node, user)
-                size_t i = node_ids[node], j = node_ids[user];
-                adj[i].push_back(j);
-                adj[j].push_back(i);
+                auto found = node_ids.find(user);
+                if (found == node_ids.end()) continue;
+                adj[i].push_back(found->second);
+                adj[found->second].push_back(i);
             }
         }
     }
 
-    std::set<Node*> articulation_points;
-    // In this implementation, we try naive approach to enumerate articulation points
-    for (size_t i = 0; i < n; ++i) {
-        // Check connectivity after the removal of node i
-        std::vector<size_t> visited(n);
-        std::queue<size_t> q;
-        q.push((i + 1) % n);
-        while (!q.empty()) {
-            size_t j = q.front();
-            q.pop();
-            if (visited[j]) continue;
-            visited[j] = 1;
-
-            for (size_t k : adj[j]) {
-                if (k == i || visited[k]) continue;
-                q.push(k);
+    // `order` is the 1-origin preorder of DFS and `low` is the lowest
+    // preorder reachable by a back edge from the subtree.
+    std::vector<size_t> order(n), low(n), parent(n, n), next_edge(n);
+    std::vector<char> is_articulation(n);
+    std::vector<size_t> stack;
+    size_t num_visited = 0;
+    for (size_t root = 0; root < n; ++root) {
+        if (order[root]) continue;
+        order[root] = low[root] = ++num_visited;
+        size_t num_root_children = 0;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            const size_t v = stack.back();
+            if (next_edge[v] < adj[v].size()) {
+                const size_t w = adj[v][next_edge[v]++];
+                if (!order[w]) {
+                    parent[w] = v;
+                    order[w] = low[w] = ++num_visited;
+                    stack.push_back(w);
+                    if (v == root) ++num_root_children;
+                } else if (w != parent[v]) {
+                    low[v] = std::min(low[v], order[w]);
+                }
+                continue;
             }
+
+            stack.pop_back();
+            if (v == root) continue;
+            const size_t p = parent[v];
+            low[p] = std::min(low[p], low[v]);
+            // No vertex in the subtree of `v` reaches above `p`.
+            if (p != root && low[v] >= order[p]) is_articulation[p] = 1;
         }
-        if (std::accumulate(visited.begin(), visited.end(), 0) < n - 1) {
-            articulation_points.insert(nodes[i]);
-        }
+        if (num_root_children > 1) is_articulation[root] = 1;
     }
-    return articulation_points;
+    return is_articulation;
 }
 
-std::vector<Order> ChenPolicy(const Graph& graph) {
-    int64_t budget = g_chen_budget * 1000000LL;
-    if (g_chen_budget == 0) {
-        // default budget = sqrt of total memory
-        for (Node* node : graph.nodes()) {
-            for (Value* value : node->outputs()) {
-                budget += value->GetNBytes();
+namespace {
+
+// Prefix sums of sizes of outputs of topologically sorted nodes.
+class SegmentCostTable {
+public:
+    explicit SegmentCostTable(const std::vector<Node*>& sorted) : prefix_(sorted.size() + 1) {
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            int64_t bytes = 0;
+            for (const Value* output : sorted[i]->outputs()) {
+                bytes += std::max<int64_t>(output->GetNBytes(), 0);
             }
+            prefix_[i + 1] = prefix_[i] + bytes;
         }
-        budget = budget / static_cast<int64_t>(std::sqrt(graph.nodes().size()));
-        std::cout << "Budget = " << budget / 1000000LL << " MB is used." << std::endl;
     }
 
-    std::vector<Order> orders;
+    // The total size of outputs of nodes in [begin, end).
+    int64_t Cost(size_t begin, size_t end) const {
+        return prefix_[end] - prefix_[begin];
+    }
 
-    std::vector<Node*> sorted = graph.GetTopologicallySortedNodes();
+    size_t size() const {
+        return prefix_.size() - 1;
+    }
 
-    // find blocks to split
-    std::set<Node*> split_candidates = FindArticulationPoints(graph);
-    std::vector<Node*> splits;
-    std::vector<size_t> split_indices;
+private:
+    std::vector<int64_t> prefix_;
+};
+
+// Splits at candidates (sorted indices) where the segment since the
+// last split would exceed `budget`. Each split is the last node of
+// its segment.
+std::vector<size_t> SplitByBudget(const SegmentCostTable& table, const std::vector<size_t>& candidates, int64_t budget) {
+    std::vector<size_t> splits;
+    size_t begin = 0;
+    for (size_t i : candidates) {
+        if (table.Cost(begin, i + 1) > budget) {
+            splits.push_back(i);
+            begin = i + 1;
+        }
+    }
+    return splits;
+}
+
+// Estimates the peak memory usage of backprop with `splits` by the
+// outputs of splits, which are kept until the backward computation,
+// and the largest segment, which is recomputed at once.
+int64_t EstimatePeak(const SegmentCostTable& table, const std::vector<size_t>& splits) {
+    int64_t kept = 0;
+    int64_t largest = 0;
+    size_t begin = 0;
+    for (size_t i : splits) {
+        kept += table.Cost(i, i + 1);
+        largest = std::max(largest, table.Cost(begin, i + 1));
+        begin = i + 1;
+    }
+    largest = std::max(largest, table.Cost(begin, table.size()));
+    return kept + largest;
+}
 
-    int64_t sum = 0;
+std::vector<size_t> GetSplitCandidates(const std::vector<Node*>& sorted) {
+    const std::vector<char> is_articulation = FindArticulationPoints(sorted);
+    std::vector<size_t> candidates;
     for (size_t i = 0; i < sorted.size(); ++i) {
-        Node* node = sorted[i];
+        if (is_articulation[i]) candidates.push_back(i);
+    }
+    return candidates;
+}
 
-        int64_t consumption = 0;
-        for (const Value* output : node->outputs()) {
-            consumption += output->GetNBytes();
-        }
-        if (split_candidates.count(node) && sum + consumption > budget) {
-            splits.push_back(node);
-            split_indices.push_back(i);
-            sum = 0;
-        } else {
-            sum += consumption;
-        }
+std::vector<Order> ComputeOrders(const std::vector<Node*>& sorted, const std::vector<size_t>& split_indices) {
+    std::vector<Order> orders;
+    std::vector<Node*> splits;
+    std::vector<char> is_split(sorted.size());
+    for (size_t i : split_indices) {
+        splits.push_back(sorted[i]);
+        is_split[i] = 1;
     }
-    for (auto s : splits) std::cout << "Split at " << s->ToString() << std::endl;
+    for (auto s : splits) CLOG() << "Split at " << s->ToString() << std::endl;
 
     // Determine nodes that should be retained after forward propagation
     std::map<Value*, size_t> generation;
@@ -141,7 +192,7 @@ std::vector<Order> ChenPolicy(const Graph& graph) {
     for (size_t i = 0; i < sorted.size(); ++i) {
         Node* node = sorted[i];
         orders.emplace_back(Order::kComputeForward, node, nullptr);
-        if (std::count(splits.begin(), splits.end(), node) > 0) {
+        if (is_split[i]) {
             // split point -> perform forgetting
             for (size_t j = last_split; j < i; ++j) {
                 for (Value* value : sorted[j]->outputs()) {
@@ -189,4 +240,43 @@ std::vector<Order> ChenPolicy(const Graph& graph) {
     return orders;
 }
 
+}  // namespace
+
+std::vector<Order> ChenPolicy(const Graph& graph, int64_t budget) {
+    const std::vector<Node*> sorted = graph.GetTopologicallySortedNodes();
+    const SegmentCostTable table(sorted);
+    return ComputeOrders(sorted, SplitByBudget(table, GetSplitCandidates(sorted), budget));
+}
+
+std::vector<Order> ChenPolicy(const Graph& graph) {
+    const std::vector<Node*> sorted = graph.GetTopologicallySortedNodes();
+    const SegmentCostTable table(sorted);
+    const std::vector<size_t> candidates = GetSplitCandidates(sorted);
+    if (g_chen_budget) {
+        return ComputeOrders(sorted, SplitByBudget(table, candidates, g_chen_budget * 1000000LL));
+    }
+
+    // Try budgets from the total size down to the largest output and
+    // use the one with the lowest estimated peak.
+    int64_t largest_output = 1;
+    for (size_t i = 0; i < table.size(); ++i) {
+        largest_output = std::max(largest_output, table.Cost(i, i + 1));
+    }
+    int64_t best_budget = table.Cost(0, table.size());
+    std::vector<size_t> best_splits = SplitByBudget(table, candidates, best_budget);
+    int64_t best_peak = EstimatePeak(table, best_splits);
+    for (int64_t budget = best_budget * 9 / 10; budget >= largest_output; budget = budget * 9 / 10) {
+        std::vector<size_t> splits = SplitByBudget(table, candidates, budget);
+        const int64_t peak = EstimatePeak(table, splits);
+        if (peak < best_peak) {
+            best_budget = budget;
+            best_peak = peak;
+            best_splits.swap(splits);
+        }
+    }
+    CLOG() << "Budget = " << best_budget / 1000000LL << " MB is used (estimated peak = " << best_peak / 1000000LL << " MB)."
+           << std::endl;
+    return ComputeOrders(sorted, best_splits);
+}
+
 }  // namespace chainer_compiler
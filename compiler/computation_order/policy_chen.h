@@ -2,10 +2,19 @@
 
 #include "compiler/computation_order/core.h"
 
+#include <stdint.h>
+
 #include <vector>
 
 namespace chainer_compiler {
 
+// Splits the graph at articulation points so that the total size of
+// outputs of each segment does not exceed `budget` bytes.
+std::vector<Order> ChenPolicy(const Graph& graph, int64_t budget);
+
+// Uses `g_chen_budget`, or the budget with the lowest estimated peak
+// memory among budgets from the total size down to the largest output
+// when it is zero.
 std::vector<Order> ChenPolicy(const Graph& graph);
 
 }  // namespace chainer_compiler
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vector>
+
+namespace chainer_compiler {
+
+class Node;
+
+// Internal functions of ChenPolicy, which are exposed only for tests.
+
+// Returns flags which are true for articulation points of `nodes` in
+// the undirected graph of their data dependencies.
+std::vector<char> FindArticulationPoints(const std::vector<Node*>& nodes);
+
+}  // namespace chainer_compiler
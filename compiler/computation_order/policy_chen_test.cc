@@ -0,0 +1,171 @@
+#include <map>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <common/strutil.h>
+#include <compiler/computation_order/policy_chen.h>
+#include <compiler/computation_order/policy_chen_internal.h>
+#include <compiler/flags.h>
+#include <compiler/graph.h>
+#include <compiler/node.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+// Each value is 1MB, which is the unit of --chen_budget.
+const Type kType(Dtype::kFloat32, {250000});
+
+// out = Relu(Relu(...Relu(x)))
+void BuildChain(Graph* graph, int length) {
+    Value* h = graph->AddInputValue("x", kType);
+    for (int i = 0; i < length; ++i) {
+        Value* next = graph->AddValue("h" + std::to_string(i), kType);
+        graph->AddNode(Node::kRelu, {h}, {next});
+        h = next;
+    }
+    graph->AddNode(Node::kRelu, {h}, {graph->AddOutputValue("out", kType)});
+}
+
+// h_{i+1} = h_i + Relu(Relu(h_i))
+void BuildResidual(Graph* graph, int num_blocks) {
+    Value* x = graph->AddInputValue("x", kType);
+    Value* h = graph->AddValue("h0", kType);
+    graph->AddNode(Node::kRelu, {x}, {h});
+    for (int i = 0; i < num_blocks; ++i) {
+        const std::string suffix = std::to_string(i);
+        Value* a = graph->AddValue("a" + suffix, kType);
+        Value* b = graph->AddValue("b" + suffix, kType);
+        Value* next = graph->AddValue("h" + std::to_string(i + 1), kType);
+        graph->AddNode(Node::kRelu, {h}, {a});
+        graph->AddNode(Node::kRelu, {a}, {b});
+        graph->AddNode(Node::kAdd, {h, b}, {next});
+        h = next;
+    }
+    graph->AddNode(Node::kRelu, {h}, {graph->AddOutputValue("out", kType)});
+}
+
+// A connected DAG whose first node reads `x` and each other node reads
+// an output of an earlier node and, for Add, one more value.
+void BuildRandomDAG(Graph* graph, int num_nodes, std::mt19937* rng) {
+    std::vector<Value*> values = {graph->AddInputValue("x", kType)};
+    for (int i = 0; i < num_nodes; ++i) {
+        Value* output = graph->AddValue("v" + std::to_string(i), kType);
+        Value* input = values[i == 0 ? 0 : std::uniform_int_distribution<int>(1, i)(*rng)];
+        if ((*rng)() % 2) {
+            Value* other = values[std::uniform_int_distribution<int>(0, i)(*rng)];
+            graph->AddNode(Node::kAdd, {input, other}, {output});
+        } else {
+            graph->AddNode(Node::kRelu, {input}, {output});
+        }
+        values.push_back(output);
+    }
+}
+
+// Finds articulation points by checking the connectivity after
+// removing each node.
+std::vector<char> FindArticulationPointsNaively(const std::vector<Node*>& nodes) {
+    const size_t n = nodes.size();
+    std::map<Node*, size_t> node_ids;
+    for (size_t i = 0; i < n; ++i) node_ids.emplace(nodes[i], i);
+    std::vector<std::vector<size_t>> adj(n);
+    for (size_t i = 0; i < n; ++i) {
+        for (Value* output : nodes[i]->outputs()) {
+            for (Node* user : output->users()) {
+                adj[i].push_back(node_ids.at(user));
+                adj[node_ids.at(user)].push_back(i);
+            }
+        }
+    }
+
+    std::vector<char> is_articulation(n);
+    for (size_t i = 0; i < n; ++i) {
+        std::vector<char> visited(n);
+        size_t num_visited = 0;
+        std::queue<size_t> q;
+        q.push((i + 1) % n);
+        while (!q.empty()) {
+            const size_t j = q.front();
+            q.pop();
+            if (visited[j]) continue;
+            visited[j] = 1;
+            ++num_visited;
+            for (size_t k : adj[j]) {
+                if (k != i && !visited[k]) q.push(k);
+            }
+        }
+        is_articulation[i] = num_visited + 1 < n;
+    }
+    return is_articulation;
+}
+
+// Formats `orders` as "F:<output>" for forward computation,
+// "B:<output>" for backward computation, and "f:<value>" for
+// forgetting.
+std::string FormatOrders(const std::vector<Order>& orders) {
+    std::vector<std::string> strs;
+    for (const Order& order : orders) {
+        switch (order.kind) {
+            case Order::kComputeForward:
+                strs.push_back("F:" + order.node->output(0)->name());
+                break;
+            case Order::kComputeBackward:
+                strs.push_back("B:" + order.node->output(0)->name());
+                break;
+            case Order::kForgetForward:
+                strs.push_back("f:" + order.value->name());
+                break;
+            default:
+                ADD_FAILURE() << order;
+        }
+    }
+    return JoinString(strs, " ");
+}
+
+TEST(PolicyChenTest, ArticulationPoints) {
+    std::mt19937 rng(42);
+    for (int num_nodes = 2; num_nodes <= 12; ++num_nodes) {
+        for (int trial = 0; trial < 50; ++trial) {
+            Graph graph("test");
+            BuildRandomDAG(&graph, num_nodes, &rng);
+            const std::vector<Node*> nodes = graph.GetTopologicallySortedNodes();
+            ASSERT_EQ(static_cast<size_t>(num_nodes), nodes.size());
+            EXPECT_EQ(FindArticulationPointsNaively(nodes), FindArticulationPoints(nodes)) << num_nodes << " nodes, trial " << trial;
+        }
+    }
+}
+
+// The expected orders below are the ones by the policy before the
+// budget was chosen automatically.
+TEST(PolicyChenTest, Chain) {
+    g_chen_budget = 3;
+    Graph graph("test");
+    BuildChain(&graph, 8);
+    // Splits at h3 and h7, where the segments would exceed 3MB.
+    EXPECT_EQ(
+            "F:h0 F:h1 F:h2 F:h3 f:h0 f:h1 f:h2 F:h4 F:h5 F:h6 F:h7 f:h4 f:h5 f:h6 F:out f:out "
+            "F:out B:out F:h4 F:h5 F:h6 B:h7 B:h6 B:h5 B:h4 F:h0 F:h1 F:h2 B:h3 B:h2 B:h1 B:h0",
+            FormatOrders(ChenPolicy(graph)));
+    g_chen_budget = 0;
+}
+
+TEST(PolicyChenTest, Residual) {
+    g_chen_budget = 3;
+    Graph graph("test");
+    BuildResidual(&graph, 2);
+    // Only Add nodes are articulation points. The second block
+    // fits in the budget after the split at h1.
+    EXPECT_EQ(
+            "F:h0 F:a0 F:b0 F:h1 f:h0 f:a0 f:b0 F:a1 F:b1 F:h2 F:out f:a1 f:b1 f:h2 f:out "
+            "F:a1 F:b1 F:h2 F:out B:out B:h2 B:b1 B:a1 F:h0 F:a0 F:b0 B:h1 B:b0 B:a0 B:h0",
+            FormatOrders(ChenPolicy(graph)));
+    g_chen_budget = 0;
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -1,93 +1,156 @@
 // Implementation of "A Graph Theoretic Framework of Recomputation Algorithms"
 // https://arxiv.org/abs/1905.11722
 #include "compiler/computation_order/policy_gt.h"
+#include "compiler/computation_order/policy_gt_internal.h"
 
-#include <numeric>
-#include <queue>
+#include <stdint.h>
 
+#include <algorithm>
+#include <bitset>
+#include <iostream>
+#include <vector>
+#include <tuple>
+#include <unordered_map>
+
+#include <common/log.h>
 #include <compiler/flags.h>
 #include <compiler/flops.h>
+#include <compiler/graph.h>
+#include <compiler/node.h>
+#include <compiler/value.h>
 #include <runtime/meminfo.h>
 
-typedef std::vector<char> NodeSet;
-
 namespace chainer_compiler {
 
-struct SimpleGraph {
-    // Simple representation of computational graph
-    size_t n;
-    std::vector<Value*> value_list;
-    std::map<Value*, size_t> value_ids;
-    std::vector<std::vector<size_t>> adj;  // adj[i] is a list of vertices adjacent from the vertex i
-    std::vector<int64_t> memories;
-    std::vector<int64_t> flopses;
+namespace {
+
+// Lower sets are enumerated only for this many values spread over the
+// topological order of larger graphs, which makes the DP approximate.
+constexpr size_t kMaxLowerSets = 1000;
+
+// The number of (flops, memory) states kept for each lower set. Only
+// Pareto optimal states are kept, and they are thinned out evenly
+// when there are more of them, which makes the DP approximate.
+constexpr size_t kMaxStatesPerLowerSet = 1024;
+
+// A set of values in `SimpleGraph` as a bitset.
+class NodeSet {
+public:
+    NodeSet() = default;
+
+    explicit NodeSet(size_t n) : words_((n + 63) / 64) {
+    }
+
+    bool Get(size_t i) const {
+        return (words_[i / 64] >> (i % 64)) & 1;
+    }
+
+    void Set(size_t i) {
+        words_[i / 64] |= uint64_t(1) << (i % 64);
+    }
+
+    size_t Count() const {
+        size_t count = 0;
+        for (uint64_t word : words_) count += std::bitset<64>(word).count();
+        return count;
+    }
 
-    std::string ToString() const {
-        std::string s;
-        for (size_t i = 0; i < n; ++i) {
-            s += "[" + std::to_string(i) + "] => " + value_list[i]->ToString() + "\n";
-            s += "      MEM=" + std::to_string(memories[i]) + " FLOPS=" + std::to_string(flopses[i]) + "\n";
+    bool IsSubsetOf(const NodeSet& other) const {
+        for (size_t i = 0; i < words_.size(); ++i) {
+            if (words_[i] & ~other.words_[i]) return false;
         }
-        s += "Edges:\n";
-        for (size_t i = 0; i < n; ++i) {
-            for (const int j : adj[i]) {
-                s += " " + std::to_string(i) + " -> " + std::to_string(j) + "\n";
+        return true;
+    }
+
+    NodeSet Minus(const NodeSet& other) const {
+        NodeSet ret(*this);
+        for (size_t i = 0; i < words_.size(); ++i) ret.words_[i] &= ~other.words_[i];
+        return ret;
+    }
+
+    // Calls `fn` with elements in the ascending order.
+    template <class Fn>
+    void ForEach(Fn fn) const {
+        for (size_t i = 0; i < words_.size(); ++i) {
+            for (uint64_t word = words_[i]; word; word &= word - 1) {
+                const uint64_t lowest = word & (~word + 1);
+                fn(i * 64 + std::bitset<64>(lowest - 1).count());
             }
         }
-        return s;
     }
-};
 
-size_t Size(const NodeSet& set) {
-    return std::accumulate(set.begin(), set.end(), 0UL);
-}
+    int64_t Sum(const std::vector<int64_t>& costs) const {
+        int64_t total = 0;
+        ForEach([&costs, &total](size_t i) { total += costs[i]; });
+        return total;
+    }
 
-bool IsIncreasing(const NodeSet& ls, const NodeSet& ls_next) {
-    // Check if ls < ls_next.
-    for (size_t i = 0; i < ls.size(); ++i) {
-        if (ls[i] > ls_next[i]) return false;
+    // The sum of `costs` of elements in both `this` and `other`.
+    int64_t SumOfIntersection(const NodeSet& other, const std::vector<int64_t>& costs) const {
+        int64_t total = 0;
+        for (size_t i = 0; i < words_.size(); ++i) {
+            for (uint64_t word = words_[i] & other.words_[i]; word; word &= word - 1) {
+                const uint64_t lowest = word & (~word + 1);
+                total += costs[i * 64 + std::bitset<64>(lowest - 1).count()];
+            }
+        }
+        return total;
     }
-    return true;
-}
 
-NodeSet SetMinus(const NodeSet& ls1, const NodeSet& ls2) {
-    // Compute (L1 \setminus L2)
-    const size_t n = ls1.size();
-    NodeSet ret(n);
-    for (size_t i = 0; i < n; ++i) ret[i] = ls1[i] && !ls2[i];
-    return ret;
-}
+private:
+    std::vector<uint64_t> words_;
+};
+
+struct SimpleGraph {
+    // Simple representation of computational graph
+    size_t n;
+    std::vector<Value*> value_list;
+    std::unordered_map<Value*, size_t> value_ids;
+    std::vector<std::vector<size_t>> adj;  // adj[i] is a list of vertices adjacent from the vertex i
+    std::vector<std::vector<size_t>> radj;  // radj[i] is a list of vertices adjacent to the vertex i
+    std::vector<int64_t> memories;
+    std::vector<int64_t> flopses;
+};
+
+// A lower set with costs which do not depend on the previous lower set
+// in the DP.
+struct LowerSet {
+    NodeSet set;
+    size_t size;
+    int64_t memory;
+    int64_t flops;
+    // Values in `set` used by values out of `set`.
+    NodeSet boundary;
+    int64_t boundary_memory;
+    int64_t boundary_flops;
+    // The memory of values out of `set` used by or using values in
+    // `set` to compute the backward of `set`.
+    int64_t outside_memory;
+};
 
 NodeSet DeltaPlus(const SimpleGraph& sg, const NodeSet& ls) {
-    const size_t n = ls.size();
-    NodeSet ret(n);
-    for (size_t i = 0; i < n; ++i) {
-        if (ls[i]) {
-            for (size_t j : sg.adj[i]) ret[j] = 1;
-        }
-    }
+    NodeSet ret(sg.n);
+    ls.ForEach([&sg, &ret](size_t i) {
+        for (size_t j : sg.adj[i]) ret.Set(j);
+    });
     return ret;
 }
 
 NodeSet DeltaMinus(const SimpleGraph& sg, const NodeSet& ls) {
-    const size_t n = ls.size();
-    NodeSet ret(n);
-    for (size_t i = 0; i < n; ++i) {
-        for (size_t j : sg.adj[i]) {
-            if (ls[j]) ret[i] = 1;
-        }
-    }
+    NodeSet ret(sg.n);
+    ls.ForEach([&sg, &ret](size_t i) {
+        for (size_t j : sg.radj[i]) ret.Set(j);
+    });
     return ret;
 }
 
 NodeSet Boundary(const SimpleGraph& sg, const NodeSet& ls) {
-    const size_t n = ls.size();
-    NodeSet ret(n);
-    for (size_t i = 0; i < n; ++i) {
+    NodeSet ret(sg.n);
+    ls.ForEach([&sg, &ls, &ret](size_t i) {
         for (size_t j : sg.adj[i]) {
-            if (!ls[j] && ls[i]) ret[i] = 1;
+            if (!ls.Get(j)) ret.Set(i);
         }
-    }
+    });
     return ret;
 }
 
@@ -108,6 +171,7 @@ SimpleGraph GetSimpleFormGraph(const Graph& graph) {
     sg.n = sg.value_ids.size();
 
     sg.adj.assign(sg.n, std::vector<size_t>());
+    sg.radj.assign(sg.n, std::vector<size_t>());
 
     for (Node* node : graph.nodes()) {
         for (Value* input : node->inputs()) {
@@ -116,6 +180,7 @@ SimpleGraph GetSimpleFormGraph(const Graph& graph) {
                 const auto out_it = sg.value_ids.find(output);
                 if (in_it != sg.value_ids.end() && out_it != sg.value_ids.end()) {
                     sg.adj[in_it->second].push_back(out_it->second);
+                    sg.radj[out_it->second].push_back(in_it->second);
                 }
             }
         }
@@ -129,9 +194,9 @@ SimpleGraph GetSimpleFormGraph(const Graph& graph) {
 
     sg.flopses.assign(sg.n, 0);
     for (Node* node : graph.nodes()) {
+        const int64_t f = CalculateFlops(*node);
         for (Value* output : node->outputs()) {
             const size_t out_id = sg.value_ids[output];
-            const int64_t f = CalculateFlops(*node);
             sg.flopses[out_id] = f;
         }
     }
@@ -139,40 +204,74 @@ SimpleGraph GetSimpleFormGraph(const Graph& graph) {
     return sg;
 }
 
-std::vector<NodeSet> EnumerateLowerSets(const SimpleGraph& sg) {
-    std::vector<NodeSet> lower_sets;
-    lower_sets.push_back(NodeSet(sg.n, 0));  // Empty node set
-    lower_sets.push_back(NodeSet(sg.n, 1));  // Entire node set
-
-    // Run BFS n times
-    // reachable[i][j] == 1 iff there is a path from i to j
-    std::vector<std::vector<char>> reachable(sg.n, std::vector<char>(sg.n, 0));
+// Returns up to `max_values` values evenly spread over the
+// topological order, or all values.
+std::vector<size_t> PickRepresentatives(const SimpleGraph& sg, size_t max_values) {
+    std::vector<size_t> sorted;
+    std::vector<size_t> num_preds(sg.n);
+    for (size_t i = 0; i < sg.n; ++i) num_preds[i] = sg.radj[i].size();
     for (size_t i = 0; i < sg.n; ++i) {
-        std::queue<size_t> q;
-        q.push(i);
-        while (!q.empty()) {
-            size_t j = q.front();
-            q.pop();
-            if (reachable[i][j]) continue;
-            reachable[i][j] = 1;
-            for (size_t k : sg.adj[j]) q.push(k);
+        if (!num_preds[i]) sorted.push_back(i);
+    }
+    for (size_t k = 0; k < sorted.size(); ++k) {
+        for (size_t j : sg.adj[sorted[k]]) {
+            if (--num_preds[j] == 0) sorted.push_back(j);
         }
     }
+    CHECK_EQ(sg.n, sorted.size()) << "Graph has a cycle?";
+    if (sorted.size() <= max_values) return sorted;
+
+    std::vector<size_t> picked;
+    for (size_t k = 0; k < max_values; ++k) {
+        picked.push_back(sorted[(k + 1) * sorted.size() / max_values - 1]);
+    }
+    return picked;
+}
 
-    for (size_t j = 0; j < sg.n; ++j) {
-        // Add representative lower sets
+LowerSet MakeLowerSet(const SimpleGraph& sg, NodeSet set) {
+    LowerSet ls;
+    ls.set = std::move(set);
+    ls.size = ls.set.Count();
+    ls.memory = ls.set.Sum(sg.memories);
+    ls.flops = ls.set.Sum(sg.flopses);
+    ls.boundary = Boundary(sg, ls.set);
+    ls.boundary_memory = ls.boundary.Sum(sg.memories);
+    ls.boundary_flops = ls.boundary.Sum(sg.flopses);
+    const NodeSet deltaplus = DeltaPlus(sg, ls.set);
+    const NodeSet memory_set3 = deltaplus.Minus(ls.set);
+    const NodeSet memory_set4 = DeltaMinus(sg, deltaplus).Minus(ls.set);
+    ls.outside_memory = memory_set3.Sum(sg.memories) + memory_set4.Sum(sg.memories);
+    return ls;
+}
+
+std::vector<LowerSet> EnumerateLowerSets(const SimpleGraph& sg) {
+    std::vector<LowerSet> lower_sets;
+    NodeSet entire(sg.n);
+    for (size_t i = 0; i < sg.n; ++i) entire.Set(i);
+    lower_sets.push_back(MakeLowerSet(sg, NodeSet(sg.n)));  // Empty node set
+    lower_sets.push_back(MakeLowerSet(sg, entire));  // Entire node set
+
+    // Add representative lower sets, i.e., values from which j is
+    // reachable, by BFS on reversed edges.
+    std::vector<size_t> q;
+    for (size_t j : PickRepresentatives(sg, kMaxLowerSets - 2)) {
         NodeSet ls(sg.n);
-        for (size_t i = 0; i < sg.n; ++i) ls[i] = reachable[i][j];
-        lower_sets.push_back(ls);
+        ls.Set(j);
+        q.assign(1, j);
+        while (!q.empty()) {
+            const size_t k = q.back();
+            q.pop_back();
+            for (size_t i : sg.radj[k]) {
+                if (ls.Get(i)) continue;
+                ls.Set(i);
+                q.push_back(i);
+            }
+        }
+        lower_sets.push_back(MakeLowerSet(sg, std::move(ls)));
     }
 
     // Sort the lower sets by their size
-    std::sort(lower_sets.begin(), lower_sets.end(), [](NodeSet& a, NodeSet& b) {
-        size_t asum = 0, bsum = 0;
-        for (char e : a) asum += e;
-        for (char e : b) bsum += e;
-        return asum < bsum;
-    });
+    std::stable_sort(lower_sets.begin(), lower_sets.end(), [](const LowerSet& a, const LowerSet& b) { return a.size < b.size; });
 
     return lower_sets;
 }
@@ -195,101 +294,136 @@ void DiscretizeFlops(SimpleGraph* sg) {
     }
 
     for (int64_t& flops : sg->flopses) {
-        flops = (flops + high - 1) / high;
+        flops = std::max<int64_t>((flops + high - 1) / high, 0);
     }
 }
 
-std::tuple<int64_t, int64_t, size_t> ComputeConsumptionInfo(const SimpleGraph& sg, const NodeSet& ls, const NodeSet& ls_next) {
+std::tuple<int64_t, int64_t, size_t> ComputeConsumptionInfo(const SimpleGraph& sg, const LowerSet& ls, const LowerSet& ls_next) {
     // Returns {MemoryCost1, MemoryCost2+3+4, FlopsCost}.
-    const NodeSet boundary = Boundary(sg, ls_next);
-    const NodeSet vs = SetMinus(ls_next, ls);
-    const NodeSet deltaplus = DeltaPlus(sg, ls_next);
-
-    const NodeSet flops_set = SetMinus(vs, boundary);
-    const NodeSet memory_set1 = SetMinus(boundary, ls);
-    const NodeSet memory_set3 = SetMinus(deltaplus, ls_next);
-    const NodeSet memory_set4 = SetMinus(DeltaMinus(sg, deltaplus), ls_next);
+    // As `ls` is a subset of `ls_next`, costs of `vs` (ls_next \ ls)
+    // and `boundary \ ls` are differences of sums.
+    const int64_t boundary_memory_in_ls = ls_next.boundary.SumOfIntersection(ls.set, sg.memories);
+    const int64_t boundary_flops_in_ls = ls_next.boundary.SumOfIntersection(ls.set, sg.flopses);
 
-    auto compute_cost = [](const NodeSet& set, const std::vector<int64_t>& costs) {
-        int64_t total = 0;
-        for (size_t i = 0; i < set.size(); ++i) {
-            if (set[i]) total += costs[i];
-        }
-        return total;
-    };
-
-    const int64_t flops = compute_cost(flops_set, sg.flopses);
-    const int64_t mem1 = compute_cost(memory_set1, sg.memories);
-    const int64_t mem234 =
-            2 * compute_cost(vs, sg.memories) + compute_cost(memory_set3, sg.memories) + compute_cost(memory_set4, sg.memories);
+    // vs \ boundary
+    const int64_t flops = (ls_next.flops - ls.flops) - (ls_next.boundary_flops - boundary_flops_in_ls);
+    // boundary \ ls
+    const int64_t mem1 = ls_next.boundary_memory - boundary_memory_in_ls;
+    const int64_t mem234 = 2 * (ls_next.memory - ls.memory) + ls_next.outside_memory;
 
     return std::make_tuple(mem1, mem234, flops);
 }
 
-std::vector<NodeSet> ComputeDP(const SimpleGraph& sg, const std::vector<NodeSet>& lower_sets, const int64_t& budget) {
-    size_t nl = lower_sets.size();
-    // opt[lower_set_index][flops] := <minimum memory consumption, prev_ls, prev_flops>
-    std::vector<std::map<size_t, std::tuple<int64_t, size_t, size_t>>> opt(nl);
-    opt[0][0] = std::make_tuple(0, nl + 1, 0);
+// A state of the DP for a lower set.
+struct DPState {
+    size_t flops;
+    // The minimum memory consumption for `flops`.
+    int64_t memory;
+    size_t prev_ls;
+    size_t prev_flops;
+};
+
+// Removes states which need more memory than another state with less
+// flops and thins them out to `kMaxStatesPerLowerSet`. `states` must
+// be sorted by flops.
+void PruneStates(std::vector<DPState>* states) {
+    std::vector<DPState> pruned;
+    for (const DPState& state : *states) {
+        if (pruned.empty() || state.memory < pruned.back().memory) pruned.push_back(state);
+    }
 
-    for (size_t i = 0; i < nl; ++i) {
-        const NodeSet& ls = lower_sets[i];
-        for (size_t i_next = i + 1; i_next < nl; ++i_next) {
-            const NodeSet& ls_next = lower_sets[i_next];
-            if (!IsIncreasing(ls, ls_next)) continue;
+    if (pruned.size() > kMaxStatesPerLowerSet) {
+        // Keep the ones with the least flops and the least memory.
+        std::vector<DPState> thinned;
+        for (size_t i = 0; i < pruned.size(); ++i) {
+            if (i * (kMaxStatesPerLowerSet - 1) / (pruned.size() - 1) == thinned.size()) thinned.push_back(pruned[i]);
+        }
+        pruned.swap(thinned);
+    }
+    states->swap(pruned);
+}
+
+// Returns the sequence of indices of lower sets from the empty set to
+// the entire set with the least flops in `budget`, or an empty vector.
+std::vector<size_t> ComputeDP(const SimpleGraph& sg, const std::vector<LowerSet>& lower_sets, const int64_t& budget) {
+    const size_t nl = lower_sets.size();
+    // opt[lower_set_index] := states sorted by flops
+    std::vector<std::vector<DPState>> opt(nl);
+    opt[0].push_back({0, 0, nl + 1, 0});
+
+    // The flops of a sequence is at most the sum of flops of values,
+    // so the states of the next lower set are gathered in an array
+    // indexed by flops.
+    size_t max_flops = 0;
+    for (int64_t flops : sg.flopses) max_flops += flops;
+    std::vector<DPState> next_states(max_flops + 1);
+    std::vector<char> has_next_state(max_flops + 1);
+    std::vector<size_t> next_flopses;
+
+    for (size_t i_next = 1; i_next < nl; ++i_next) {
+        const LowerSet& ls_next = lower_sets[i_next];
+        for (size_t i = 0; i < i_next; ++i) {
+            const LowerSet& ls = lower_sets[i];
+            if (opt[i].empty() || !ls.set.IsSubsetOf(ls_next.set)) continue;
 
             const auto info = ComputeConsumptionInfo(sg, ls, ls_next);
             const int64_t additional_memory1 = std::get<0>(info);
             const int64_t additional_memory234 = std::get<1>(info);
             const size_t additional_flops = std::get<2>(info);
 
-            for (const auto& p : opt[i]) {
-                const size_t flops = p.first;
-                const int64_t memopt = std::get<0>(p.second);
-                const int64_t total_memory = memopt + additional_memory234;
-                if (total_memory > budget) continue;
-
-                const size_t flops_next = flops + additional_flops;
-                const int64_t memopt_next = memopt + additional_memory1;
-
-                auto next_opt_it = opt[i_next].find(flops_next);
-
-                if (next_opt_it == opt[i_next].end()) {
-                    opt[i_next].insert({flops_next, std::make_tuple(memopt_next, i, flops)});
-                } else if (std::get<0>(next_opt_it->second) > memopt_next) {
-                    next_opt_it->second = std::make_tuple(memopt_next, i, flops);
+            // As states need less memory for more flops after
+            // pruning, ones which fit in the budget come last.
+            for (auto it = opt[i].rbegin(); it != opt[i].rend(); ++it) {
+                const int64_t total_memory = it->memory + additional_memory234;
+                if (total_memory > budget) break;
+
+                const size_t flops_next = it->flops + additional_flops;
+                const int64_t memopt_next = it->memory + additional_memory1;
+                DPState* next = &next_states[flops_next];
+                if (!has_next_state[flops_next]) {
+                    has_next_state[flops_next] = 1;
+                    next_flopses.push_back(flops_next);
+                    *next = {flops_next, memopt_next, i, it->flops};
+                } else if (next->memory > memopt_next) {
+                    *next = {flops_next, memopt_next, i, it->flops};
                 }
             }
         }
+
+        std::sort(next_flopses.begin(), next_flopses.end());
+        for (size_t flops : next_flopses) {
+            opt[i_next].push_back(next_states[flops]);
+            has_next_state[flops] = 0;
+        }
+        next_flopses.clear();
+        PruneStates(&opt[i_next]);
     }
 
-    std::vector<NodeSet> seq;
-    const auto last_it = opt[nl - 1].begin();
-    if (last_it != opt[nl - 1].end()) {
+    std::vector<size_t> seq;
+    if (!opt[nl - 1].empty()) {
         size_t i = nl - 1;
-        size_t flops = last_it->first;
+        size_t flops = opt[nl - 1].front().flops;
 
         while (i < nl) {
-            seq.push_back(lower_sets[i]);
-            const auto it = opt[i].find(flops);
-            i = std::get<1>(it->second);
-            flops = std::get<2>(it->second);
+            seq.push_back(i);
+            const auto it = std::lower_bound(
+                    opt[i].begin(), opt[i].end(), flops, [](const DPState& state, size_t f) { return state.flops < f; });
+            CHECK(it != opt[i].end() && it->flops == flops);
+            i = it->prev_ls;
+            flops = it->prev_flops;
         }
         std::reverse(seq.begin(), seq.end());
     }
     return seq;
 }
 
-std::vector<Order> ComputeOrder(const Graph& graph, const SimpleGraph& sg, const std::vector<NodeSet>& seq) {
+std::vector<Order> ComputeOrder(const Graph& graph, const SimpleGraph& sg, const std::vector<const LowerSet*>& seq) {
     CHECK_GT(seq.size(), 0) << "seq should be non-empty";
 
-    std::map<Value*, size_t> block_index;
+    std::unordered_map<Value*, size_t> block_index;
     for (size_t i = 0; i + 1 < seq.size(); ++i) {
-        NodeSet set = SetMinus(seq[i + 1], seq[i]);
-        for (size_t k = 0; k < sg.n; ++k) {
-            if (!set[k]) continue;
-            block_index.insert({sg.value_list[k], i});
-        }
+        const NodeSet set = seq[i + 1]->set.Minus(seq[i]->set);
+        set.ForEach([&sg, &block_index, i](size_t k) { block_index.emplace(sg.value_list[k], i); });
     }
 
     const std::vector<Node*> sorted = graph.GetTopologicallySortedNodes();
@@ -309,9 +443,8 @@ std::vector<Order> ComputeOrder(const Graph& graph, const SimpleGraph& sg, const
             forget_sets[i] = NodeSet(sg.n);
             continue;
         }
-        const NodeSet boundary = Boundary(sg, seq[i + 1]);
-        const NodeSet nonboundary = SetMinus(seq[i + 1], boundary);
-        forget_sets[i] = SetMinus(nonboundary, seq[i]);
+        const NodeSet nonboundary = seq[i + 1]->set.Minus(seq[i + 1]->boundary);
+        forget_sets[i] = nonboundary.Minus(seq[i]->set);
     }
 
     std::vector<Order> orders;
@@ -324,11 +457,7 @@ std::vector<Order> ComputeOrder(const Graph& graph, const SimpleGraph& sg, const
             orders.emplace_back(Order::kComputeForward, producer, nullptr);
         }
         // Forget non-boundary values
-        for (size_t k = 0; k < sg.n; ++k) {
-            if (!forget_sets[i][k]) continue;
-            Value* forget_value = sg.value_list[k];
-            orders.emplace_back(Order::kForgetForward, nullptr, forget_value);
-        }
+        forget_sets[i].ForEach([&sg, &orders](size_t k) { orders.emplace_back(Order::kForgetForward, nullptr, sg.value_list[k]); });
     }
 
     // Backward part
@@ -336,7 +465,7 @@ std::vector<Order> ComputeOrder(const Graph& graph, const SimpleGraph& sg, const
         // Recompute forgotten values
         for (Value* value : blocks[i]) {
             const size_t k = sg.value_ids.find(value)->second;
-            if (!forget_sets[i][k]) continue;
+            if (!forget_sets[i].Get(k)) continue;
 
             Node* producer = value->producer();
             CHECK(producer);
@@ -354,6 +483,8 @@ std::vector<Order> ComputeOrder(const Graph& graph, const SimpleGraph& sg, const
     return orders;
 }
 
+}  // namespace
+
 int64_t AutomaticBudgetDetection() {
     runtime::g_meminfo_enabled = true;
     auto info = runtime::GetMemoryUsageInBytes();
@@ -363,18 +494,41 @@ int64_t AutomaticBudgetDetection() {
         return info->second - 3 * info->first;
 }
 
-std::vector<Order> GTPolicy(const Graph& graph) {
-    const int64_t budget = (g_gt_budget ? (g_gt_budget * 1000000LL) : AutomaticBudgetDetection());
-    std::cerr << "GT budget=" << budget << " bytes" << std::endl;
+std::vector<Order> GTPolicyWithSegments(const Graph& graph, int64_t budget, std::vector<std::vector<Value*>>* segments) {
     SimpleGraph sg = GetSimpleFormGraph(graph);
 
     DiscretizeFlops(&sg);
 
-    const std::vector<NodeSet> lower_sets = EnumerateLowerSets(sg);
-    const std::vector<NodeSet> seq = ComputeDP(sg, lower_sets, budget);
+    const std::vector<LowerSet> lower_sets = EnumerateLowerSets(sg);
+    const std::vector<size_t> seq = ComputeDP(sg, lower_sets, budget);
+    if (seq.empty()) return {};
+
+    std::vector<const LowerSet*> seq_sets;
+    for (size_t i : seq) seq_sets.push_back(&lower_sets[i]);
+    const std::vector<Order> orders = ComputeOrder(graph, sg, seq_sets);
+
+    if (segments) {
+        segments->clear();
+        for (size_t i = 0; i + 1 < seq_sets.size(); ++i) {
+            segments->emplace_back();
+            seq_sets[i + 1]->set.Minus(seq_sets[i]->set).ForEach([&sg, segments](size_t k) {
+                segments->back().push_back(sg.value_list[k]);
+            });
+        }
+    }
+
+    return orders;
+}
 
-    const std::vector<Order> orders = ComputeOrder(graph, sg, seq);
+std::vector<Order> GTPolicy(const Graph& graph, int64_t budget) {
+    return GTPolicyWithSegments(graph, budget, nullptr);
+}
 
+std::vector<Order> GTPolicy(const Graph& graph) {
+    const int64_t budget = (g_gt_budget ? (g_gt_budget * 1000000LL) : AutomaticBudgetDetection());
+    std::cerr << "GT budget=" << budget << " bytes" << std::endl;
+    const std::vector<Order> orders = GTPolicy(graph, budget);
+    CHECK(!orders.empty()) << "No computation order fits in GT budget=" << budget << " bytes";
     return orders;
 }
 
@@ -2,10 +2,16 @@
 
 #include "compiler/computation_order/core.h"
 
+#include <stdint.h>
+
 #include <vector>
 
 namespace chainer_compiler {
 
+// Returns an empty vector when no order fits in `budget` bytes.
+std::vector<Order> GTPolicy(const Graph& graph, int64_t budget);
+
+// Uses `g_gt_budget`, or the free device memory when it is zero.
 std::vector<Order> GTPolicy(const Graph& graph);
 
 }  // namespace chainer_compiler
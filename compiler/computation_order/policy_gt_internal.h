@@ -0,0 +1,18 @@
+#pragma once
+
+#include "compiler/computation_order/core.h"
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace chainer_compiler {
+
+// Internal functions of GTPolicy, which are exposed only for tests.
+
+// The same as `GTPolicy(graph, budget)`, but also stores the values
+// computed in each segment of the chosen sequence of lower sets to
+// `segments` if it is non-null.
+std::vector<Order> GTPolicyWithSegments(const Graph& graph, int64_t budget, std::vector<std::vector<Value*>>* segments);
+
+}  // namespace chainer_compiler
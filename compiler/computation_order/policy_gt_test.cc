@@ -0,0 +1,383 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <bitset>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <common/log.h>
+#include <compiler/computation_order/policy_gt.h>
+#include <compiler/computation_order/policy_gt_internal.h>
+#include <compiler/graph.h>
+#include <compiler/node.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+// All values have the same size and flops, so the flops of a sequence
+// of lower sets is the number of values it computes.
+const Type kType(Dtype::kFloat32, {1000});
+
+// out = Relu(Relu(...Relu(x)))
+void BuildChain(Graph* graph, int length) {
+    Value* h = graph->AddInputValue("x", kType);
+    for (int i = 0; i < length; ++i) {
+        Value* next = graph->AddValue("h" + std::to_string(i), kType);
+        graph->AddNode(Node::kRelu, {h}, {next});
+        h = next;
+    }
+    graph->AddNode(Node::kRelu, {h}, {graph->AddOutputValue("out", kType)});
+}
+
+// h_{i+1} = h_i + Relu(Relu(h_i))
+void BuildResidual(Graph* graph, int num_blocks) {
+    Value* x = graph->AddInputValue("x", kType);
+    Value* h = graph->AddValue("h0", kType);
+    graph->AddNode(Node::kRelu, {x}, {h});
+    for (int i = 0; i < num_blocks; ++i) {
+        const std::string suffix = std::to_string(i);
+        Value* a = graph->AddValue("a" + suffix, kType);
+        Value* b = graph->AddValue("b" + suffix, kType);
+        Value* next = graph->AddValue("h" + std::to_string(i + 1), kType);
+        graph->AddNode(Node::kRelu, {h}, {a});
+        graph->AddNode(Node::kRelu, {a}, {b});
+        graph->AddNode(Node::kAdd, {h, b}, {next});
+        h = next;
+    }
+    graph->AddNode(Node::kRelu, {h}, {graph->AddOutputValue("out", kType)});
+}
+
+// Two chains which add values of each other.
+void BuildLadder(Graph* graph, int length) {
+    Value* x = graph->AddInputValue("x", kType);
+    Value* l = graph->AddValue("l0", kType);
+    Value* r = graph->AddValue("r0", kType);
+    graph->AddNode(Node::kRelu, {x}, {l});
+    graph->AddNode(Node::kRelu, {l}, {r});
+    for (int i = 1; i < length; ++i) {
+        const std::string suffix = std::to_string(i);
+        Value* next_l = graph->AddValue("l" + suffix, kType);
+        Value* next_r = graph->AddValue("r" + suffix, kType);
+        graph->AddNode(Node::kRelu, {l}, {next_l});
+        graph->AddNode(Node::kAdd, {r, next_l}, {next_r});
+        l = next_l;
+        r = next_r;
+    }
+    graph->AddNode(Node::kAdd, {l, r}, {graph->AddOutputValue("out", kType)});
+}
+
+// The cost model of `GTPolicy` on values which are not inputs of a
+// small graph. Sets of values are bitsets.
+class GTModel {
+public:
+    explicit GTModel(const Graph& graph) {
+        std::vector<Value*> values(graph.temp_values());
+        for (Value* value : graph.output_values()) values.push_back(value);
+        CHECK_GE(64, values.size());
+        for (size_t i = 0; i < values.size(); ++i) ids_.emplace(values[i], i);
+        num_values_ = values.size();
+        value_bytes_ = kType.GetNBytes();
+        succs_.resize(num_values_);
+        preds_.resize(num_values_);
+        for (const Node* node : graph.nodes()) {
+            for (Value* input : node->inputs()) {
+                for (Value* output : node->outputs()) {
+                    auto in_found = ids_.find(input);
+                    auto out_found = ids_.find(output);
+                    if (in_found == ids_.end() || out_found == ids_.end()) continue;
+                    succs_[in_found->second] |= Bit(out_found->second);
+                    preds_[out_found->second] |= Bit(in_found->second);
+                }
+            }
+        }
+    }
+
+    // Returns the least flops by the DP without thinning out states
+    // over all lower sets `GTPolicy` considers, or -1 if no sequence
+    // fits in `budget`.
+    int64_t SolveExactly(int64_t budget) const {
+        std::vector<uint64_t> sets = {0, Full()};
+        for (size_t i = 0; i < num_values_; ++i) sets.push_back(Ancestors(i));
+        std::sort(sets.begin(), sets.end());
+        sets.erase(std::unique(sets.begin(), sets.end()), sets.end());
+        std::stable_sort(sets.begin(), sets.end(), [](uint64_t a, uint64_t b) { return Count(a) < Count(b); });
+
+        // The least memory for each flops of each lower set.
+        std::map<uint64_t, std::map<int64_t, int64_t>> states;
+        states[0][0] = 0;
+        for (uint64_t next : sets) {
+            for (uint64_t ls : sets) {
+                if (ls == next || (ls & ~next) || !states.count(ls)) continue;
+                int64_t memory1, memory234, flops;
+                Transit(ls, next, &memory1, &memory234, &flops);
+                for (const auto& p : states[ls]) {
+                    if (p.second + memory234 > budget) continue;
+                    auto inserted = states[next].emplace(p.first + flops, p.second + memory1);
+                    inserted.first->second = std::min(inserted.first->second, p.second + memory1);
+                }
+            }
+        }
+        auto found = states.find(Full());
+        return found == states.end() ? -1 : found->second.begin()->first;
+    }
+
+    // Returns the flops of the sequence of lower sets which compute
+    // `segments` in order, or -1 if it is not a valid sequence in
+    // `budget`.
+    int64_t Evaluate(const std::vector<std::vector<Value*>>& segments, int64_t budget) const {
+        uint64_t ls = 0;
+        int64_t memory = 0;
+        int64_t total_flops = 0;
+        for (const std::vector<Value*>& segment : segments) {
+            uint64_t next = ls;
+            for (Value* value : segment) next |= Bit(ids_.at(value));
+            for (size_t i = 0; i < num_values_; ++i) {
+                if ((next & Bit(i)) && (preds_[i] & ~next)) return -1;
+            }
+            int64_t memory1, memory234, flops;
+            Transit(ls, next, &memory1, &memory234, &flops);
+            if (memory + memory234 > budget) return -1;
+            memory += memory1;
+            total_flops += flops;
+            ls = next;
+        }
+        return ls == Full() ? total_flops : -1;
+    }
+
+private:
+    static uint64_t Bit(size_t i) {
+        return uint64_t(1) << i;
+    }
+
+    static int64_t Count(uint64_t set) {
+        return std::bitset<64>(set).count();
+    }
+
+    uint64_t Full() const {
+        return num_values_ == 64 ? ~uint64_t(0) : Bit(num_values_) - 1;
+    }
+
+    // The values from which `i` is reachable, including `i`.
+    uint64_t Ancestors(size_t i) const {
+        uint64_t set = Bit(i);
+        for (uint64_t prev = 0; prev != set;) {
+            prev = set;
+            for (size_t j = 0; j < num_values_; ++j) {
+                if (set & Bit(j)) set |= preds_[j];
+            }
+        }
+        return set;
+    }
+
+    uint64_t Neighbors(uint64_t set, const std::vector<uint64_t>& edges) const {
+        uint64_t neighbors = 0;
+        for (size_t i = 0; i < num_values_; ++i) {
+            if (set & Bit(i)) neighbors |= edges[i];
+        }
+        return neighbors;
+    }
+
+    // Values in `set` used by values out of `set`.
+    uint64_t Boundary(uint64_t set) const {
+        uint64_t boundary = 0;
+        for (size_t i = 0; i < num_values_; ++i) {
+            if ((set & Bit(i)) && (succs_[i] & ~set)) boundary |= Bit(i);
+        }
+        return boundary;
+    }
+
+    int64_t Memory(uint64_t set) const {
+        return Count(set) * value_bytes_;
+    }
+
+    // The memory which stays after `ls_next` is computed from `ls`,
+    // the memory which is needed temporarily, and the flops.
+    void Transit(uint64_t ls, uint64_t ls_next, int64_t* memory1, int64_t* memory234, int64_t* flops) const {
+        const uint64_t computed = ls_next & ~ls;
+        const uint64_t boundary = Boundary(ls_next);
+        const uint64_t delta_plus = Neighbors(ls_next, succs_);
+        const uint64_t delta_minus = Neighbors(delta_plus, preds_);
+        *memory1 = Memory(boundary & ~ls);
+        *memory234 = 2 * Memory(computed) + Memory(delta_plus & ~ls_next) + Memory(delta_minus & ~ls_next);
+        *flops = Count(computed & ~boundary);
+    }
+
+    std::map<Value*, size_t> ids_;
+    size_t num_values_;
+    int64_t value_bytes_;
+    std::vector<uint64_t> succs_;
+    std::vector<uint64_t> preds_;
+};
+
+// Returns true if values are alive when they are used by `orders` and
+// every node is differentiated once.
+bool IsValidSchedule(const Graph& graph, const std::vector<Order>& orders) {
+    std::set<Value*> alive(graph.input_values().begin(), graph.input_values().end());
+    std::map<Node*, int> num_backwards;
+    for (const Order& order : orders) {
+        switch (order.kind) {
+            case Order::kComputeForward:
+                for (Value* input : order.node->inputs()) {
+                    if (!alive.count(input)) return false;
+                }
+                for (Value* output : order.node->outputs()) alive.insert(output);
+                break;
+            case Order::kForgetForward:
+                if (!alive.erase(order.value)) return false;
+                break;
+            case Order::kComputeBackward:
+                for (Value* value : order.node->inputs()) {
+                    if (!alive.count(value)) return false;
+                }
+                for (Value* value : order.node->outputs()) {
+                    if (!alive.count(value)) return false;
+                }
+                ++num_backwards[order.node];
+                break;
+            default:
+                return false;
+        }
+    }
+    for (Node* node : graph.nodes()) {
+        if (num_backwards[node] != 1) return false;
+    }
+    return true;
+}
+
+// Returns the peak memory of computing `segments` in order by the cost
+// model of `GTPolicy`, or -1 if they are not a sequence of lower sets
+// which ends with all values. Unlike `GTModel`, this works for graphs
+// of any size.
+int64_t SimulatePeak(const Graph& graph, const std::vector<std::vector<Value*>>& segments) {
+    std::set<Value*> values(graph.temp_values().begin(), graph.temp_values().end());
+    values.insert(graph.output_values().begin(), graph.output_values().end());
+    auto succs = [&values](Value* value) {
+        std::set<Value*> found;
+        for (Node* user : value->users()) {
+            for (Value* output : user->outputs()) {
+                if (values.count(output)) found.insert(output);
+            }
+        }
+        return found;
+    };
+    auto preds = [&values](Value* value) {
+        std::set<Value*> found;
+        for (Value* input : value->producer()->inputs()) {
+            if (values.count(input)) found.insert(input);
+        }
+        return found;
+    };
+    auto bytes_out_of = [](const std::set<Value*>& set, const std::set<Value*>& excluded) {
+        int64_t bytes = 0;
+        for (Value* value : set) {
+            if (!excluded.count(value)) bytes += value->GetNBytes();
+        }
+        return bytes;
+    };
+
+    std::set<Value*> ls;
+    int64_t memory = 0;
+    int64_t peak = 0;
+    for (const std::vector<Value*>& segment : segments) {
+        std::set<Value*> next(ls);
+        int64_t computed_bytes = 0;
+        for (Value* value : segment) {
+            if (!next.insert(value).second) return -1;
+            computed_bytes += value->GetNBytes();
+        }
+        std::set<Value*> boundary, delta_plus, delta_minus;
+        for (Value* value : next) {
+            for (Value* pred : preds(value)) {
+                if (!next.count(pred)) return -1;
+            }
+            for (Value* succ : succs(value)) {
+                if (!next.count(succ)) boundary.insert(value);
+                delta_plus.insert(succ);
+            }
+        }
+        for (Value* value : delta_plus) {
+            for (Value* pred : preds(value)) delta_minus.insert(pred);
+        }
+        const int64_t memory234 = 2 * computed_bytes + bytes_out_of(delta_plus, next) + bytes_out_of(delta_minus, next);
+        peak = std::max(peak, memory + memory234);
+        memory += bytes_out_of(boundary, ls);
+        ls.swap(next);
+    }
+    return ls == values ? peak : -1;
+}
+
+// Compares `GTPolicy` with the exact DP for budgets from zero to
+// enough for keeping everything.
+void CheckAgainstExactDP(const Graph& graph) {
+    const GTModel model(graph);
+    const int64_t step = kType.GetNBytes();
+    const int64_t max_budget = 4 * step * (graph.temp_values().size() + graph.output_values().size());
+    int num_budgets = 0;
+    int num_feasible = 0;
+    for (int64_t budget = 0; budget <= max_budget; budget += step) {
+        SCOPED_TRACE(budget);
+        ++num_budgets;
+        std::vector<std::vector<Value*>> segments;
+        const std::vector<Order> orders = GTPolicyWithSegments(graph, budget, &segments);
+        const int64_t expected = model.SolveExactly(budget);
+        if (expected < 0) {
+            EXPECT_TRUE(orders.empty());
+            continue;
+        }
+        ++num_feasible;
+        ASSERT_FALSE(orders.empty());
+        EXPECT_EQ(expected, model.Evaluate(segments, budget));
+        EXPECT_TRUE(IsValidSchedule(graph, orders));
+    }
+    EXPECT_LT(0, num_feasible);
+    EXPECT_GT(num_budgets, num_feasible);
+}
+
+TEST(PolicyGTTest, Chain) {
+    Graph graph("test");
+    BuildChain(&graph, 10);
+    CheckAgainstExactDP(graph);
+}
+
+TEST(PolicyGTTest, Residual) {
+    Graph graph("test");
+    BuildResidual(&graph, 4);
+    CheckAgainstExactDP(graph);
+}
+
+TEST(PolicyGTTest, Ladder) {
+    Graph graph("test");
+    BuildLadder(&graph, 6);
+    CheckAgainstExactDP(graph);
+}
+
+// With more values than `kMaxLowerSets`, the DP considers only the
+// lower sets of some values. With the larger budget, Pareto optimal
+// states of some lower sets are more than `kMaxStatesPerLowerSet` and
+// they are thinned out.
+TEST(PolicyGTTest, LargeResidual) {
+    Graph graph("test");
+    BuildResidual(&graph, 400);
+    const size_t num_values = graph.temp_values().size() + graph.output_values().size();
+    ASSERT_LT(1000, num_values);
+    const int64_t total_bytes = kType.GetNBytes() * num_values;
+    for (int64_t budget : {total_bytes / 5, total_bytes}) {
+        SCOPED_TRACE(budget);
+        std::vector<std::vector<Value*>> segments;
+        const std::vector<Order> orders = GTPolicyWithSegments(graph, budget, &segments);
+        ASSERT_FALSE(orders.empty());
+        EXPECT_TRUE(IsValidSchedule(graph, orders));
+        const int64_t peak = SimulatePeak(graph, segments);
+        EXPECT_LT(0, peak);
+        EXPECT_GE(budget, peak);
+    }
+}
+
+}  // namespace
+}  // namespace chainer_compiler
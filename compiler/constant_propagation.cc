@@ -1,112 +1,246 @@
 #include "compiler/constant_propagation.h"
 
+#include <map>
+#include <memory>
+#include <queue>
+#include <set>
 #include <vector>
 
+#include <common/log.h>
 #include <compiler/evaluator.h>
+#include <compiler/flags.h>
 #include <compiler/graph.h>
 #include <compiler/graph_builder.h>
 #include <compiler/log.h>
 #include <compiler/node.h>
 #include <compiler/tensor.h>
+#include <compiler/type.h>
 #include <compiler/value.h>
 
 namespace chainer_compiler {
 
 namespace {
 
-bool HasConstantInputsOnly(const Node& node) {
-    if (node.inputs().empty()) return false;
-    for (Value* input : node.inputs()) {
-        if (input->producer() &&
-            (input->producer()->op_type() == Node::kConstant || input->producer()->op_type() == Node::kChainerSequenceConstants)) {
-        } else {
-            return false;
-        }
-    }
-    return true;
-}
-
-void DoConstantPropagation(Graph* graph, Node* node) {
-    CLOG() << "Propagate " << node->ToString() << std::endl;
-    std::vector<Node*> inputs;
-    std::set<Value*> seen_inputs;
-    for (Value* input : node->inputs()) {
-        if (seen_inputs.insert(input).second) {
-            inputs.push_back(input->producer());
-        }
-    }
-
-    std::vector<std::unique_ptr<EvaluatedValue>> next_values;
-    std::vector<Node*> nodes = inputs;
-    nodes.push_back(node);
-    Eval(nodes, node->outputs(), &next_values);
-
-    for (size_t i = 0; i < next_values.size(); ++i) {
-        auto& next_value = next_values[i];
-        GraphBuilder gb(graph, "Const", node->output(i));
-        if (next_value->is_tensor()) {
-            gb.Op(Node::kConstant, {}, node->output(i))->producer()->set_tensor_value(next_value->ReleaseTensor());
-        } else {
-            gb.Op(Node::kChainerSequenceConstants, {}, node->output(i))->producer()->set_tensor_values(next_value->ReleaseSequence());
-        }
-    }
-
-    graph->DetachNode(node);
-    for (Node* input : inputs) {
-        Value* output = input->output(0);
-        // Detach node if the value is not uesd by other ops nor a
-        // graph output.
-        if (output->users().empty() && !output->IsOutput()) {
-            graph->DetachNode(input);
-        }
-    }
+bool IsConstant(const Node* node) {
+    return node && (node->op_type() == Node::kConstant || node->op_type() == Node::kChainerSequenceConstants);
 }
 
-bool MaybePropagateConstant(Graph* graph, Node* node) {
-    switch (node->op_type()) {
-        // TODO(hamaji): Handle more ops.
+// Ops which are deterministic and have no side effects.
+bool IsFoldable(const Node& node) {
+    switch (node.op_type()) {
+        case Node::kAbs:
         case Node::kAdd:
+        case Node::kAnd:
+        case Node::kArgMax:
+        case Node::kArgMin:
         case Node::kCast:
+        case Node::kCeil:
+        case Node::kChainerGenericAdd:
+        case Node::kChainerGenericGetItem:
+        case Node::kChainerGenericGetSlice:
         case Node::kChainerGenericIs:
         case Node::kChainerGenericLen:
         case Node::kChainerSequenceAppend:
         case Node::kChainerSequenceConcat:
         case Node::kChainerSequenceCreate:
+        case Node::kChainerSequenceExtend:
+        case Node::kChainerSequenceGetSlice:
+        case Node::kChainerSequenceLengths:
+        case Node::kChainerSequenceLookup:
         case Node::kChainerSequenceRange:
+        case Node::kChainerSequenceSize:
         case Node::kChainerSequenceStack:
+        case Node::kClip:
         case Node::kConcat:
+        case Node::kConstantOfShape:
         case Node::kDiv:
+        case Node::kDynamicSlice:
+        case Node::kEqual:
+        case Node::kExp:
         case Node::kExpand:
+        case Node::kFlatten:
+        case Node::kFloor:
         case Node::kGather:
+        case Node::kGreater:
         case Node::kIdentity:
+        case Node::kLess:
+        case Node::kLog:
+        case Node::kMax:
+        case Node::kMin:
         case Node::kMul:
+        case Node::kNeg:
+        case Node::kNot:
+        case Node::kOneHot:
+        case Node::kOr:
+        case Node::kPow:
+        case Node::kReciprocal:
+        case Node::kReduceMax:
+        case Node::kReduceMean:
+        case Node::kReduceMin:
+        case Node::kReduceProd:
+        case Node::kReduceSum:
+        case Node::kReshape:
         case Node::kShape:
+        case Node::kSign:
+        case Node::kSize:
         case Node::kSlice:
+        case Node::kSplit:
+        case Node::kSqrt:
+        case Node::kSqueeze:
         case Node::kSub:
+        case Node::kSum:
         case Node::kTranspose:
-        case Node::kUnsqueeze: {
-            DoConstantPropagation(graph, node);
+        case Node::kUnsqueeze:
+        case Node::kWhere:
+        case Node::kXor:
             return true;
-        }
 
         default:
-            CLOG() << "Not propagate " << node->ToString() << std::endl;
+            return false;
+    }
+}
+
+int64_t GetMaxFoldedElements() {
+    return g_max_folded_constant_elements ? g_max_folded_constant_elements : 1 << 20;
+}
+
+bool IsTooLarge(int64_t num_elements) {
+    const int64_t max_elements = GetMaxFoldedElements();
+    return max_elements >= 0 && num_elements > max_elements;
+}
+
+// Constant subgraphs of a graph, which are evaluated at once.
+struct ConstantSubGraphs {
+    // Foldable nodes in a topological order.
+    std::vector<Node*> nodes;
+    // Constant nodes which feed `nodes`.
+    std::vector<Node*> constants;
+    // Values computed by `nodes` and used by other nodes or the graph.
+    std::vector<Value*> outputs;
+};
+
+// Finds nodes whose inputs are all computed from constants, except
+// for `excluded`.
+void FindConstantSubGraphs(const Graph& graph, const std::set<Node*>& excluded, ConstantSubGraphs* subgraphs) {
+    std::queue<Value*> q;
+    std::set<Node*> nodes;
+    auto add_node = [&q, &nodes, subgraphs](Node* node) {
+        nodes.insert(node);
+        subgraphs->nodes.push_back(node);
+        for (Value* output : node->outputs()) {
+            q.push(output);
+        }
+    };
+
+    for (Node* node : graph.GetLiveNodes()) {
+        if (IsConstant(node)) {
+            for (Value* output : node->outputs()) {
+                q.push(output);
+            }
+        } else if (node->GetNumActualInputs() == 0 && IsFoldable(*node) && !excluded.count(node)) {
+            add_node(node);
+        }
+    }
+
+    // The number of constant inputs for each node.
+    std::map<Node*, int> num_constant_inputs;
+    while (!q.empty()) {
+        Value* value = q.front();
+        q.pop();
+        for (Node* user : value->users()) {
+            if (!IsFoldable(*user) || excluded.count(user)) continue;
+            if (++num_constant_inputs[user] == user->GetNumActualInputs()) {
+                add_node(user);
+            }
+        }
+    }
+
+    std::set<Node*> constants;
+    for (Node* node : subgraphs->nodes) {
+        for (Value* input : node->inputs()) {
+            Node* producer = input->producer();
+            if (IsConstant(producer) && constants.insert(producer).second) {
+                subgraphs->constants.push_back(producer);
+            }
+        }
+        for (Value* output : node->outputs()) {
+            if (output->IsNull()) continue;
+            bool is_used_outside = output->IsOutput();
+            for (Node* user : output->users()) {
+                if (!nodes.count(user)) is_used_outside = true;
+            }
+            if (is_used_outside) {
+                subgraphs->outputs.push_back(output);
+            }
+        }
+    }
+}
+
+// Replaces `value` by a constant node.
+void ReplaceByConstant(Graph* graph, Value* value, EvaluatedValue* evaluated) {
+    GraphBuilder gb(graph, "Const", value);
+    if (evaluated->is_tensor()) {
+        gb.Op(Node::kConstant, {}, value)->producer()->set_tensor_value(evaluated->ReleaseTensor());
+    } else {
+        gb.Op(Node::kChainerSequenceConstants, {}, value)->producer()->set_tensor_values(evaluated->ReleaseSequence());
     }
-    return false;
 }
 
 }  // namespace
 
 void PropagateConstants(Graph* graph) {
-    bool replaced = true;
-    while (replaced) {
-        replaced = false;
-        for (Node* node : graph->GetLiveNodes()) {
-            if (!HasConstantInputsOnly(*node)) continue;
-            if (MaybePropagateConstant(graph, node)) {
-                replaced = true;
+    std::set<Node*> excluded;
+    while (true) {
+        ConstantSubGraphs subgraphs;
+        FindConstantSubGraphs(*graph, excluded, &subgraphs);
+        if (subgraphs.nodes.empty()) return;
+
+        // Keep nodes whose outputs are known to be too large before
+        // evaluating them.
+        bool has_large_output = false;
+        for (Value* value : subgraphs.outputs) {
+            const Type& type = value->type();
+            if (type.kind() == Type::Kind::kTensor && IsTooLarge(type.NumElements())) {
+                CLOG() << "Not propagate large " << value->producer()->ToString() << std::endl;
+                excluded.insert(value->producer());
+                has_large_output = true;
+            }
+        }
+        if (has_large_output) continue;
+
+        std::vector<Node*> nodes = subgraphs.constants;
+        nodes.insert(nodes.end(), subgraphs.nodes.begin(), subgraphs.nodes.end());
+        std::vector<std::unique_ptr<EvaluatedValue>> evaluated;
+        Eval(nodes, subgraphs.outputs, &evaluated);
+        CHECK_EQ(subgraphs.outputs.size(), evaluated.size());
+
+        for (size_t i = 0; i < evaluated.size(); ++i) {
+            if (IsTooLarge(evaluated[i]->NumElements())) {
+                CLOG() << "Not propagate large " << subgraphs.outputs[i]->producer()->ToString() << std::endl;
+                excluded.insert(subgraphs.outputs[i]->producer());
+                has_large_output = true;
+            }
+        }
+        if (has_large_output) continue;
+
+        for (Node* node : subgraphs.nodes) {
+            CLOG() << "Propagate " << node->ToString() << std::endl;
+        }
+        for (size_t i = 0; i < evaluated.size(); ++i) {
+            ReplaceByConstant(graph, subgraphs.outputs[i], evaluated[i].get());
+        }
+        for (Node* node : subgraphs.nodes) {
+            graph->DetachNode(node);
+        }
+        for (Node* node : subgraphs.constants) {
+            // Detach node if the value is not uesd by other ops nor a
+            // graph output.
+            Value* output = node->output(0);
+            if (output->users().empty() && !output->IsOutput()) {
+                graph->DetachNode(node);
             }
         }
+        return;
     }
 }
 
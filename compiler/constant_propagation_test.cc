@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <chainerx/testing/context_session.h>
+
+#include <compiler/constant_propagation.h>
+#include <compiler/flags.h>
+#include <compiler/graph.h>
+#include <compiler/graph_builder.h>
+#include <compiler/node.h>
+#include <compiler/tensor.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+TEST(ConstantPropagationTest, FoldSubGraph) {
+    chainerx::testing::ContextSession sess;
+
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32, {2, 3, 4}));
+    Value* y = graph.AddOutputValue("y", Type(Dtype::kFloat32, {2, 12}));
+    {
+        GraphBuilder gb(&graph, "test", y);
+        Value* a = gb.Const(Type(Dtype::kInt64, {1}), std::vector<int64_t>{2});
+        Value* b = gb.Const(Type(Dtype::kInt64, {2}), std::vector<int64_t>{3, 4});
+        Value* prod = gb.Op(Node::kReduceProd, {b});
+        Value* shape = gb.Op(Node::kConcat, {a, prod});
+        shape->producer()->set_axis(0);
+        gb.Op(Node::kReshape, {x, shape}, y);
+    }
+
+    PropagateConstants(&graph);
+
+    ASSERT_EQ(2, graph.GetLiveNodes().size());
+    Node* reshape = y->producer();
+    ASSERT_EQ(Node::kReshape, reshape->op_type());
+    const Tensor* shape = reshape->input(1)->GetConstTensor();
+    ASSERT_TRUE(shape);
+    ASSERT_EQ(2, shape->NumElements());
+    EXPECT_EQ(2, shape->Get<int64_t>(0));
+    EXPECT_EQ(12, shape->Get<int64_t>(1));
+    graph.CheckSanity("folded");
+}
+
+TEST(ConstantPropagationTest, SizeLimit) {
+    chainerx::testing::ContextSession sess;
+    g_max_folded_constant_elements = 4;
+
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32, {8}));
+    Value* y = graph.AddOutputValue("y", Type(Dtype::kFloat32, {8}));
+    Node* expand;
+    {
+        GraphBuilder gb(&graph, "test", y);
+        Value* one = gb.Const(Type(Dtype::kFloat32, {}), {1.0f});
+        Value* shape = gb.Const(Type(Dtype::kInt64, {1}), std::vector<int64_t>{8});
+        Value* ones = gb.Op(Node::kExpand, {one, shape});
+        expand = ones->producer();
+        gb.Op(Node::kAdd, {x, ones}, y);
+    }
+
+    PropagateConstants(&graph);
+
+    EXPECT_FALSE(expand->detached());
+    EXPECT_EQ(4, graph.GetLiveNodes().size());
+    g_max_folded_constant_elements = 0;
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -0,0 +1,378 @@
+#include "compiler/cpu_fusion_builder.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <set>
+#include <sstream>
+
+#include <common/log.h>
+#include <common/strutil.h>
+#include <compiler/code_emitter.h>
+#include <compiler/flags.h>
+#include <compiler/fusion.h>
+#include <compiler/log.h>
+#include <compiler/node.h>
+#include <compiler/type.h>
+#include <compiler/util.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+const char* kCpuFusionFuncName = "chainer_compiler_fusion";
+
+namespace {
+
+// Columns processed by a task. Rows are split into such blocks so
+// 1D arrays can be processed in parallel.
+constexpr int64_t kColumnBlock = 4096;
+// Small arrays are processed by a single thread.
+constexpr int64_t kMinParallelElements = 1 << 15;
+
+void EmitNode(const Node* node, CodeEmitter* ce) {
+    std::vector<std::string> ins;
+    std::vector<std::string> outs;
+    for (Value* value : node->inputs()) ins.push_back(CleanseIdent(value->name(), "v_"));
+    for (Value* value : node->outputs()) outs.push_back(CleanseIdent(value->name(), "v_"));
+
+    auto out1 = [&outs, node, ce](const std::string& rhs) {
+        CHECK_EQ(1UL, outs.size());
+        *ce << "const T " << outs[0] << " = " << rhs << ";  // " << node->op_type() << "\n";
+    };
+
+    auto unary = [&ins, out1](const std::string& fn) {
+        CHECK_EQ(1UL, ins.size());
+        out1(fn + "(" + ins[0] + ")");
+    };
+
+    auto binary = [&ins, out1](char op) {
+        CHECK_EQ(2UL, ins.size());
+        out1(ins[0] + ' ' + op + ' ' + ins[1]);
+    };
+
+    switch (node->op_type()) {
+        case Node::kIdentity:
+            out1(ins[0]);
+            break;
+
+        case Node::kNeg:
+            out1("-" + ins[0]);
+            break;
+
+        case Node::kReciprocal:
+            out1("T(1) / " + ins[0]);
+            break;
+
+        case Node::kRelu:
+            out1(ins[0] + " > T(0) ? " + ins[0] + " : T(0)");
+            break;
+
+        case Node::kAbs:
+            unary("std::abs");
+            break;
+
+        case Node::kTanh:
+            unary("std::tanh");
+            break;
+
+        case Node::kExp:
+            unary("std::exp");
+            break;
+
+        case Node::kLog:
+            unary("std::log");
+            break;
+
+        case Node::kSqrt:
+            unary("std::sqrt");
+            break;
+
+        case Node::kErf:
+            unary("std::erf");
+            break;
+
+        case Node::kSigmoid:
+            unary("sigmoid");
+            break;
+
+        case Node::kAdd:
+            binary('+');
+            break;
+
+        case Node::kSub:
+            binary('-');
+            break;
+
+        case Node::kMul:
+            binary('*');
+            break;
+
+        case Node::kDiv:
+            binary('/');
+            break;
+
+        case Node::kPow:
+            CHECK_EQ(2UL, ins.size());
+            out1("std::pow(" + ins[0] + ", " + ins[1] + ")");
+            break;
+
+        default:
+            CHECK(false) << "Cannot build CPU fusion program for: " << node->ToString();
+    }
+}
+
+uint64_t Fnv1a(const std::string& s) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : s) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Returns a description of the host CPU. `-march=native` depends on
+// it, so shared objects built on another CPU must not be reused.
+const std::string& GetHostTarget() {
+    static const std::string* target = [] {
+        std::string t;
+        struct utsname u;
+        if (uname(&u) == 0) {
+            t = u.machine;
+        }
+        std::ifstream ifs("/proc/cpuinfo");
+        bool has_model = false;
+        bool has_flags = false;
+        std::string line;
+        while (!(has_model && has_flags) && std::getline(ifs, line)) {
+            if (!has_model && line.find("model name") == 0) {
+                has_model = true;
+            } else if (!has_flags && (line.find("flags") == 0 || line.find("Features") == 0)) {
+                has_flags = true;
+            } else {
+                continue;
+            }
+            t += '\n' + line;
+        }
+        return new std::string(t);
+    }();
+    return *target;
+}
+
+std::string QuoteShellArg(const std::string& s) {
+    std::string o = "'";
+    for (char c : s) {
+        if (c == '\'') {
+            o += "'\\''";
+        } else {
+            o += c;
+        }
+    }
+    return o + "'";
+}
+
+void MakeDirectory(const std::string& dir) {
+    if (mkdir(dir.c_str(), 0700) != 0) {
+        CHECK_EQ(EEXIST, errno) << "Failed to create " << dir << ": " << strerror(errno);
+    }
+}
+
+// Shared objects in the cache directory are loaded into the process,
+// so the directory must not be writable by other users.
+void CheckCacheDirectory(const std::string& dir) {
+    struct stat st;
+    CHECK_EQ(0, stat(dir.c_str(), &st)) << "Failed to stat " << dir << ": " << strerror(errno);
+    CHECK(S_ISDIR(st.st_mode)) << dir << " is not a directory";
+    CHECK_EQ(getuid(), st.st_uid) << dir << " is not owned by the current user";
+    CHECK_EQ(0, st.st_mode & (S_IWGRP | S_IWOTH)) << dir << " is writable by group or others";
+}
+
+// Returns the cache directory of shared objects after creating it.
+std::string PrepareCacheDirectory() {
+    std::string cache_dir = g_cpu_codegen_cache_dir;
+    if (cache_dir.empty()) {
+        const char* xdg_cache_home = getenv("XDG_CACHE_HOME");
+        if (xdg_cache_home && *xdg_cache_home) {
+            cache_dir = xdg_cache_home;
+        } else {
+            const char* home = getenv("HOME");
+            CHECK(home && *home) << "Neither $XDG_CACHE_HOME nor $HOME is set. Specify --cpu_codegen_cache_dir";
+            cache_dir = StrCat(home, "/.cache");
+            MakeDirectory(cache_dir);
+        }
+        cache_dir += "/chainer_compiler";
+        MakeDirectory(cache_dir);
+        cache_dir += "/cpu_fusion";
+    }
+    MakeDirectory(cache_dir);
+    CheckCacheDirectory(cache_dir);
+    return cache_dir;
+}
+
+}  // namespace
+
+void BuildCpuFusionProgram(
+        const std::vector<Node*>& nodes, const std::vector<Value*>& inputs, const std::vector<Value*>& outputs, std::string* prog, Dtype* dtype) {
+    std::set<Node::OpType> seen_ops;
+    for (Node* node : nodes) {
+        seen_ops.insert(node->op_type());
+    }
+
+    *dtype = GetFusionDtype(nodes);
+
+    std::ostringstream oss;
+    CodeEmitter ce(oss);
+    ce << "#include <algorithm>\n";
+    ce << "#include <cmath>\n";
+    ce << "#include <cstdint>\n\n";
+    switch (*dtype) {
+        case Dtype::kFloat32:
+            ce << "typedef float T;\n\n";
+            break;
+        case Dtype::kFloat64:
+            ce << "typedef double T;\n\n";
+            break;
+        default:
+            CHECK(false) << "Unsupported dtype for CPU fusion: " << *dtype;
+    }
+
+    ce << "namespace {\n\n";
+
+    if (seen_ops.count(Node::kSigmoid)) {
+        ce << "inline T sigmoid(T x) {\n";
+        ce << "return T(1) / (T(1) + std::exp(-x));\n";
+        ce << "}\n\n";
+    }
+
+    // The computation of a single element.
+    std::vector<std::string> params;
+    for (Value* value : inputs) {
+        params.push_back("const T " + CleanseIdent(value->name(), "v_"));
+    }
+    for (Value* value : outputs) {
+        params.push_back("T* " + CleanseIdent(value->name(), "o_"));
+    }
+    ce << "inline void fusion(" << JoinString(params) << ") {\n";
+
+    VisitFusionNodes(nodes, inputs, [&ce](Node* node) {
+        if (node->op_type() == Node::kConstant) {
+            std::ostringstream value;
+            value << std::setprecision(std::numeric_limits<double>::max_digits10) << GetScalarConstant(*node);
+            ce << "const T " << CleanseIdent(node->output(0)->name(), "v_") << " = T(" << value.str() << ");  // Constant\n";
+        } else {
+            EmitNode(node, &ce);
+        }
+    });
+
+    for (Value* value : outputs) {
+        ce << "*" << CleanseIdent(value->name(), "o_") << " = " << CleanseIdent(value->name(), "v_") << ";  // output\n";
+    }
+    ce << "}\n\n";
+    ce << "}  // namespace\n\n";
+
+    // The entry point. Each task processes a block of a row.
+    ce << "extern \"C\" void " << kCpuFusionFuncName << "(";
+    ce << "int64_t rows, int64_t cols, const void* const* ins, const int64_t* strides, void* const* outs) {\n";
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        ce << "const T* const i" << i << " = static_cast<const T*>(ins[" << i << "]);\n";
+        ce << "const int64_t rs" << i << " = strides[" << i * 2 << "];\n";
+        ce << "const int64_t cs" << i << " = strides[" << i * 2 + 1 << "];\n";
+    }
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        ce << "T* const o" << i << " = static_cast<T*>(outs[" << i << "]);\n";
+    }
+    ce << "const bool unit_stride = true";
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        ce << " && cs" << i << " == 1";
+    }
+    ce << ";\n";
+    ce << "const int64_t col_blocks = (cols + " << kColumnBlock << " - 1) / " << kColumnBlock << ";\n";
+    ce << "#pragma omp parallel for if (rows * cols >= " << kMinParallelElements << ") schedule(static)\n";
+    ce << "for (int64_t t = 0; t < rows * col_blocks; ++t) {\n";
+    ce << "const int64_t r = t / col_blocks;\n";
+    ce << "const int64_t begin = (t % col_blocks) * " << kColumnBlock << ";\n";
+    ce << "const int64_t end = std::min(cols, begin + " << kColumnBlock << ");\n";
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        ce << "const T* __restrict__ const p" << i << " = i" << i << " + r * rs" << i << ";\n";
+    }
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        ce << "T* __restrict__ const q" << i << " = o" << i << " + r * cols;\n";
+    }
+
+    auto emit_loop = [&ce, &inputs, &outputs](bool unit_stride) {
+        std::vector<std::string> args;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            args.push_back(unit_stride ? StrCat("p", i, "[c]") : StrCat("p", i, "[c * cs", i, "]"));
+        }
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            args.push_back(StrCat("&q", i, "[c]"));
+        }
+        ce << "for (int64_t c = begin; c < end; ++c) {\n";
+        ce << "fusion(" << JoinString(args) << ");\n";
+        ce << "}\n";
+    };
+
+    ce << "if (unit_stride) {\n";
+    ce << "#pragma omp simd\n";
+    emit_loop(true);
+    ce << "} else {\n";
+    emit_loop(false);
+    ce << "}\n";
+    ce << "}\n";
+    ce << "}\n";
+
+    *prog = oss.str();
+}
+
+std::string CompileCpuFusionProgram(const std::string& prog) {
+    const char* cxx = getenv("CXX");
+    const std::string compiler = cxx && *cxx ? cxx : "c++";
+    // Without -ffast-math, GCC does not use vectorized versions of
+    // math functions such as expf.
+    const std::string cxxflags =
+            StrCat("-std=c++11 -O3 -march=native -fPIC -shared -fopenmp ", g_cpu_codegen_fast_math ? "-ffast-math" : "-fno-math-errno");
+    const std::string cache_dir = PrepareCacheDirectory();
+
+    std::ostringstream hash;
+    const std::string key = StrCat(compiler, ' ', cxxflags, '\n', GetHostTarget(), '\n', prog);
+    hash << std::hex << std::setw(16) << std::setfill('0') << Fnv1a(key);
+    const std::string base = StrCat(cache_dir, "/fusion_", hash.str());
+    const std::string dso_filename = base + ".so";
+
+    struct stat st;
+    if (stat(dso_filename.c_str(), &st) == 0) {
+        CLOG() << "Reuse " << dso_filename << std::endl;
+        return dso_filename;
+    }
+
+    // Other processes may compile the same program concurrently, so
+    // the shared object is renamed after it is built.
+    const std::string tmp_base = StrCat(base, ".", getpid());
+    const std::string src_filename = tmp_base + ".cc";
+    {
+        std::ofstream ofs(src_filename);
+        CHECK(ofs) << "Failed to open " << src_filename;
+        ofs << prog;
+    }
+
+    const std::string tmp_dso_filename = tmp_base + ".so";
+    const std::string cmdline =
+            StrCat(compiler, ' ', cxxflags, ' ', QuoteShellArg(src_filename), " -o ", QuoteShellArg(tmp_dso_filename));
+    CLOG() << "Run command: " << cmdline << std::endl;
+    int ret = system(cmdline.c_str());
+    CHECK_EQ(0, ret) << "Command failed: " << cmdline;
+    CHECK_EQ(0, rename(tmp_dso_filename.c_str(), dso_filename.c_str()))
+            << "Failed to rename " << tmp_dso_filename << ": " << strerror(errno);
+    remove(src_filename.c_str());
+    return dso_filename;
+}
+
+}  // namespace chainer_compiler
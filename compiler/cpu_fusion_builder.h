@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <compiler/dtype.h>
+
+namespace chainer_compiler {
+
+class Node;
+class Value;
+
+// The name of the function exported by shared objects built by
+// `BuildCpuFusionProgram`. Its signature is
+//
+//   void chainer_compiler_fusion(int64_t rows, int64_t cols,
+//                                const void* const* inputs,
+//                                const int64_t* input_strides,
+//                                void* const* outputs);
+//
+// where `input_strides` has the strides of rows and columns (in
+// elements) for each input. Outputs must be contiguous.
+extern const char* kCpuFusionFuncName;
+
+// Generates C++ code which computes `outputs` of element-wise `nodes`
+// from `inputs`. `dtype` is set to the dtype of the generated code.
+void BuildCpuFusionProgram(
+        const std::vector<Node*>& nodes, const std::vector<Value*>& inputs, const std::vector<Value*>& outputs, std::string* prog, Dtype* dtype);
+
+// Compiles `prog` by the host C++ compiler and returns the filename
+// of the shared object. The result is cached in a per-user directory
+// by the hash of `prog`, the command line, and the host CPU.
+std::string CompileCpuFusionProgram(const std::string& prog);
+
+}  // namespace chainer_compiler
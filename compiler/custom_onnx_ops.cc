@@ -1,3 +1,5 @@
+#include <limits>
+
 #include "compiler/onnx.h"
 #include "onnx/defs/schema.h"
 
@@ -47,6 +49,22 @@ ONNX_CHAINER_OPERATOR_SET_SCHEMA(
                         "Constrain input and output types to signed numeric tensors.")
                 .TypeAndShapeInferenceFunction(InferLinear));
 
+ONNX_CHAINER_OPERATOR_SET_SCHEMA(
+        ChainerFusedLinear,
+        9,
+        OpSchema()
+                .SetDoc("ChainerLinear with n_batch_axes=1 followed by an activation.")
+                .Input(0, "X", "Input tensor", "T")
+                .Input(1, "W", "Weight tensor", "T")
+                .Input(2, "B", "Bias tensor", "T", OpSchema::Optional)
+                .Output(0, "Y", "Output tensor", "T")
+                .Attr("activation", "One of Relu, Tanh, and Sigmoid or empty.", AttributeProto::STRING, std::string(""))
+                .TypeConstraint(
+                        "T",
+                        {"tensor(float)", "tensor(float16)", "tensor(double)"},
+                        "Constrain input and output types to float tensors.")
+                .TypeAndShapeInferenceFunction(InferLinear));
+
 ONNX_CHAINER_OPERATOR_SET_SCHEMA(
         ChainerSoftmaxCrossEntropy,
         9,
@@ -243,6 +261,32 @@ ONNX_WORKAROUND_OPERATOR_SET_SCHEMA(
                 .TypeConstraint("I", {"tensor(int64)"}, "Constrain index tensor to int64")
                 .TypeAndShapeInferenceFunction([](InferenceContext& ctx) { convPoolTypeAndShapeInference(ctx, false, true); }));
 
+ONNX_CHAINER_OPERATOR_SET_SCHEMA(
+        ChainerFusedConv,
+        9,
+        OpSchema()
+                .SetDoc("Conv followed by an optional residual addition and an activation.")
+                .Input(0, "X", "Input tensor", "T")
+                .Input(1, "W", "Weight tensor", "T")
+                .Input(2, "B", "Bias tensor", "T", OpSchema::Optional)
+                .Input(3, "Z", "Residual tensor with the same shape as the output", "T", OpSchema::Optional)
+                .Output(0, "Y", "Output tensor", "T")
+                .Attr("activation", "One of Relu, LeakyRelu, Sigmoid, and Clip or empty.", AttributeProto::STRING, std::string(""))
+                .Attr("alpha", "The slope of LeakyRelu.", AttributeProto::FLOAT, 0.01f)
+                .Attr("max", "The maximum value of Clip.", AttributeProto::FLOAT, std::numeric_limits<float>::infinity())
+                .Attr("min", "The minimum value of Clip.", AttributeProto::FLOAT, -std::numeric_limits<float>::infinity())
+                .Attr("auto_pad", "", AttributeProto::STRING, std::string("NOTSET"))
+                .Attr("dilations", "", AttributeProto::INTS, OPTIONAL)
+                .Attr("group", "", AttributeProto::INT, static_cast<int64_t>(1))
+                .Attr("kernel_shape", "", AttributeProto::INTS, OPTIONAL)
+                .Attr("pads", "", AttributeProto::INTS, OPTIONAL)
+                .Attr("strides", "", AttributeProto::INTS, OPTIONAL)
+                .TypeConstraint(
+                        "T",
+                        {"tensor(float)", "tensor(float16)", "tensor(double)"},
+                        "Constrain input and output types to float tensors.")
+                .TypeAndShapeInferenceFunction([](InferenceContext& ctx) { convPoolTypeAndShapeInference(ctx, true, false); }));
+
 namespace {
 
 void InferROI(InferenceContext& ctx) {
@@ -607,6 +651,8 @@ public:
         fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Chainer, 9, ChainerROIAveragePool2D)>());
         fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Chainer, 9, ChainerROIMaxAlign2D)>());
         fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Chainer, 9, ChainerROIMaxPool2D)>());
+        fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Chainer, 9, ChainerFusedConv)>());
+        fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Chainer, 9, ChainerFusedLinear)>());
         fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Chainer, 9, ChainerLinear)>());
         fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Chainer, 9, ChainerResizeImages)>());
         fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Chainer, 9, ChainerSoftmaxCrossEntropy)>());
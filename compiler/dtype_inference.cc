@@ -101,11 +101,18 @@ void InferDtype(Node* node) {
         case Node::kMatMul:
         case Node::kGemm:
         case Node::kChainerLinear:
-        case Node::kChainerLinearGradWeight: {
+        case Node::kChainerLinearGradWeight:
+        case Node::kChainerFusedLinear: {
             set(0, coerce());
             break;
         }
 
+        case Node::kChainerFusedLinearGradWeight: {
+            set(0, coerce());
+            set(1, coerce());
+            break;
+        }
+
         case Node::kChainerConvTransposeWithDynamicOutputShape: {
             CHECK(in2 == Dtype::kInt64 || in2 == Dtype::kUnknown) << in1.ToString() << " in " << node->ToString();
             set(0, CoerceDtype(in0, in1));
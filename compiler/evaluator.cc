@@ -29,6 +29,17 @@ EvaluatedValue::EvaluatedValue(Tensor* tensor) : tensor_(tensor) {
 EvaluatedValue::EvaluatedValue(std::vector<std::unique_ptr<Tensor>>&& sequence) : sequence_(std::move(sequence)) {
 }
 
+int64_t EvaluatedValue::NumElements() const {
+    if (is_tensor()) {
+        return tensor_->NumElements();
+    }
+    int64_t num_elements = 0;
+    for (const std::unique_ptr<Tensor>& tensor : sequence_) {
+        num_elements += tensor->NumElements();
+    }
+    return num_elements;
+}
+
 Tensor* EvaluatedValue::ReleaseTensor() {
     CHECK(is_tensor());
     return tensor_.release();
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #include <memory>
 #include <utility>
 #include <vector>
@@ -19,6 +21,9 @@ public:
         return tensor_.get();
     }
 
+    // The number of elements, which is summed up for sequences.
+    int64_t NumElements() const;
+
     Tensor* ReleaseTensor();
     std::vector<std::unique_ptr<Tensor>> ReleaseSequence();
 
@@ -1,5 +1,6 @@
 #include "compiler/flops.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include <compiler/graph.h>
@@ -9,13 +10,20 @@ namespace chainer_compiler {
 
 namespace {
 
+// Opaque values such as packed weights have no shapes.
 bool HasKnownInOuts(const Node& node) {
     for (Value* value : node.inputs()) {
+        if (value->IsNull() || value->type().kind() == Type::Kind::kOpaque) {
+            continue;
+        }
         if (!value->type().HasKnownShape()) {
             return false;
         }
     }
     for (Value* value : node.outputs()) {
+        if (value->type().kind() == Type::Kind::kOpaque) {
+            continue;
+        }
         if (!value->type().HasKnownShape()) {
             return false;
         }
@@ -58,6 +66,71 @@ int64_t CalculateFlopsOfConv(const Node& node) {
     return bsize * ichan * ochan * ow * oh * kw * kh / node.group();
 }
 
+// FLOPs per element of the activation fused into a node.
+int64_t FlopsOfFusedActivation(const Node& node) {
+    if (node.activation() == "Sigmoid") {
+        return 4;
+    } else if (node.activation() == "LeakyRelu" || node.activation() == "Clip") {
+        return 2;
+    } else if (!node.activation().empty()) {
+        return 1;
+    }
+    return 0;
+}
+
+// FLOPs per output element to add the bias and the residual, and to
+// apply the activation.
+int64_t FlopsOfEpilogue(const Node& node) {
+    int64_t epilogue = FlopsOfFusedActivation(node);
+    for (size_t i = 2; i < node.inputs().size(); ++i) {
+        if (!node.input(i)->IsNull()) ++epilogue;
+    }
+    return epilogue;
+}
+
+// Conv with the bias, the residual, and the activation.
+int64_t CalculateFlopsOfFusedConv(Node const& node) {
+    return CalculateFlopsOfConv(node) + FlopsOfEpilogue(node) * OutputSize(node);
+}
+
+// Weights are packed as (KB, CB, KH, KW, Lin, Lout), or (CB, KH, KW, L)
+// for depthwise Conv.
+int64_t CalculateFlopsOfLayoutConv(Node const& node) {
+    Type const& w = node.input(1)->type();
+    const int64_t ochan = node.group() == 1 ? w.dims()[0] * w.dims()[5] : w.dims()[0] * w.dims()[3];
+    return OutputSize(node) * (w.NumElements() / ochan) + FlopsOfEpilogue(node) * OutputSize(node);
+}
+
+// The filter is opaque, so its spatial size is taken from
+// `kernel_shape`.
+int64_t CalculateFlopsOfPackedConv(Node const& node) {
+    Type const& x = node.input(0)->type();
+    Type const& y = node.output(0)->type();
+    int64_t kernel_size = 1;
+    for (int64_t k : node.kernel_shape()) kernel_size *= k;
+    const int64_t flops = x.dims()[0] * x.dims()[1] * y.dims()[1] * y.dims()[2] * y.dims()[3] * kernel_size / node.group();
+    return flops + FlopsOfEpilogue(node) * OutputSize(node);
+}
+
+// Axes of X other than the first `n_batch_axes` are reduced.
+int64_t CalculateFlopsOfPackedLinear(Node const& node) {
+    const int64_t out_size = OutputSize(node);
+    const int64_t num_rows = out_size / std::max<int64_t>(1, node.output(0)->type().dims().back());
+    const int64_t depth = node.input(0)->type().NumElements() / std::max<int64_t>(1, num_rows);
+    return out_size * depth + FlopsOfEpilogue(node) * out_size;
+}
+
+int64_t CalculateFlopsOfFusedLinear(Node const& node) {
+    const int64_t out_size = OutputSize(node);
+    return out_size * node.input(0)->type().dims()[1] + FlopsOfEpilogue(node) * out_size;
+}
+
+int64_t CalculateFlopsOfFusedLinearGradWeight(Node const& node) {
+    const Type& x = node.input(0)->type();
+    const Type& gy = node.input(1)->type();
+    return gy.NumElements() * x.dims()[1] + FlopsOfFusedActivation(node) * gy.NumElements();
+}
+
 int64_t CalculateFlopsOfConvTranspose(Node const& node) {
     Type const& x = node.input(0)->type();
     Type const& w = node.input(1)->type();
@@ -139,6 +212,29 @@ int64_t CalculateFlopsImpl(const Node& node) {
         case Node::kConv:
             return CalculateFlopsOfConv(node);
 
+        case Node::kChainerFusedConv:
+            return CalculateFlopsOfFusedConv(node);
+
+        case Node::kChainerLayoutConv:
+            return CalculateFlopsOfLayoutConv(node);
+
+        case Node::kChainerFusedLinear:
+            return CalculateFlopsOfFusedLinear(node);
+
+        // Weights are packed once at the first run.
+        case Node::kChainerPackConvWeight:
+        case Node::kChainerPackMatrixWeight:
+            return 0;
+
+        case Node::kChainerPackedConv:
+            return CalculateFlopsOfPackedConv(node);
+
+        case Node::kChainerPackedLinear:
+            return CalculateFlopsOfPackedLinear(node);
+
+        case Node::kChainerFusedLinearGradWeight:
+            return CalculateFlopsOfFusedLinearGradWeight(node);
+
         case Node::kConvTranspose:
             return CalculateFlopsOfConvTranspose(node);
 
@@ -157,9 +253,11 @@ int64_t CalculateFlopsImpl(const Node& node) {
 
         // Pooling nodes:
         case Node::kAveragePool:
+        case Node::kChainerLayoutAveragePool:
             return CalculateFlopsOfAveragePool(node);
 
         case Node::kMaxPool:
+        case Node::kChainerLayoutMaxPool:
             return CalculateFlopsOfMaxPool(node);
 
         default:
@@ -6,23 +6,27 @@
 #include <algorithm>
 #include <functional>
 #include <iterator>
+#include <map>
+#include <queue>
 #include <set>
 #include <stack>
 #include <vector>
 
 #include <common/iterator.h>
+#include <common/log.h>
 #include <common/strutil.h>
 #include <compiler/flags.h>
+#include <compiler/fusion_planner.h>
 #include <compiler/graph.h>
 #include <compiler/graph_builder.h>
+#include <compiler/log.h>
 #include <compiler/node.h>
+#include <compiler/tensor.h>
 #include <compiler/topology.h>
 #include <compiler/value.h>
 
 namespace chainer_compiler {
 
-namespace {
-
 void RejectCyclicNodes(std::set<Node*>* cands) {
     std::stack<Node*> q;
     for (Node* node : *cands) {
@@ -78,6 +82,8 @@ void RejectUnusedConstants(std::set<Node*>* cands) {
     for (Node* node : rejected) cands->erase(node);
 }
 
+namespace {
+
 std::string MakeValueName(const char* prefix, int index, const std::string& name) {
     CHECK_LT(index, 1000);
     char buf[12];
@@ -164,10 +170,11 @@ void CreateFusionGroup(
 
 void FuseAllConnectedNodes(
         const char* name, Graph* graph, int min_fuse_ops, bool can_fuse_initializers, const std::function<bool(const Node&)>& is_fusable) {
-    int num_fusion_groups = 0;
-    const std::vector<Node*> all_nodes(graph->nodes());
-    for (Node* base_node : all_nodes) {
-        if (base_node->chainer_fusion_group()) continue;
+    std::vector<std::set<Node*>> components;
+    std::set<Node*> visited;
+    for (Node* base_node : graph->nodes()) {
+        if (base_node->chainer_fusion_group() || base_node->detached()) continue;
+        if (visited.count(base_node)) continue;
         if (!is_fusable(*base_node)) continue;
 
         std::set<Node*> cands;
@@ -195,21 +202,107 @@ void FuseAllConnectedNodes(
             }
         }
 
-        RejectCyclicNodes(&cands);
-        RejectUnusedConstants(&cands);
+        visited.insert(cands.begin(), cands.end());
+        components.push_back(std::move(cands));
+    }
 
-        int num_calculation = 0;
-        for (Node* node : cands) {
-            if (!node->IsZeroCost()) ++num_calculation;
-        }
-        if (num_calculation < min_fuse_ops) continue;
+    // All components are planned at once so groups of different
+    // components do not make cycles and nodes are sorted only once.
+    int num_fusion_groups = 0;
+    int num_recomputed = 0;
+    FusionCost total_cost;
+    for (const std::set<Node*>& group : PlanFusionGroups(graph, components, min_fuse_ops, &num_recomputed)) {
+        const FusionCost cost = EstimateFusionCost(group);
+        if (cost.num_ops < min_fuse_ops) continue;
 
         ++num_fusion_groups;
-        for (Node* node : cands) {
+        for (Node* node : group) {
             node->set_chainer_fusion_group(num_fusion_groups);
         }
 
-        CreateFusionGroup(graph, cands, name, num_fusion_groups, can_fuse_initializers);
+        if (g_compiler_log) {
+            CLOG() << "Fusion group " << name << "#" << num_fusion_groups << ": " << cost.num_ops << " ops " << cost.flops
+                   << " FLOPs, memory traffic " << cost.unfused_bytes << " => " << cost.fused_bytes << " bytes, benefit "
+                   << cost.GetBenefit() << std::endl;
+        }
+        total_cost.num_ops += cost.num_ops;
+        total_cost.flops += cost.flops;
+        total_cost.unfused_bytes += cost.unfused_bytes;
+        total_cost.fused_bytes += cost.fused_bytes;
+
+        CreateFusionGroup(graph, group, name, num_fusion_groups, can_fuse_initializers);
+    }
+
+    if (g_compiler_log && num_fusion_groups) {
+        CLOG() << "Fused " << total_cost.num_ops << " ops into " << num_fusion_groups << " " << name << " groups: saved "
+               << total_cost.GetSavedBytes() << " bytes of memory traffic, recomputed " << num_recomputed << " ops" << std::endl;
+    }
+}
+
+double GetScalarConstant(const Node& node) {
+    Tensor* t = node.tensor_value().get();
+    CHECK_EQ(1, t->NumElements()) << t->dtype();
+    switch (t->dtype()) {
+        case Dtype::kFloat16:
+            return static_cast<double>(t->Get<chainerx::Float16>(0));
+        case Dtype::kFloat32:
+            return t->Get<float>(0);
+        case Dtype::kFloat64:
+            return t->Get<double>(0);
+        default:
+            CHECK(false) << t->dtype();
+    }
+    return 0;
+}
+
+Dtype GetFusionDtype(const std::vector<Node*>& nodes) {
+    Dtype dtype = Dtype::kUnknown;
+    for (Node* node : nodes) {
+        for (Value* value : node->inputs()) {
+            Dtype dt = value->type().dtype();
+            if (dt == Dtype::kUnknown) {
+                continue;
+            }
+            if (dtype != Dtype::kUnknown) {
+                CHECK_EQ(dtype, dt);
+            }
+            dtype = dt;
+        }
+    }
+    if (dtype == Dtype::kUnknown) {
+        dtype = Dtype::kFloat32;
+    }
+    return dtype;
+}
+
+void VisitFusionNodes(const std::vector<Node*>& nodes, const std::vector<Value*>& inputs, const std::function<void(Node*)>& fn) {
+    std::map<Node*, int> input_counts;
+    for (Node* node : nodes) {
+        CHECK(input_counts.emplace(node, node->GetNumActualInputs()).second);
+    }
+
+    std::queue<Value*> q;
+    for (Value* value : inputs) {
+        q.push(value);
+    }
+
+    for (Node* node : nodes) {
+        if (node->op_type() != Node::kConstant) continue;
+        q.push(node->output(0));
+        fn(node);
+    }
+
+    while (!q.empty()) {
+        Value* value = q.front();
+        q.pop();
+
+        for (Node* node : value->users()) {
+            auto found = input_counts.find(node);
+            if (found == input_counts.end()) continue;
+            if (--found->second != 0) continue;
+            fn(node);
+            for (Value* value : node->outputs()) q.push(value);
+        }
     }
 }
 
@@ -231,6 +324,9 @@ void FuseOperations(Graph* graph) {
         FuseTVMOperations(graph);
     }
     if (g_fuse_operations) {
+        if (g_use_fusion_interpreter) {
+            FuseReductionOperations(graph);
+        }
         FuseElementwiseOperations(graph);
     }
 }
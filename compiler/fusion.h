@@ -3,14 +3,25 @@
 #include <functional>
 #include <set>
 #include <string>
+#include <vector>
+
+#include <compiler/dtype.h>
 
 namespace chainer_compiler {
 
 class Graph;
 class Node;
+class Value;
 
 void FuseOperations(Graph* graph);
 
+// Removes nodes in `cands` which are reachable from other nodes in
+// `cands` via nodes outside `cands`.
+void RejectCyclicNodes(std::set<Node*>* cands);
+
+// Removes constants in `cands` which are not used by others.
+void RejectUnusedConstants(std::set<Node*>* cands);
+
 void CreateFusionGroup(
         Graph* graph, const std::set<Node*>& nodes, const std::string& fusion_type, int fusion_group_id, bool can_fuse_initializers);
 
@@ -21,5 +32,22 @@ void FuseDldtOperations(Graph* graph);
 void FuseNGraphOperations(Graph* graph);
 void FuseTVMOperations(Graph* graph);
 void FuseElementwiseOperations(Graph* graph);
+void FuseReductionOperations(Graph* graph);
+
+// Returns true if `node` can be fused by FuseElementwiseOperations
+// with the current flags.
+bool IsFusableElementwise(const Node& node);
+
+// Returns the value of a Constant `node` with a single floating point
+// element, which builders of fusion groups embed into their programs.
+double GetScalarConstant(const Node& node);
+
+// Returns the dtype of inputs of `nodes` in a fusion group. Unknown
+// dtypes are assumed to be float32.
+Dtype GetFusionDtype(const std::vector<Node*>& nodes);
+
+// Calls `fn` for Constant nodes in `nodes` first and then for the
+// other nodes in a topological order from `inputs`.
+void VisitFusionNodes(const std::vector<Node*>& nodes, const std::vector<Value*>& inputs, const std::function<void(Node*)>& fn);
 
 }  // namespace chainer_compiler
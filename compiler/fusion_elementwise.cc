@@ -1,5 +1,6 @@
 #include <set>
 
+#include <compiler/flags.h>
 #include <compiler/fusion.h>
 #include <compiler/graph.h>
 #include <compiler/node.h>
@@ -7,9 +8,9 @@
 
 namespace chainer_compiler {
 
-void FuseElementwiseOperations(Graph* graph) {
+bool IsFusableElementwise(const Node& node) {
     // TODO(hamaji): Do not try fusing integer ops.
-    const std::set<Node::OpType> fusable_ops = {
+    static const std::set<Node::OpType> kNvrtcOps = {
             Node::kIdentity,
             Node::kAdd,
             Node::kSub,
@@ -19,24 +20,61 @@ void FuseElementwiseOperations(Graph* graph) {
             Node::kSigmoid,
             Node::kExp,
     };
+    // The CPU code generator also handles ops in GELU and
+    // normalizations.
+    static const std::set<Node::OpType> kCpuOps = {
+            Node::kAbs,
+            Node::kDiv,
+            Node::kErf,
+            Node::kLog,
+            Node::kNeg,
+            Node::kPow,
+            Node::kReciprocal,
+            Node::kRelu,
+            Node::kSqrt,
+    };
+    // Ops supported by runtime/elementwise_bytecode.h.
+    static const std::set<Node::OpType> kInterpreterOps = {
+            Node::kClip,
+            Node::kDiv,
+            Node::kLog,
+            Node::kNeg,
+            Node::kPow,
+            Node::kRelu,
+            Node::kSqrt,
+            Node::kWhere,
+    };
 
-    auto is_fusable = [&fusable_ops](const Node& node) {
-        if (node.op_type() == Node::kConstant) {
-            Tensor* t = node.tensor_value().get();
-            return t->dtype().IsFloat() && t->NumElements() == 1;
-        }
+    if (node.op_type() == Node::kConstant) {
+        Tensor* t = node.tensor_value().get();
+        return t->dtype().IsFloat() && t->NumElements() == 1;
+    }
 
-        if (!fusable_ops.count(node.op_type())) return false;
-        for (Value* value : node.inputs()) {
-            Dtype dtype = value->type().dtype();
-            // TODO(hamaji): Fix the dtype inference and do not fuse
-            // unknown dtypes.
-            if (!dtype.IsFloat() && dtype != Dtype::kUnknown) return false;
+    if (!kNvrtcOps.count(node.op_type())) {
+        if (g_use_cpu_codegen) {
+            if (!kCpuOps.count(node.op_type())) return false;
+        } else if (g_use_fusion_interpreter) {
+            if (!kInterpreterOps.count(node.op_type())) return false;
+        } else {
+            return false;
         }
-        return true;
-    };
+    }
+    for (size_t i = 0; i < node.inputs().size(); ++i) {
+        Dtype dtype = node.input(i)->type().dtype();
+        // The condition of Where is converted by the interpreter.
+        if (node.op_type() == Node::kWhere && i == 0 && dtype == Dtype::kBool) continue;
+        // TODO(hamaji): Fix the dtype inference and do not fuse
+        // unknown dtypes.
+        if (!dtype.IsFloat() && dtype != Dtype::kUnknown) return false;
+        // There is no native float16 arithmetic on CPU.
+        if ((g_use_cpu_codegen || g_use_fusion_interpreter) && dtype == Dtype::kFloat16) return false;
+    }
+    return true;
+}
 
-    FuseAllConnectedNodes("nvrtc", graph, 2, false, is_fusable);
+void FuseElementwiseOperations(Graph* graph) {
+    const char* fusion_type = g_use_cpu_codegen ? "cpu" : g_use_fusion_interpreter ? "interpreter" : "nvrtc";
+    FuseAllConnectedNodes(fusion_type, graph, 2, false, IsFusableElementwise);
 }
 
 }  // namespace chainer_compiler
@@ -0,0 +1,496 @@
+#include "compiler/fusion_planner.h"
+
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <stack>
+#include <tuple>
+
+#include <common/log.h>
+#include <compiler/flags.h>
+#include <compiler/flops.h>
+#include <compiler/graph.h>
+#include <compiler/node.h>
+#include <compiler/tensor.h>
+#include <compiler/topology.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+int64_t GetBytes(const Value* value) {
+    return std::max<int64_t>(0, value->GetNBytes());
+}
+
+int64_t GetLaunchCost() {
+    return g_fusion_launch_cost ? g_fusion_launch_cost : 16 * 1024;
+}
+
+// Ops without attributes, which can be duplicated only with their
+// inputs.
+bool IsRecomputable(const Node& node) {
+    switch (node.op_type()) {
+        case Node::kIdentity:
+        case Node::kAdd:
+        case Node::kSub:
+        case Node::kMul:
+        case Node::kDiv:
+        case Node::kNeg:
+        case Node::kReciprocal:
+        case Node::kAbs:
+        case Node::kExp:
+        case Node::kLog:
+        case Node::kSqrt:
+        case Node::kTanh:
+        case Node::kSigmoid:
+        case Node::kRelu:
+        case Node::kErf:
+            return true;
+        default:
+            return false;
+    }
+}
+
+class FusionPlanner {
+public:
+    FusionPlanner(Graph* graph, const std::vector<std::set<Node*>>& components, int min_fuse_ops)
+        : graph_(graph), num_components_(components.size()), min_fuse_ops_(min_fuse_ops) {
+        for (size_t i = 0; i < components.size(); ++i) {
+            for (Node* node : components[i]) CHECK(component_ids_.emplace(node, i).second);
+        }
+
+        // The topological order is computed once for all components.
+        const std::vector<Node*> sorted = graph->GetTopologicallySortedNodes();
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            CHECK(order_.emplace(sorted[i], i).second);
+        }
+        span_ends_.resize(sorted.size() + 1);
+
+        for (Node* node : sorted) {
+            auto found = component_ids_.find(node);
+            if (found == component_ids_.end()) continue;
+            if (node->op_type() == Node::kConstant) {
+                constants_.push_back(node);
+            } else {
+                group_ids_.emplace(node, groups_.size());
+                groups_.push_back({node});
+                group_components_.push_back(found->second);
+                spans_.emplace_back(order_[node], order_[node]);
+            }
+        }
+    }
+
+    std::vector<std::set<Node*>> Plan(int* num_recomputed) {
+        MergeGroups();
+        if (!g_skip_fusion_recompute) {
+            RecomputeOps(num_recomputed);
+        }
+        DistributeConstants(num_recomputed);
+
+        // Groups of each component in the topological order.
+        std::vector<std::vector<std::set<Node*>>> groups_by_component(num_components_);
+        for (size_t i = 0; i < groups_.size(); ++i) {
+            if (!groups_[i].empty()) groups_by_component[group_components_[i]].push_back(std::move(groups_[i]));
+        }
+        std::vector<std::set<Node*>> groups;
+        for (std::vector<std::set<Node*>>& component : groups_by_component) {
+            for (std::set<Node*>& group : component) groups.push_back(std::move(group));
+        }
+        return groups;
+    }
+
+private:
+    // A merge of the groups of `producer` and `user`, which was
+    // estimated when the groups had `versions`.
+    struct Merge {
+        int64_t benefit;
+        size_t producer_order;
+        size_t user_order;
+        Node* producer;
+        Node* user;
+        std::pair<int, int> versions;
+
+        // Merges with more benefit come first in a priority queue,
+        // and then ones along earlier values.
+        bool operator<(const Merge& rhs) const {
+            if (benefit != rhs.benefit) return benefit < rhs.benefit;
+            return std::make_tuple(rhs.producer_order, rhs.user_order) < std::make_tuple(producer_order, user_order);
+        }
+    };
+
+    std::set<Node*> GetMergedGroup(int dst, int src) const {
+        std::set<Node*> merged = groups_[dst];
+        merged.insert(groups_[src].begin(), groups_[src].end());
+        return merged;
+    }
+
+    // Returns the benefit of fusing the groups `dst` and `src` as
+    // `merged` over fusing them separately.
+    int64_t GetMergeBenefit(int dst, int src, const FusionCost& merged) const {
+        return merged.GetBenefit() - costs_[dst].GetBenefit() - costs_[src].GetBenefit();
+    }
+
+    Merge EstimateMerge(Node* producer, Node* user) const {
+        const int dst = group_ids_.at(producer);
+        const int src = group_ids_.at(user);
+        const FusionCost merged = EstimateFusionCost(GetMergedGroup(dst, src));
+        return {GetMergeBenefit(dst, src, merged),
+                order_.at(producer),
+                order_.at(user),
+                producer,
+                user,
+                std::make_pair(versions_[dst], versions_[src])};
+    }
+
+    void MergeGroups() {
+        costs_.clear();
+        for (const std::set<Node*>& group : groups_) costs_.push_back(EstimateFusionCost(group));
+        versions_.assign(groups_.size(), 0);
+
+        // Merges along values passed between candidates, the one with
+        // the most benefit first. Merges are estimated again when
+        // their groups have grown since they were queued.
+        std::priority_queue<Merge> queue;
+        for (const auto& p : group_ids_) {
+            Node* node = p.first;
+            for (Value* value : node->outputs()) {
+                for (Node* user : value->users()) {
+                    if (GetGroupInComponent(user, group_components_[p.second]) < 0) continue;
+                    queue.push(EstimateMerge(node, user));
+                }
+            }
+        }
+
+        const int64_t max_live_bytes = g_fusion_max_live_mb > 0 ? static_cast<int64_t>(g_fusion_max_live_mb) << 20 : -1;
+        while (!queue.empty()) {
+            const Merge merge = queue.top();
+            queue.pop();
+            const int dst = group_ids_[merge.producer];
+            const int src = group_ids_[merge.user];
+            if (dst == src) continue;
+            if (merge.versions != std::make_pair(versions_[dst], versions_[src])) {
+                queue.push(EstimateMerge(merge.producer, merge.user));
+                continue;
+            }
+
+            // Merging ops never increases memory traffic, but merges
+            // which save neither traffic nor launches are not worth
+            // it, except ones with a group of zero-cost ops such as
+            // Identity and Reshape, or with values of unknown sizes,
+            // whose saving is not estimated. Skipping them would split
+            // chains of ops. All inputs and outputs of a group are
+            // alive while it runs.
+            if (merge.benefit < 0) continue;
+            std::set<Node*> merged = GetMergedGroup(dst, src);
+            if (merge.benefit == 0 && costs_[dst].num_ops && costs_[src].num_ops && !HasUnknownBytes(merged)) continue;
+            const FusionCost merged_cost = EstimateFusionCost(merged);
+            if (max_live_bytes >= 0 && merged_cost.fused_bytes > max_live_bytes) continue;
+            if (Reaches(merged, merged)) continue;
+
+            for (Node* node : groups_[src]) group_ids_[node] = dst;
+            groups_[dst] = std::move(merged);
+            groups_[src].clear();
+            costs_[dst] = merged_cost;
+            ++versions_[dst];
+            ++versions_[src];
+            ExtendSpan(dst, spans_[src].first);
+            ExtendSpan(dst, spans_[src].second);
+        }
+    }
+
+    // Extends the span of the group `group_id` in the topological
+    // order to cover `order`.
+    void ExtendSpan(int group_id, size_t order) {
+        std::pair<size_t, size_t>& span = spans_[group_id];
+        span.first = std::min(span.first, order);
+        span.second = std::max(span.second, order);
+        // A Fenwick tree of the maximum end of spans which begin at or
+        // before each order. Stale spans of merged groups are kept as
+        // they are covered by the new one.
+        for (size_t i = span.first + 1; i < span_ends_.size(); i += i & -i) {
+            span_ends_[i] = std::max(span_ends_[i], span.second);
+        }
+    }
+
+    // Returns an order after which nodes never reach nodes at or
+    // before `last`. Paths go forward in the topological order except
+    // that entering a group reaches all of its nodes, so the order is
+    // extended by groups which begin at or before it.
+    size_t GetReachBound(size_t last) const {
+        size_t bound = last;
+        while (true) {
+            size_t end = bound;
+            for (size_t i = bound + 1; i > 0; i -= i & -i) {
+                end = std::max(end, span_ends_[i]);
+            }
+            if (end == bound) return bound;
+            bound = end;
+        }
+    }
+
+    // Returns true if a path from `from` reaches `to` when each group
+    // is contracted into a single op. Groups are kept acyclic in this
+    // graph, i.e., a group cannot be put together with nodes it
+    // reaches through other ops or groups.
+    bool Reaches(const std::set<Node*>& from, const std::set<Node*>& to) const {
+        bool has_last = false;
+        size_t last = 0;
+        for (Node* node : to) {
+            auto found = order_.find(node);
+            if (found == order_.end()) continue;
+            last = std::max(last, found->second);
+            has_last = true;
+        }
+        if (!has_last) return false;
+        const size_t bound = GetReachBound(last);
+
+        std::stack<Node*> q;
+        auto push_users = [&q](Node* node) {
+            for (Value* output : node->outputs()) {
+                for (Node* user : output->users()) q.push(user);
+            }
+        };
+        for (Node* node : from) {
+            for (Value* output : node->outputs()) {
+                for (Node* user : output->users()) {
+                    if (!from.count(user)) q.push(user);
+                }
+            }
+        }
+
+        std::set<Node*> seen;
+        std::set<int> entered_groups;
+        while (!q.empty()) {
+            Node* node = q.top();
+            q.pop();
+            if (to.count(node)) return true;
+            if (!seen.emplace(node).second) continue;
+            // Nodes after `bound` never reach `to`. The whole group of
+            // such a node is after `bound`, too.
+            auto found = order_.find(node);
+            if (found == order_.end() || found->second > bound) continue;
+
+            auto group = group_ids_.find(node);
+            if (group == group_ids_.end()) {
+                push_users(node);
+            } else if (entered_groups.insert(group->second).second) {
+                for (Node* member : groups_[group->second]) {
+                    if (to.count(member)) return true;
+                    seen.insert(member);
+                    push_users(member);
+                }
+            }
+        }
+        return false;
+    }
+
+    static bool HasUnknownBytes(const std::set<Node*>& nodes) {
+        for (Node* node : nodes) {
+            for (Value* value : node->inputs()) {
+                if (value->GetNBytes() < 0) return true;
+            }
+            for (Value* value : node->outputs()) {
+                if (value->GetNBytes() < 0) return true;
+            }
+        }
+        return false;
+    }
+
+    static int NumOps(const std::set<Node*>& nodes) {
+        int num_ops = 0;
+        for (Node* node : nodes) {
+            if (!node->IsZeroCost()) ++num_ops;
+        }
+        return num_ops;
+    }
+
+    // Returns the group of `node` if it is in the component
+    // `component_id`, or -1 otherwise. Groups in other components are
+    // fused separately like ops which are not fused.
+    int GetGroupInComponent(Node* node, int component_id) const {
+        auto found = group_ids_.find(node);
+        if (found == group_ids_.end() || group_components_[found->second] != component_id) return -1;
+        return found->second;
+    }
+
+    bool Reads(int group_id, Value* value) const {
+        for (Node* user : value->users()) {
+            auto found = group_ids_.find(user);
+            if (found != group_ids_.end() && found->second == group_id) return true;
+        }
+        return false;
+    }
+
+    // Duplicates element-wise ops whose outputs are used by other
+    // groups if reading their inputs costs less than materializing
+    // their outputs. This also removes dependencies between groups.
+    void RecomputeOps(int* num_recomputed) {
+        for (size_t gid = 0; gid < groups_.size(); ++gid) {
+            const std::vector<Node*> nodes(groups_[gid].begin(), groups_[gid].end());
+            for (Node* node : nodes) {
+                if (!IsRecomputable(*node)) continue;
+                // Only ops computed from inputs of the group.
+                bool from_inputs = true;
+                for (Value* input : node->inputs()) {
+                    Node* producer = input->producer();
+                    if (producer && group_ids_.count(producer) && group_ids_[producer] == static_cast<int>(gid)) from_inputs = false;
+                }
+                if (!from_inputs) continue;
+
+                Value* output = node->output(0);
+                bool used_elsewhere = output->IsOutput();
+                std::map<int, std::vector<Node*>> users_in_groups;
+                for (Node* user : output->users()) {
+                    const int user_group = GetGroupInComponent(user, group_components_[gid]);
+                    if (user_group < 0) {
+                        used_elsewhere = true;
+                    } else {
+                        users_in_groups[user_group].push_back(user);
+                    }
+                }
+                bool used_inside = users_in_groups.erase(gid) > 0;
+
+                for (const auto& p : users_in_groups) {
+                    // Do not duplicate ops into groups which will not be
+                    // fused.
+                    if (NumOps(groups_[p.first]) < min_fuse_ops_) {
+                        used_elsewhere = true;
+                        continue;
+                    }
+
+                    int64_t recompute_bytes = 0;
+                    for (Value* input : node->inputs()) {
+                        if (!Reads(p.first, input)) recompute_bytes += GetBytes(input);
+                    }
+                    // The output is read by the other group, and also
+                    // written if no one else uses it.
+                    int64_t materialize_bytes = GetBytes(output);
+                    if (!used_inside && !used_elsewhere && users_in_groups.size() == 1) materialize_bytes += GetBytes(output);
+                    if (recompute_bytes >= materialize_bytes) {
+                        used_elsewhere = true;
+                        continue;
+                    }
+
+                    // The duplicated op makes the group read the inputs
+                    // of `node`, whose producers must not depend on it.
+                    std::set<Node*> producers;
+                    for (Value* input : node->inputs()) {
+                        Node* producer = input->producer();
+                        if (!producer) continue;
+                        auto found = group_ids_.find(producer);
+                        if (found == group_ids_.end()) {
+                            producers.insert(producer);
+                        } else if (found->second != p.first) {
+                            producers.insert(groups_[found->second].begin(), groups_[found->second].end());
+                        }
+                    }
+                    if (Reaches(groups_[p.first], producers)) {
+                        used_elsewhere = true;
+                        continue;
+                    }
+
+                    Value* new_output = graph_->AddValue(output->name(), output->type());
+                    Node* dup = graph_->AddNode(node->op_type(), node->inputs(), {new_output}, node->name());
+                    for (Node* user : p.second) user->ReplaceInput(output, new_output);
+                    // The duplicated op runs right after its inputs like
+                    // the original one.
+                    order_.emplace(dup, order_[node]);
+                    group_ids_.emplace(dup, p.first);
+                    groups_[p.first].insert(dup);
+                    ExtendSpan(p.first, order_[node]);
+                    ++*num_recomputed;
+                }
+
+                if (output->users().empty() && !output->IsOutput()) {
+                    groups_[gid].erase(node);
+                    group_ids_.erase(node);
+                    graph_->DetachNode(node);
+                }
+            }
+        }
+    }
+
+    // Scalar constants are duplicated into all groups which use them
+    // so groups do not depend on each other.
+    void DistributeConstants(int* num_recomputed) {
+        for (Node* node : constants_) {
+            Value* output = node->output(0);
+            bool used_elsewhere = output->IsOutput();
+            std::map<int, std::vector<Node*>> users_in_groups;
+            for (Node* user : output->users()) {
+                const int user_group = GetGroupInComponent(user, component_ids_[node]);
+                if (user_group < 0) {
+                    used_elsewhere = true;
+                } else {
+                    users_in_groups[user_group].push_back(user);
+                }
+            }
+
+            bool is_first = true;
+            for (const auto& p : users_in_groups) {
+                if (is_first && (!used_elsewhere || g_skip_fusion_recompute)) {
+                    groups_[p.first].insert(node);
+                } else if (!g_skip_fusion_recompute) {
+                    Value* new_output = graph_->AddValue(output->name(), output->type());
+                    Node* dup = graph_->AddNode(Node::kConstant, {}, {new_output}, node->name());
+                    dup->set_tensor_value(new Tensor(new_output->name(), *node->tensor_value()));
+                    for (Node* user : p.second) user->ReplaceInput(output, new_output);
+                    groups_[p.first].insert(dup);
+                    ++*num_recomputed;
+                }
+                is_first = false;
+            }
+        }
+    }
+
+    Graph* graph_;
+    const size_t num_components_;
+    const int min_fuse_ops_;
+    std::map<Node*, int> component_ids_;
+    std::map<Node*, size_t> order_;
+    std::vector<std::set<Node*>> groups_;
+    std::map<Node*, int> group_ids_;
+    std::vector<int> group_components_;
+    // Estimated costs of groups and the number of times they have
+    // grown while they are merged.
+    std::vector<FusionCost> costs_;
+    std::vector<int> versions_;
+    // The first and the last orders of nodes in each group.
+    std::vector<std::pair<size_t, size_t>> spans_;
+    std::vector<size_t> span_ends_;
+    std::vector<Node*> constants_;
+};
+
+}  // namespace
+
+int64_t FusionCost::GetBenefit() const {
+    return GetSavedBytes() + std::max(0, num_ops - 1) * GetLaunchCost();
+}
+
+FusionCost EstimateFusionCost(const std::set<Node*>& nodes) {
+    FusionCost cost;
+    for (Node* node : nodes) {
+        if (node->IsZeroCost()) continue;
+        ++cost.num_ops;
+        cost.flops += std::max<int64_t>(0, CalculateFlops(*node));
+        for (Value* value : node->inputs()) cost.unfused_bytes += GetBytes(value);
+        for (Value* value : node->outputs()) cost.unfused_bytes += GetBytes(value);
+    }
+
+    std::vector<Value*> inputs;
+    std::vector<Value*> outputs;
+    std::vector<Value*> temps;
+    ClassifyValues(std::vector<Node*>(nodes.begin(), nodes.end()), &inputs, &outputs, &temps);
+    for (Value* value : inputs) cost.fused_bytes += GetBytes(value);
+    for (Value* value : outputs) cost.fused_bytes += GetBytes(value);
+    return cost;
+}
+
+std::vector<std::set<Node*>> PlanFusionGroups(
+        Graph* graph, const std::vector<std::set<Node*>>& components, int min_fuse_ops, int* num_recomputed) {
+    FusionPlanner planner(graph, components, min_fuse_ops);
+    return planner.Plan(num_recomputed);
+}
+
+}  // namespace chainer_compiler
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <set>
+#include <vector>
+
+namespace chainer_compiler {
+
+class Graph;
+class Node;
+
+// An estimate of running a set of nodes as a single fusion group.
+struct FusionCost {
+    // The number of ops which are not zero cost.
+    int num_ops{0};
+    int64_t flops{0};
+    // Bytes read and written when the ops run one by one.
+    int64_t unfused_bytes{0};
+    // Bytes of inputs and outputs of the group, which are also alive
+    // while the group runs.
+    int64_t fused_bytes{0};
+
+    int64_t GetSavedBytes() const {
+        return unfused_bytes - fused_bytes;
+    }
+
+    // Saved memory traffic plus the overhead of launched ops, which
+    // decides the order of merges in `PlanFusionGroups`.
+    int64_t GetBenefit() const;
+};
+
+FusionCost EstimateFusionCost(const std::set<Node*>& nodes);
+
+// Splits each of `components`, connected sets of fusable nodes, into
+// fusion groups. Groups are returned for each component in order.
+// Groups are merged along values between them in the order of the
+// benefit estimated by `FusionCost`, as long as the merge saves
+// something or involves zero-cost ops or unknown shapes, the graph
+// stays acyclic when all groups are fused, and they are within
+// --fusion_max_live_mb. Constants and cheap element-wise ops whose
+// outputs are used by other groups are duplicated into groups with at
+// least `min_fuse_ops` ops (unless --skip_fusion_recompute) if it
+// costs less memory traffic than passing their outputs. Duplicated
+// nodes are added to `graph`. `num_recomputed` is incremented by the
+// number of such nodes.
+std::vector<std::set<Node*>> PlanFusionGroups(
+        Graph* graph, const std::vector<std::set<Node*>>& components, int min_fuse_ops, int* num_recomputed);
+
+}  // namespace chainer_compiler
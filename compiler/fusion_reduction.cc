@@ -0,0 +1,129 @@
+#include <set>
+#include <stack>
+#include <vector>
+
+#include <compiler/fusion.h>
+#include <compiler/graph.h>
+#include <compiler/node.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+// Returns true if `node` reduces or normalizes the last axis of a
+// statically shaped input, which ElementWiseInterpreter can run
+// row by row.
+bool IsRowwiseOperation(const Node& node) {
+    switch (node.op_type()) {
+        case Node::kReduceSum:
+        case Node::kReduceSumSquare:
+        case Node::kReduceMean:
+        case Node::kReduceMax:
+            if (!node.keepdims() || node.axes().size() != 1) return false;
+            break;
+        case Node::kSoftmax:
+        case Node::kLogSoftmax:
+            break;
+        default:
+            return false;
+    }
+
+    const Type& type = node.input(0)->type();
+    if (!type.HasKnownShape() || type.ndim() == 0) return false;
+    if (!type.dtype().IsFloat() || type.dtype() == Dtype::kFloat16) return false;
+    const int64_t ndim = type.ndim();
+    int64_t axis = node.op_type() == Node::kSoftmax || node.op_type() == Node::kLogSoftmax ? node.axis() : node.axes()[0];
+    if (axis < 0) axis += ndim;
+    return axis == ndim - 1;
+}
+
+bool HasDims(const Value* value, const std::vector<int64_t>& dims) {
+    return value->type().HasKnownShape() && value->type().dims() == dims;
+}
+
+// Removes nodes whose reduced outputs are used outside `cands`, since
+// reduced values are broadcasted to rows in fusion groups.
+void RejectReducedOutputs(const std::vector<int64_t>& reduced_dims, std::set<Node*>* cands) {
+    std::set<Node*> rejected;
+    for (Node* node : *cands) {
+        Value* output = node->output(0);
+        if (node->op_type() == Node::kConstant || !HasDims(output, reduced_dims)) continue;
+        bool escapes = output->IsOutput();
+        for (Node* user : output->users()) {
+            if (!cands->count(user)) escapes = true;
+        }
+        if (escapes) rejected.insert(node);
+    }
+    for (Node* node : rejected) cands->erase(node);
+}
+
+}  // namespace
+
+void FuseReductionOperations(Graph* graph) {
+    int num_fusion_groups = 0;
+    const std::vector<Node*> all_nodes(graph->nodes());
+    for (Node* base_node : all_nodes) {
+        if (base_node->chainer_fusion_group()) continue;
+        if (!IsRowwiseOperation(*base_node)) continue;
+
+        // All values in a group have the shape of the input of the
+        // reduction or the reduced shape.
+        const std::vector<int64_t> dims = base_node->input(0)->type().dims();
+        std::vector<int64_t> reduced_dims = dims;
+        reduced_dims.back() = 1;
+
+        auto is_fusable = [base_node, &dims, &reduced_dims](const Node& node) {
+            if (node.chainer_fusion_group()) return false;
+            if (base_node->IsGradNode() != node.IsGradNode()) return false;
+            if (node.op_type() == Node::kConstant) return IsFusableElementwise(node);
+            if (IsRowwiseOperation(node)) return HasDims(node.input(0), dims);
+            if (!IsFusableElementwise(node)) return false;
+            return HasDims(node.output(0), dims) || HasDims(node.output(0), reduced_dims);
+        };
+
+        std::set<Node*> cands;
+        std::stack<Node*> q;
+        q.push(base_node);
+        while (!q.empty()) {
+            Node* node = q.top();
+            q.pop();
+            if (!cands.emplace(node).second) continue;
+
+            for (Value* value : node->inputs()) {
+                Node* next_node = value->producer();
+                if (next_node && is_fusable(*next_node)) q.push(next_node);
+            }
+            for (Value* value : node->outputs()) {
+                for (Node* next_node : value->users()) {
+                    if (is_fusable(*next_node)) q.push(next_node);
+                }
+            }
+        }
+
+        while (true) {
+            const size_t num_cands = cands.size();
+            RejectCyclicNodes(&cands);
+            RejectReducedOutputs(reduced_dims, &cands);
+            if (num_cands == cands.size()) break;
+        }
+        RejectUnusedConstants(&cands);
+
+        int num_calculation = 0;
+        bool has_rowwise = false;
+        for (Node* node : cands) {
+            if (!node->IsZeroCost()) ++num_calculation;
+            if (IsRowwiseOperation(*node)) has_rowwise = true;
+        }
+        if (!has_rowwise || num_calculation < 2) continue;
+
+        ++num_fusion_groups;
+        for (Node* node : cands) {
+            node->set_chainer_fusion_group(num_fusion_groups);
+        }
+
+        CreateFusionGroup(graph, cands, "interpreter", num_fusion_groups, false);
+    }
+}
+
+}  // namespace chainer_compiler
@@ -1,9 +1,17 @@
+#include <algorithm>
+
 #include <gtest/gtest.h>
 
+#include <chainerx/testing/context_session.h>
+
+#include <common/strutil.h>
+#include <compiler/cpu_fusion_builder.h>
 #include <compiler/flags.h>
 #include <compiler/fusion.h>
+#include <compiler/fusion_planner.h>
 #include <compiler/graph.h>
 #include <compiler/graph_builder.h>
+#include <compiler/node.h>
 
 namespace chainer_compiler {
 namespace {
@@ -29,5 +37,257 @@ TEST(FusionTest, Basic) {
     g_fuse_operations = false;
 }
 
+TEST(FusionTest, EstimateCost) {
+    Type type(Dtype::kFloat32, {2, 3});
+    Graph graph("test");
+    Value* input = graph.AddInputValue("input", type);
+    Value* output = graph.AddOutputValue("output", type);
+    {
+        GraphBuilder gb(&graph, "test", output);
+        Value* tmp = gb.Op(Node::kTanh, {input});
+        gb.Op(Node::kSigmoid, {tmp}, {output});
+    }
+
+    const FusionCost cost = EstimateFusionCost({graph.nodes().begin(), graph.nodes().end()});
+    EXPECT_EQ(2, cost.num_ops);
+    // Each op reads and writes 24 bytes.
+    EXPECT_EQ(96, cost.unfused_bytes);
+    EXPECT_EQ(48, cost.fused_bytes);
+    EXPECT_EQ(48, cost.GetSavedBytes());
+}
+
+TEST(FusionTest, SplitCyclicGroup) {
+    g_fuse_operations = true;
+    Type type(Dtype::kFloat32, {2, 3});
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", type);
+    Value* output = graph.AddOutputValue("output", type);
+    {
+        GraphBuilder gb(&graph, "test", output);
+        // Relu is not fused, so fusing Tanh with Add makes a cycle.
+        Value* a = gb.Op(Node::kTanh, {x});
+        Value* b = gb.Op(Node::kRelu, {a});
+        Value* c = gb.Op(Node::kAdd, {a, b});
+        gb.Op(Node::kSigmoid, {c}, {output});
+    }
+
+    FuseOperations(&graph);
+    std::vector<Node::OpType> op_types;
+    for (const Node* node : graph.GetLiveNodes()) {
+        op_types.push_back(node->op_type());
+        if (node->op_type() == Node::kChainerFusionGroup) {
+            EXPECT_EQ(2, node->subgraph()->nodes().size());
+        }
+    }
+    std::sort(op_types.begin(), op_types.end());
+    std::vector<Node::OpType> expected = {Node::kChainerFusionGroup, Node::kRelu, Node::kTanh};
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(expected, op_types);
+    graph.CheckSanity("fused");
+    g_fuse_operations = false;
+}
+
+TEST(FusionTest, KeepGroupsAcyclic) {
+    g_fuse_operations = true;
+    g_fusion_max_live_mb = 4;
+    // Each value is 1MB.
+    Type type(Dtype::kFloat32, {256, 1024});
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", type);
+    Value* y = graph.AddInputValue("y", type);
+    Value* a1 = graph.AddOutputValue("a1", type);
+    Value* b1 = graph.AddOutputValue("b1", type);
+    Value* a2 = graph.AddOutputValue("a2", type);
+    {
+        GraphBuilder gb(&graph, "test", a2);
+        // Both {a0, a1, a2} and {b0, b1, b2} fit in the limit and do
+        // not make cycles by themselves, but a1 -> b1 and b2 -> a2
+        // make a cycle between them.
+        Value* a0 = gb.Op(Node::kTanh, {x});
+        gb.Op(Node::kSigmoid, {a0}, a1);
+        Value* b0 = gb.Op(Node::kTanh, {y});
+        gb.Op(Node::kAdd, {b0, a1}, b1);
+        Value* b2 = gb.Op(Node::kSigmoid, {b0});
+        gb.Op(Node::kAdd, {a0, b2}, a2);
+    }
+
+    FuseOperations(&graph);
+    // {a0, a1, b2, a2} is fused first. Neither b0 nor b1 joins it
+    // within the limit, and {b0, b1} makes a cycle through it.
+    std::vector<Node::OpType> op_types;
+    for (const Node* node : graph.GetLiveNodes()) {
+        op_types.push_back(node->op_type());
+        if (node->op_type() == Node::kChainerFusionGroup) {
+            EXPECT_EQ(4, node->subgraph()->nodes().size());
+        }
+    }
+    std::sort(op_types.begin(), op_types.end());
+    std::vector<Node::OpType> expected = {Node::kChainerFusionGroup, Node::kTanh, Node::kAdd};
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(expected, op_types);
+    // Nodes in a cycle are dropped by the topological sort.
+    EXPECT_EQ(graph.GetLiveNodes().size(), graph.GetTopologicallySortedNodes().size());
+    graph.CheckSanity("fused");
+    g_fusion_max_live_mb = 0;
+    g_fuse_operations = false;
+}
+
+TEST(FusionTest, MergeZeroCostOpsWithUnknownShapes) {
+    // No merge saves estimated bytes as sizes of values are unknown,
+    // and Identity does not save launches.
+    Type type(Dtype::kFloat32);
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", type);
+    Value* output = graph.AddOutputValue("output", type);
+    {
+        GraphBuilder gb(&graph, "test", output);
+        Value* t = gb.Op(Node::kIdentity, {x});
+        t = gb.Op(Node::kRelu, {t});
+        t = gb.Op(Node::kIdentity, {t});
+        gb.Op(Node::kIdentity, {t}, {output});
+    }
+
+    const std::set<Node*> nodes(graph.nodes().begin(), graph.nodes().end());
+    ASSERT_EQ(4, nodes.size());
+    int num_recomputed = 0;
+    const std::vector<std::set<Node*>> groups = PlanFusionGroups(&graph, {nodes}, 1, &num_recomputed);
+    ASSERT_EQ(1, groups.size());
+    EXPECT_EQ(nodes, groups[0]);
+    EXPECT_EQ(0, num_recomputed);
+}
+
+TEST(FusionTest, RecomputeConstant) {
+    chainerx::testing::ContextSession sess;
+    g_fuse_operations = true;
+    Type type(Dtype::kFloat32, {2, 3});
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", type);
+    Value* output = graph.AddOutputValue("output", type);
+    {
+        GraphBuilder gb(&graph, "test", output);
+        // Two groups separated by Relu share a constant.
+        Value* c = gb.Const(Type(Dtype::kFloat32, {}), {2.0f});
+        Value* t = gb.Op(Node::kMul, {gb.Op(Node::kTanh, {x}), c});
+        t = gb.Op(Node::kRelu, {t});
+        gb.Op(Node::kMul, {gb.Op(Node::kSigmoid, {t}), c}, {output});
+    }
+
+    FuseOperations(&graph);
+    int num_groups = 0;
+    for (const Node* node : graph.GetLiveNodes()) {
+        if (node->op_type() != Node::kChainerFusionGroup) continue;
+        ++num_groups;
+        // Both groups have their own constant, which is not passed
+        // between them.
+        EXPECT_EQ(3, node->subgraph()->nodes().size());
+        EXPECT_EQ(1, node->inputs().size());
+        EXPECT_EQ(1, node->outputs().size());
+    }
+    EXPECT_EQ(2, num_groups);
+    graph.CheckSanity("fused");
+    g_fuse_operations = false;
+}
+
+TEST(FusionTest, CpuCodegen) {
+    chainerx::testing::ContextSession sess;
+    g_fuse_operations = true;
+    g_use_cpu_codegen = true;
+    Type type(Dtype::kFloat32, {2, 3});
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", type);
+    Value* output = graph.AddOutputValue("output", type);
+    GraphBuilder gb(&graph, "test", output);
+    // GELU: x * (erf(x / sqrt(2)) + 1) / 2.
+    Value* t = gb.Op(Node::kDiv, {x, gb.Const(Type(Dtype::kFloat32, {}), {1.4142135f})});
+    t = gb.Op(Node::kErf, {t});
+    t = gb.Op(Node::kAdd, {t, gb.Const(Type(Dtype::kFloat32, {}), {1.0f})});
+    t = gb.Op(Node::kMul, {x, t});
+    gb.Op(Node::kMul, {t, gb.Const(Type(Dtype::kFloat32, {}), {0.5f})}, {output});
+
+    FuseOperations(&graph);
+    ASSERT_EQ(1, graph.GetLiveNodes().size());
+    const Node& node = *graph.GetLiveNodes()[0];
+    ASSERT_EQ(Node::kChainerFusionGroup, node.op_type());
+    EXPECT_EQ("cpu", node.fusion_type());
+
+    const Graph& body = *node.subgraph();
+    std::string code;
+    Dtype dtype;
+    BuildCpuFusionProgram(body.nodes(), body.input_values(), body.output_values(), &code, &dtype);
+    EXPECT_EQ(Dtype::kFloat32, dtype);
+    EXPECT_NE(std::string::npos, code.find("typedef float T;"));
+    EXPECT_NE(std::string::npos, code.find("std::erf("));
+    EXPECT_NE(std::string::npos, code.find(StrCat("extern \"C\" void ", kCpuFusionFuncName, "(")));
+    g_use_cpu_codegen = false;
+    g_fuse_operations = false;
+}
+
+TEST(FusionTest, LayerNormalization) {
+    chainerx::testing::ContextSession sess;
+    g_fuse_operations = true;
+    g_use_fusion_interpreter = true;
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32, {4, 8}));
+    Value* gamma = graph.AddInputValue("gamma", Type(Dtype::kFloat32, {8}));
+    Value* output = graph.AddOutputValue("output", Type(Dtype::kFloat32, {4, 8}));
+    {
+        GraphBuilder gb(&graph, "test", output);
+        // (x - mean(x)) / sqrt(mean((x - mean(x)) ** 2) + eps) * gamma.
+        Value* mean = gb.Op(Node::kReduceMean, {x});
+        mean->producer()->set_axes({-1});
+        Value* d = gb.Op(Node::kSub, {x, mean});
+        Value* v = gb.Op(Node::kPow, {d, gb.Const(Type(Dtype::kFloat32, {}), {2.0f})});
+        v = gb.Op(Node::kReduceMean, {v});
+        v->producer()->set_axes({1});
+        v = gb.Op(Node::kAdd, {v, gb.Const(Type(Dtype::kFloat32, {}), {1e-5f})});
+        v = gb.Op(Node::kSqrt, {v});
+        v = gb.Op(Node::kDiv, {d, v});
+        gb.Op(Node::kMul, {v, gamma}, {output});
+    }
+
+    FuseOperations(&graph);
+    ASSERT_EQ(1, graph.GetLiveNodes().size());
+    const Node& node = *graph.GetLiveNodes()[0];
+    ASSERT_EQ(Node::kChainerFusionGroup, node.op_type());
+    EXPECT_EQ("interpreter", node.fusion_type());
+    EXPECT_EQ(10, node.subgraph()->nodes().size());
+    g_use_fusion_interpreter = false;
+    g_fuse_operations = false;
+}
+
+TEST(FusionTest, ReducedOutputIsNotFused) {
+    chainerx::testing::ContextSession sess;
+    g_fuse_operations = true;
+    g_use_fusion_interpreter = true;
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32, {4, 8}));
+    Value* output = graph.AddOutputValue("output", Type(Dtype::kFloat32, {4, 8}));
+    Value* sum = graph.AddOutputValue("sum", Type(Dtype::kFloat32, {4, 1}));
+    {
+        GraphBuilder gb(&graph, "test", output);
+        // Exp is fused with Softmax while ReduceSum is not since
+        // its output is used outside.
+        Value* t = gb.Op(Node::kExp, {x});
+        gb.Op(Node::kReduceSum, {t}, sum)->producer()->set_axes({1});
+        gb.Op(Node::kSoftmax, {t}, output)->producer()->set_axis(-1);
+    }
+
+    FuseOperations(&graph);
+    ASSERT_EQ(2, graph.GetLiveNodes().size());
+    int num_groups = 0;
+    for (const Node* node : graph.GetLiveNodes()) {
+        if (node->op_type() != Node::kChainerFusionGroup) {
+            EXPECT_EQ(Node::kReduceSum, node->op_type());
+            continue;
+        }
+        ++num_groups;
+        EXPECT_EQ("interpreter", node->fusion_type());
+        EXPECT_EQ(2, node->subgraph()->nodes().size());
+    }
+    EXPECT_EQ(1, num_groups);
+    g_use_fusion_interpreter = false;
+    g_fuse_operations = false;
+}
+
 }  // namespace
 }  // namespace chainer_compiler
@@ -36,7 +36,9 @@ class Dtype(object):
     pass
 
 
-CHAINER_COMPILERX_GLOBAL_ATTRS = attr_sets(chainer_order=-1, chainer_fusion_group=0)
+CHAINER_COMPILERX_GLOBAL_ATTRS = attr_sets(
+    chainer_order=-1, chainer_fusion_group=0,
+    chainer_stream=-1, chainer_stream_waits=[int])
 
 NODES = []
 
@@ -246,6 +248,12 @@ NodeDef('BitShift', 2, 1, direction='LEFT')
 
 NodeDef('ChainerLinear', (2, 3), 1, n_batch_axes=1)
 NodeDef('ChainerLinearGradWeight', 2, 1)
+# ChainerLinear with n_batch_axes=1 followed by an activation, which
+# is one of "Relu", "Tanh", and "Sigmoid".
+NodeDef('ChainerFusedLinear', (2, 3), 1, activation='')
+# Takes (X, GY, Y) of ChainerFusedLinear and outputs (GW, GZ), where
+# GZ is the gradient of the input of the activation.
+NodeDef('ChainerFusedLinearGradWeight', 3, 2, activation='')
 NodeDef('ChainerReluGrad', 2, 1)
 NodeDef('ChainerReduceSumTo', 2, 1)
 
@@ -278,6 +286,42 @@ NodeDef('ChainerLRNGrad', 4, 1,
         alpha=1e-4, beta=0.75, bias=1.0, size=Required(int))
 NodeDef('ChainerLSTMGrad', 2, 4)
 NodeDef('ChainerConvGradWeight', 3, 1, **conv_attrs)
+# Conv followed by an optional residual addition and an activation:
+# (X, W, B?, Z?) -> (activation(Conv(X, W, B) + Z)). `activation` is
+# one of "", "Relu", "LeakyRelu", "Sigmoid", and "Clip".
+NodeDef('ChainerFusedConv', (2, 3, 4), 1,
+        activation='', alpha=0.01, max=float('inf'), min=float('-inf'),
+        **conv_attrs)
+# Ops on 4D images in the layout `layout`, which is "NHWC" or
+# "NCHW<B>c" (e.g., NCHW8c), i.e., (N, ceil(C/B), H, W, B) where
+# channels are padded by zeros. Weights are packed by the compiler:
+# (ceil(K/B), ceil(C/B), KH, KW, B, B) or (1, 1, KH, KW, C, K) for NHWC,
+# and (ceil(C/B), KH, KW, B) or (1, KH, KW, C) for depthwise Conv.
+NodeDef('ChainerLayoutConvert', 1, 1,
+        src_layout=Required(str), dst_layout=Required(str), channels=0)
+NodeDef('ChainerLayoutConv', (2, 3, 4), 1, layout=Required(str),
+        activation='', alpha=0.01, max=float('inf'), min=float('-inf'),
+        **conv_attrs)
+NodeDef('ChainerLayoutMaxPool', 1, 1, layout=Required(str),
+        chainer_cover_all=False, **pool_attrs)
+NodeDef('ChainerLayoutAveragePool', 1, 1, layout=Required(str),
+        count_include_pad=False, **pool_attrs)
+# Weights packed for the GEMM of the CPU convolution engine at the
+# first run. The packed weight is an opaque value, which is cached
+# while the same parameter is fed. ChainerPackConvWeight takes W of
+# Conv and packs it for the algorithm chosen for `input_shape`.
+# ChainerPackMatrixWeight takes B of X * B, or B^T if `transB`.
+NodeDef('ChainerPackConvWeight', 1, 1,
+        input_shape=[int], group=1, pads=[int], strides=[int])
+NodeDef('ChainerPackMatrixWeight', 1, 1, transB=False)
+# ChainerFusedConv and ChainerFusedLinear with packed weights:
+# (X, PACKED, B?, Z?) -> activation(Conv(X, W, B) + Z) and
+# (X, PACKED, B?) -> activation(X * W + B), where first `n_batch_axes`
+# axes of X are flattened into rows and others into columns.
+NodeDef('ChainerPackedConv', (2, 3, 4), 1,
+        activation='', alpha=0.01, max=float('inf'), min=float('-inf'),
+        **conv_attrs)
+NodeDef('ChainerPackedLinear', (2, 3), 1, n_batch_axes=1, activation='')
 NodeDef('ChainerGatherGrad', 3, 1, axis=0)
 NodeDef('ChainerConcatGrad', None, None, axis=0)
 NodeDef('ChainerDynamicSliceGrad', (4, 5, 6), 1)
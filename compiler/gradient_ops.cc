@@ -619,6 +619,35 @@ void LinearGradFn(GradientOpContext* gc) {
     }
 }
 
+void FusedLinearGradFn(GradientOpContext* gc) {
+    const Node* node = gc->node();
+    Value* gy = gc->gy(0);
+
+    // The gradient of the activation is computed with the gradient of
+    // the weight.
+    Value* gz;
+    {
+        GraphBuilder gb{gc->builder(1)};
+        Value* gw = gc->AddGradValue(1);
+        gz = gb.Temp(gy->type());
+        gb.MOp(Node::kChainerFusedLinearGradWeight, {gc->x(0), gy, gc->y(0)}, {gw, gz})->set_activation(node->activation());
+    }
+
+    {
+        GraphBuilder gb{gc->builder(0)};
+        gc->GradOp(Node::kGemm, 0, {gz, gc->x(1), gc->x(0)})
+                ->producer()
+                ->set_alpha(1)
+                ->set_beta(0)
+                ->set_trans_a(false)
+                ->set_trans_b(false);
+    }
+
+    if (node->inputs().size() == 3) {
+        gc->GradOp(Node::kReduceSum, 2, {gz})->producer()->set_axes({0})->set_keepdims(false);
+    }
+}
+
 void LSTMGradFn(GradientOpContext* gc) {
     GraphBuilder gb{gc->builder(0)};
     Node* node = gc->node();
@@ -1091,6 +1120,7 @@ bool AddGradientForNode(Graph* graph, Graph* dest_graph, Node* node, std::map<Va
         register_grad_fn(Node::kLRN, &LRNGradFn);
 
         register_grad_fn(Node::kChainerLinear, &LinearGradFn);
+        register_grad_fn(Node::kChainerFusedLinear, &FusedLinearGradFn);
         register_grad_fn(Node::kLSTM, &LSTMGradFn);
 
         // TODO(hamaji): Implement dropout.
@@ -48,5 +48,38 @@ TEST(GradientTest, Basic) {
     EXPECT_EQ(1, output_names.count("grad_out@in2"));
 }
 
+TEST(GradientTest, FusedLinear) {
+    chainerx::testing::ContextSession sess;
+
+    Graph graph("test");
+    Value* out = graph.AddOutputValue("out", Type(Dtype::kFloat32, {2, 4}));
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32, {2, 3}));
+    Value* w = graph.AddInputValue("w", Type(Dtype::kFloat32, {4, 3}));
+    w->ResetInitializer(std::make_unique<Tensor>("w", Dtype::kFloat32, std::vector<int64_t>{4, 3}, std::vector<float>(12, 1.0)));
+    Value* b = graph.AddInputValue("b", Type(Dtype::kFloat32, {4}));
+    b->ResetInitializer(std::make_unique<Tensor>("b", Dtype::kFloat32, std::vector<int64_t>{4}, std::vector<float>(4, 1.0)));
+    graph.AddNode(Node::kChainerFusedLinear, {x, w, b}, {out})->set_activation("Relu");
+
+    AddGradientNodesForTraining(&graph);
+
+    // The mask of Relu is applied by ChainerFusedLinearGradWeight.
+    int num_grad_weights = 0;
+    for (const Node* node : graph.nodes()) {
+        EXPECT_NE(Node::kChainerReluGrad, node->op_type());
+        if (node->op_type() == Node::kChainerFusedLinearGradWeight) {
+            ++num_grad_weights;
+            EXPECT_EQ("Relu", node->activation());
+            EXPECT_EQ(2, node->outputs().size());
+        }
+    }
+    EXPECT_EQ(1, num_grad_weights);
+    std::set<std::string> output_names;
+    for (Value* output : graph.output_values()) {
+        output_names.insert(output->name());
+    }
+    EXPECT_EQ(1, output_names.count("grad_out@w"));
+    EXPECT_EQ(1, output_names.count("grad_out@b"));
+}
+
 }  // namespace
 }  // namespace chainer_compiler
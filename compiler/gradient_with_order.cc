@@ -1,5 +1,6 @@
 #include "compiler/computation_order/core.h"
 
+#include "compiler/computation_order/policy_auto.h"
 #include "compiler/computation_order/policy_chen.h"
 #include "compiler/computation_order/policy_custom.h"
 #include "compiler/computation_order/policy_dummy.h"
@@ -107,6 +108,8 @@ std::vector<Order> GetComputationOrder(const Graph& graph, const std::string& po
         return ChenPolicy(graph);
     } else if (policy == "gt") {
         return GTPolicy(graph);
+    } else if (policy == "auto") {
+        return AutoPolicy(graph);
     } else {
         CHECK(false) << "Unknown policy of computation order: " << policy;
         return {};
@@ -11,8 +11,10 @@
 
 #include <common/log.h>
 #include <common/strutil.h>
+#include <compiler/flags.h>
 #include <compiler/node.h>
 #include <compiler/serializer_util.h>
+#include <compiler/shape_inference.h>
 #include <compiler/tensor.h>
 #include <compiler/topology.h>
 #include <compiler/util.h>
@@ -310,6 +312,11 @@ void Graph::MigrateNodes(const std::vector<Node*>& nodes, const std::vector<Valu
 }
 
 void Graph::InferShapes() {
+    if (!g_onnx_shape_inference) {
+        InferAllShapes(this);
+        return;
+    }
+
     onnx::GraphProto xgraph;
     ToONNX(&xgraph);
     output_values_.clear();
@@ -10,6 +10,7 @@
 #include <compiler/flags.h>
 #include <compiler/graph.h>
 #include <compiler/node.h>
+#include <compiler/shape_inference.h>
 #include <compiler/topology.h>
 #include <compiler/value.h>
 
@@ -35,26 +36,31 @@ GraphBuilder::~GraphBuilder() {
         }
         CHECK_EQ(added_nodes_.size(), nodes.size());
 
-        onnx::GraphProto xgraph;
-        for (Node* node : nodes) {
-            node->ToONNX(xgraph.add_node());
-        }
-        for (Value* value : inputs) {
-            value->ToONNX(xgraph.add_input());
-        }
-        for (Value* value : outputs) {
-            value->ToONNX(xgraph.add_output());
-        }
-        for (Value* value : temps) {
-            value->ToONNX(xgraph.add_value_info());
-        }
-        onnx::shape_inference::InferShapes(&xgraph, OpsetImports());
+        if (!g_onnx_shape_inference) {
+            // Also updates users of the outputs.
+            InferShapesFrom(nodes);
+        } else {
+            onnx::GraphProto xgraph;
+            for (Node* node : nodes) {
+                node->ToONNX(xgraph.add_node());
+            }
+            for (Value* value : inputs) {
+                value->ToONNX(xgraph.add_input());
+            }
+            for (Value* value : outputs) {
+                value->ToONNX(xgraph.add_output());
+            }
+            for (Value* value : temps) {
+                value->ToONNX(xgraph.add_value_info());
+            }
+            onnx::shape_inference::InferShapes(&xgraph, OpsetImports());
 
-        for (size_t i = 0; i < outputs.size(); ++i) {
-            if (xgraph.output(i).type().has_tensor_type()) outputs[i]->set_type(new Type(xgraph.output(i).type()));
-        }
-        for (size_t i = 0; i < temps.size(); ++i) {
-            if (xgraph.value_info(i).type().has_tensor_type()) temps[i]->set_type(new Type(xgraph.value_info(i).type()));
+            for (size_t i = 0; i < outputs.size(); ++i) {
+                if (xgraph.output(i).type().has_tensor_type()) outputs[i]->set_type(new Type(xgraph.output(i).type()));
+            }
+            for (size_t i = 0; i < temps.size(); ++i) {
+                if (xgraph.value_info(i).type().has_tensor_type()) temps[i]->set_type(new Type(xgraph.value_info(i).type()));
+            }
         }
     }
 
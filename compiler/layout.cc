@@ -0,0 +1,402 @@
+#include "compiler/layout.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+
+#include <chainerx/routines/creation.h>
+#include <chainerx/routines/manipulation.h>
+#include <chainerx/routines/misc.h>
+
+#include <common/log.h>
+#include <common/strutil.h>
+#include <compiler/flags.h>
+#include <compiler/graph.h>
+#include <compiler/graph_builder.h>
+#include <compiler/log.h>
+#include <compiler/node.h>
+#include <compiler/tensor.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+constexpr char kNCHW[] = "NCHW";
+
+int64_t RoundUp(int64_t size, int64_t block) {
+    return (size + block - 1) / block * block;
+}
+
+bool IsImage(const Value* value) {
+    const Type& type = value->type();
+    return type.kind() == Type::Kind::kTensor && type.dtype() == Dtype::kFloat32 && type.HasKnownShape() && type.ndim() == 4;
+}
+
+bool IsConstTensor(const Value* value, size_t ndim) {
+    const Tensor* tensor = value->GetConstTensor();
+    return tensor && tensor->dtype() == Dtype::kFloat32 && tensor->dims().size() == ndim;
+}
+
+bool HasInput(const Node& node, size_t index) {
+    return node.inputs().size() > index && !node.input(index)->IsNull();
+}
+
+// Outputs for backward contexts must not be used.
+bool UsesOnlyFirstOutput(const Node& node) {
+    for (size_t i = 1; i < node.outputs().size(); ++i) {
+        const Value* output = node.output(i);
+        if (!output->IsNull() && (output->IsOutput() || !output->users().empty())) return false;
+    }
+    return true;
+}
+
+bool IsDepthwiseConv(const Node& node) {
+    const int64_t channels = node.input(0)->type().dims()[1];
+    const std::vector<int64_t> w = node.input(1)->GetConstTensor()->dims();
+    return node.group() > 1 && node.group() == channels && w[0] == channels && w[1] == 1;
+}
+
+bool IsConvolution(const Node& node) {
+    return node.op_type() == Node::kConv || node.op_type() == Node::kChainerFusedConv;
+}
+
+bool CanConvertLayout(const Node& node) {
+    if (node.outputs().empty() || !IsImage(node.output(0)) || !UsesOnlyFirstOutput(node)) return false;
+    switch (node.op_type()) {
+        case Node::kConv:
+        case Node::kChainerFusedConv: {
+            if (!IsImage(node.input(0)) || !IsConstTensor(node.input(1), 4)) return false;
+            if (HasInput(node, 2) && !IsConstTensor(node.input(2), 1)) return false;
+            if (HasInput(node, 3) && !IsImage(node.input(3))) return false;
+            if (node.auto_pad() != "NOTSET") return false;
+            for (int64_t d : node.dilations()) {
+                if (d != 1) return false;
+            }
+            return node.group() == 1 || IsDepthwiseConv(node);
+        }
+
+        case Node::kMaxPool:
+        case Node::kAveragePool:
+            return IsImage(node.input(0)) && node.kernel_shape().size() == 2 && node.auto_pad() == "NOTSET" && node.storage_order() == 0;
+
+        case Node::kBatchNormalization: {
+            if (node.inputs().size() != 5 || !IsImage(node.input(0)) || !node.spatial()) return false;
+            for (int i = 1; i < 5; ++i) {
+                if (!IsConstTensor(node.input(i), 1)) return false;
+            }
+            return true;
+        }
+
+        case Node::kRelu:
+            return IsImage(node.input(0));
+
+        case Node::kAdd:
+            return node.inputs().size() == 2 && IsImage(node.input(0)) && IsImage(node.input(1)) &&
+                   node.input(0)->type().dims() == node.output(0)->type().dims() &&
+                   node.input(1)->type().dims() == node.output(0)->type().dims();
+
+        case Node::kConcat: {
+            if (node.axis() != 1 && node.axis() != -3) return false;
+            for (const Value* input : node.inputs()) {
+                if (!IsImage(input)) return false;
+            }
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+// Inputs which are images in the layout of the node.
+std::vector<Value*> GetImageInputs(const Node& node) {
+    switch (node.op_type()) {
+        case Node::kConv:
+        case Node::kChainerFusedConv:
+            if (HasInput(node, 3)) return {node.input(0), node.input(3)};
+            return {node.input(0)};
+        case Node::kAdd:
+        case Node::kConcat:
+            return node.inputs();
+        default:
+            return {node.input(0)};
+    }
+}
+
+// Pads `axis` of `a` by zeros to a multiple of `block`.
+chainerx::Array PadChannels(const chainerx::Array& a, int8_t axis, int64_t block) {
+    const int64_t size = a.shape()[axis];
+    if (block == 0 || size % block == 0) return a;
+    chainerx::Shape shape = a.shape();
+    shape[axis] = RoundUp(size, block) - size;
+    return chainerx::Concatenate({a, chainerx::Zeros(shape, a.dtype(), a.device())}, axis);
+}
+
+// (K, C, KH, KW) => (KB, CB, KH, KW, Lin, Lout), where Lin and Lout
+// are the block size or C and K for NHWC.
+chainerx::Array PackConvWeight(chainerx::Array w, int64_t block) {
+    w = PadChannels(PadChannels(w, 0, block), 1, block);
+    const int64_t k = w.shape()[0];
+    const int64_t c = w.shape()[1];
+    const int64_t lout = block ? block : k;
+    const int64_t lin = block ? block : c;
+    w = w.Reshape({k / lout, lout, c / lin, lin, w.shape()[2], w.shape()[3]});
+    return chainerx::AsContiguous(chainerx::Transpose(w, chainerx::Axes{0, 2, 4, 5, 3, 1}));
+}
+
+// (C, 1, KH, KW) => (CB, KH, KW, L).
+chainerx::Array PackDepthwiseWeight(chainerx::Array w, int64_t block) {
+    w = PadChannels(w, 0, block);
+    const int64_t c = w.shape()[0];
+    const int64_t l = block ? block : c;
+    w = w.Reshape({c / l, l, w.shape()[2], w.shape()[3]});
+    return chainerx::AsContiguous(chainerx::Transpose(w, chainerx::Axes{0, 2, 3, 1}));
+}
+
+class LayoutRewriter {
+public:
+    LayoutRewriter(Graph* graph, const std::vector<Node*>& nodes, const std::string& layout)
+        : graph_(graph), nodes_(nodes.begin(), nodes.end()), layout_(layout), block_(GetLayoutBlockSize(layout)) {
+    }
+
+    void Run(const std::vector<Node*>& sorted_nodes) {
+        for (Node* node : sorted_nodes) {
+            if (nodes_.count(node)) Rewrite(node);
+        }
+        CLOG() << "Layout " << layout_ << ": " << nodes_.size() << " ops with " << num_conversions_ << " conversions" << std::endl;
+    }
+
+private:
+    // Returns `value` in the layout. Values from outside the region are
+    // converted only once.
+    Value* ToLayout(Value* value) {
+        auto found = converted_.find(value);
+        if (found != converted_.end()) return found->second;
+        CHECK(!nodes_.count(value->producer())) << value->ToString();
+
+        GraphBuilder gb(graph_, "ConvertLayout", value);
+        Value* converted = gb.Temp(Type(value->type().dtype(), ToLayoutDims(value->type().dims(), layout_)));
+        Node* node = gb.MOp(Node::kChainerLayoutConvert, {value}, {converted});
+        node->set_src_layout(kNCHW)->set_dst_layout(layout_);
+        ++num_conversions_;
+        converted_.emplace(value, converted);
+        return converted;
+    }
+
+    // Returns per-channel values which are broadcasted to images in
+    // the layout.
+    chainerx::Array ToChannelArray(const chainerx::Array& a) {
+        chainerx::Array padded = PadChannels(a, 0, block_);
+        if (block_ == 0) return padded;
+        return padded.Reshape({padded.shape()[0] / block_, 1, 1, block_});
+    }
+
+    void Rewrite(Node* node) {
+        Value* output = node->output(0);
+        bool escapes = output->IsOutput();
+        for (Node* user : output->users()) {
+            if (!nodes_.count(user)) escapes = true;
+        }
+
+        GraphBuilder gb(graph_, "ConvertLayout", output);
+        Value* y = gb.Temp(Type(output->type().dtype(), ToLayoutDims(output->type().dims(), layout_)));
+        switch (node->op_type()) {
+            case Node::kConv:
+            case Node::kChainerFusedConv:
+                RewriteConv(&gb, *node, y);
+                break;
+
+            case Node::kMaxPool: {
+                Node* pool = gb.MOp(Node::kChainerLayoutMaxPool, {ToLayout(node->input(0))}, {y});
+                pool->set_layout(layout_)->set_kernel_shape(node->kernel_shape())->set_pads(node->pads())->set_strides(node->strides());
+                pool->set_chainer_cover_all(node->chainer_cover_all());
+                break;
+            }
+
+            case Node::kAveragePool: {
+                Node* pool = gb.MOp(Node::kChainerLayoutAveragePool, {ToLayout(node->input(0))}, {y});
+                pool->set_layout(layout_)->set_kernel_shape(node->kernel_shape())->set_pads(node->pads())->set_strides(node->strides());
+                pool->set_count_include_pad(node->count_include_pad());
+                break;
+            }
+
+            case Node::kBatchNormalization: {
+                // Inference BatchNormalization is an affine transform of
+                // each channel.
+                auto get_array = [node](int i) { return node->input(i)->GetConstTensor()->chx(); };
+                const chainerx::Array& var = get_array(4);
+                const chainerx::Array eps = chainerx::Full(var.shape(), node->epsilon(), var.dtype(), var.device());
+                const chainerx::Array scale = get_array(1) / chainerx::Sqrt(var + eps);
+                const chainerx::Array shift = get_array(2) - get_array(3) * scale;
+                Value* scaled = gb.Op(Node::kMul, {ToLayout(node->input(0)), gb.Param(ToChannelArray(scale))});
+                gb.Op(Node::kAdd, {scaled, gb.Param(ToChannelArray(shift))}, y);
+                break;
+            }
+
+            case Node::kRelu:
+            case Node::kAdd: {
+                std::vector<Value*> inputs;
+                for (Value* input : node->inputs()) inputs.push_back(ToLayout(input));
+                gb.Op(node->op_type(), inputs, y);
+                break;
+            }
+
+            case Node::kConcat: {
+                std::vector<Value*> inputs;
+                for (Value* input : node->inputs()) inputs.push_back(ToLayout(input));
+                // Blocks of channels are concatenated along the axis 1.
+                gb.Op(Node::kConcat, inputs, y)->producer()->set_axis(block_ ? 1 : 3);
+                break;
+            }
+
+            default:
+                CHECK(false) << node->ToString();
+        }
+
+        const int64_t channels = output->type().dims()[1];
+        graph_->DetachNode(node);
+        converted_.emplace(output, y);
+        if (escapes) {
+            Node* back = gb.MOp(Node::kChainerLayoutConvert, {y}, {output});
+            back->set_src_layout(layout_)->set_dst_layout(kNCHW)->set_channels(channels);
+            ++num_conversions_;
+        }
+    }
+
+    void RewriteConv(GraphBuilder* gb, const Node& node, Value* y) {
+        const chainerx::Array& w = node.input(1)->GetConstTensor()->chx();
+        const bool is_depthwise = node.group() > 1;
+        std::vector<Value*> inputs = {ToLayout(node.input(0)),
+                                      gb->Param(is_depthwise ? PackDepthwiseWeight(w, block_) : PackConvWeight(w, block_))};
+        if (HasInput(node, 2)) {
+            inputs.push_back(gb->Param(PadChannels(node.input(2)->GetConstTensor()->chx(), 0, block_)));
+        }
+        if (HasInput(node, 3)) {
+            if (inputs.size() == 2) inputs.push_back(gb->Null());
+            inputs.push_back(ToLayout(node.input(3)));
+        }
+
+        Node* conv = gb->MOp(Node::kChainerLayoutConv, inputs, {y});
+        conv->set_layout(layout_)->set_kernel_shape({w.shape()[2], w.shape()[3]});
+        conv->set_group(node.group())->set_pads(node.pads())->set_strides(node.strides());
+        if (node.op_type() == Node::kChainerFusedConv) {
+            conv->set_activation(node.activation())->set_alpha(node.alpha())->set_min(node.min())->set_max(node.max());
+        }
+    }
+
+    Graph* graph_;
+    std::set<Node*> nodes_;
+    const std::string layout_;
+    const int64_t block_;
+    std::map<Value*, Value*> converted_;
+    int num_conversions_{0};
+};
+
+Node* FindRoot(std::map<Node*, Node*>* parents, Node* node) {
+    Node* parent = (*parents)[node];
+    if (parent == node) return node;
+    Node* root = FindRoot(parents, parent);
+    (*parents)[node] = root;
+    return root;
+}
+
+// Blocked layouts are worth their padding when most channels are
+// multiples of the block.
+std::string ChooseLayout(const std::vector<Node*>& nodes) {
+    if (g_layout != "auto") return g_layout;
+    int64_t block = GetPreferredLayoutBlockSize();
+    for (const Node* node : nodes) {
+        if (!IsConvolution(*node)) continue;
+        const int64_t channels = node->output(0)->type().dims()[1];
+        if (channels % 8 != 0) return "NHWC";
+        if (channels % block != 0) block = 8;
+    }
+    return StrCat(kNCHW, block, 'c');
+}
+
+}  // namespace
+
+int64_t GetPreferredLayoutBlockSize() {
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    static const bool has_avx512 = __builtin_cpu_supports("avx512f");
+    return has_avx512 ? 16 : 8;
+#else
+    return 8;
+#endif
+}
+
+int64_t GetLayoutBlockSize(const std::string& layout) {
+    if (layout == "NHWC") return 0;
+    CHECK(layout.size() > 5 && layout.compare(0, 4, kNCHW) == 0 && layout.back() == 'c') << "Unknown layout: " << layout;
+    const int64_t block = std::stoll(layout.substr(4, layout.size() - 5));
+    CHECK_LT(0, block) << "Unknown layout: " << layout;
+    return block;
+}
+
+std::vector<int64_t> ToLayoutDims(const std::vector<int64_t>& nchw, const std::string& layout) {
+    CHECK_EQ(4, nchw.size());
+    const int64_t block = GetLayoutBlockSize(layout);
+    if (block == 0) return {nchw[0], nchw[2], nchw[3], nchw[1]};
+    return {nchw[0], (nchw[1] + block - 1) / block, nchw[2], nchw[3], block};
+}
+
+std::vector<int64_t> FromLayoutDims(const std::vector<int64_t>& dims, const std::string& layout) {
+    const int64_t block = GetLayoutBlockSize(layout);
+    if (block == 0) {
+        CHECK_EQ(4, dims.size());
+        return {dims[0], dims[3], dims[1], dims[2]};
+    }
+    CHECK_EQ(5, dims.size());
+    CHECK_EQ(block, dims[4]);
+    return {dims[0], dims[1] * block, dims[2], dims[3]};
+}
+
+void ConvertLayout(Graph* graph) {
+    if (g_layout.empty() || g_layout == kNCHW) return;
+
+    const std::vector<Node*> sorted_nodes = graph->GetTopologicallySortedNodes();
+    std::map<Node*, Node*> parents;
+    for (Node* node : sorted_nodes) {
+        if (CanConvertLayout(*node)) parents.emplace(node, node);
+    }
+    for (const auto& p : parents) {
+        for (Value* input : GetImageInputs(*p.first)) {
+            Node* producer = input->producer();
+            if (producer && parents.count(producer)) {
+                parents[FindRoot(&parents, p.first)] = FindRoot(&parents, producer);
+            }
+        }
+    }
+
+    std::map<Node*, std::vector<Node*>> regions;
+    for (Node* node : sorted_nodes) {
+        if (parents.count(node)) regions[FindRoot(&parents, node)].push_back(node);
+    }
+
+    for (const auto& p : regions) {
+        const std::vector<Node*>& region = p.second;
+        if (std::none_of(region.begin(), region.end(), [](const Node* node) { return IsConvolution(*node); })) continue;
+
+        const std::string layout = ChooseLayout(region);
+        const int64_t block = GetLayoutBlockSize(layout);
+        std::vector<Node*> nodes;
+        for (Node* node : region) {
+            // Padded channels cannot be concatenated.
+            bool padded = false;
+            if (block && node->op_type() == Node::kConcat) {
+                for (const Value* input : node->inputs()) {
+                    if (input->type().dims()[1] % block) padded = true;
+                }
+            }
+            if (!padded) nodes.push_back(node);
+        }
+
+        LayoutRewriter rewriter(graph, nodes, layout);
+        rewriter.Run(sorted_nodes);
+    }
+}
+
+}  // namespace chainer_compiler
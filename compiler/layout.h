@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace chainer_compiler {
+
+class Graph;
+
+// Returns B of "NCHW<B>c", or 0 for "NHWC".
+int64_t GetLayoutBlockSize(const std::string& layout);
+
+// Returns the number of floats in a vector register of the host CPU,
+// i.e., 16 with AVX-512 and 8 otherwise, which --layout auto uses as
+// the block size when channels are its multiples.
+int64_t GetPreferredLayoutBlockSize();
+
+// Converts dims of an NCHW image to dims in `layout`. Channels are
+// rounded up to a multiple of the block size.
+std::vector<int64_t> ToLayoutDims(const std::vector<int64_t>& nchw, const std::string& layout);
+
+// Converts dims in `layout` to NCHW dims, which have padded channels.
+std::vector<int64_t> FromLayoutDims(const std::vector<int64_t>& dims, const std::string& layout);
+
+// Rewrites connected Conv, MaxPool, AveragePool, BatchNormalization,
+// Relu, Add, and Concat on statically shaped float images into
+// ChainerLayout* ops in --layout with packed weights. Layout
+// conversions are inserted once for each value entering or leaving
+// such a region. For inference on CPU.
+void ConvertLayout(Graph* graph);
+
+}  // namespace chainer_compiler
@@ -0,0 +1,147 @@
+#include <map>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <chainerx/testing/context_session.h>
+
+#include <compiler/flags.h>
+#include <compiler/graph.h>
+#include <compiler/graph_builder.h>
+#include <compiler/layout.h>
+#include <compiler/node.h>
+#include <compiler/tensor.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+TEST(LayoutTest, Dims) {
+    EXPECT_EQ(0, GetLayoutBlockSize("NHWC"));
+    EXPECT_EQ(8, GetLayoutBlockSize("NCHW8c"));
+    EXPECT_EQ(16, GetLayoutBlockSize("NCHW16c"));
+
+    EXPECT_EQ(std::vector<int64_t>({2, 5, 7, 3}), ToLayoutDims({2, 3, 5, 7}, "NHWC"));
+    EXPECT_EQ(std::vector<int64_t>({2, 2, 5, 7, 8}), ToLayoutDims({2, 11, 5, 7}, "NCHW8c"));
+    EXPECT_EQ(std::vector<int64_t>({2, 3, 5, 7}), FromLayoutDims({2, 5, 7, 3}, "NHWC"));
+    EXPECT_EQ(std::vector<int64_t>({2, 16, 5, 7}), FromLayoutDims({2, 2, 5, 7, 8}, "NCHW8c"));
+}
+
+// Builds Conv -> Relu -> MaxPool -> Conv with constant weights.
+void BuildConvNet(Graph* graph, int64_t channels) {
+    Value* x = graph->AddInputValue("x", Type(Dtype::kFloat32, {2, 3, 8, 8}));
+    Value* output = graph->AddOutputValue("output", Type(Dtype::kFloat32, {2, channels, 4, 4}));
+    GraphBuilder gb(graph, "test", output);
+    Value* w1 = gb.Const(Type(Dtype::kFloat32, {channels, 3, 3, 3}), std::vector<float>(channels * 3 * 3 * 3, 0.1f));
+    Value* b1 = gb.Const(Type(Dtype::kFloat32, {channels}), std::vector<float>(channels, 0.5f));
+    Value* w2 = gb.Const(Type(Dtype::kFloat32, {channels, channels, 1, 1}), std::vector<float>(channels * channels, 0.2f));
+    Value* h = gb.Op(Node::kConv, {x, w1, b1});
+    h->producer()->set_pads({1, 1, 1, 1});
+    h = gb.Op(Node::kRelu, {h});
+    h = gb.Op(Node::kMaxPool, {h});
+    h->producer()->set_kernel_shape({2, 2})->set_strides({2, 2});
+    gb.Op(Node::kConv, {h, w2}, output);
+}
+
+std::map<Node::OpType, std::vector<const Node*>> GetNodesByType(const Graph& graph) {
+    std::map<Node::OpType, std::vector<const Node*>> nodes;
+    for (const Node* node : graph.GetLiveNodes()) nodes[node->op_type()].push_back(node);
+    return nodes;
+}
+
+TEST(LayoutTest, NHWC) {
+    chainerx::testing::ContextSession sess;
+    g_layout = "NHWC";
+    Graph graph("test");
+    BuildConvNet(&graph, 4);
+    ConvertLayout(&graph);
+    graph.DeleteDetached();
+    graph.CheckSanity("converted");
+
+    auto nodes = GetNodesByType(graph);
+    // One conversion for the input and one for the output.
+    ASSERT_EQ(2, nodes[Node::kChainerLayoutConvert].size());
+    ASSERT_EQ(2, nodes[Node::kChainerLayoutConv].size());
+    ASSERT_EQ(1, nodes[Node::kChainerLayoutMaxPool].size());
+    ASSERT_EQ(1, nodes[Node::kRelu].size());
+    EXPECT_EQ(0, nodes[Node::kConv].size());
+    EXPECT_EQ(0, nodes[Node::kMaxPool].size());
+
+    for (const Node* conv : nodes[Node::kChainerLayoutConv]) {
+        EXPECT_EQ("NHWC", conv->layout());
+        ASSERT_TRUE(conv->input(1)->GetConstTensor());
+        const std::vector<int64_t> w = conv->input(1)->GetConstTensor()->dims();
+        ASSERT_EQ(6, w.size());
+        EXPECT_EQ(1, w[0]);
+        EXPECT_EQ(1, w[1]);
+        EXPECT_EQ(4, w[5]);
+    }
+    const Node* pool = nodes[Node::kChainerLayoutMaxPool][0];
+    EXPECT_EQ(std::vector<int64_t>({2, 4, 4, 4}), pool->output(0)->type().dims());
+    g_layout = "";
+}
+
+TEST(LayoutTest, PaddedBlocks) {
+    chainerx::testing::ContextSession sess;
+    g_layout = "NCHW8c";
+    Graph graph("test");
+    BuildConvNet(&graph, 5);
+    ConvertLayout(&graph);
+    graph.DeleteDetached();
+    graph.CheckSanity("converted");
+
+    auto nodes = GetNodesByType(graph);
+    ASSERT_EQ(2, nodes[Node::kChainerLayoutConvert].size());
+    ASSERT_EQ(2, nodes[Node::kChainerLayoutConv].size());
+    for (const Node* convert : nodes[Node::kChainerLayoutConvert]) {
+        if (convert->dst_layout() == "NCHW") {
+            // Padded channels are dropped when leaving the region.
+            EXPECT_EQ(5, convert->channels());
+            EXPECT_EQ(std::vector<int64_t>({2, 5, 4, 4}), convert->output(0)->type().dims());
+        } else {
+            EXPECT_EQ(std::vector<int64_t>({2, 1, 8, 8, 8}), convert->output(0)->type().dims());
+        }
+    }
+    const Node* pool = nodes[Node::kChainerLayoutMaxPool][0];
+    EXPECT_EQ(std::vector<int64_t>({2, 1, 4, 4, 8}), pool->output(0)->type().dims());
+    g_layout = "";
+}
+
+std::string GetAutoLayout(int64_t channels) {
+    g_layout = "auto";
+    Graph graph("test");
+    BuildConvNet(&graph, channels);
+    ConvertLayout(&graph);
+    g_layout = "";
+    auto nodes = GetNodesByType(graph);
+    if (nodes[Node::kChainerLayoutConv].empty()) return "";
+    return nodes[Node::kChainerLayoutConv][0]->layout();
+}
+
+TEST(LayoutTest, Auto) {
+    chainerx::testing::ContextSession sess;
+    EXPECT_EQ("NHWC", GetAutoLayout(12));
+    EXPECT_EQ("NCHW8c", GetAutoLayout(24));
+    // 16 floats fill a vector register with AVX-512.
+    EXPECT_EQ("NCHW" + std::to_string(GetPreferredLayoutBlockSize()) + "c", GetAutoLayout(32));
+}
+
+TEST(LayoutTest, NoConv) {
+    g_layout = "NHWC";
+    Type type(Dtype::kFloat32, {2, 3, 8, 8});
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", type);
+    Value* output = graph.AddOutputValue("output", type);
+    {
+        GraphBuilder gb(&graph, "test", output);
+        gb.Op(Node::kRelu, {x}, output);
+    }
+    ConvertLayout(&graph);
+    graph.DeleteDetached();
+    ASSERT_EQ(1, graph.nodes().size());
+    EXPECT_EQ(Node::kRelu, graph.nodes()[0]->op_type());
+    g_layout = "";
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -1,5 +1,6 @@
 #include "compiler/memory_simulator.h"
 
+#include <algorithm>
 #include <map>
 #include <numeric>
 
@@ -7,15 +8,53 @@
 #include <common/strutil.h>
 #include <compiler/graph.h>
 #include <compiler/log.h>
+#include <compiler/node.h>
+#include <compiler/value.h>
 
 namespace chainer_compiler {
 
+namespace {
+
+bool CanRunInPlace(Node::OpType op_type) {
+    switch (op_type) {
+        case Node::kAdd:
+        case Node::kMul:
+        case Node::kRelu:
+        case Node::kChainerReluGrad:
+        case Node::kSigmoid:
+        case Node::kTanh:
+        case Node::kClip:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Returns an input of `node` whose buffer can be reused for the output
+// of `node`, or nullptr.
+const Value* FindInPlaceInput(const Node& node, const std::map<const Value*, int>& num_users) {
+    if (!CanRunInPlace(node.op_type()) || node.outputs().size() != 1) return nullptr;
+    const Value* output = node.output(0);
+    for (const Value* input : node.inputs()) {
+        if (!input->IsTemp() || input->type().dtype() != output->type().dtype()) continue;
+        if (input->GetNBytes() < 0 || input->GetNBytes() != output->GetNBytes()) continue;
+        auto found = num_users.find(input);
+        if (found == num_users.end()) continue;
+        const int num_uses = std::count(node.inputs().begin(), node.inputs().end(), input);
+        if (found->second == num_uses) return input;
+    }
+    return nullptr;
+}
+
+}  // namespace
+
 SimulatedMemoryUsage SimulateMemoryUsage(const Graph& graph) {
     std::map<const Value*, int> num_users;
     SimulatedMemoryUsage usage{};
     int64_t mem = 0;
+    int64_t mem_inplace = 0;
 
-    auto alloc = [&usage, &mem](const Value* value) {
+    auto alloc = [&usage, &mem, &mem_inplace](const Value* value) {
         const int64_t increase = value->GetNBytes();
         usage.num_values++;
         if (increase < 0) {
@@ -25,8 +64,10 @@ SimulatedMemoryUsage SimulateMemoryUsage(const Graph& graph) {
             return;
         }
         mem += increase;
+        mem_inplace += increase;
         usage.all += increase;
         usage.peak = std::max<int64_t>(usage.peak, mem);
+        usage.peak_inplace = std::max<int64_t>(usage.peak_inplace, mem_inplace);
     };
 
     for (const Value* value : graph.GetNecessaryValues()) {
@@ -45,6 +86,11 @@ SimulatedMemoryUsage SimulateMemoryUsage(const Graph& graph) {
 
     std::vector<const Node*> nodes(graph.GetComputationSequence());
     for (const Node* node : nodes) {
+        // The buffer of `reused` is handed over to the output.
+        const Value* reused = FindInPlaceInput(*node, num_users);
+        if (reused) {
+            mem_inplace -= reused->GetNBytes();
+        }
         for (const Value* value : node->outputs()) {
             alloc(value);
         }
@@ -53,6 +99,9 @@ SimulatedMemoryUsage SimulateMemoryUsage(const Graph& graph) {
             if (found == num_users.end()) continue;
             if (--found->second == 0) {
                 mem -= value->GetNBytes();
+                if (value != reused) {
+                    mem_inplace -= value->GetNBytes();
+                }
             }
         }
     }
@@ -67,8 +116,9 @@ void ShowSimulatedMemoryUsage(const Graph& graph) {
     }
     int64_t param_mb = usage.param / 1000 / 1000;
     int64_t peak_mb = usage.peak / 1000 / 1000;
+    int64_t peak_inplace_mb = usage.peak_inplace / 1000 / 1000;
     int64_t all_mb = usage.all / 1000 / 1000;
-    std::cerr << "Simulated memory usage: param=" << param_mb << "MB peak=" << peak_mb << "MB all=" << all_mb << "MB" << std::endl;
+    std::cerr << "Simulated memory usage: param=" << param_mb << "MB peak=" << peak_mb << "MB peak_inplace=" << peak_inplace_mb << "MB all=" << all_mb << "MB" << std::endl;
 }
 
 }  // namespace chainer_compiler
@@ -9,6 +9,9 @@ class Graph;
 struct SimulatedMemoryUsage {
     int64_t param;
     int64_t peak;
+    // The peak when element-wise ops write their outputs to inputs
+    // which die at them (see MarkInPlaceOutputs).
+    int64_t peak_inplace;
     int64_t all;
     int num_values;
     int num_unknowns;
@@ -4,65 +4,56 @@
 #include <chainerx/routines/manipulation.h>
 #include <chainerx/routines/misc.h>
 
-#include <common/iterator.h>
+#include <compiler/flags.h>
 #include <compiler/graph.h>
 #include <compiler/graph_builder.h>
 #include <compiler/node.h>
+#include <compiler/pattern_rewriter.h>
+#include <compiler/tensor.h>
+#include <compiler/type.h>
 #include <compiler/value.h>
+#include <configs/backend_config.h>
 
 namespace chainer_compiler {
 
 namespace {
 
-bool MaybeMergeSplitConcat(Graph* graph, Node* node) {
-    Node::OpType user_type = node->op_type() == Node::kSplit ? Node::kConcat : Node::kSplit;
-
-    // Check if all outputs are used by a single Concat/Split.
-    Node* user = nullptr;
-    for (Value* output : node->outputs()) {
-        if (output->users().size() != 1) {
-            return false;
-        }
-        if (user && user != output->user(0)) {
-            return false;
-        }
-        user = output->user(0);
-    }
-    if (!user) {
-        return false;
-    }
-    if (user->op_type() != user_type) {
-        return false;
-    }
-    if (node->inputs().size() != user->outputs().size()) {
+// Split followed by Concat which restores the input.
+bool IsSplitConcat(const Node& concat) {
+    const Node* split = concat.input(0)->producer();
+    if (!split || split->op_type() != Node::kSplit || concat.inputs().size() != split->outputs().size()) {
         return false;
     }
-    if (node->outputs().size() != user->inputs().size()) {
+    if (split->inputs().size() != 1 || concat.outputs().size() != 1) {
         return false;
     }
-    if (node->axis() != user->axis()) {
+    if (split->axis() != concat.axis()) {
         return false;
     }
-
-    for (const auto& p : Zip(node->inputs(), user->outputs())) {
-        Value* input;
-        Value* output;
-        std::tie(input, output) = p;
-        GraphBuilder gb(graph, "MergeSplitConcat", output);
-        gb.Op(Node::kIdentity, {input}, output);
+    // All outputs of the Split must be used by the Concat in order.
+    for (size_t i = 0; i < concat.inputs().size(); ++i) {
+        Value* output = split->output(i);
+        if (concat.input(i) != output || output->users().size() != 1 || output->IsOutput()) {
+            return false;
+        }
     }
+    return true;
+}
 
-    graph->DetachNode(node);
-    graph->DetachNode(user);
+bool MergeSplitConcat(Graph* graph, const PatternMatch& m) {
+    Node* split = m.node("split");
+    Node* concat = m.root();
+    GraphBuilder gb(graph, "MergeSplitConcat", concat->output(0));
+    gb.Op(Node::kIdentity, {split->input(0)}, concat->output(0));
     return true;
 }
 
-bool MaybeMergePadConv(Graph* graph, Node* pad) {
-    if (pad->value() != 0.0 || pad->mode() != "constant") {
+bool IsMergeablePad(const Node& pad) {
+    if (pad.value() != 0.0 || pad.mode() != "constant" || pad.inputs().size() != 1) {
         return false;
     }
 
-    std::vector<int64_t> const& pads = pad->pads();
+    std::vector<int64_t> const& pads = pad.pads();
 
     // Padding for non-spatial dims can't be merged.
     if (pads.size() < 4) {
@@ -73,7 +64,7 @@ bool MaybeMergePadConv(Graph* graph, Node* pad) {
     }
 
     // Padding of begin and end must be same due to ChainerX limitation.
-    for (auto i = 2; i < pads.size() / 2; ++i) {
+    for (size_t i = 2; i < pads.size() / 2; ++i) {
         if (pads[i] != pads[pads.size() / 2 + i]) {
             return false;
         }
@@ -85,20 +76,17 @@ bool MaybeMergePadConv(Graph* graph, Node* pad) {
             return false;
         }
     }
+    return true;
+}
 
-    // Connected node must be Conv.
-    if (pad->outputs().size() != 1 || pad->output(0)->users().size() != 1) {
-        return false;
-    }
-    Value* pad_conv = pad->output(0);
-    Node* conv = pad_conv->user(0);
-    if (conv->input(0) != pad_conv || conv->op_type() != Node::kConv) {
-        return false;
-    }
+bool MergePadConv(Graph* graph, const PatternMatch& m) {
+    Node* pad = m.node("pad");
+    Node* conv = m.root();
+    std::vector<int64_t> const& pads = pad->pads();
 
     // Replace Pad+Conv with merged Conv.
     GraphBuilder gb(graph, "MergePadConv", pad->input(0));
-    std::vector<Value*> new_in = pad->inputs();
+    std::vector<Value*> new_in = {m.value("x")};
     std::copy(conv->inputs().begin() + 1, conv->inputs().end(), std::back_inserter(new_in));
     Node* n = gb.MOp(Node::kConv, new_in, conv->outputs());
     n->set_dilations(conv->dilations());
@@ -109,51 +97,36 @@ bool MaybeMergePadConv(Graph* graph, Node* pad) {
 
     // Merge pads with Conv op.
     std::vector<int64_t> new_pads(pads.size() - 4);
-    for (auto i = 2; i < pads.size() / 2; ++i) {
+    for (size_t i = 2; i < pads.size() / 2; ++i) {
         // Merge [x1_begin, x2_begin...] part.
         new_pads[i - 2] = conv->pads()[i - 2] + pads[i];
         // Merge [x1_end, x2_end...] part.
         new_pads[new_pads.size() / 2 + (i - 2)] = conv->pads()[i - 2] + pads[pads.size() / 2 + i];
     }
     n->set_pads(std::move(new_pads));
-
-    graph->DetachNode(pad);
-    graph->DetachNode(conv);
-
     return true;
 }
 
-bool MaybeMergeConvBN(Graph* graph, Node* conv) {
-    Value* conv_bn = conv->output(0);
-    if (conv_bn->users().size() != 1) {
-        return false;
-    }
-    Node* bn = conv_bn->user(0);
-    if (bn->input(0) != conv_bn || bn->op_type() != Node::kBatchNormalization || bn->outputs().size() != 1) {
-        return false;
-    }
-
-#define GET_TENSOR(name, in, idx)                            \
-    Value* name##_val = in->input(idx);                      \
-    const Tensor* name##_tns = name##_val->GetConstTensor(); \
-    if (!name##_tns) {                                       \
-        return false;                                        \
-    }                                                        \
-    chainerx::Array name = name##_tns->chx()
+bool MergeConvBN(Graph* graph, const PatternMatch& m) {
+    Node* conv = m.node("conv");
+    Node* bn = m.root();
 
     chainerx::Array bc;
     const bool has_conv_bias = conv->inputs().size() == 3;
-
     if (has_conv_bias) {
-        GET_TENSOR(bias, conv, 2);
-        bc = bias;
+        const Tensor* bias = conv->input(2)->GetConstTensor();
+        if (!bias) {
+            return false;
+        }
+        bc = bias->chx();
     }
 
-    GET_TENSOR(scale, bn, 1);
-    GET_TENSOR(bn_bias, bn, 2);
-    GET_TENSOR(mean, bn, 3);
-    GET_TENSOR(var, bn, 4);
-    GET_TENSOR(w, conv, 1);
+    auto get_array = [&m](const char* name) { return m.value(name)->GetConstTensor()->chx(); };
+    chainerx::Array scale = get_array("scale");
+    chainerx::Array bn_bias = get_array("bias");
+    chainerx::Array mean = get_array("mean");
+    chainerx::Array var = get_array("var");
+    chainerx::Array w = get_array("w");
     const float epsilon = bn->epsilon();
 
     const chainerx::Array eps = chainerx::Full({scale.shape()[0]}, epsilon, scale.dtype(), scale.device());
@@ -169,35 +142,19 @@ bool MaybeMergeConvBN(Graph* graph, Node* conv) {
     bc = (bc - mean) * s + bn_bias;
 
     GraphBuilder gb(graph, "MergeConvBN", bn->input(0));
-    Node* new_conv = gb.MOp(Node::kConv, {conv->input(0), gb.Param(new_w), gb.Param(bc)}, bn->outputs());
+    Node* new_conv = gb.MOp(Node::kConv, {m.value("x"), gb.Param(new_w), gb.Param(bc)}, bn->outputs());
     new_conv->set_auto_pad(conv->auto_pad());
     new_conv->set_dilations(conv->dilations());
     new_conv->set_group(conv->group());
     new_conv->set_pads(conv->pads());
     new_conv->set_strides(conv->strides());
-
-    graph->DetachNode(conv);
-    graph->DetachNode(bn);
-
-#undef GET_TENSOR
-
     return true;
 }
 
-bool MaybeMergeTransposeGemm(Graph* graph, Node* trans) {
+bool MergeTransposeGemm(Graph* graph, const PatternMatch& m) {
+    Node* trans = m.node("trans");
+    Node* gemm = m.root();
     Value* trans_gemm = trans->output(0);
-    if (trans_gemm->users().size() != 1) {
-        return false;
-    }
-    Node* gemm = trans_gemm->user(0);
-    if (trans->output(0) != trans_gemm || gemm->op_type() != Node::kGemm) {
-        return false;
-    }
-
-    std::vector<int64_t> opt_perm{1, 0};
-    if (trans->perm() != opt_perm) {
-        return false;
-    }
 
     GraphBuilder gb(graph, "MergeTransposeGemm", trans->input(0));
     std::vector<Value*> new_in = gemm->inputs();
@@ -211,78 +168,201 @@ bool MaybeMergeTransposeGemm(Graph* graph, Node* trans) {
     new_gemm->set_beta(gemm->beta());
     new_gemm->set_trans_a(new_in[0] == trans->input(0) ? !gemm->trans_a() : gemm->trans_a());
     new_gemm->set_trans_b(new_in[1] == trans->input(0) ? !gemm->trans_b() : gemm->trans_b());
+    return true;
+}
 
-    graph->DetachNode(trans);
-    graph->DetachNode(gemm);
-
+bool MergeMatMulAdd(Graph* graph, const PatternMatch& m) {
+    Node* add = m.root();
+    GraphBuilder gb(graph, "MergeMatMulAdd", m.value("a"));
+    gb.Op(Node::kGemm, {m.value("a"), m.value("b"), m.value("c")}, add->output(0));
     return true;
 }
 
-bool MaybeMergeMatMulAdd(Graph* graph, Node* matmul) {
-    if (matmul->input(0)->type().ndim() != 2 || matmul->input(1)->type().ndim() != 2) {
-        return false;
-    }
+bool IsMatrix(const Value& value) {
+    return value.type().ndim() == 2;
+}
 
-    const std::vector<Node*>& users = matmul->output(0)->users();
-    if (users.size() != 1) {
-        return false;
-    }
-    Node& add = *users.front();
-    if (add.op_type() != Node::kAdd) {
-        return false;
+bool IsFusableConv(const Node& conv) {
+    for (int64_t d : conv.dilations()) {
+        if (d != 1) {
+            return false;
+        }
     }
+    return true;
+}
 
-    GraphBuilder gb(graph, "MergeMatMulAdd", matmul->input(0));
+bool HasSameKnownShape(const Value& a, const Value& b) {
+    const Type& at = a.type();
+    const Type& bt = b.type();
+    return at.kind() == Type::Kind::kTensor && bt.kind() == Type::Kind::kTensor && at.HasKnownShape() && bt.HasKnownShape() &&
+           at.dtype() == bt.dtype() && at.dims() == bt.dims();
+}
 
-    Value* c = add.input(add.input(0) == matmul->output(0) ? 1 : 0);
-    if (c->type().ndim() != 2) {
-        return false;
+Node* AddFusedConv(GraphBuilder* gb, const Node& conv, const std::vector<Value*>& inputs, Value* output) {
+    Node* fused = gb->MOp(Node::kChainerFusedConv, inputs, {output});
+    fused->set_auto_pad(conv.auto_pad());
+    fused->set_dilations(conv.dilations());
+    fused->set_group(conv.group());
+    fused->set_kernel_shape(conv.kernel_shape());
+    fused->set_pads(conv.pads());
+    fused->set_strides(conv.strides());
+    return fused;
+}
+
+// Conv + Add(residual) => ChainerFusedConv.
+bool FuseConvAdd(Graph* graph, const PatternMatch& m) {
+    Node* conv = m.node("conv");
+    Node* add = m.root();
+    GraphBuilder gb(graph, "FuseConvAdd", add->output(0));
+    Value* b = conv->inputs().size() == 3 ? conv->input(2) : gb.Null();
+    AddFusedConv(&gb, *conv, {conv->input(0), conv->input(1), b, m.value("z")}, add->output(0));
+    return true;
+}
+
+// Conv or ChainerFusedConv + activation => ChainerFusedConv.
+bool FuseConvActivation(Graph* graph, const PatternMatch& m) {
+    Node* conv = m.node("conv");
+    Node* act = m.root();
+    GraphBuilder gb(graph, "FuseConvActivation", act->output(0));
+    Node* fused = AddFusedConv(&gb, *conv, conv->inputs(), act->output(0));
+    fused->set_activation(Node::OpTypeToString(act->op_type()));
+    switch (act->op_type()) {
+        case Node::kLeakyRelu:
+            fused->set_alpha(act->alpha());
+            break;
+        case Node::kClip:
+            fused->set_min(act->min());
+            fused->set_max(act->max());
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+// Forms ChainerFusedConv from Conv -> Add(residual) -> activation
+// such as the tail of ResNet blocks.
+void AddConvEpilogueRules(PatternRewriter* rewriter) {
+    auto conv = []() { return Pattern::Op(Node::kConv, {}, "conv").OneUse().If(IsFusableConv); };
+    rewriter->AddRule(
+            "FuseConvAdd",
+            Pattern::Op(Node::kAdd, {conv(), Pattern::Any("z")})
+                    .Commutative()
+                    .If([](const Node& add) {
+                        return HasSameKnownShape(*add.input(0), *add.input(1)) && HasSameKnownShape(*add.input(0), *add.output(0));
+                    }),
+            FuseConvAdd);
+
+    for (Node::OpType act : {Node::kRelu, Node::kLeakyRelu, Node::kSigmoid, Node::kClip}) {
+        auto is_unary = [](const Node& node) { return node.inputs().size() == 1; };
+        rewriter->AddRule("FuseConvActivation", Pattern::Op(act, {conv()}).If(is_unary), FuseConvActivation);
+        rewriter->AddRule(
+                "FuseConvActivation",
+                Pattern::Op(act,
+                            {Pattern::Op(Node::kChainerFusedConv, {}, "conv").OneUse().If([](const Node& fused) {
+                                return fused.activation().empty();
+                            })})
+                        .If(is_unary),
+                FuseConvActivation);
     }
-    gb.Op(Node::kGemm, {matmul->input(0), matmul->input(1), c}, add.output(0));
+}
+
+bool IsVector(const Value& value) {
+    return value.type().ndim() == 1;
+}
 
-    graph->DetachNode(matmul);
-    graph->DetachNode(&add);
+// Gemm which computes the same value as ChainerLinear.
+bool IsLinearGemm(const Node& gemm) {
+    return gemm.inputs().size() == 3 && gemm.alpha() == 1.0 && gemm.beta() == 1.0 && !gemm.trans_a() && gemm.trans_b();
+}
 
+// Gemm or ChainerLinear + activation => ChainerFusedLinear.
+bool FuseLinearActivation(Graph* graph, const PatternMatch& m) {
+    Node* linear = m.node("linear");
+    Node* act = m.root();
+    GraphBuilder gb(graph, "FuseLinearActivation", act->output(0));
+    gb.MOp(Node::kChainerFusedLinear, linear->inputs(), {act->output(0)})->set_activation(Node::OpTypeToString(act->op_type()));
     return true;
 }
 
+// Forms ChainerFusedLinear from layers of MLPs. Gradients of the
+// activations are fused into ChainerFusedLinearGradWeight.
+void AddLinearEpilogueRules(PatternRewriter* rewriter) {
+    auto is_unary = [](const Node& node) { return node.inputs().size() == 1; };
+    auto matrix = []() { return Pattern::Any().IfValue(IsMatrix); };
+    for (Node::OpType act : {Node::kRelu, Node::kTanh, Node::kSigmoid}) {
+        Pattern gemm = Pattern::Op(Node::kGemm, {matrix(), matrix(), Pattern::Any().IfValue(IsVector)}, "linear");
+        gemm.OneUse().If(IsLinearGemm);
+        rewriter->AddRule("FuseLinearActivation", Pattern::Op(act, {gemm}).If(is_unary), FuseLinearActivation);
+
+        Pattern linear = Pattern::Op(Node::kChainerLinear, {matrix(), matrix()}, "linear");
+        linear.OneUse().If([](const Node& node) { return node.n_batch_axes() == 1; });
+        rewriter->AddRule("FuseLinearActivation", Pattern::Op(act, {linear}).If(is_unary), FuseLinearActivation);
+    }
+}
+
 }  // namespace
 
-void MergeOperations(Graph* graph, bool gen_backprop) {
-    bool replaced = true;
-    while (replaced) {
-        replaced = false;
-        for (Node* node : graph->GetLiveNodes()) {
-            if (node->detached()) {
-                continue;
-            }
-
-            // TODO(hamaji): Fix the implementation of Concat => Split
-            // merge. Unlike Split => Concat merge, we should check
-            // if the split dimensions are not changed.
-            switch (node->op_type()) {
-                case Node::kSplit:
-                    replaced |= MaybeMergeSplitConcat(graph, node);
-                    break;
-                case Node::kPad:
-                    replaced |= MaybeMergePadConv(graph, node);
-                    break;
-                case Node::kConv:
-                    if (!gen_backprop) {
-                        replaced |= MaybeMergeConvBN(graph, node);
-                    }
-                    break;
-                case Node::kTranspose:
-                    replaced |= MaybeMergeTransposeGemm(graph, node);
-                    break;
-                case Node::kMatMul:
-                    replaced |= MaybeMergeMatMulAdd(graph, node);
-                    break;
-                default:
-                    break;
-            }
-        }
+void MergeOperations(Graph* graph, bool gen_backprop, const BackendConfig* backend_config) {
+    PatternRewriter rewriter;
+
+    // TODO(hamaji): Fix the implementation of Concat => Split
+    // merge. Unlike Split => Concat merge, we should check
+    // if the split dimensions are not changed.
+    rewriter.AddRule(
+            "MergeSplitConcat", Pattern::Op(Node::kConcat, {Pattern::Op(Node::kSplit, {}, "split")}).If(IsSplitConcat), MergeSplitConcat);
+
+    rewriter.AddRule(
+            "MergePadConv",
+            Pattern::Op(Node::kConv, {Pattern::Op(Node::kPad, {Pattern::Any("x")}, "pad").OneUse().If(IsMergeablePad)}),
+            MergePadConv);
+
+    if (!gen_backprop) {
+        rewriter.AddRule(
+                "MergeConvBN",
+                Pattern::Op(
+                        Node::kBatchNormalization,
+                        {Pattern::Op(Node::kConv, {Pattern::Any("x"), Pattern::Const("w")}, "conv").OneUse(),
+                         Pattern::Const("scale"),
+                         Pattern::Const("bias"),
+                         Pattern::Const("mean"),
+                         Pattern::Const("var")})
+                        .If([](const Node& bn) { return bn.outputs().size() == 1; }),
+                MergeConvBN);
     }
+
+    // The transposed matrix can be either A or B.
+    rewriter.AddRule(
+            "MergeTransposeGemm",
+            Pattern::Op(
+                    Node::kGemm,
+                    {Pattern::Op(Node::kTranspose, {}, "trans").OneUse().If([](const Node& trans) {
+                        return trans.perm() == std::vector<int64_t>({1, 0});
+                    }),
+                     Pattern::Any()})
+                    .Commutative(),
+            MergeTransposeGemm);
+
+    rewriter.AddRule(
+            "MergeMatMulAdd",
+            Pattern::Op(
+                    Node::kAdd,
+                    {Pattern::Op(Node::kMatMul, {Pattern::Any("a").IfValue(IsMatrix), Pattern::Any("b").IfValue(IsMatrix)}).OneUse(),
+                     Pattern::Any("c").IfValue(IsMatrix)})
+                    .Commutative(),
+            MergeMatMulAdd);
+
+    // ChainerFusedConv has no gradient.
+    if (!gen_backprop && !g_skip_fused_conv && backend_config && backend_config->HasOp("ChainerFusedConv")) {
+        AddConvEpilogueRules(&rewriter);
+    }
+
+    if (!g_skip_fused_linear && backend_config && backend_config->HasOp("ChainerFusedLinear") &&
+        (!gen_backprop || backend_config->HasOp("ChainerFusedLinearGradWeight"))) {
+        AddLinearEpilogueRules(&rewriter);
+    }
+
+    rewriter.Run(graph);
 }
 
 }  // namespace chainer_compiler
@@ -2,8 +2,12 @@
 
 namespace chainer_compiler {
 
+class BackendConfig;
 class Graph;
 
-void MergeOperations(Graph* graph, bool gen_backprop);
+// Merges sequences of nodes into cheaper ones. Merges which create
+// backend specific ops are done only when `backend_config` supports
+// the ops.
+void MergeOperations(Graph* graph, bool gen_backprop, const BackendConfig* backend_config = nullptr);
 
 }  // namespace chainer_compiler
@@ -7,6 +7,7 @@
 #include <compiler/graph.h>
 #include <compiler/graph_builder.h>
 #include <compiler/merge.h>
+#include <configs/backend_config.h>
 #include <runtime/chainerx_util.h>
 
 namespace chainer_compiler {
@@ -180,5 +181,68 @@ TEST(MergeTest, MatMulAdd) {
     graph.CheckSanity("merged");
 }
 
+TEST(MergeTest, ConvAddRelu) {
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32, {2, 3, 8, 8}));
+    Value* w = graph.AddInputValue("w", Type(Dtype::kFloat32, {3, 3, 3, 3}));
+    Value* b = graph.AddInputValue("b", Type(Dtype::kFloat32, {3}));
+    Value* output = graph.AddOutputValue("output", Type(Dtype::kFloat32, {2, 3, 8, 8}));
+
+    {
+        GraphBuilder gb(&graph, "test", output);
+        Value* conv = gb.Op(Node::kConv, {x, w, b});
+        conv->producer()->set_pads({1, 1, 1, 1})->set_strides({1, 1});
+        // The residual is on the left hand side.
+        gb.Op(Node::kRelu, {gb.Op(Node::kAdd, {x, conv})}, output);
+    }
+
+    // Nothing is fused unless the backend supports the fused op.
+    MergeOperations(&graph, false);
+    graph.DeleteDetached();
+    EXPECT_EQ(3, graph.nodes().size());
+
+    std::unique_ptr<BackendConfig> backend_config(BackendConfig::FromName("chxvm"));
+    MergeOperations(&graph, false, backend_config.get());
+    graph.DeleteDetached();
+    ASSERT_EQ(1, graph.nodes().size());
+    const Node& node = *graph.nodes()[0];
+    ASSERT_EQ(Node::kChainerFusedConv, node.op_type());
+    ASSERT_EQ(4, node.inputs().size());
+    EXPECT_EQ(x, node.input(0));
+    EXPECT_EQ(w, node.input(1));
+    EXPECT_EQ(b, node.input(2));
+    EXPECT_EQ(x, node.input(3));
+    EXPECT_EQ(output, node.output(0));
+    EXPECT_EQ("Relu", node.activation());
+    EXPECT_EQ(std::vector<int64_t>({1, 1, 1, 1}), node.pads());
+    graph.CheckSanity("merged");
+}
+
+TEST(MergeTest, GemmRelu) {
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32, {4, 3}));
+    Value* w = graph.AddInputValue("w", Type(Dtype::kFloat32, {5, 3}));
+    Value* b = graph.AddInputValue("b", Type(Dtype::kFloat32, {5}));
+    Value* output = graph.AddOutputValue("output", Type(Dtype::kFloat32, {4, 5}));
+
+    {
+        GraphBuilder gb(&graph, "test", output);
+        Value* y = gb.Op(Node::kGemm, {x, w, b});
+        y->producer()->set_trans_b(true);
+        gb.Op(Node::kRelu, {y}, output);
+    }
+
+    std::unique_ptr<BackendConfig> backend_config(BackendConfig::FromName("chxvm"));
+    MergeOperations(&graph, true, backend_config.get());
+    graph.DeleteDetached();
+    ASSERT_EQ(1, graph.nodes().size());
+    const Node& node = *graph.nodes()[0];
+    ASSERT_EQ(Node::kChainerFusedLinear, node.op_type());
+    EXPECT_EQ(std::vector<Value*>({x, w, b}), node.inputs());
+    EXPECT_EQ(output, node.output(0));
+    EXPECT_EQ("Relu", node.activation());
+    graph.CheckSanity("merged");
+}
+
 }  // namespace
 }  // namespace chainer_compiler
@@ -153,6 +153,8 @@ TEST(ModelTest, CompileCH2OResNet50) {
     EXPECT_GT(110 * 1000 * 1000, usage.param);
     // Followings could require some tweaks after some optimizations.
     EXPECT_LT(250 * 1000 * 1000, usage.peak);
+    EXPECT_LT(0, usage.peak_inplace);
+    EXPECT_GT(usage.peak, usage.peak_inplace);
     EXPECT_LT(300 * 1000 * 1000, usage.all);
 }
 
@@ -5,6 +5,7 @@
 #include <map>
 #include <memory>
 
+#include <compiler/common_subexpression_elimination.h>
 #include <compiler/computation_order/core.h>
 #include <compiler/constant_propagation.h>
 #include <compiler/dtype_inference.h>
@@ -14,12 +15,16 @@
 #include <compiler/gradient.h>
 #include <compiler/gradient_with_order.h>
 #include <compiler/graph.h>
+#include <compiler/layout.h>
 #include <compiler/memory_simulator.h>
 #include <compiler/merge.h>
 #include <compiler/model.h>
+#include <compiler/prepack.h>
 #include <compiler/scheduler.h>
 #include <compiler/shape_evaluator.h>
+#include <compiler/shape_inference.h>
 #include <compiler/simplifier.h>
+#include <compiler/stream_scheduler.h>
 #include <compiler/subgraph_canonicalizer.h>
 #include <configs/backend_config.h>
 
@@ -115,12 +120,18 @@ void RunDefaultPasses(Graph* graph, bool gen_backprop, bool skip_scheduling) {
             Simplify(bc.GetSimplifyPreproc(), graph, gen_backprop);
         });
 
-        Recursively([gen_backprop](Graph* graph) { MergeOperations(graph, gen_backprop); }, graph);
+        Recursively(*backend_config, graph, [gen_backprop](const BackendConfig& bc, Graph* graph) {
+            // External backends do not know ops fused for ChxVM.
+            const bool use_external = g_use_tvm || g_use_ngraph || g_use_dldt;
+            MergeOperations(graph, gen_backprop, use_external ? nullptr : &bc);
+        });
 
         Recursively(PropagateConstants, graph);
 
         Recursively(EvaluateShapes, graph);
 
+        if (!g_skip_cse) Recursively(EliminateCommonSubexpressions, graph);
+
         Recursively([](Graph* g) { g->DeleteDetached(); }, graph);
 
         dump_onnx(g_dump_after_simplification, "after simplification");
@@ -144,8 +155,9 @@ void RunDefaultPasses(Graph* graph, bool gen_backprop, bool skip_scheduling) {
         }
     }
 
-    // TODO(hamaji): Make it possible to infer shapes here.
-    // if (!g_skip_inference) graph->InferShapes();
+    // Types of gradient values are inferred in place, which keeps
+    // `Value` pointers unlike the ONNX's inference.
+    if (!g_skip_inference) InferAllShapes(graph);
 
     if (!skip_scheduling) {
         Recursively(*backend_config, graph, [gen_backprop](const BackendConfig& bc, Graph* graph) {
@@ -154,6 +166,9 @@ void RunDefaultPasses(Graph* graph, bool gen_backprop, bool skip_scheduling) {
 
         Recursively(PropagateConstants, graph);
 
+        // Gradients of shared subexpressions are often duplicated.
+        if (!g_skip_cse) Recursively(EliminateCommonSubexpressions, graph);
+
         Recursively([](Graph* g) { g->DeleteDetached(); }, graph);
     }
 
@@ -164,6 +179,12 @@ void RunDefaultPasses(Graph* graph, bool gen_backprop, bool skip_scheduling) {
     }
 
     if (!skip_scheduling) {
+        // Layouts of images are changed only for inference on CPU.
+        const bool use_external = g_use_tvm || g_use_ngraph || g_use_dldt;
+        if (!gen_backprop && !g_use_cuda && !use_external && backend_config->HasOp("ChainerLayoutConv")) {
+            Recursively(ConvertLayout, graph);
+        }
+
         FuseOperations(graph);
         dump_onnx(g_dump_after_fusion, "after fusion");
     }
@@ -176,14 +197,28 @@ void RunDefaultPasses(Graph* graph, bool gen_backprop, bool skip_scheduling) {
         Recursively(PropagateConstants, graph);
 
         Recursively([](Graph* g) { g->DeleteDetached(); }, graph);
+
+        // Packed weights are opaque, so constants are not propagated
+        // after this.
+        const bool use_external = g_use_tvm || g_use_ngraph || g_use_dldt;
+        if (!gen_backprop && g_prepack_weights && !g_use_cuda && !use_external && backend_config->HasOp("ChainerPackedConv")) {
+            Recursively(PrepackWeights, graph);
+            Recursively([](Graph* g) { g->DeleteDetached(); }, graph);
+        }
     }
 
     int64_t order = 0;
-    Recursively([&order](Graph* g) { order = ScheduleComputation(*g, order); }, graph);
+    const SchedulerType scheduler_type = ParseSchedulerType(g_scheduler);
+    Recursively([&order, scheduler_type](Graph* g) { order = ScheduleComputation(*g, order, scheduler_type); }, graph);
+
+    if (!skip_scheduling && g_num_streams > 1) {
+        AssignStreams(graph, g_num_streams, g_stream_peak_increase_percent);
+    }
 
     if (g_compiler_log) {
         ShowSimulatedMemoryUsage(*graph);
         ShowFlops(*graph);
+        if (g_num_streams > 1) ShowStreamStats(*graph, g_num_streams);
     }
 
     Recursively(CollectGarbageNode, graph);
@@ -0,0 +1,249 @@
+#include "compiler/pattern_rewriter.h"
+
+#include <deque>
+#include <set>
+
+#include <common/log.h>
+#include <compiler/flags.h>
+#include <compiler/graph.h>
+#include <compiler/log.h>
+#include <compiler/node.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+Pattern::Pattern(Kind kind, Node::OpType op_type, std::vector<Pattern> inputs, const char* name)
+    : kind_(kind), op_type_(op_type), inputs_(std::move(inputs)), name_(name ? name : "") {
+}
+
+Pattern Pattern::Any(const char* name) {
+    return Pattern(kAny, Node::kIdentity, {}, name);
+}
+
+Pattern Pattern::Const(const char* name) {
+    return Pattern(kConst, Node::kIdentity, {}, name);
+}
+
+Pattern Pattern::Op(Node::OpType op_type, std::vector<Pattern> inputs, const char* name) {
+    return Pattern(kOp, op_type, std::move(inputs), name);
+}
+
+Pattern& Pattern::If(NodePredicate pred) {
+    CHECK(is_op());
+    node_preds_.push_back(std::move(pred));
+    return *this;
+}
+
+Pattern& Pattern::IfValue(ValuePredicate pred) {
+    value_preds_.push_back(std::move(pred));
+    return *this;
+}
+
+Pattern& Pattern::Commutative() {
+    CHECK(is_op());
+    CHECK_LE(2, inputs_.size());
+    commutative_ = true;
+    return *this;
+}
+
+Pattern& Pattern::OneUse() {
+    one_use_ = true;
+    return *this;
+}
+
+bool PatternMatch::MatchRoot(const Pattern& pattern, Node* root) {
+    CHECK(pattern.is_op());
+    root_ = root;
+    if (!root->outputs().empty()) {
+        for (const Pattern::ValuePredicate& pred : pattern.value_preds_) {
+            if (!pred(*root->output(0))) return false;
+        }
+        if (!Bind(pattern, nullptr, root->output(0))) return false;
+    }
+    return MatchNode(pattern, root);
+}
+
+Node* PatternMatch::node(const std::string& name) const {
+    auto found = named_nodes_.find(name);
+    CHECK(found != named_nodes_.end()) << "No node is bound to " << name;
+    return found->second;
+}
+
+Value* PatternMatch::value(const std::string& name) const {
+    auto found = named_values_.find(name);
+    CHECK(found != named_values_.end()) << "No value is bound to " << name;
+    return found->second;
+}
+
+bool PatternMatch::MatchValue(const Pattern& pattern, Value* value) {
+    if (pattern.one_use_ && (value->users().size() != 1 || value->IsOutput())) {
+        return false;
+    }
+    for (const Pattern::ValuePredicate& pred : pattern.value_preds_) {
+        if (!pred(*value)) return false;
+    }
+
+    switch (pattern.kind_) {
+        case Pattern::kAny:
+            return Bind(pattern, nullptr, value);
+
+        case Pattern::kConst:
+            if (!value->GetConstTensor()) return false;
+            return Bind(pattern, nullptr, value);
+
+        case Pattern::kOp: {
+            Node* producer = value->producer();
+            if (!producer || producer->detached()) return false;
+            return Bind(pattern, nullptr, value) && MatchNode(pattern, producer);
+        }
+    }
+    CHECK(false) << "Unknown pattern kind: " << pattern.kind_;
+    return false;
+}
+
+bool PatternMatch::MatchNode(const Pattern& pattern, Node* node) {
+    if (node->op_type() != pattern.op_type_) return false;
+    if (node->inputs().size() < pattern.inputs_.size()) return false;
+    for (const Pattern::NodePredicate& pred : pattern.node_preds_) {
+        if (!pred(*node)) return false;
+    }
+    if (!Bind(pattern, node, nullptr)) return false;
+    nodes_.push_back(node);
+
+    auto match_inputs = [this, &pattern, node](bool reversed) {
+        for (size_t i = 0; i < pattern.inputs_.size(); ++i) {
+            size_t j = reversed && i < 2 ? 1 - i : i;
+            if (!MatchValue(pattern.inputs_[i], node->input(j))) return false;
+        }
+        return true;
+    };
+
+    if (!pattern.commutative_) {
+        return match_inputs(false);
+    }
+
+    // Bindings by the failed attempt must be discarded.
+    PatternMatch saved(*this);
+    if (match_inputs(false)) return true;
+    *this = saved;
+    return match_inputs(true);
+}
+
+bool PatternMatch::Bind(const Pattern& pattern, Node* node, Value* value) {
+    if (pattern.name_.empty()) return true;
+    if (node) {
+        auto p = named_nodes_.emplace(pattern.name_, node);
+        if (!p.second && p.first->second != node) return false;
+    }
+    if (value) {
+        auto p = named_values_.emplace(pattern.name_, value);
+        if (!p.second && p.first->second != value) return false;
+    }
+    return true;
+}
+
+void PatternRewriter::AddRule(const std::string& name, Pattern pattern, RewriteFn fn) {
+    CHECK(pattern.is_op()) << "The root of a rule must be an op: " << name;
+    Node::OpType op_type = pattern.op_type();
+    rules_[op_type].push_back(Rule{name, std::move(pattern), std::move(fn)});
+}
+
+namespace {
+
+bool IsDead(const Node& node) {
+    for (Value* output : node.outputs()) {
+        if (!output->users().empty() || output->IsOutput()) return false;
+    }
+    return true;
+}
+
+// Adds `node` and nodes which are directly connected to it.
+void AddNeighbors(Node* node, std::vector<Node*>* neighbors) {
+    neighbors->push_back(node);
+    for (Value* input : node->inputs()) {
+        if (input->producer()) neighbors->push_back(input->producer());
+    }
+    for (Value* output : node->outputs()) {
+        for (Node* user : output->users()) neighbors->push_back(user);
+    }
+}
+
+}  // namespace
+
+bool PatternRewriter::TryRewrite(Graph* graph, Node* node, std::vector<Node*>* touched, int64_t* num_attempts) const {
+    auto found = rules_.find(node->op_type());
+    if (found == rules_.end()) return false;
+
+    for (const Rule& rule : found->second) {
+        ++*num_attempts;
+        PatternMatch match;
+        if (!match.MatchRoot(rule.pattern, node)) continue;
+
+        // Connections of matched nodes are cleared by detaching them.
+        std::vector<Node*> neighbors;
+        for (Node* n : match.nodes()) {
+            AddNeighbors(n, &neighbors);
+        }
+
+        const size_t num_nodes = graph->nodes().size();
+        if (!rule.fn(graph, match)) continue;
+        CLOG() << rule.name << ": " << node->ToString() << std::endl;
+
+        // `nodes()` is in the pre-order so users are detached first.
+        graph->DetachNode(node);
+        for (Node* n : match.nodes()) {
+            if (!n->detached() && IsDead(*n)) graph->DetachNode(n);
+        }
+
+        for (size_t i = num_nodes; i < graph->nodes().size(); ++i) {
+            AddNeighbors(graph->nodes()[i], &neighbors);
+        }
+        touched->swap(neighbors);
+        return true;
+    }
+    return false;
+}
+
+int PatternRewriter::Run(Graph* graph) const {
+    int num_rewrites = 0;
+    int64_t num_attempts = 0;
+    std::vector<Node*> touched;
+
+    if (g_pattern_rewrite_full_scan) {
+        bool replaced = true;
+        while (replaced) {
+            replaced = false;
+            for (Node* node : graph->GetLiveNodes()) {
+                if (node->detached()) continue;
+                if (TryRewrite(graph, node, &touched, &num_attempts)) {
+                    ++num_rewrites;
+                    replaced = true;
+                }
+            }
+        }
+    } else {
+        std::deque<Node*> q;
+        std::set<Node*> queued;
+        auto push = [&q, &queued](Node* node) {
+            if (!node->detached() && queued.insert(node).second) q.push_back(node);
+        };
+
+        for (Node* node : graph->GetLiveNodes()) push(node);
+        while (!q.empty()) {
+            Node* node = q.front();
+            q.pop_front();
+            queued.erase(node);
+            if (node->detached()) continue;
+            if (TryRewrite(graph, node, &touched, &num_attempts)) {
+                ++num_rewrites;
+                for (Node* n : touched) push(n);
+            }
+        }
+    }
+
+    CLOG() << "PatternRewriter: " << num_rewrites << " rewrites with " << num_attempts << " match attempts in " << graph->name()
+           << std::endl;
+    return num_rewrites;
+}
+
+}  // namespace chainer_compiler
@@ -0,0 +1,135 @@
+// A small engine for local graph rewrites such as merges and
+// simplifications.
+//
+// A rule consists of a `Pattern` rooted at a node and a function
+// which rewrites a match. For example, Pad followed by Conv can be
+// matched by
+//
+//   Pattern::Op(Node::kConv, {Pattern::Op(Node::kPad, {}, "pad").OneUse()})
+//
+// `PatternRewriter` visits nodes with a worklist. After a rewrite,
+// only nodes around the rewritten nodes are revisited, so the cost
+// of a rewrite does not depend on the size of the graph.
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <compiler/node.h>
+
+namespace chainer_compiler {
+
+class Graph;
+class Value;
+
+// Matches a value in a graph.
+class Pattern {
+public:
+    typedef std::function<bool(const Node&)> NodePredicate;
+    typedef std::function<bool(const Value&)> ValuePredicate;
+
+    // Matches any value.
+    static Pattern Any(const char* name = nullptr);
+    // Matches a value whose content is known at compile time.
+    static Pattern Const(const char* name = nullptr);
+    // Matches a value computed by a node of `op_type`. `inputs`
+    // matches the first inputs of the node. Remaining inputs can be
+    // anything.
+    static Pattern Op(Node::OpType op_type, std::vector<Pattern> inputs = {}, const char* name = nullptr);
+
+    // Adds a predicate for the node, e.g., a check for attributes.
+    Pattern& If(NodePredicate pred);
+    // Adds a predicate for the value, e.g., a check for its shape.
+    Pattern& IfValue(ValuePredicate pred);
+    // The first two inputs are also tried in the reversed order.
+    Pattern& Commutative();
+    // The value must be used only by the node of the parent pattern
+    // and must not be a graph output.
+    Pattern& OneUse();
+
+    bool is_op() const {
+        return kind_ == kOp;
+    }
+    Node::OpType op_type() const {
+        return op_type_;
+    }
+
+private:
+    friend class PatternMatch;
+
+    enum Kind { kAny, kConst, kOp };
+
+    Pattern(Kind kind, Node::OpType op_type, std::vector<Pattern> inputs, const char* name);
+
+    Kind kind_;
+    Node::OpType op_type_;
+    std::vector<Pattern> inputs_;
+    std::string name_;
+    std::vector<NodePredicate> node_preds_;
+    std::vector<ValuePredicate> value_preds_;
+    bool commutative_{false};
+    bool one_use_{false};
+};
+
+// The result of a match. Names given to patterns are bound to nodes
+// and values.
+class PatternMatch {
+public:
+    // Matches `pattern` with the outputs of `root`.
+    bool MatchRoot(const Pattern& pattern, Node* root);
+
+    Node* root() const {
+        return root_;
+    }
+    Node* node(const std::string& name) const;
+    Value* value(const std::string& name) const;
+
+    // All nodes matched by `Pattern::Op`, including the root.
+    const std::vector<Node*>& nodes() const {
+        return nodes_;
+    }
+
+private:
+    bool MatchValue(const Pattern& pattern, Value* value);
+    bool MatchNode(const Pattern& pattern, Node* node);
+    bool Bind(const Pattern& pattern, Node* node, Value* value);
+
+    Node* root_{nullptr};
+    std::map<std::string, Node*> named_nodes_;
+    std::map<std::string, Value*> named_values_;
+    std::vector<Node*> nodes_;
+};
+
+// Rewrites a matched subgraph. This should compute outputs of the
+// root (e.g., by `GraphBuilder` with the outputs of the root) and
+// return true, or return false without modifying the graph. After a
+// rewrite, the root and matched nodes whose outputs are no longer
+// used are detached.
+typedef std::function<bool(Graph*, const PatternMatch&)> RewriteFn;
+
+class PatternRewriter {
+public:
+    void AddRule(const std::string& name, Pattern pattern, RewriteFn fn);
+
+    // Applies rules until no rule matches. Returns the number of
+    // applied rewrites.
+    int Run(Graph* graph) const;
+
+private:
+    struct Rule {
+        std::string name;
+        Pattern pattern;
+        RewriteFn fn;
+    };
+
+    // Tries rules for `node`. Returns true and fills nodes which
+    // should be revisited to `touched` if a rule is applied.
+    bool TryRewrite(Graph* graph, Node* node, std::vector<Node*>* touched, int64_t* num_attempts) const;
+
+    std::map<Node::OpType, std::vector<Rule>> rules_;
+};
+
+}  // namespace chainer_compiler
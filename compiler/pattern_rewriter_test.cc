@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <compiler/flags.h>
+#include <compiler/graph.h>
+#include <compiler/graph_builder.h>
+#include <compiler/node.h>
+#include <compiler/pattern_rewriter.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+TEST(PatternRewriterTest, Commutative) {
+    Type type(Dtype::kFloat32, {2, 3});
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", type);
+    Value* y = graph.AddInputValue("y", type);
+    Value* output = graph.AddOutputValue("output", type);
+    Node* add;
+    {
+        GraphBuilder gb(&graph, "test", output);
+        Value* t = gb.Op(Node::kMul, {x, y});
+        add = gb.Op(Node::kAdd, {y, t}, output)->producer();
+    }
+
+    Pattern pattern = Pattern::Op(Node::kAdd, {Pattern::Op(Node::kMul, {}, "mul").OneUse(), Pattern::Any("c")});
+    PatternMatch match;
+    EXPECT_FALSE(match.MatchRoot(pattern, add));
+
+    pattern.Commutative();
+    match = PatternMatch();
+    ASSERT_TRUE(match.MatchRoot(pattern, add));
+    EXPECT_EQ(add, match.root());
+    EXPECT_EQ(add->input(1)->producer(), match.node("mul"));
+    EXPECT_EQ(y, match.value("c"));
+    EXPECT_EQ(2, match.nodes().size());
+}
+
+TEST(PatternRewriterTest, SameName) {
+    Type type(Dtype::kFloat32, {2, 3});
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", type);
+    Value* y = graph.AddInputValue("y", type);
+    Value* output0 = graph.AddOutputValue("output0", type);
+    Value* output1 = graph.AddOutputValue("output1", type);
+    Node* square;
+    Node* mul;
+    {
+        GraphBuilder gb(&graph, "test", output0);
+        square = gb.Op(Node::kMul, {x, x}, output0)->producer();
+        mul = gb.Op(Node::kMul, {x, y}, output1)->producer();
+    }
+
+    Pattern pattern = Pattern::Op(Node::kMul, {Pattern::Any("x"), Pattern::Any("x")});
+    PatternMatch match;
+    EXPECT_TRUE(match.MatchRoot(pattern, square));
+    match = PatternMatch();
+    EXPECT_FALSE(match.MatchRoot(pattern, mul));
+}
+
+// Neg(Neg(x)) => Identity(x).
+int RemoveDoubleNeg(Graph* graph) {
+    PatternRewriter rewriter;
+    rewriter.AddRule(
+            "RemoveDoubleNeg",
+            Pattern::Op(Node::kNeg, {Pattern::Op(Node::kNeg, {Pattern::Any("x")}).OneUse()}),
+            [](Graph* graph, const PatternMatch& m) {
+                GraphBuilder gb(graph, "RemoveDoubleNeg", m.root()->output(0));
+                gb.Op(Node::kIdentity, {m.value("x")}, m.root()->output(0));
+                return true;
+            });
+    return rewriter.Run(graph);
+}
+
+void TestNegChain(bool full_scan) {
+    g_pattern_rewrite_full_scan = full_scan;
+    Type type(Dtype::kFloat32, {2, 3});
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", type);
+    Value* output = graph.AddOutputValue("output", type);
+    Value* other = graph.AddOutputValue("other", type);
+    {
+        GraphBuilder gb(&graph, "test", output);
+        Value* t = x;
+        for (int i = 0; i < 3; ++i) {
+            t = gb.Op(Node::kNeg, {t});
+        }
+        // The third Neg is also used by `other` so it must be kept.
+        gb.Op(Node::kIdentity, {t}, other);
+        t = gb.Op(Node::kNeg, {t});
+        gb.Op(Node::kNeg, {t}, output);
+    }
+
+    EXPECT_EQ(2, RemoveDoubleNeg(&graph));
+    graph.DeleteDetached();
+
+    // Neg(Neg(x)) => Identity(x), Neg(Identity(x)) is kept, and
+    // Neg(Neg(t)) => Identity(t).
+    Node* node = output->producer();
+    ASSERT_EQ(Node::kIdentity, node->op_type());
+    node = node->input(0)->producer();
+    ASSERT_EQ(Node::kNeg, node->op_type());
+    node = node->input(0)->producer();
+    ASSERT_EQ(Node::kIdentity, node->op_type());
+    EXPECT_EQ(x, node->input(0));
+    EXPECT_EQ(4, graph.nodes().size());
+    graph.CheckSanity("rewritten");
+    g_pattern_rewrite_full_scan = false;
+}
+
+TEST(PatternRewriterTest, Worklist) {
+    TestNegChain(false);
+}
+
+TEST(PatternRewriterTest, FullScan) {
+    TestNegChain(true);
+}
+
+}  // namespace
+}  // namespace chainer_compiler
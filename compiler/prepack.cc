@@ -0,0 +1,190 @@
+#include "compiler/prepack.h"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <common/log.h>
+#include <common/strutil.h>
+#include <compiler/graph.h>
+#include <compiler/graph_builder.h>
+#include <compiler/log.h>
+#include <compiler/node.h>
+#include <compiler/tensor.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+bool IsFloat(Dtype dtype) {
+    return dtype == Dtype::kFloat32 || dtype == Dtype::kFloat64;
+}
+
+bool IsFloatTensor(const Value* value) {
+    const Type& type = value->type();
+    return type.kind() == Type::Kind::kTensor && IsFloat(type.dtype()) && type.HasKnownRank();
+}
+
+bool IsConstTensor(const Value* value, size_t ndim, Dtype dtype) {
+    const Tensor* tensor = value->GetConstTensor();
+    return tensor && tensor->dtype() == dtype && tensor->dims().size() == ndim;
+}
+
+bool HasInput(const Node& node, size_t index) {
+    return node.inputs().size() > index && !node.input(index)->IsNull();
+}
+
+std::string JoinInts(const std::vector<int64_t>& ints) {
+    return JoinString(MapToString(ints, [](int64_t i) { return std::to_string(i); }), ",");
+}
+
+bool IsPackableConv(const Node& node) {
+    const Value* x = node.input(0);
+    if (!IsFloatTensor(x) || x->type().ndim() != 4 || !IsConstTensor(node.input(1), 4, x->type().dtype())) return false;
+    if (node.auto_pad() != "NOTSET") return false;
+    for (int64_t d : node.dilations()) {
+        if (d != 1) return false;
+    }
+    const std::vector<int64_t>& pads = node.pads();
+    if (pads.size() % 2) return false;
+    for (size_t i = 0; i < pads.size() / 2; ++i) {
+        if (pads[i] != pads[i + pads.size() / 2]) return false;
+    }
+    return true;
+}
+
+// Returns the number of batch axes of X of X * B, or 0 if B is not a
+// packable matrix.
+int64_t GetNumBatchAxes(const Node& node) {
+    const Value* x = node.input(0);
+    if (!IsFloatTensor(x) || !IsConstTensor(node.input(1), 2, x->type().dtype())) return 0;
+    const int64_t ndim = x->type().ndim();
+    switch (node.op_type()) {
+        case Node::kGemm: {
+            if (ndim != 2 || node.alpha() != 1.0 || node.trans_a()) return 0;
+            if (HasInput(node, 2) && node.beta() != 0.0) {
+                const int64_t units = node.input(1)->GetConstTensor()->dims()[node.trans_b() ? 0 : 1];
+                const Type& c = node.input(2)->type();
+                if (node.beta() != 1.0 || !c.HasKnownShape() || c.dims() != std::vector<int64_t>{units} || c.dtype() != x->type().dtype()) {
+                    return 0;
+                }
+            }
+            return 1;
+        }
+
+        case Node::kMatMul:
+            return ndim >= 2 ? ndim - 1 : 0;
+
+        case Node::kChainerLinear:
+            return ndim > node.n_batch_axes() ? node.n_batch_axes() : 0;
+
+        case Node::kChainerFusedLinear:
+            return ndim == 2 ? 1 : 0;
+
+        default:
+            return 0;
+    }
+}
+
+class Prepacker {
+public:
+    explicit Prepacker(Graph* graph) : graph_(graph) {
+    }
+
+    void Run() {
+        for (Node* node : graph_->GetTopologicallySortedNodes()) {
+            switch (node->op_type()) {
+                case Node::kConv:
+                case Node::kChainerFusedConv:
+                    if (IsPackableConv(*node)) RewriteConv(node);
+                    break;
+
+                case Node::kGemm:
+                case Node::kMatMul:
+                case Node::kChainerLinear:
+                case Node::kChainerFusedLinear:
+                    if (int64_t n_batch_axes = GetNumBatchAxes(*node)) RewriteMatMul(node, n_batch_axes);
+                    break;
+
+                default:
+                    break;
+            }
+        }
+        if (num_packed_ops_) {
+            CLOG() << "Prepacked " << packed_.size() << " weights of " << num_packed_ops_ << " ops" << std::endl;
+        }
+    }
+
+private:
+    // Returns the packed weight of `w`, which is shared by ops with the
+    // same `key`.
+    Value* GetPacked(Node::OpType op_type, Value* w, const std::string& key, const std::function<void(Node*)>& set_attributes) {
+        auto found = packed_.find(std::make_pair(w, key));
+        if (found != packed_.end()) return found->second;
+        GraphBuilder gb(graph_, "Prepack", w);
+        Value* packed = gb.Temp(Type(Type::Kind::kOpaque));
+        set_attributes(gb.MOp(op_type, {w}, {packed}));
+        packed_.emplace(std::make_pair(w, key), packed);
+        return packed;
+    }
+
+    void RewriteConv(Node* node) {
+        const Type& x = node->input(0)->type();
+        std::vector<int64_t> input_shape;
+        if (x.HasKnownShape()) input_shape = x.dims();
+        const std::string key =
+                StrCat("conv ", node->group(), " ", JoinInts(input_shape), " ", JoinInts(node->strides()), " ", JoinInts(node->pads()));
+        Value* packed = GetPacked(Node::kChainerPackConvWeight, node->input(1), key, [node, &input_shape](Node* pack) {
+            pack->set_input_shape(input_shape)->set_group(node->group())->set_strides(node->strides())->set_pads(node->pads());
+        });
+
+        std::vector<Value*> inputs = node->inputs();
+        inputs[1] = packed;
+        const std::vector<int64_t>& w = node->input(1)->GetConstTensor()->dims();
+        GraphBuilder gb(graph_, "Prepack", node->output(0));
+        Node* conv = gb.MOp(Node::kChainerPackedConv, inputs, node->outputs());
+        conv->set_kernel_shape({w[2], w[3]})->set_group(node->group())->set_pads(node->pads())->set_strides(node->strides());
+        if (node->op_type() == Node::kChainerFusedConv) {
+            conv->set_activation(node->activation())->set_alpha(node->alpha())->set_min(node->min())->set_max(node->max());
+        }
+        graph_->DetachNode(node);
+        ++num_packed_ops_;
+    }
+
+    void RewriteMatMul(Node* node, int64_t n_batch_axes) {
+        // ChainerLinear computes X * W^T.
+        const bool trans =
+                node->op_type() == Node::kChainerLinear || node->op_type() == Node::kChainerFusedLinear ||
+                (node->op_type() == Node::kGemm && node->trans_b());
+        Value* packed = GetPacked(Node::kChainerPackMatrixWeight, node->input(1), trans ? "matrix T" : "matrix", [trans](Node* pack) {
+            pack->set_trans_b(trans);
+        });
+
+        std::vector<Value*> inputs = {node->input(0), packed};
+        const bool has_bias = node->op_type() == Node::kGemm ? HasInput(*node, 2) && node->beta() != 0.0 : HasInput(*node, 2);
+        if (has_bias) inputs.push_back(node->input(2));
+        GraphBuilder gb(graph_, "Prepack", node->output(0));
+        Node* linear = gb.MOp(Node::kChainerPackedLinear, inputs, node->outputs());
+        linear->set_n_batch_axes(n_batch_axes);
+        if (node->op_type() == Node::kChainerFusedLinear) linear->set_activation(node->activation());
+        graph_->DetachNode(node);
+        ++num_packed_ops_;
+    }
+
+    Graph* graph_;
+    std::map<std::pair<Value*, std::string>, Value*> packed_;
+    int num_packed_ops_{0};
+};
+
+}  // namespace
+
+void PrepackWeights(Graph* graph) {
+    Prepacker prepacker(graph);
+    prepacker.Run();
+}
+
+}  // namespace chainer_compiler
@@ -0,0 +1,14 @@
+#pragma once
+
+namespace chainer_compiler {
+
+class Graph;
+
+// Rewrites Conv, ChainerFusedConv, Gemm, MatMul, ChainerLinear, and
+// ChainerFusedLinear with constant float weights into ChainerPacked*
+// ops which take weights packed by ChainerPack*Weight. Weights are
+// packed once at the first run for the CPU convolution engine and
+// shared by all ops which use the same weight. For inference on CPU.
+void PrepackWeights(Graph* graph);
+
+}  // namespace chainer_compiler
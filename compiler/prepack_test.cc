@@ -0,0 +1,105 @@
+#include <map>
+
+#include <gtest/gtest.h>
+
+#include <chainerx/testing/context_session.h>
+
+#include <compiler/graph.h>
+#include <compiler/graph_builder.h>
+#include <compiler/node.h>
+#include <compiler/prepack.h>
+#include <compiler/tensor.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+std::map<Node::OpType, std::vector<const Node*>> GetNodesByType(const Graph& graph) {
+    std::map<Node::OpType, std::vector<const Node*>> nodes;
+    for (const Node* node : graph.GetLiveNodes()) nodes[node->op_type()].push_back(node);
+    return nodes;
+}
+
+TEST(PrepackTest, Conv) {
+    chainerx::testing::ContextSession sess;
+    Type type(Dtype::kFloat32, {2, 3, 8, 8});
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", type);
+    Value* output = graph.AddOutputValue("output", Type(Dtype::kFloat32, {2, 4, 8, 8}));
+    {
+        GraphBuilder gb(&graph, "test", output);
+        Value* w = gb.Const(Type(Dtype::kFloat32, {4, 3, 3, 3}), std::vector<float>(4 * 3 * 3 * 3, 0.1f));
+        Value* b = gb.Const(Type(Dtype::kFloat32, {4}), std::vector<float>(4, 0.5f));
+        Value* h1 = gb.Op(Node::kConv, {x, w, b});
+        h1->producer()->set_pads({1, 1, 1, 1});
+        Value* h2 = gb.Op(Node::kConv, {x, w});
+        h2->producer()->set_pads({1, 1, 1, 1});
+        // Dilated convolutions are not supported by the engine.
+        Value* h3 = gb.Op(Node::kConv, {x, w});
+        h3->producer()->set_pads({2, 2, 2, 2})->set_dilations({2, 2});
+        gb.Op(Node::kSum, {h1, h2, h3}, output);
+    }
+    PrepackWeights(&graph);
+    graph.DeleteDetached();
+    graph.CheckSanity("prepacked");
+
+    auto nodes = GetNodesByType(graph);
+    // The weight is packed once for the two Conv with the same shape.
+    ASSERT_EQ(1, nodes[Node::kChainerPackConvWeight].size());
+    ASSERT_EQ(2, nodes[Node::kChainerPackedConv].size());
+    EXPECT_EQ(1, nodes[Node::kConv].size());
+
+    const Node* pack = nodes[Node::kChainerPackConvWeight][0];
+    EXPECT_EQ(type.dims(), pack->input_shape());
+    EXPECT_EQ(Type::Kind::kOpaque, pack->output(0)->type().kind());
+    for (const Node* conv : nodes[Node::kChainerPackedConv]) {
+        EXPECT_EQ(pack->output(0), conv->input(1));
+        EXPECT_EQ(std::vector<int64_t>({3, 3}), conv->kernel_shape());
+        EXPECT_EQ(std::vector<int64_t>({2, 4, 8, 8}), conv->output(0)->type().dims());
+    }
+}
+
+TEST(PrepackTest, MatMul) {
+    chainerx::testing::ContextSession sess;
+    Graph graph("test");
+    Value* a = graph.AddInputValue("a", Type(Dtype::kFloat32, {2, 5}));
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32, {2, 4, 5}));
+    Value* v = graph.AddInputValue("v", Type(Dtype::kFloat32, {5, 3}));
+    Value* y1 = graph.AddOutputValue("y1", Type(Dtype::kFloat32, {2, 3}));
+    Value* y2 = graph.AddOutputValue("y2", Type(Dtype::kFloat32, {2, 4, 3}));
+    Value* y3 = graph.AddOutputValue("y3", Type(Dtype::kFloat32, {2, 3}));
+    {
+        GraphBuilder gb(&graph, "test", y1);
+        Value* wt = gb.Const(Type(Dtype::kFloat32, {3, 5}), std::vector<float>(15, 0.1f));
+        Value* c = gb.Const(Type(Dtype::kFloat32, {3}), std::vector<float>(3, 0.5f));
+        Value* w = gb.Const(Type(Dtype::kFloat32, {5, 3}), std::vector<float>(15, 0.2f));
+        gb.Op(Node::kGemm, {a, wt, c}, y1)->producer()->set_trans_b(true);
+        gb.Op(Node::kMatMul, {x, w}, y2);
+        // The matrix which is not a constant is not packed.
+        gb.Op(Node::kMatMul, {a, v}, y3);
+    }
+    PrepackWeights(&graph);
+    graph.DeleteDetached();
+    graph.CheckSanity("prepacked");
+
+    auto nodes = GetNodesByType(graph);
+    ASSERT_EQ(2, nodes[Node::kChainerPackMatrixWeight].size());
+    ASSERT_EQ(2, nodes[Node::kChainerPackedLinear].size());
+    EXPECT_EQ(0, nodes[Node::kGemm].size());
+    EXPECT_EQ(1, nodes[Node::kMatMul].size());
+
+    const Node* gemm = y1->producer();
+    ASSERT_EQ(Node::kChainerPackedLinear, gemm->op_type());
+    EXPECT_EQ(3, gemm->inputs().size());
+    EXPECT_EQ(1, gemm->n_batch_axes());
+    EXPECT_TRUE(gemm->input(1)->producer()->trans_b());
+
+    const Node* matmul = y2->producer();
+    ASSERT_EQ(Node::kChainerPackedLinear, matmul->op_type());
+    EXPECT_EQ(2, matmul->inputs().size());
+    EXPECT_EQ(2, matmul->n_batch_axes());
+    EXPECT_FALSE(matmul->input(1)->producer()->trans_b());
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -1,12 +1,19 @@
 #include "compiler/scheduler.h"
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <iterator>
 #include <map>
 #include <queue>
+#include <random>
+#include <set>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <common/log.h>
+#include <compiler/flags.h>
 #include <compiler/graph.h>
 #include <compiler/log.h>
 #include <compiler/node.h>
@@ -199,6 +206,298 @@ std::vector<Node*> ScheduleGreedy(const Graph& graph, const std::vector<Value*>&
     return nodes;
 }
 
+// Searches the order of `nodes` which minimizes the peak memory usage
+// estimated like SimulateMemoryUsage, i.e., inputs are allocated
+// first, outputs are allocated when their producers run, and values
+// except for initializers are freed when all their users have run.
+//
+// Partial orders are extended node by node, and only the one with the
+// lowest peak is kept among partial orders which have run the same set
+// of nodes, since the rest of the schedule depends only on the set.
+// This is an exact dynamic programming while the number of such sets
+// is small, and it is narrowed to a beam search of the partial orders
+// with the lowest peaks once they are too many or the time budget is
+// exhausted. Partial orders whose peak is not lower than the given
+// upper bound are pruned.
+class ScheduleSearcher {
+public:
+    ScheduleSearcher(const std::vector<Node*>& nodes, const std::vector<Value*>& input_values) : nodes_(nodes) {
+        num_words_ = (nodes_.size() + 63) / 64;
+        std::map<const Node*, int> node_ids;
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            CHECK(node_ids.emplace(nodes_[i], i).second);
+        }
+        std::set<const Value*> inputs;
+        for (const Value* value : input_values) {
+            if (!inputs.emplace(value).second) continue;
+            initial_mem_ += std::max<int64_t>(value->GetNBytes(), 0);
+        }
+
+        std::map<const Value*, int> value_ids;
+        infos_.resize(nodes_.size());
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            NodeInfo& info = infos_[i];
+            for (const Value* output : nodes_[i]->outputs()) {
+                if (!output->IsNull()) info.output_bytes += std::max<int64_t>(output->GetNBytes(), 0);
+            }
+            for (const Value* input : nodes_[i]->inputs()) {
+                if (input->IsNull()) continue;
+                if (!inputs.count(input)) {
+                    auto found = input->producer() ? node_ids.find(input->producer()) : node_ids.end();
+                    if (found == node_ids.end()) {
+                        info.blocked = true;
+                        continue;
+                    }
+                    info.preds.push_back(found->second);
+                }
+
+                auto inserted = value_ids.emplace(input, values_.size());
+                if (inserted.second) values_.push_back(MakeValueInfo(*input, node_ids));
+                const int value_id = inserted.first->second;
+                if (values_[value_id].freeable) info.inputs.push_back(value_id);
+            }
+            SortUnique(&info.preds);
+            SortUnique(&info.inputs);
+            for (int pred : info.preds) infos_[pred].succs.push_back(i);
+        }
+
+        std::mt19937_64 rng(nodes_.size());
+        for (size_t i = 0; i < nodes_.size(); ++i) zobrist_.push_back(rng());
+    }
+
+    // Returns the peak of `order`, which must be a topologically sorted
+    // permutation of the nodes.
+    int64_t GetPeak(const std::vector<Node*>& order) const {
+        std::map<const Node*, int> node_ids;
+        for (size_t i = 0; i < nodes_.size(); ++i) node_ids.emplace(nodes_[i], i);
+        std::vector<uint64_t> done(num_words_);
+        int64_t mem = initial_mem_;
+        int64_t peak = mem;
+        for (const Node* node : order) {
+            auto found = node_ids.find(node);
+            CHECK(found != node_ids.end()) << node->ToString();
+            const int id = found->second;
+            peak = std::max(peak, mem + infos_[id].output_bytes);
+            mem += infos_[id].output_bytes - GetFreedBytes(done.data(), id);
+            done[id / 64] |= 1ULL << (id % 64);
+        }
+        return peak;
+    }
+
+    // Returns an order whose peak is lower than `upper_bound`, or an
+    // empty vector if none was found. `exact` will be true if the
+    // order is the best one.
+    std::vector<Node*> Search(int64_t upper_bound, std::chrono::milliseconds time_budget, bool* exact, int64_t* peak) const {
+        const auto deadline = std::chrono::steady_clock::now() + time_budget;
+        size_t width = kMaxExactStates;
+        *exact = true;
+
+        std::vector<State> states(1);
+        State& initial = states[0];
+        initial.done.resize(num_words_);
+        initial.mem = initial.peak = initial_mem_;
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            if (infos_[i].preds.empty() && !infos_[i].blocked) initial.ready.push_back(i);
+        }
+
+        // The parent state and the node run last of states in each step.
+        std::vector<std::vector<std::pair<int, int>>> trails;
+        for (size_t step = 0; step < nodes_.size(); ++step) {
+            std::vector<Candidate> candidates;
+            std::unordered_map<uint64_t, size_t> candidate_index;
+            for (size_t parent = 0; parent < states.size(); ++parent) {
+                const State& state = states[parent];
+                for (int id : state.ready) {
+                    Candidate candidate;
+                    candidate.peak = std::max(state.peak, state.mem + infos_[id].output_bytes);
+                    if (candidate.peak >= upper_bound) continue;
+                    candidate.mem = state.mem + infos_[id].output_bytes - GetFreedBytes(state.done.data(), id);
+                    candidate.hash = state.hash ^ zobrist_[id];
+                    candidate.parent = parent;
+                    candidate.node = id;
+                    auto inserted = candidate_index.emplace(candidate.hash, candidates.size());
+                    if (inserted.second) {
+                        candidates.push_back(candidate);
+                    } else if (candidate.peak < candidates[inserted.first->second].peak) {
+                        candidates[inserted.first->second] = candidate;
+                    }
+                }
+            }
+            if (candidates.empty()) return {};
+
+            if (std::chrono::steady_clock::now() > deadline) width = 1;
+            if (candidates.size() > width) {
+                if (*exact) {
+                    *exact = false;
+                    width = std::min(width, kBeamWidth);
+                }
+                std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+                    return std::make_pair(a.peak, a.mem) < std::make_pair(b.peak, b.mem);
+                });
+                candidates.resize(width);
+            }
+
+            std::vector<State> next(candidates.size());
+            trails.emplace_back();
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                const Candidate& candidate = candidates[i];
+                trails.back().emplace_back(candidate.parent, candidate.node);
+                Extend(states[candidate.parent], candidate, &next[i]);
+            }
+            states.swap(next);
+        }
+
+        CHECK_EQ(1, states.size());
+        *peak = states[0].peak;
+        std::vector<Node*> order(nodes_.size());
+        int index = 0;
+        for (size_t step = nodes_.size(); step > 0; --step) {
+            const std::pair<int, int>& trail = trails[step - 1][index];
+            order[step - 1] = nodes_[trail.second];
+            index = trail.first;
+        }
+        return order;
+    }
+
+private:
+    // The number of partial orders kept in each step.
+    static constexpr size_t kMaxExactStates = 10000;
+    static constexpr size_t kBeamWidth = 32;
+
+    struct NodeInfo {
+        std::vector<int> preds;
+        std::vector<int> succs;
+        // Inputs which may be freed after this node.
+        std::vector<int> inputs;
+        int64_t output_bytes{0};
+        // True if some input will never be ready.
+        bool blocked{false};
+    };
+
+    struct ValueInfo {
+        int64_t bytes;
+        bool freeable;
+        std::vector<int> users;
+    };
+
+    // A set of nodes which have run.
+    struct State {
+        std::vector<uint64_t> done;
+        std::vector<int> ready;
+        int64_t mem{0};
+        int64_t peak{0};
+        uint64_t hash{0};
+    };
+
+    struct Candidate {
+        int64_t peak;
+        int64_t mem;
+        uint64_t hash;
+        int parent;
+        int node;
+    };
+
+    static void SortUnique(std::vector<int>* ids) {
+        std::sort(ids->begin(), ids->end());
+        ids->erase(std::unique(ids->begin(), ids->end()), ids->end());
+    }
+
+    static ValueInfo MakeValueInfo(const Value& value, const std::map<const Node*, int>& node_ids) {
+        ValueInfo info{std::max<int64_t>(value.GetNBytes(), 0), !value.initializer(), {}};
+        for (const Node* user : value.users()) {
+            auto found = node_ids.find(user);
+            // Values used by nodes which are not scheduled are never freed.
+            if (found == node_ids.end()) {
+                info.freeable = false;
+                break;
+            }
+            info.users.push_back(found->second);
+        }
+        SortUnique(&info.users);
+        return info;
+    }
+
+    static bool Has(const uint64_t* done, int id) {
+        return done[id / 64] & (1ULL << (id % 64));
+    }
+
+    // Returns the size of inputs freed after running node `id` when
+    // nodes in `done` have run.
+    int64_t GetFreedBytes(const uint64_t* done, int id) const {
+        int64_t freed = 0;
+        for (int value_id : infos_[id].inputs) {
+            const ValueInfo& value = values_[value_id];
+            if (std::all_of(value.users.begin(), value.users.end(), [done, id](int user) { return user == id || Has(done, user); })) {
+                freed += value.bytes;
+            }
+        }
+        return freed;
+    }
+
+    void Extend(const State& state, const Candidate& candidate, State* next) const {
+        next->done = state.done;
+        next->done[candidate.node / 64] |= 1ULL << (candidate.node % 64);
+        next->mem = candidate.mem;
+        next->peak = candidate.peak;
+        next->hash = candidate.hash;
+        for (int id : state.ready) {
+            if (id != candidate.node) next->ready.push_back(id);
+        }
+        for (int succ : infos_[candidate.node].succs) {
+            const std::vector<int>& preds = infos_[succ].preds;
+            if (infos_[succ].blocked) continue;
+            if (std::all_of(preds.begin(), preds.end(), [next](int pred) { return Has(next->done.data(), pred); })) {
+                next->ready.push_back(succ);
+            }
+        }
+    }
+
+    std::vector<Node*> nodes_;
+    std::vector<NodeInfo> infos_;
+    std::vector<ValueInfo> values_;
+    std::vector<uint64_t> zobrist_;
+    size_t num_words_;
+    int64_t initial_mem_{0};
+};
+
+constexpr size_t ScheduleSearcher::kMaxExactStates;
+constexpr size_t ScheduleSearcher::kBeamWidth;
+
+// Searches the order with the lowest peak memory, or falls back to the
+// greedy scheduler if it does not find a better order. In the second
+// scheduling, outputs of nodes scheduled earlier are treated as inputs
+// which are alive from the beginning.
+std::vector<Node*> ScheduleSearch(const Graph& graph, const std::vector<Value*>& input_values, const std::vector<Value*>& output_values) {
+    std::vector<Node*> greedy = ScheduleGreedy(graph, input_values, output_values);
+    if (greedy.empty()) return greedy;
+
+    std::vector<Value*> available_values = input_values;
+    int num_scheduled = 0;
+    for (const auto& p : graph.GetNecessaryNodesAndInputCounts(output_values)) {
+        Node* node = p.first;
+        if (node->chainer_order() < 0) continue;
+        ++num_scheduled;
+        for (Value* value : node->outputs()) {
+            if (!value->IsNull()) available_values.push_back(value);
+        }
+    }
+
+    ScheduleSearcher searcher(greedy, available_values);
+    const int64_t greedy_peak = searcher.GetPeak(greedy);
+    const int time_budget_ms = g_scheduler_time_budget_ms ? g_scheduler_time_budget_ms : 1000;
+    bool exact;
+    int64_t peak;
+    std::vector<Node*> nodes = searcher.Search(greedy_peak, std::chrono::milliseconds(time_budget_ms), &exact, &peak);
+    if (g_compiler_log) {
+        const int64_t naive_peak = searcher.GetPeak(ScheduleNaively(graph, input_values, output_values));
+        const int64_t search_peak = nodes.empty() ? greedy_peak : peak;
+        CLOG() << "Scheduled " << greedy.size() << " nodes after " << num_scheduled << " scheduled nodes in " << graph.name() << " ("
+               << (exact ? "exact" : "beam") << "): naive_peak=" << naive_peak << " greedy_peak=" << greedy_peak
+               << " search_peak=" << search_peak << std::endl;
+    }
+    return nodes.empty() ? greedy : nodes;
+}
+
 void CheckSanity(
         const Graph& graph,
         const std::vector<Value*>& input_values,
@@ -236,6 +535,13 @@ void CheckSanity(
 
 }  // namespace
 
+SchedulerType ParseSchedulerType(const std::string& name) {
+    if (name.empty() || name == "greedy") return SchedulerType::kGreedy;
+    if (name == "naive") return SchedulerType::kNaive;
+    if (name == "search") return SchedulerType::kSearch;
+    CHECK(false) << "Unknown scheduler: " << name;
+}
+
 int64_t ScheduleComputation(
         const Graph& graph,
         const std::vector<Value*>& input_values,
@@ -250,6 +556,9 @@ int64_t ScheduleComputation(
         case SchedulerType::kGreedy:
             nodes = ScheduleGreedy(graph, input_values, output_values);
             break;
+        case SchedulerType::kSearch:
+            nodes = ScheduleSearch(graph, input_values, output_values);
+            break;
     }
 
     CheckSanity(graph, input_values, output_values, nodes);
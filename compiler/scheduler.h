@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 namespace chainer_compiler {
@@ -9,8 +10,14 @@ class Value;
 enum class SchedulerType {
     kNaive,
     kGreedy,
+    // Searches the order with the lowest peak memory estimated like
+    // SimulateMemoryUsage. Exact for small graphs.
+    kSearch,
 };
 
+// Parses "naive", "greedy", or "search". An empty string is "greedy".
+SchedulerType ParseSchedulerType(const std::string& name);
+
 int64_t ScheduleComputation(
         const Graph& graph,
         const std::vector<Value*>& input_values,
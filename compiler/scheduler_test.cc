@@ -4,8 +4,10 @@
 
 #include <common/log.h>
 #include <compiler/graph.h>
+#include <compiler/memory_simulator.h>
 #include <compiler/node.h>
 #include <compiler/scheduler.h>
+#include <compiler/type.h>
 
 namespace chainer_compiler {
 namespace {
@@ -94,7 +96,86 @@ TEST_P(SchedulerTest, MultipleTimes) {
     EXPECT_EQ(2, n3->chainer_order());
 }
 
-INSTANTIATE_TEST_CASE_P(ForEachScheduler, SchedulerTest, ::testing::Values(SchedulerType::kNaive, SchedulerType::kGreedy));
+INSTANTIATE_TEST_CASE_P(
+        ForEachScheduler, SchedulerTest, ::testing::Values(SchedulerType::kNaive, SchedulerType::kGreedy, SchedulerType::kSearch));
+
+// Runs two branches which allocate 4000 bytes and reduce them. The
+// greedy scheduler delays Relu and runs both large nodes first.
+int64_t GetPeakOfBranches(SchedulerType scheduler_type) {
+    Graph graph("test");
+    const Type small(Dtype::kFloat32, {1});
+    const Type large(Dtype::kFloat32, {1000});
+    Value* x = graph.AddInputValue("x", small);
+    Value* y = graph.AddInputValue("y", small);
+    Value* out = graph.AddOutputValue("out", small);
+    Value* p = graph.AddValue("p", large);
+    Value* q = graph.AddValue("q", large);
+    Value* r = graph.AddValue("r", small);
+    Value* s = graph.AddValue("s", small);
+    graph.AddNode(Node::kAdd, {x, y}, {p});
+    graph.AddNode(Node::kMul, {x, y}, {q});
+    graph.AddNode(Node::kRelu, {p}, {r});
+    graph.AddNode(Node::kIdentity, {q}, {s});
+    graph.AddNode(Node::kAdd, {r, s}, {out});
+
+    ScheduleComputation(graph, 0, scheduler_type);
+    EXPECT_EQ(5UL, graph.GetComputationSequence().size());
+    return SimulateMemoryUsage(graph).peak;
+}
+
+TEST(SchedulerSearchTest, LowerPeak) {
+    const int64_t greedy_peak = GetPeakOfBranches(SchedulerType::kGreedy);
+    const int64_t search_peak = GetPeakOfBranches(SchedulerType::kSearch);
+    EXPECT_EQ(8008, greedy_peak);
+    // x and y, either p or q, and a small value.
+    EXPECT_EQ(4012, search_peak);
+}
+
+// Runs the branches of GetPeakOfBranches in the second scheduling
+// after `f` is computed by the first one.
+int64_t GetPeakOfBranchesInSecondScheduling(SchedulerType scheduler_type) {
+    Graph graph("test");
+    const Type small(Dtype::kFloat32, {1});
+    const Type large(Dtype::kFloat32, {1000});
+    Value* x = graph.AddInputValue("x", small);
+    Value* y = graph.AddInputValue("y", small);
+    Value* out = graph.AddOutputValue("out", small);
+    Value* f = graph.AddValue("f", small);
+    Value* p = graph.AddValue("p", large);
+    Value* q = graph.AddValue("q", large);
+    Value* r = graph.AddValue("r", small);
+    Value* s = graph.AddValue("s", small);
+    Node* first = graph.AddNode(Node::kIdentity, {x}, {f});
+    graph.AddNode(Node::kAdd, {f, y}, {p});
+    graph.AddNode(Node::kMul, {f, y}, {q});
+    graph.AddNode(Node::kRelu, {p}, {r});
+    graph.AddNode(Node::kIdentity, {q}, {s});
+    graph.AddNode(Node::kAdd, {r, s}, {out});
+
+    int64_t order = ScheduleComputation(graph, {x}, {f}, 0, scheduler_type);
+    EXPECT_EQ(1, order);
+    order = ScheduleComputation(graph, {x, y}, {out}, order, scheduler_type);
+    EXPECT_EQ(6, order);
+    EXPECT_EQ(1, first->chainer_order());
+    EXPECT_EQ(6UL, graph.GetComputationSequence().size());
+    return SimulateMemoryUsage(graph).peak;
+}
+
+TEST(SchedulerSearchTest, SecondScheduling) {
+    // The greedy scheduler does not delay nodes in the second
+    // scheduling, so it keeps both p and q.
+    const int64_t greedy_peak = GetPeakOfBranchesInSecondScheduling(SchedulerType::kGreedy);
+    const int64_t search_peak = GetPeakOfBranchesInSecondScheduling(SchedulerType::kSearch);
+    EXPECT_LE(8000, greedy_peak);
+    // Either p or q, and small values.
+    EXPECT_GT(5000, search_peak);
+}
+
+TEST(SchedulerSearchTest, ParseSchedulerType) {
+    EXPECT_EQ(SchedulerType::kGreedy, ParseSchedulerType(""));
+    EXPECT_EQ(SchedulerType::kNaive, ParseSchedulerType("naive"));
+    EXPECT_EQ(SchedulerType::kSearch, ParseSchedulerType("search"));
+}
 
 }  // namespace
 }  // namespace chainer_compiler
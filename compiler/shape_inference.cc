@@ -0,0 +1,868 @@
+#include "compiler/shape_inference.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+#include <compiler/onnx.h>
+#include <onnx/shape_inference/implementation.h>
+
+#include <common/log.h>
+#include <compiler/dtype_inference.h>
+#include <compiler/graph.h>
+#include <compiler/layout.h>
+#include <compiler/node.h>
+#include <compiler/tensor.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+// Values in outer graphs which are visible from subgraphs.
+typedef std::map<std::string, const Value*> Scope;
+
+typedef std::vector<std::unique_ptr<Type>> Types;
+
+// Constant inputs larger than this are not passed to the ONNX's
+// inference, which only needs small tensors such as shapes.
+const int64_t kMaxConstElementsForInference = 1024;
+
+int64_t NormalizeAxis(int64_t axis, size_t rank) {
+    return axis < 0 ? axis + static_cast<int64_t>(rank) : axis;
+}
+
+Type* NewType(Dtype dtype, const std::vector<int64_t>& dims) {
+    return new Type(dtype, dims);
+}
+
+// Returns a type which is compatible with both `a` and `b`.
+Type* Unify(const Type& a, const Type& b) {
+    if (a.kind() != Type::Kind::kTensor || b.kind() != Type::Kind::kTensor) {
+        return a.kind() == b.kind() ? new Type(a) : new Type();
+    }
+    const Dtype dtype = a.dtype() == b.dtype() ? a.dtype() : Dtype(Dtype::kUnknown);
+    if (!a.HasKnownRank() || !b.HasKnownRank() || a.ndim() != b.ndim()) {
+        return new Type(dtype);
+    }
+    std::vector<int64_t> dims;
+    for (size_t i = 0; i < a.ndim(); ++i) {
+        dims.push_back(a.dims()[i] == b.dims()[i] ? a.dims()[i] : -1);
+    }
+    return NewType(dtype, dims);
+}
+
+// Numpy style broadcast. An unknown dimension is assumed to be
+// compatible with the other one. Returns false for mismatches.
+bool Broadcast(const std::vector<int64_t>& a, const std::vector<int64_t>& b, std::vector<int64_t>* dims) {
+    const size_t rank = std::max(a.size(), b.size());
+    std::vector<int64_t> result(rank);
+    for (size_t i = 0; i < rank; ++i) {
+        const int64_t x = i < a.size() ? a[a.size() - 1 - i] : 1;
+        const int64_t y = i < b.size() ? b[b.size() - 1 - i] : 1;
+        int64_t d;
+        if (x == 1) {
+            d = y;
+        } else if (y == 1 || y < 0) {
+            d = x;
+        } else if (x < 0 || x == y) {
+            d = y;
+        } else {
+            return false;
+        }
+        result[rank - 1 - i] = d;
+    }
+    dims->swap(result);
+    return true;
+}
+
+// Computes the output shape of Conv and pooling ops. `x` is
+// (N, C, D1, D2, ...) and `channels` is the number of output channels.
+bool InferConvLikeDims(
+        const Node& node,
+        const std::vector<int64_t>& x,
+        int64_t channels,
+        const std::vector<int64_t>& kernel,
+        const std::vector<int64_t>& dilations,
+        bool ceil_mode,
+        std::vector<int64_t>* dims) {
+    const size_t num_spatial = kernel.size();
+    if (x.size() != num_spatial + 2) return false;
+    const std::vector<int64_t>& strides = node.strides();
+    const std::vector<int64_t>& pads = node.pads();
+    if (!strides.empty() && strides.size() != num_spatial) return false;
+    if (!pads.empty() && pads.size() != num_spatial * 2) return false;
+    if (!dilations.empty() && dilations.size() != num_spatial) return false;
+    const std::string& auto_pad = node.auto_pad();
+
+    dims->assign({x[0], channels});
+    for (size_t i = 0; i < num_spatial; ++i) {
+        const int64_t in = x[i + 2];
+        const int64_t stride = strides.empty() ? 1 : strides[i];
+        const int64_t dilation = dilations.empty() ? 1 : dilations[i];
+        if (in < 0 || kernel[i] < 0) {
+            dims->push_back(-1);
+        } else if (auto_pad == "SAME_UPPER" || auto_pad == "SAME_LOWER") {
+            dims->push_back((in + stride - 1) / stride);
+        } else {
+            const bool use_pads = auto_pad != "VALID" && !pads.empty();
+            const int64_t padded = in + (use_pads ? pads[i] + pads[i + num_spatial] : 0);
+            const int64_t window = (kernel[i] - 1) * dilation + 1;
+            const int64_t rest = padded - window + (ceil_mode ? stride - 1 : 0);
+            if (rest < 0) return false;
+            dims->push_back(rest / stride + 1);
+        }
+    }
+    return true;
+}
+
+bool InferMatMulDims(const std::vector<int64_t>& a, const std::vector<int64_t>& b, std::vector<int64_t>* dims) {
+    if (a.empty() || b.empty()) return false;
+    std::vector<int64_t> a_batch, b_batch;
+    int64_t a_k = a.back();
+    int64_t b_k = b.size() == 1 ? b[0] : b[b.size() - 2];
+    if (a_k >= 0 && b_k >= 0 && a_k != b_k) return false;
+    if (a.size() > 2) a_batch.assign(a.begin(), a.end() - 2);
+    if (b.size() > 2) b_batch.assign(b.begin(), b.end() - 2);
+    if (!Broadcast(a_batch, b_batch, dims)) return false;
+    if (a.size() >= 2) dims->push_back(a[a.size() - 2]);
+    if (b.size() >= 2) dims->push_back(b.back());
+    return true;
+}
+
+// Returns the values of a constant shape tensor, or false if it is
+// not available.
+bool GetConstShape(const Value* value, std::vector<int64_t>* shape) {
+    const Tensor* tensor = value->GetConstTensor();
+    if (!tensor || tensor->dtype() != Dtype::kInt64 || tensor->dims().size() != 1) return false;
+    shape->clear();
+    for (int64_t i = 0; i < tensor->NumElements(); ++i) {
+        shape->push_back(tensor->Get<int64_t>(i));
+    }
+    return true;
+}
+
+// `shape` may have 0 (copy the input dimension) and -1 (inferred).
+bool InferReshapeDims(const Type& x, const std::vector<int64_t>& shape, std::vector<int64_t>* dims) {
+    dims->clear();
+    int inferred_axis = -1;
+    for (size_t i = 0; i < shape.size(); ++i) {
+        int64_t d = shape[i];
+        if (d == 0) {
+            if (!x.HasKnownRank() || i >= x.ndim()) return false;
+            d = x.dims()[i];
+        } else if (d == -1) {
+            if (inferred_axis >= 0) return false;
+            inferred_axis = i;
+        } else if (d < 0) {
+            return false;
+        }
+        dims->push_back(d);
+    }
+    if (inferred_axis < 0 || !x.HasKnownShape()) return true;
+
+    int64_t known_size = 1;
+    for (size_t i = 0; i < dims->size(); ++i) {
+        if (static_cast<int>(i) == inferred_axis) continue;
+        if ((*dims)[i] < 0) return true;
+        known_size *= (*dims)[i];
+    }
+    const int64_t total = x.NumElements();
+    if (known_size == 0 || total % known_size) return false;
+    (*dims)[inferred_axis] = total / known_size;
+    return true;
+}
+
+void InferGraph(Graph* graph, const Scope& scope);
+
+// Native inference rules. Returns false if `node` is not supported
+// or its inputs are inconsistent so the ONNX's inference should be
+// tried. Outputs which cannot be inferred are left null in `outs`.
+bool InferNative(Node* node, const Scope& scope, Types* outs) {
+    auto in = [node](int i) -> const Type& { return node->input(i)->type(); };
+    auto set = [outs](int i, Type* type) {
+        std::unique_ptr<Type> t(type);
+        if (i < static_cast<int>(outs->size())) (*outs)[i] = std::move(t);
+    };
+    // Sets a type with the same shape as `type`.
+    auto set_like = [&set](int i, const Type& type, Dtype dtype) {
+        Type* t = new Type(type);
+        t->set_dtype(dtype);
+        set(i, t);
+    };
+
+    const std::vector<Value*>& inputs = node->inputs();
+    // Control flow ops may take sequences.
+    if (node->op_type() != Node::kIf && node->op_type() != Node::kLoop) {
+        for (Value* input : inputs) {
+            if (input->type().kind() != Type::Kind::kTensor) return false;
+        }
+    }
+
+    switch (node->op_type()) {
+        case Node::kIdentity:
+        case Node::kNeg:
+        case Node::kAbs:
+        case Node::kRelu:
+        case Node::kLeakyRelu:
+        case Node::kElu:
+        case Node::kSelu:
+        case Node::kSigmoid:
+        case Node::kTanh:
+        case Node::kExp:
+        case Node::kLog:
+        case Node::kSqrt:
+        case Node::kReciprocal:
+        case Node::kFloor:
+        case Node::kCeil:
+        case Node::kSoftplus:
+        case Node::kSoftsign:
+        case Node::kSin:
+        case Node::kSinh:
+        case Node::kCos:
+        case Node::kCosh:
+        case Node::kTan:
+        case Node::kAsin:
+        case Node::kAsinh:
+        case Node::kAcos:
+        case Node::kAcosh:
+        case Node::kAtan:
+        case Node::kAtanh:
+        case Node::kErf:
+        case Node::kSign:
+        case Node::kClip:
+        case Node::kSoftmax:
+        case Node::kLogSoftmax:
+        case Node::kHardmax: {
+            set(0, new Type(in(0)));
+            return true;
+        }
+
+        case Node::kDropout:
+        case Node::kLRN: {
+            // Other outputs are contexts for backward computation.
+            set(0, new Type(in(0)));
+            return true;
+        }
+
+        case Node::kBatchNormalization: {
+            set(0, new Type(in(0)));
+            // Running and saved statistics.
+            const Type& scale = in(1);
+            for (int i = 1; i < 5; ++i) {
+                set(i, new Type(scale));
+            }
+            return true;
+        }
+
+        case Node::kIsNaN:
+        case Node::kIsInf:
+        case Node::kNot: {
+            set_like(0, in(0), Dtype::kBool);
+            return true;
+        }
+
+        case Node::kAdd:
+        case Node::kSub:
+        case Node::kMul:
+        case Node::kDiv:
+        case Node::kPow:
+        case Node::kSum:
+        case Node::kMean:
+        case Node::kMax:
+        case Node::kMin:
+        case Node::kEqual:
+        case Node::kGreater:
+        case Node::kLess:
+        case Node::kAnd:
+        case Node::kOr:
+        case Node::kXor:
+        case Node::kWhere: {
+            Dtype dtype;
+            switch (node->op_type()) {
+                case Node::kPow:
+                    dtype = in(0).dtype();
+                    break;
+                case Node::kEqual:
+                case Node::kGreater:
+                case Node::kLess:
+                case Node::kAnd:
+                case Node::kOr:
+                case Node::kXor:
+                    dtype = Dtype::kBool;
+                    break;
+                case Node::kWhere:
+                    dtype = in(1).dtype();
+                    break;
+                default:
+                    dtype = in(0).dtype();
+                    for (size_t i = 1; i < inputs.size(); ++i) {
+                        dtype = CoerceDtype(dtype, in(i).dtype());
+                    }
+            }
+            std::vector<int64_t> dims;
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                if (!in(i).HasKnownRank()) {
+                    set(0, new Type(dtype));
+                    return true;
+                }
+                if (!Broadcast(dims, in(i).dims(), &dims)) return false;
+            }
+            set(0, NewType(dtype, dims));
+            return true;
+        }
+
+        case Node::kConv:
+        case Node::kChainerFusedConv: {
+            const Type& x = in(0);
+            const Type& w = in(1);
+            if (!x.HasKnownRank() || !w.HasKnownRank() || w.ndim() < 2) {
+                set(0, new Type(x.dtype()));
+                return true;
+            }
+            std::vector<int64_t> kernel = node->kernel_shape();
+            if (kernel.empty()) kernel.assign(w.dims().begin() + 2, w.dims().end());
+            std::vector<int64_t> dims;
+            if (!InferConvLikeDims(*node, x.dims(), w.dims()[0], kernel, node->dilations(), false, &dims)) return false;
+            set(0, NewType(x.dtype(), dims));
+            return true;
+        }
+
+        case Node::kMaxPool:
+        case Node::kAveragePool: {
+            const Type& x = in(0);
+            if (!x.HasKnownRank() || x.ndim() < 2) {
+                set(0, new Type(x.dtype()));
+                return true;
+            }
+            const bool ceil_mode = node->op_type() == Node::kMaxPool && node->chainer_cover_all();
+            std::vector<int64_t> dims;
+            if (!InferConvLikeDims(*node, x.dims(), x.dims()[1], node->kernel_shape(), {}, ceil_mode, &dims)) return false;
+            set(0, NewType(x.dtype(), dims));
+            return true;
+        }
+
+        case Node::kChainerLayoutConvert: {
+            const Type& x = in(0);
+            if (!x.HasKnownRank()) {
+                set(0, new Type(x.dtype()));
+                return true;
+            }
+            if (node->src_layout() == "NCHW") {
+                if (x.ndim() != 4) return false;
+                set(0, NewType(x.dtype(), ToLayoutDims(x.dims(), node->dst_layout())));
+                return true;
+            }
+            std::vector<int64_t> dims = FromLayoutDims(x.dims(), node->src_layout());
+            if (node->channels() > 0) dims[1] = node->channels();
+            set(0, NewType(x.dtype(), dims));
+            return true;
+        }
+
+        case Node::kChainerLayoutConv:
+        case Node::kChainerLayoutMaxPool:
+        case Node::kChainerLayoutAveragePool: {
+            const Type& x = in(0);
+            if (!x.HasKnownRank()) {
+                set(0, new Type(x.dtype()));
+                return true;
+            }
+            const std::vector<int64_t> nchw = FromLayoutDims(x.dims(), node->layout());
+            int64_t channels = nchw[1];
+            if (node->op_type() == Node::kChainerLayoutConv && node->group() == 1) {
+                // Packed as (KB, CB, KH, KW, Lin, Lout).
+                const Type& w = in(1);
+                if (!w.HasKnownShape() || w.ndim() != 6) return false;
+                channels = w.dims()[0] * w.dims()[5];
+            }
+            const bool ceil_mode = node->op_type() == Node::kChainerLayoutMaxPool && node->chainer_cover_all();
+            std::vector<int64_t> dims;
+            if (!InferConvLikeDims(*node, nchw, channels, node->kernel_shape(), {}, ceil_mode, &dims)) return false;
+            set(0, NewType(x.dtype(), ToLayoutDims(dims, node->layout())));
+            return true;
+        }
+
+        case Node::kGlobalAveragePool:
+        case Node::kGlobalMaxPool: {
+            const Type& x = in(0);
+            if (!x.HasKnownRank() || x.ndim() < 2) {
+                set(0, new Type(x.dtype()));
+                return true;
+            }
+            std::vector<int64_t> dims(x.ndim(), 1);
+            dims[0] = x.dims()[0];
+            dims[1] = x.dims()[1];
+            set(0, NewType(x.dtype(), dims));
+            return true;
+        }
+
+        case Node::kGemm: {
+            const Type& a = in(0);
+            const Type& b = in(1);
+            if (!a.HasKnownRank() || !b.HasKnownRank()) {
+                set(0, new Type(a.dtype()));
+                return true;
+            }
+            if (a.ndim() != 2 || b.ndim() != 2) return false;
+            set(0, NewType(a.dtype(), {a.dims()[node->trans_a() ? 1 : 0], b.dims()[node->trans_b() ? 0 : 1]}));
+            return true;
+        }
+
+        case Node::kChainerFusedLinear: {
+            const Type& x = in(0);
+            const Type& w = in(1);
+            if (!x.HasKnownRank() || !w.HasKnownRank()) {
+                set(0, new Type(x.dtype()));
+                return true;
+            }
+            if (x.ndim() != 2 || w.ndim() != 2) return false;
+            set(0, NewType(x.dtype(), {x.dims()[0], w.dims()[0]}));
+            return true;
+        }
+
+        case Node::kChainerFusedLinearGradWeight: {
+            const Type& x = in(0);
+            const Type& gy = in(1);
+            if (!x.HasKnownRank() || !gy.HasKnownRank()) {
+                set(0, new Type(gy.dtype()));
+                set(1, new Type(gy));
+                return true;
+            }
+            if (x.ndim() != 2 || gy.ndim() != 2) return false;
+            set(0, NewType(gy.dtype(), {gy.dims()[1], x.dims()[1]}));
+            set(1, new Type(gy));
+            return true;
+        }
+
+        case Node::kMatMul: {
+            const Type& a = in(0);
+            const Type& b = in(1);
+            if (!a.HasKnownRank() || !b.HasKnownRank()) {
+                set(0, new Type(a.dtype()));
+                return true;
+            }
+            std::vector<int64_t> dims;
+            if (!InferMatMulDims(a.dims(), b.dims(), &dims)) return false;
+            set(0, NewType(a.dtype(), dims));
+            return true;
+        }
+
+        case Node::kTranspose: {
+            const Type& x = in(0);
+            if (!x.HasKnownRank()) {
+                set(0, new Type(x.dtype()));
+                return true;
+            }
+            std::vector<int64_t> perm = node->perm();
+            if (perm.empty()) {
+                for (size_t i = 0; i < x.ndim(); ++i) perm.push_back(x.ndim() - 1 - i);
+            }
+            if (perm.size() != x.ndim()) return false;
+            std::vector<int64_t> dims;
+            for (int64_t p : perm) {
+                if (p < 0 || p >= static_cast<int64_t>(x.ndim())) return false;
+                dims.push_back(x.dims()[p]);
+            }
+            set(0, NewType(x.dtype(), dims));
+            return true;
+        }
+
+        case Node::kFlatten: {
+            const Type& x = in(0);
+            if (!x.HasKnownRank()) {
+                set(0, new Type(x.dtype()));
+                return true;
+            }
+            const int64_t axis = NormalizeAxis(node->axis(), x.ndim());
+            if (axis < 0 || axis > static_cast<int64_t>(x.ndim())) return false;
+            std::vector<int64_t> dims = {1, 1};
+            for (size_t i = 0; i < x.ndim(); ++i) {
+                int64_t& d = dims[static_cast<int64_t>(i) < axis ? 0 : 1];
+                d = (d < 0 || x.dims()[i] < 0) ? -1 : d * x.dims()[i];
+            }
+            set(0, NewType(x.dtype(), dims));
+            return true;
+        }
+
+        case Node::kReshape: {
+            const Type& x = in(0);
+            std::vector<int64_t> shape;
+            if (GetConstShape(node->input(1), &shape)) {
+                std::vector<int64_t> dims;
+                if (!InferReshapeDims(x, shape, &dims)) return false;
+                set(0, NewType(x.dtype(), dims));
+            } else if (in(1).HasKnownShape() && in(1).ndim() == 1) {
+                set(0, NewType(x.dtype(), std::vector<int64_t>(in(1).dims()[0], -1)));
+            } else {
+                set(0, new Type(x.dtype()));
+            }
+            return true;
+        }
+
+        case Node::kExpand: {
+            const Type& x = in(0);
+            std::vector<int64_t> shape;
+            if (!x.HasKnownRank() || !GetConstShape(node->input(1), &shape)) {
+                set(0, new Type(x.dtype()));
+                return true;
+            }
+            std::vector<int64_t> dims;
+            if (!Broadcast(x.dims(), shape, &dims)) return false;
+            set(0, NewType(x.dtype(), dims));
+            return true;
+        }
+
+        case Node::kConcat: {
+            std::vector<int64_t> dims;
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                const Type& x = in(i);
+                if (!x.HasKnownRank()) {
+                    set(0, new Type(in(0).dtype()));
+                    return true;
+                }
+                const int64_t axis = NormalizeAxis(node->axis(), x.ndim());
+                if (axis < 0 || axis >= static_cast<int64_t>(x.ndim())) return false;
+                if (i == 0) {
+                    dims = x.dims();
+                    continue;
+                }
+                if (dims.size() != x.ndim()) return false;
+                for (size_t j = 0; j < dims.size(); ++j) {
+                    const int64_t d = x.dims()[j];
+                    if (static_cast<int64_t>(j) == axis) {
+                        dims[j] = (dims[j] < 0 || d < 0) ? -1 : dims[j] + d;
+                    } else if (dims[j] < 0) {
+                        dims[j] = d;
+                    } else if (d >= 0 && d != dims[j]) {
+                        return false;
+                    }
+                }
+            }
+            set(0, NewType(in(0).dtype(), dims));
+            return true;
+        }
+
+        case Node::kSqueeze: {
+            const Type& x = in(0);
+            if (!x.HasKnownRank()) {
+                set(0, new Type(x.dtype()));
+                return true;
+            }
+            std::set<int64_t> axes;
+            for (int64_t axis : node->axes()) axes.insert(NormalizeAxis(axis, x.ndim()));
+            std::vector<int64_t> dims;
+            for (size_t i = 0; i < x.ndim(); ++i) {
+                const int64_t d = x.dims()[i];
+                if (axes.empty()) {
+                    if (d < 0) {
+                        set(0, new Type(x.dtype()));
+                        return true;
+                    }
+                    if (d == 1) continue;
+                } else if (axes.count(i)) {
+                    if (d > 1) return false;
+                    continue;
+                }
+                dims.push_back(d);
+            }
+            set(0, NewType(x.dtype(), dims));
+            return true;
+        }
+
+        case Node::kUnsqueeze: {
+            const Type& x = in(0);
+            if (!x.HasKnownRank()) {
+                set(0, new Type(x.dtype()));
+                return true;
+            }
+            const size_t rank = x.ndim() + node->axes().size();
+            std::set<int64_t> axes;
+            for (int64_t axis : node->axes()) axes.insert(NormalizeAxis(axis, rank));
+            std::vector<int64_t> dims;
+            size_t j = 0;
+            for (size_t i = 0; i < rank; ++i) {
+                if (axes.count(i)) {
+                    dims.push_back(1);
+                } else {
+                    if (j >= x.ndim()) return false;
+                    dims.push_back(x.dims()[j++]);
+                }
+            }
+            set(0, NewType(x.dtype(), dims));
+            return true;
+        }
+
+        case Node::kGather: {
+            const Type& x = in(0);
+            const Type& indices = in(1);
+            if (!x.HasKnownRank() || !indices.HasKnownRank()) {
+                set(0, new Type(x.dtype()));
+                return true;
+            }
+            const int64_t axis = NormalizeAxis(node->axis(), x.ndim());
+            if (axis < 0 || axis >= static_cast<int64_t>(x.ndim())) return false;
+            std::vector<int64_t> dims(x.dims().begin(), x.dims().begin() + axis);
+            dims.insert(dims.end(), indices.dims().begin(), indices.dims().end());
+            dims.insert(dims.end(), x.dims().begin() + axis + 1, x.dims().end());
+            set(0, NewType(x.dtype(), dims));
+            return true;
+        }
+
+        case Node::kSplit: {
+            const Type& x = in(0);
+            if (!x.HasKnownRank()) {
+                for (size_t i = 0; i < outs->size(); ++i) set(i, new Type(x.dtype()));
+                return true;
+            }
+            const int64_t axis = NormalizeAxis(node->axis(), x.ndim());
+            if (axis < 0 || axis >= static_cast<int64_t>(x.ndim())) return false;
+            const std::vector<int64_t>& split = node->split();
+            if (!split.empty() && split.size() != outs->size()) return false;
+            const int64_t d = x.dims()[axis];
+            const int64_t num_outputs = outs->size();
+            for (size_t i = 0; i < outs->size(); ++i) {
+                std::vector<int64_t> dims = x.dims();
+                if (!split.empty()) {
+                    dims[axis] = split[i];
+                } else if (d >= 0) {
+                    if (d % num_outputs) return false;
+                    dims[axis] = d / num_outputs;
+                }
+                set(i, NewType(x.dtype(), dims));
+            }
+            return true;
+        }
+
+        case Node::kShape: {
+            const Type& x = in(0);
+            if (x.HasKnownRank()) {
+                set(0, NewType(Dtype::kInt64, {static_cast<int64_t>(x.ndim())}));
+            } else {
+                set(0, NewType(Dtype::kInt64, {-1}));
+            }
+            return true;
+        }
+
+        case Node::kSize: {
+            set(0, NewType(Dtype::kInt64, {}));
+            return true;
+        }
+
+        case Node::kReduceSum:
+        case Node::kReduceSumSquare:
+        case Node::kReduceMean:
+        case Node::kReduceMax:
+        case Node::kReduceMin:
+        case Node::kReduceL1:
+        case Node::kReduceL2:
+        case Node::kReduceLogSum:
+        case Node::kReduceLogSumExp:
+        case Node::kReduceProd:
+        case Node::kArgMax:
+        case Node::kArgMin: {
+            const Type& x = in(0);
+            const bool is_arg = node->op_type() == Node::kArgMax || node->op_type() == Node::kArgMin;
+            const Dtype dtype = is_arg ? Dtype(Dtype::kInt64) : x.dtype();
+            if (!x.HasKnownRank()) {
+                set(0, new Type(dtype));
+                return true;
+            }
+            std::set<int64_t> axes;
+            if (is_arg) {
+                axes.insert(NormalizeAxis(node->axis(), x.ndim()));
+            } else {
+                for (int64_t axis : node->axes()) axes.insert(NormalizeAxis(axis, x.ndim()));
+            }
+            std::vector<int64_t> dims;
+            for (size_t i = 0; i < x.ndim(); ++i) {
+                if (axes.empty() || axes.count(i)) {
+                    if (node->keepdims()) dims.push_back(1);
+                } else {
+                    dims.push_back(x.dims()[i]);
+                }
+            }
+            set(0, NewType(dtype, dims));
+            return true;
+        }
+
+        case Node::kCast: {
+            set_like(0, in(0), node->to());
+            return true;
+        }
+
+        case Node::kConstant: {
+            const Tensor& tensor = *node->tensor_value();
+            set(0, NewType(tensor.dtype(), tensor.dims()));
+            return true;
+        }
+
+        case Node::kIf: {
+            Graph* then_branch = node->then_branch().get();
+            Graph* else_branch = node->else_branch().get();
+            for (Graph* branch : {then_branch, else_branch}) {
+                // Inputs of canonicalized branches.
+                if (branch->input_values().size() + 1 == inputs.size()) {
+                    for (size_t i = 0; i < branch->input_values().size(); ++i) {
+                        branch->input_values()[i]->mutable_type()->Merge(in(i + 1));
+                    }
+                }
+                InferGraph(branch, scope);
+            }
+            for (size_t i = 0; i < outs->size(); ++i) {
+                if (i >= then_branch->output_values().size() || i >= else_branch->output_values().size()) break;
+                set(i, Unify(then_branch->output_values()[i]->type(), else_branch->output_values()[i]->type()));
+            }
+            return true;
+        }
+
+        case Node::kLoop: {
+            Graph* body = node->body().get();
+            if (inputs.size() < 2) return false;
+            const size_t num_states = inputs.size() - 2;
+            if (body->input_values().size() != num_states + 2 || body->output_values().size() != outs->size() + 1) {
+                InferGraph(body, scope);
+                return true;
+            }
+            body->input_values()[0]->mutable_type()->Merge(Type(Dtype::kInt64, {}));
+            body->input_values()[1]->mutable_type()->Merge(Type(Dtype::kBool, {}));
+            for (size_t i = 0; i < num_states; ++i) {
+                if (node->input(i + 2)->IsNull()) continue;
+                body->input_values()[i + 2]->mutable_type()->Merge(in(i + 2));
+            }
+            InferGraph(body, scope);
+            for (size_t i = 0; i < outs->size(); ++i) {
+                const Type& type = body->output_values()[i + 1]->type();
+                if (i < num_states) {
+                    if (!node->input(i + 2)->IsNull()) set(i, Unify(in(i + 2), type));
+                } else if (type.HasKnownRank()) {
+                    // Scan outputs are stacked along `chainer_stack_axis`.
+                    std::vector<int64_t> dims = type.dims();
+                    const int64_t axis = NormalizeAxis(node->chainer_stack_axis(), dims.size() + 1);
+                    if (axis < 0 || axis > static_cast<int64_t>(dims.size())) return false;
+                    dims.insert(dims.begin() + axis, -1);
+                    set(i, NewType(type.dtype(), dims));
+                } else {
+                    set(i, new Type(type.dtype()));
+                }
+            }
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+// Runs the ONNX's shape inference for a graph which only has `node`.
+bool InferByONNX(Node* node, Types* outs) {
+    onnx::GraphProto xgraph;
+    node->ToONNX(xgraph.add_node());
+    std::set<const Value*> seen;
+    for (const Value* value : node->inputs()) {
+        if (value->IsNull() || !seen.insert(value).second) continue;
+        value->ToONNX(xgraph.add_input());
+        const Tensor* tensor = value->GetConstTensor();
+        if (tensor && tensor->NumElements() <= kMaxConstElementsForInference) {
+            onnx::TensorProto* xtensor = xgraph.add_initializer();
+            tensor->ToONNX(xtensor);
+            xtensor->set_name(value->name());
+        }
+    }
+    std::vector<int> output_indices;
+    for (size_t i = 0; i < node->outputs().size(); ++i) {
+        const Value* value = node->output(i);
+        if (value->IsNull()) continue;
+        value->ToONNX(xgraph.add_output());
+        output_indices.push_back(i);
+    }
+
+    try {
+        onnx::shape_inference::InferShapes(&xgraph, OpsetImports());
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    for (size_t i = 0; i < output_indices.size(); ++i) {
+        const onnx::TypeProto& xtype = xgraph.output(i).type();
+        if (xtype.has_tensor_type() || xtype.has_sequence_type()) {
+            (*outs)[output_indices[i]].reset(new Type(xtype));
+        }
+    }
+    return true;
+}
+
+bool InferShapeImpl(Node* node, const Scope& scope) {
+    Types outs(node->outputs().size());
+    if (!InferNative(node, scope, &outs) && !InferByONNX(node, &outs)) {
+        return false;
+    }
+    bool updated = false;
+    for (size_t i = 0; i < outs.size(); ++i) {
+        Value* output = node->output(i);
+        if (outs[i] && !output->IsNull() && output->mutable_type()->Merge(*outs[i])) {
+            updated = true;
+        }
+    }
+    return updated;
+}
+
+void InferShapesImpl(const std::vector<Node*>& nodes, const Scope& scope) {
+    std::deque<Node*> queue(nodes.begin(), nodes.end());
+    std::set<Node*> queued(nodes.begin(), nodes.end());
+    // As types are only refined, this terminates.
+    while (!queue.empty()) {
+        Node* node = queue.front();
+        queue.pop_front();
+        queued.erase(node);
+        if (node->detached() || !InferShapeImpl(node, scope)) continue;
+        for (Value* output : node->outputs()) {
+            for (Node* user : output->users()) {
+                if (queued.insert(user).second) queue.push_back(user);
+            }
+        }
+    }
+}
+
+void InferGraph(Graph* graph, const Scope& scope) {
+    // Values which come from outer graphs.
+    for (const std::unique_ptr<Value>& value : graph->all_values()) {
+        if (value->IsInput() || value->IsNull() || value->producer()) continue;
+        auto found = scope.find(value->name());
+        if (found != scope.end()) value->mutable_type()->Merge(found->second->type());
+    }
+
+    bool has_subgraphs = false;
+    for (Node* node : graph->nodes()) {
+        if (!node->GetSubGraphs().empty()) has_subgraphs = true;
+    }
+    if (!has_subgraphs) {
+        InferShapesImpl(graph->nodes(), scope);
+        return;
+    }
+
+    Scope inner_scope = scope;
+    for (const std::unique_ptr<Value>& value : graph->all_values()) {
+        if (!value->IsNull()) inner_scope[value->name()] = value.get();
+    }
+    InferShapesImpl(graph->nodes(), inner_scope);
+}
+
+}  // namespace
+
+bool InferShape(Node* node) {
+    return InferShapeImpl(node, Scope());
+}
+
+void InferShapesFrom(const std::vector<Node*>& nodes) {
+    InferShapesImpl(nodes, Scope());
+}
+
+void InferAllShapes(Graph* graph) {
+    InferGraph(graph, Scope());
+}
+
+}  // namespace chainer_compiler
@@ -0,0 +1,31 @@
+// Shape and dtype inference which works directly on `Graph`.
+//
+// Unlike `onnx::shape_inference::InferShapes`, this does not need to
+// serialize the whole graph so passes can cheaply re-infer types of
+// nodes around a rewrite. Operators without native rules are inferred
+// by running the ONNX's inference on a graph with the single node.
+//
+// Inferred types are merged into existing types of outputs, i.e.,
+// only unknown dtypes and dimensions are filled.
+
+#pragma once
+
+#include <vector>
+
+namespace chainer_compiler {
+
+class Graph;
+class Node;
+
+// Infers types of outputs of `node`. Returns true if any of them is
+// updated.
+bool InferShape(Node* node);
+
+// Infers types of outputs of `nodes` and users of updated values
+// until no type changes.
+void InferShapesFrom(const std::vector<Node*>& nodes);
+
+// Infers types of all values in `graph` and its subgraphs.
+void InferAllShapes(Graph* graph);
+
+}  // namespace chainer_compiler
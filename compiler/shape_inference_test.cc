@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include <compiler/graph.h>
+#include <compiler/graph_builder.h>
+#include <compiler/node.h>
+#include <compiler/shape_inference.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+TEST(ShapeInferenceTest, MergeType) {
+    Type type;
+    EXPECT_TRUE(type.Merge(Type(Dtype::kFloat32, {-1, 3})));
+    EXPECT_EQ(Dtype::kFloat32, type.dtype());
+    EXPECT_TRUE(type.HasKnownRank());
+    EXPECT_FALSE(type.HasKnownShape());
+
+    EXPECT_TRUE(type.Merge(Type(Dtype::kFloat32, {2, 4})));
+    std::vector<int64_t> expected_dims = {2, 3};
+    EXPECT_EQ(expected_dims, type.dims());
+    EXPECT_FALSE(type.Merge(Type(Dtype::kInt32, {2, 3})));
+    EXPECT_EQ(Dtype::kFloat32, type.dtype());
+}
+
+TEST(ShapeInferenceTest, ConvPoolGemm) {
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32, {2, 3, 32, 32}));
+    Value* w = graph.AddInputValue("w", Type(Dtype::kFloat32, {8, 3, 3, 3}));
+    Value* fc_w = graph.AddInputValue("fc_w", Type(Dtype::kFloat32, {10, 512}));
+    Value* fc_b = graph.AddInputValue("fc_b", Type(Dtype::kFloat32, {10}));
+    Value* conv = graph.AddValue("conv");
+    Value* pool = graph.AddValue("pool");
+    Value* flat = graph.AddValue("flat");
+    Value* y = graph.AddOutputValue("y", Type());
+    graph.AddNode(Node::kConv, {x, w}, {conv})->set_pads({1, 1, 1, 1})->set_strides({2, 2});
+    graph.AddNode(Node::kMaxPool, {conv}, {pool})->set_kernel_shape({2, 2})->set_strides({2, 2});
+    graph.AddNode(Node::kFlatten, {pool}, {flat});
+    graph.AddNode(Node::kGemm, {flat, fc_w, fc_b}, {y})->set_trans_b(true);
+
+    InferAllShapes(&graph);
+
+    EXPECT_EQ(std::vector<int64_t>({2, 8, 16, 16}), conv->type().dims());
+    EXPECT_EQ(std::vector<int64_t>({2, 8, 8, 8}), pool->type().dims());
+    EXPECT_EQ(std::vector<int64_t>({2, 512}), flat->type().dims());
+    EXPECT_EQ(std::vector<int64_t>({2, 10}), y->type().dims());
+    EXPECT_EQ(Dtype::kFloat32, y->type().dtype());
+}
+
+TEST(ShapeInferenceTest, Broadcast) {
+    Graph graph("test");
+    Value* a = graph.AddInputValue("a", Type(Dtype::kInt32, {3, 1, 5}));
+    Value* b = graph.AddInputValue("b", Type(Dtype::kFloat32, {4, 1}));
+    Value* c = graph.AddInputValue("c", Type(Dtype::kFloat32, {-1, 1, 1}));
+    Value* ab = graph.AddValue("ab");
+    Value* abc = graph.AddValue("abc");
+    Value* y = graph.AddOutputValue("y", Type());
+    graph.AddNode(Node::kAdd, {a, b}, {ab});
+    graph.AddNode(Node::kMul, {ab, c}, {abc});
+    graph.AddNode(Node::kGreater, {abc, b}, {y});
+
+    InferAllShapes(&graph);
+
+    EXPECT_EQ(Dtype::kFloat32, ab->type().dtype());
+    EXPECT_EQ(std::vector<int64_t>({3, 4, 5}), ab->type().dims());
+    EXPECT_EQ(std::vector<int64_t>({3, 4, 5}), abc->type().dims());
+    EXPECT_EQ(Dtype::kBool, y->type().dtype());
+    EXPECT_EQ(std::vector<int64_t>({3, 4, 5}), y->type().dims());
+}
+
+TEST(ShapeInferenceTest, ConstantReshape) {
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32, {2, 3, 4}));
+    Value* y = graph.AddOutputValue("y", Type());
+    {
+        GraphBuilder gb(&graph, "test", y);
+        Value* shape = gb.Const(Type(Dtype::kInt64, {2}), std::vector<int64_t>{0, -1});
+        graph.AddNode(Node::kReshape, {x, shape}, {y});
+    }
+
+    InferAllShapes(&graph);
+
+    EXPECT_EQ(std::vector<int64_t>({2, 12}), y->type().dims());
+}
+
+TEST(ShapeInferenceTest, Incremental) {
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type());
+    Value* t = graph.AddValue("t");
+    Value* y = graph.AddOutputValue("y", Type());
+    Node* relu = graph.AddNode(Node::kRelu, {x}, {t});
+    graph.AddNode(Node::kTranspose, {t}, {y});
+
+    InferAllShapes(&graph);
+    EXPECT_FALSE(y->type().HasKnownRank());
+
+    // Only the users of the updated value need to be re-inferred.
+    x->set_type(new Type(Dtype::kFloat32, {2, 3}));
+    InferShapesFrom({relu});
+
+    EXPECT_EQ(std::vector<int64_t>({2, 3}), t->type().dims());
+    EXPECT_EQ(std::vector<int64_t>({3, 2}), y->type().dims());
+    EXPECT_FALSE(InferShape(relu));
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -13,6 +13,7 @@
 #include <compiler/graph_builder.h>
 #include <compiler/log.h>
 #include <compiler/node.h>
+#include <compiler/pattern_rewriter.h>
 #include <compiler/value.h>
 #include <configs/backend_config.h>
 
@@ -708,25 +709,16 @@ void Simplify(const std::set<std::string>& simplifier_names, Graph* graph, bool
         CHECK_EQ(1, all_simplifier_names.count(name)) << name;
     }
 
-    bool replaced = true;
-    while (replaced) {
-        replaced = false;
-        for (Node* node : graph->GetLiveNodes()) {
-            auto found = simplifiers.find(node->op_type());
-            if (found == simplifiers.end()) {
-                continue;
-            }
-            const Simplifier& simplifier = found->second;
-            if (!simplifier_names.count(simplifier.name)) {
-                continue;
-            }
-            if (simplifier.fn(graph, node)) {
-                CLOG() << node->op_type() << " simplified" << std::endl;
-                graph->DetachNode(node);
-                replaced = true;
-            }
+    PatternRewriter rewriter;
+    for (const auto& p : simplifiers) {
+        const Simplifier& simplifier = p.second;
+        if (!simplifier_names.count(simplifier.name)) {
+            continue;
         }
+        SimplifierFn fn = simplifier.fn;
+        rewriter.AddRule(simplifier.name, Pattern::Op(p.first), [fn](Graph* graph, const PatternMatch& m) { return fn(graph, m.root()); });
     }
+    rewriter.Run(graph);
 }
 
 }  // namespace chainer_compiler
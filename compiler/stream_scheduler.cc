@@ -0,0 +1,440 @@
+#include "compiler/stream_scheduler.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <common/log.h>
+#include <compiler/flops.h>
+#include <compiler/graph.h>
+#include <compiler/log.h>
+#include <compiler/node.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+// Scheduled nodes of a graph in `chainer_order` with their costs and
+// the sizes of values they allocate and free.
+class ScheduledNodes {
+public:
+    explicit ScheduledNodes(const Graph& graph) {
+        for (Node* node : graph.nodes()) {
+            if (node->chainer_order() >= 0) nodes_.push_back(node);
+        }
+        std::sort(nodes_.begin(), nodes_.end(), [](const Node* a, const Node* b) { return a->chainer_order() < b->chainer_order(); });
+
+        std::map<const Node*, int> node_ids;
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            CHECK(node_ids.emplace(nodes_[i], i).second);
+        }
+
+        infos_.resize(nodes_.size());
+        std::map<const Value*, int> value_ids;
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            const Node& node = *nodes_[i];
+            NodeInfo& info = infos_[i];
+            info.cost = std::max<int64_t>(CalculateFlops(node, &num_unknown_flops_), 0) + 1;
+            for (const Value* output : node.outputs()) {
+                if (!output->IsNull()) info.output_bytes += std::max<int64_t>(output->GetNBytes(), 0);
+            }
+            for (const Value* input : node.inputs()) {
+                if (input->IsNull()) continue;
+                if (input->producer()) {
+                    auto found = node_ids.find(input->producer());
+                    if (found != node_ids.end()) info.preds.push_back(found->second);
+                }
+
+                auto inserted = value_ids.emplace(input, values_.size());
+                if (inserted.second) {
+                    ValueInfo value{std::max<int64_t>(input->GetNBytes(), 0), 0};
+                    std::set<int> users;
+                    bool freeable = !input->initializer();
+                    for (const Node* user : input->users()) {
+                        auto found = node_ids.find(user);
+                        if (found == node_ids.end()) {
+                            freeable = false;
+                        } else {
+                            users.insert(found->second);
+                        }
+                    }
+                    // Values used by nodes which are not scheduled
+                    // are never freed.
+                    value.num_users = freeable ? users.size() : -1;
+                    if (!input->producer()) initial_mem_ += value.bytes;
+                    values_.push_back(value);
+                }
+                info.inputs.push_back(inserted.first->second);
+            }
+            std::sort(info.preds.begin(), info.preds.end());
+            info.preds.erase(std::unique(info.preds.begin(), info.preds.end()), info.preds.end());
+            std::sort(info.inputs.begin(), info.inputs.end());
+            info.inputs.erase(std::unique(info.inputs.begin(), info.inputs.end()), info.inputs.end());
+            for (int pred : info.preds) infos_[pred].succs.push_back(i);
+        }
+    }
+
+    size_t size() const {
+        return nodes_.size();
+    }
+
+    Node* node(int id) const {
+        return nodes_[id];
+    }
+
+    const std::vector<int>& preds(int id) const {
+        return infos_[id].preds;
+    }
+
+    const std::vector<int>& succs(int id) const {
+        return infos_[id].succs;
+    }
+
+    int64_t cost(int id) const {
+        return infos_[id].cost;
+    }
+
+    int64_t output_bytes(int id) const {
+        return infos_[id].output_bytes;
+    }
+
+    int64_t initial_mem() const {
+        return initial_mem_;
+    }
+
+    // Returns the number of users of inputs of each node which have not
+    // finished, or -1 for inputs which are never freed.
+    std::vector<int> GetNumUsers() const {
+        std::vector<int> num_users;
+        for (const ValueInfo& value : values_) num_users.push_back(value.num_users);
+        return num_users;
+    }
+
+    // Returns the size of inputs freed when node `id` finishes.
+    int64_t Finish(int id, std::vector<int>* num_users) const {
+        int64_t freed = 0;
+        for (int value_id : infos_[id].inputs) {
+            if ((*num_users)[value_id] > 0 && --(*num_users)[value_id] == 0) freed += values_[value_id].bytes;
+        }
+        return freed;
+    }
+
+    // The peak of the memory usage when nodes run one by one in
+    // `chainer_order`.
+    int64_t GetSequentialPeak() const {
+        std::vector<int> num_users = GetNumUsers();
+        int64_t mem = initial_mem_;
+        int64_t peak = mem;
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            mem += output_bytes(i);
+            peak = std::max(peak, mem);
+            mem -= Finish(i, &num_users);
+        }
+        return peak;
+    }
+
+    // Returns the cost of the longest path from each node to the end.
+    std::vector<int64_t> GetBottomLevels() const {
+        std::vector<int64_t> levels(nodes_.size());
+        for (size_t i = nodes_.size(); i > 0; --i) {
+            int64_t level = 0;
+            for (int succ : succs(i - 1)) level = std::max(level, levels[succ]);
+            levels[i - 1] = level + cost(i - 1);
+        }
+        return levels;
+    }
+
+private:
+    struct NodeInfo {
+        std::vector<int> preds;
+        std::vector<int> succs;
+        std::vector<int> inputs;
+        int64_t cost{0};
+        int64_t output_bytes{0};
+    };
+
+    struct ValueInfo {
+        int64_t bytes;
+        int num_users;
+    };
+
+    std::vector<Node*> nodes_;
+    std::vector<NodeInfo> infos_;
+    std::vector<ValueInfo> values_;
+    int64_t initial_mem_{0};
+    int num_unknown_flops_{0};
+};
+
+// Planned execution of each node.
+struct Timeline {
+    std::vector<int> streams;
+    std::vector<int64_t> starts;
+    std::vector<int64_t> finishes;
+};
+
+// Returns the peak of the memory usage of `timeline`. Outputs are
+// allocated when nodes start and inputs are freed when all their users
+// finish.
+int64_t GetPeak(const ScheduledNodes& nodes, const Timeline& timeline) {
+    // Events at the same time are sorted so nodes finish first.
+    std::vector<std::pair<std::pair<int64_t, int>, int>> events;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        events.emplace_back(std::make_pair(timeline.starts[i], 1), i);
+        events.emplace_back(std::make_pair(timeline.finishes[i], 0), i);
+    }
+    std::sort(events.begin(), events.end());
+    std::vector<int> num_users = nodes.GetNumUsers();
+    int64_t mem = nodes.initial_mem();
+    int64_t peak = mem;
+    for (const auto& event : events) {
+        const int id = event.second;
+        if (event.first.second) {
+            mem += nodes.output_bytes(id);
+            peak = std::max(peak, mem);
+        } else {
+            mem -= nodes.Finish(id, &num_users);
+        }
+    }
+    return peak;
+}
+
+StreamStats GetStats(const ScheduledNodes& nodes, const Timeline& timeline) {
+    StreamStats stats{};
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        stats.serial_cost += nodes.cost(i);
+        stats.makespan = std::max(stats.makespan, timeline.finishes[i]);
+        stats.num_waits += nodes.node(i)->chainer_stream_waits().size();
+    }
+    for (int64_t level : nodes.GetBottomLevels()) {
+        stats.critical_path = std::max(stats.critical_path, level);
+    }
+    stats.peak = GetPeak(nodes, timeline);
+    return stats;
+}
+
+class StreamPlanner {
+public:
+    StreamPlanner(const ScheduledNodes& nodes, int num_streams, int64_t memory_limit)
+        : nodes_(nodes), num_streams_(num_streams), memory_limit_(memory_limit), levels_(nodes.GetBottomLevels()) {
+    }
+
+    Timeline Run() {
+        const int num_nodes = nodes_.size();
+        timeline_.streams.assign(num_nodes, -1);
+        timeline_.starts.assign(num_nodes, -1);
+        timeline_.finishes.assign(num_nodes, -1);
+        running_.assign(num_streams_, -1);
+        num_users_ = nodes_.GetNumUsers();
+        mem_ = nodes_.initial_mem();
+
+        std::vector<int> num_preds(num_nodes);
+        for (int i = 0; i < num_nodes; ++i) {
+            num_preds[i] = nodes_.preds(i).size();
+            if (num_preds[i] == 0) AddReady(i);
+        }
+
+        // Finish times and nodes.
+        std::priority_queue<std::pair<int64_t, int>, std::vector<std::pair<int64_t, int>>, std::greater<std::pair<int64_t, int>>> finishes;
+        int64_t now = 0;
+        int num_started = 0;
+        while (num_started < num_nodes) {
+            while (int stream = GetIdleStream()) {
+                const int id = PickReadyNode(finishes.empty());
+                if (id < 0) break;
+                Start(id, stream - 1, now);
+                finishes.emplace(timeline_.finishes[id], id);
+                ++num_started;
+            }
+
+            CHECK(!finishes.empty());
+            now = finishes.top().first;
+            while (!finishes.empty() && finishes.top().first == now) {
+                const int id = finishes.top().second;
+                finishes.pop();
+                running_[timeline_.streams[id]] = -1;
+                mem_ -= nodes_.Finish(id, &num_users_);
+                last_finished_ = id;
+                for (int succ : nodes_.succs(id)) {
+                    if (--num_preds[succ] == 0) AddReady(succ);
+                }
+            }
+        }
+        return timeline_;
+    }
+
+    // Returns nodes in other streams `id` waits for. Waits for nodes
+    // which are known to have finished by earlier waits of the stream
+    // are omitted.
+    std::vector<int> GetWaits(int id, std::vector<std::vector<int64_t>>* waited) const {
+        const int stream = timeline_.streams[id];
+        std::vector<int> waits;
+        for (int wait : waits_.at(id)) {
+            const int other = timeline_.streams[wait];
+            int64_t& last = (*waited)[stream][other];
+            if (timeline_.finishes[wait] <= last) continue;
+            last = timeline_.finishes[wait];
+            waits.push_back(wait);
+        }
+        return waits;
+    }
+
+private:
+    void AddReady(int id) {
+        ready_.emplace(-levels_[id], id);
+    }
+
+    // Returns an idle stream plus one, or zero if all are busy.
+    int GetIdleStream() const {
+        for (int i = 0; i < num_streams_; ++i) {
+            if (running_[i] < 0) return i + 1;
+        }
+        return 0;
+    }
+
+    // Returns the ready node on the longest path which fits in the
+    // memory limit. If no node fits and `force` is true, the one on
+    // the longest path is returned.
+    int PickReadyNode(bool force) {
+        auto picked = std::find_if(ready_.begin(), ready_.end(), [this](const std::pair<int64_t, int>& p) {
+            return mem_ + nodes_.output_bytes(p.second) <= memory_limit_;
+        });
+        if (picked == ready_.end()) {
+            if (!force || ready_.empty()) return -1;
+            picked = ready_.begin();
+        }
+        const int id = picked->second;
+        ready_.erase(picked);
+        return id;
+    }
+
+    void Start(int id, int stream, int64_t now) {
+        // Prefer the stream of the predecessor which finished last so
+        // the node does not wait for it.
+        int64_t last_finish = -1;
+        for (int pred : nodes_.preds(id)) {
+            const int s = timeline_.streams[pred];
+            if (running_[s] < 0 && timeline_.finishes[pred] > last_finish) {
+                last_finish = timeline_.finishes[pred];
+                stream = s;
+            }
+        }
+
+        // The node waits for predecessors in other streams, and for the
+        // node whose finish let it start if it starts later than its
+        // predecessors.
+        std::vector<int> waits;
+        int64_t ready_time = 0;
+        for (int pred : nodes_.preds(id)) {
+            ready_time = std::max(ready_time, timeline_.finishes[pred]);
+            if (timeline_.streams[pred] != stream) waits.push_back(pred);
+        }
+        if (ready_time < now && last_finished_ >= 0 && timeline_.streams[last_finished_] != stream) {
+            waits.push_back(last_finished_);
+        }
+        waits_.emplace(id, waits);
+
+        timeline_.streams[id] = stream;
+        timeline_.starts[id] = now;
+        timeline_.finishes[id] = now + nodes_.cost(id);
+        running_[stream] = id;
+        mem_ += nodes_.output_bytes(id);
+    }
+
+private:
+    const ScheduledNodes& nodes_;
+    const int num_streams_;
+    const int64_t memory_limit_;
+    const std::vector<int64_t> levels_;
+
+    Timeline timeline_;
+    // Ready nodes sorted by the negated bottom level.
+    std::set<std::pair<int64_t, int>> ready_;
+    // The running node of each stream.
+    std::vector<int> running_;
+    std::vector<int> num_users_;
+    std::map<int, std::vector<int>> waits_;
+    int64_t mem_{0};
+    int last_finished_{-1};
+};
+
+}  // namespace
+
+StreamStats AssignStreams(Graph* graph, int num_streams, int peak_increase_percent) {
+    CHECK_LT(0, num_streams);
+    ScheduledNodes nodes(*graph);
+    const int64_t sequential_peak = nodes.GetSequentialPeak();
+    const int64_t memory_limit = sequential_peak + sequential_peak * peak_increase_percent / 100;
+    StreamPlanner planner(nodes, num_streams, memory_limit);
+    const Timeline timeline = planner.Run();
+
+    // Reorder nodes by their start times with the orders of the graph.
+    std::vector<int64_t> orders;
+    std::vector<int> ids;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        orders.push_back(nodes.node(i)->chainer_order());
+        ids.push_back(i);
+    }
+    std::stable_sort(ids.begin(), ids.end(), [&timeline](int a, int b) { return timeline.starts[a] < timeline.starts[b]; });
+    // Nodes are visited in the new order and the finish time of the
+    // last node each stream waited for in each other stream is tracked.
+    std::vector<std::vector<int64_t>> waited(num_streams, std::vector<int64_t>(num_streams, -1));
+    for (size_t i = 0; i < ids.size(); ++i) {
+        Node* node = nodes.node(ids[i]);
+        node->set_chainer_order(orders[i]);
+        node->set_chainer_stream(timeline.streams[ids[i]]);
+    }
+    for (int id : ids) {
+        std::vector<int64_t> waits;
+        for (int wait : planner.GetWaits(id, &waited)) waits.push_back(nodes.node(wait)->chainer_order());
+        nodes.node(id)->set_chainer_stream_waits(waits);
+    }
+
+    StreamStats stats = GetStats(nodes, timeline);
+    CLOG() << "Streams: " << num_streams << " streams for " << nodes.size() << " nodes in " << graph->name()
+           << " sequential_peak=" << sequential_peak << " peak=" << stats.peak << " waits=" << stats.num_waits
+           << " makespan=" << stats.makespan << "/" << stats.serial_cost << std::endl;
+    return stats;
+}
+
+StreamStats SimulateStreams(const Graph& graph, int num_cores) {
+    CHECK_LT(0, num_cores);
+    ScheduledNodes nodes(graph);
+    std::map<int64_t, int> ids;
+    for (size_t i = 0; i < nodes.size(); ++i) ids.emplace(nodes.node(i)->chainer_order(), i);
+
+    // Nodes are visited in `chainer_order` and each of them starts when
+    // its core becomes idle and its predecessors and waits finish.
+    Timeline timeline{std::vector<int>(nodes.size()), std::vector<int64_t>(nodes.size()), std::vector<int64_t>(nodes.size())};
+    std::vector<int64_t> idle_times(num_cores);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const Node& node = *nodes.node(i);
+        const int core = std::max<int>(node.chainer_stream(), 0) % num_cores;
+        int64_t start = idle_times[core];
+        for (int pred : nodes.preds(i)) start = std::max(start, timeline.finishes[pred]);
+        for (int64_t order : node.chainer_stream_waits()) {
+            auto found = ids.find(order);
+            CHECK(found != ids.end()) << "Unknown wait " << order << " in " << node.ToString();
+            start = std::max(start, timeline.finishes[found->second]);
+        }
+        timeline.streams[i] = core;
+        timeline.starts[i] = start;
+        timeline.finishes[i] = start + nodes.cost(i);
+        idle_times[core] = timeline.finishes[i];
+    }
+    return GetStats(nodes, timeline);
+}
+
+void ShowStreamStats(const Graph& graph, int num_cores) {
+    StreamStats stats = SimulateStreams(graph, num_cores);
+    std::cerr << "Simulated streams on " << num_cores << " cores: makespan=" << stats.makespan << " serial=" << stats.serial_cost
+              << " critical_path=" << stats.critical_path << " speedup=" << static_cast<double>(stats.serial_cost) / stats.makespan
+              << " waits=" << stats.num_waits << " peak=" << stats.peak / 1000 / 1000 << "MB" << std::endl;
+}
+
+}  // namespace chainer_compiler
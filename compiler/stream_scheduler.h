@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace chainer_compiler {
+
+class Graph;
+
+// The execution of nodes on multiple streams estimated by costs from
+// CalculateFlops and memory usage like SimulateMemoryUsage.
+struct StreamStats {
+    // The makespan on a single stream, i.e., the sum of costs.
+    int64_t serial_cost;
+    // The cost of the longest chain of dependent nodes.
+    int64_t critical_path;
+    int64_t makespan;
+    // The number of waits for nodes in other streams.
+    int num_waits;
+    int64_t peak;
+};
+
+// Partitions scheduled nodes of `graph` into `num_streams` streams by
+// list scheduling, which starts ready nodes on the longest remaining
+// path first. A node is not started while it would make the memory
+// usage exceed the peak of the original order increased by
+// `peak_increase_percent` unless no other node is running. Nodes are
+// reordered by their planned start times and `chainer_stream_waits`
+// of each node lists `chainer_order` of nodes in other streams it
+// waits for, which include ones delayed for memory. Nodes in
+// subgraphs are not assigned.
+StreamStats AssignStreams(Graph* graph, int num_streams, int peak_increase_percent);
+
+// Predicts the execution of scheduled nodes of `graph` on `num_cores`
+// cores. Each core runs nodes of streams assigned to it in
+// `chainer_order`, and nodes without streams run on the first core.
+StreamStats SimulateStreams(const Graph& graph, int num_cores);
+
+void ShowStreamStats(const Graph& graph, int num_cores);
+
+}  // namespace chainer_compiler
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <compiler/graph.h>
+#include <compiler/node.h>
+#include <compiler/scheduler.h>
+#include <compiler/stream_scheduler.h>
+#include <compiler/type.h>
+
+namespace chainer_compiler {
+namespace {
+
+// Two branches which allocate 4000 bytes by Relu and reduce them by
+// Identity, and Add of them.
+class TwoBranches {
+public:
+    TwoBranches() : graph_("test") {
+        const Type small(Dtype::kFloat32, {1});
+        const Type large(Dtype::kFloat32, {1000});
+        Value* x = graph_.AddInputValue("x", small);
+        Value* out = graph_.AddOutputValue("out", small);
+        Value* a = graph_.AddValue("a", large);
+        Value* b = graph_.AddValue("b", large);
+        Value* a2 = graph_.AddValue("a2", small);
+        Value* b2 = graph_.AddValue("b2", small);
+        a1_ = graph_.AddNode(Node::kRelu, {x}, {a});
+        b1_ = graph_.AddNode(Node::kRelu, {x}, {b});
+        graph_.AddNode(Node::kIdentity, {a}, {a2});
+        graph_.AddNode(Node::kIdentity, {b}, {b2});
+        add_ = graph_.AddNode(Node::kAdd, {a2, b2}, {out});
+        ScheduleComputation(graph_, 0);
+    }
+
+    Graph graph_;
+    Node* a1_;
+    Node* b1_;
+    Node* add_;
+};
+
+TEST(StreamSchedulerTest, Parallel) {
+    TwoBranches t;
+    // Allow both 4000 bytes to be alive.
+    StreamStats stats = AssignStreams(&t.graph_, 2, 100);
+    // Relu costs 1001, Identity 1, and Add 2.
+    EXPECT_EQ(2006, stats.serial_cost);
+    EXPECT_EQ(1004, stats.critical_path);
+    EXPECT_EQ(1004, stats.makespan);
+    EXPECT_EQ(8008, stats.peak);
+    EXPECT_NE(t.a1_->chainer_stream(), t.b1_->chainer_stream());
+    // Add waits for the branch in the other stream.
+    EXPECT_EQ(1, stats.num_waits);
+    EXPECT_EQ(1, t.add_->chainer_stream_waits().size());
+
+    const std::vector<const Node*> nodes = t.graph_.GetComputationSequence();
+    ASSERT_EQ(5, nodes.size());
+    EXPECT_EQ(t.add_, nodes.back());
+
+    EXPECT_EQ(1004, SimulateStreams(t.graph_, 2).makespan);
+    EXPECT_EQ(2006, SimulateStreams(t.graph_, 1).makespan);
+}
+
+TEST(StreamSchedulerTest, MemoryLimit) {
+    TwoBranches t;
+    // The sequential order has only one of 4000 bytes at once.
+    StreamStats stats = AssignStreams(&t.graph_, 2, 0);
+    EXPECT_EQ(2006, stats.makespan);
+    EXPECT_GE(4008, stats.peak);
+    EXPECT_EQ(2006, SimulateStreams(t.graph_, 2).makespan);
+}
+
+}  // namespace
+}  // namespace chainer_compiler
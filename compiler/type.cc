@@ -177,6 +177,55 @@ bool Type::HasKnownShape() const {
     return true;
 }
 
+bool Type::Merge(const Type& type) {
+    if (kind_ != type.kind_) {
+        // A default constructed type can be refined to any kind.
+        if (kind_ != Kind::kTensor || dtype_ != Dtype::kUnknown || has_known_shape_) {
+            return false;
+        }
+        kind_ = type.kind_;
+        dtype_ = type.dtype_;
+        dims_ = type.dims_;
+        dim_params_ = type.dim_params_;
+        dim_denotations_ = type.dim_denotations_;
+        sequence_.reset(type.sequence_ ? new Type(*type.sequence_) : nullptr);
+        has_known_shape_ = type.has_known_shape_;
+        return true;
+    }
+
+    if (kind_ == Kind::kSequence) {
+        if (!type.sequence_) return false;
+        if (!sequence_) {
+            sequence_.reset(new Type(*type.sequence_));
+            return true;
+        }
+        return sequence_->Merge(*type.sequence_);
+    }
+    if (kind_ != Kind::kTensor) return false;
+
+    bool updated = false;
+    if (dtype_ == Dtype::kUnknown && type.dtype_ != Dtype::kUnknown) {
+        dtype_ = type.dtype_;
+        updated = true;
+    }
+    if (!type.has_known_shape_) return updated;
+    if (!has_known_shape_) {
+        dims_ = type.dims_;
+        dim_params_ = type.dim_params_;
+        dim_denotations_ = type.dim_denotations_;
+        has_known_shape_ = true;
+        return true;
+    }
+    if (dims_.size() != type.dims_.size()) return updated;
+    for (size_t i = 0; i < dims_.size(); ++i) {
+        if (dims_[i] < 0 && type.dims_[i] >= 0) {
+            dims_[i] = type.dims_[i];
+            updated = true;
+        }
+    }
+    return updated;
+}
+
 std::ostream& operator<<(std::ostream& os, const Type::Kind& kind) {
     static const char* kNames[] = {"Tensor", "Sequence", "Map", "Opaque"};
     int k = static_cast<int>(kind);
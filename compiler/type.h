@@ -60,6 +60,16 @@ public:
 
     bool HasKnownShape() const;
 
+    // Returns true if this is a tensor whose number of dimensions is
+    // known. Some of its dimensions may be still unknown.
+    bool HasKnownRank() const {
+        return kind_ == Kind::kTensor && has_known_shape_;
+    }
+
+    // Fills unknown parts of this type by `type`. Known dtype and
+    // dimensions are never changed. Returns true if this is updated.
+    bool Merge(const Type& type);
+
 private:
     Kind kind_{Kind::kTensor};
     Dtype dtype_{Dtype::kUnknown};
@@ -53,8 +53,8 @@ void StripONNXModel(onnx::ModelProto* model) {
     StripONNXGraph(model->mutable_graph());
 }
 
-std::string CleanseIdent(const std::string& s) {
-    std::string o;
+std::string CleanseIdent(const std::string& s, const char* prefix) {
+    std::string o = prefix;
     std::locale loc;
     for (char c : s) {
         if (std::isalnum(c, loc)) {
@@ -12,6 +12,8 @@ void StripONNXGraph(onnx::GraphProto* graph);
 
 void StripONNXModel(onnx::ModelProto* model);
 
-std::string CleanseIdent(const std::string& s);
+// Returns `prefix` followed by `s` with non-alphanumeric characters
+// replaced by underscores.
+std::string CleanseIdent(const std::string& s, const char* prefix = "");
 
 }  // namespace chainer_compiler
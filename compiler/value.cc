@@ -91,6 +91,9 @@ int64_t Value::GetNBytes() const {
         retained = {node.input(0), node.output(0)};
     } else if (node.op_type() == Node::kAveragePool) {
         retained = {node.input(0), node.output(0)};
+    } else if (node.op_type() == Node::kChainerPackConvWeight || node.op_type() == Node::kChainerPackMatrixWeight) {
+        // Packed weights are cached like parameters.
+        return 0;
     } else {
         return -1;
     }
@@ -116,6 +116,10 @@ def main():
                         help='Compile the model')
     parser.add_argument('--computation_order', type=str, default=None,
                         help='Computation order in backpropagation')
+    parser.add_argument('--computation_order_memory_limit', type=int,
+                        default=None,
+                        help='Peak memory limit in MB for '
+                        '--computation_order=auto')
 
     parser.add_argument('--model',
                         '-m', choices=model_cfgs.keys(), default='resnet50',
@@ -203,6 +207,9 @@ def main():
         compiler_kwargs = {}
         if args.compiler_log:
             compiler_kwargs['compiler_log'] = True
+        if args.computation_order_memory_limit is not None:
+            compiler_kwargs['computation_order_memory_limit'] = (
+                args.computation_order_memory_limit)
         runtime_kwargs = {}
         if args.trace:
             runtime_kwargs['trace'] = True
@@ -23,6 +23,7 @@
 #include <runtime/chrome_tracing.h>
 #include <runtime/chxvm.h>
 #include <runtime/chxvm.pb.h>
+#include <runtime/chxvm_state.h>
 #include <runtime/chxvm_var.h>
 #include <tools/util.h>
 
@@ -542,6 +543,8 @@ struct menoh_model {
     std::unique_ptr<chainer_compiler::runtime::ChxVM> chxvm;
     chainer_compiler::runtime::ChxVMOptions chxvm_options;
     std::vector<std::shared_ptr<void>> buffer_holder;
+    // Reused by all runs. `inputs` are bound to it before each run.
+    std::unique_ptr<chainer_compiler::runtime::ChxVMState> state;
 };
 void menoh_delete_model(menoh_model_handle model) {
     delete model;
@@ -643,6 +646,8 @@ menoh_error_code menoh_build_model(
             chxvm_opts.check_nans = value_or(j, "check_nans", false);
             chxvm_opts.check_infs = value_or(j, "check_infs", false);
 
+            std::unique_ptr<chainer_compiler::runtime::ChxVMState> state(chxvm->Prepare(inputs, chxvm_opts));
+
             std::unordered_map<std::string, menoh_impl::array_profile> variable_profiles(
                     builder->input_profile_table.begin(), builder->input_profile_table.end());
             variable_profiles.insert(builder->output_profile_table.begin(), builder->output_profile_table.end());
@@ -652,7 +657,8 @@ menoh_error_code menoh_build_model(
                                                                           std::move(outputs),
                                                                           std::move(chxvm),
                                                                           chxvm_opts,
-                                                                          std::move(buffer_holder)})
+                                                                          std::move(buffer_holder),
+                                                                          std::move(state)})
                                         .release();
         }
         return menoh_error_code_success;
@@ -717,8 +723,9 @@ menoh_error_code menoh_model_run(menoh_model_handle model) {
         chainerx::ContextScope(*(model->context));
         {
             chainerx::NoBackpropModeScope scope;
-            auto outputs = model->chxvm->Run(model->inputs, model->chxvm_options);
-            for (auto output : outputs) {
+            model->chxvm->BindInputs(model->state.get(), model->inputs);
+            model->chxvm->Run(model->state.get());
+            for (const auto& output : model->state->GetOutputs()) {
                 auto found = model->outputs.find(output.first);
                 assert(found != model->outputs.end() && "output buffer not found");
                 auto const& array = output.second->GetArray();
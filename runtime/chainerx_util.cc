@@ -199,6 +199,13 @@ bool IsFloat(chainerx::Dtype dtype) {
     return chainerx::GetKind(dtype) == chainerx::DtypeKind::kFloat;
 }
 
+bool IsAnyBackpropRequired(std::initializer_list<absl::optional<chainerx::Array>> arrays) {
+    for (const absl::optional<chainerx::Array>& a : arrays) {
+        if (a.has_value() && a->IsBackpropRequired(chainerx::AnyGraph{})) return true;
+    }
+    return false;
+}
+
 void BlitArray(const chainerx::Array& src, const chainerx::Array& dst) {
     src.device().backend().CallKernel<chainerx::CopyKernel>(src, dst);
 }
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <initializer_list>
 #include <map>
 #include <string>
 
+#include <absl/types/optional.h>
+
 #include <chainerx/array.h>
 
 namespace chainer_compiler {
@@ -41,6 +44,11 @@ Int64StackVector ComplementPad(const Int64StackVector& pads, const chainerx::Arr
 
 bool IsFloat(chainerx::Dtype dtype);
 
+// Returns true if any of `arrays` requires backprop for any graph.
+// Outputs of kernels called directly are not connected to graphs, so
+// fast paths which call them must not be used for such arrays.
+bool IsAnyBackpropRequired(std::initializer_list<absl::optional<chainerx::Array>> arrays);
+
 void BlitArray(const chainerx::Array& src, const chainerx::Array& dst);
 
 chainerx::Array NumpyMatMul(const chainerx::Array& a, const chainerx::Array& b);
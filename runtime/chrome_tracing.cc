@@ -1,70 +1,236 @@
 #include "chrome_tracing.h"
 
 #include <cstdint>
-#include <fstream>
+#include <functional>
+#include <iomanip>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <common/log.h>
+#include <common/strutil.h>
 
 namespace chainer_compiler {
 namespace runtime {
 
-ChromeTracingEmitter::ChromeTracingEmitter() : base_time_(std::chrono::system_clock::now()) {
+namespace {
+
+std::atomic<uint64_t> g_next_emitter_id{1};
+
+// The buffer of the emitter which was used by this thread last time.
+thread_local uint64_t g_cached_emitter_id = 0;
+thread_local void* g_cached_buffer = nullptr;
+
+int64_t GetThreadId() {
+#ifdef __linux__
+    return syscall(SYS_gettid);
+#else
+    return std::hash<std::thread::id>()(std::this_thread::get_id());
+#endif
 }
 
-void ChromeTracingEmitter::AddEvent(Event* event) {
-    events_.emplace_back(event);
+int RoundUpToPowerOfTwo(int n) {
+    int r = 1;
+    while (r < n) {
+        r *= 2;
+    }
+    return r;
 }
 
-ChromeTracingEmitter::Event::Event(const std::string& c, const std::string& n, int p, int64_t f)
-    : category(c), name(n), pc(p), flops(f), start_time(std::chrono::system_clock::now()) {
+int64_t InNsecs(ChromeTracingEmitter::Clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
 }
 
-void ChromeTracingEmitter::Event::Finish() {
-    end_time = std::chrono::system_clock::now();
+}  // namespace
+
+ChromeTracingEmitter::ChromeTracingEmitter(int buffer_size) : id_(g_next_emitter_id++), buffer_size_(RoundUpToPowerOfTwo(buffer_size)), base_time_(Clock::now()) {
+    CHECK_LT(0, buffer_size);
 }
 
-ChromeTracingEmitter::ScopedEvent::ScopedEvent(
-        ChromeTracingEmitter* chrome_tracing, const std::string& category, const std::string& name, int pc, int64_t flops)
-    : event_(nullptr) {
-    if (chrome_tracing) {
-        event_ = new ChromeTracingEmitter::Event(category, name, pc, flops);
-        chrome_tracing->AddEvent(event_);
+ChromeTracingEmitter::~ChromeTracingEmitter() {
+    if (flusher_.joinable()) {
+        Emit(stream_filename_);
     }
 }
 
-ChromeTracingEmitter::ScopedEvent::~ScopedEvent() {
-    if (event_) {
-        event_->Finish();
+int ChromeTracingEmitter::Intern(const std::string& name) {
+    std::lock_guard<std::mutex> lock(names_mu_);
+    auto p = name_ids_.emplace(name, static_cast<int>(names_.size()));
+    if (p.second) {
+        names_.push_back(EscapeJSON(name));
     }
+    return p.first->second;
 }
 
-void ChromeTracingEmitter::Emit(const std::string& output_filename) const {
-    std::ofstream ofs(output_filename);
-    ofs << "[\n";
-    bool is_first = true;
-    for (const std::unique_ptr<Event>& event : events_) {
-        int64_t ts = std::chrono::duration_cast<std::chrono::microseconds>(event->start_time - base_time_).count();
-        int64_t dur = std::chrono::duration_cast<std::chrono::microseconds>(event->end_time - event->start_time).count();
+ChromeTracingEmitter::ThreadBuffer* ChromeTracingEmitter::GetThreadBuffer() {
+    if (g_cached_emitter_id == id_) {
+        return static_cast<ThreadBuffer*>(g_cached_buffer);
+    }
+
+    const int64_t tid = GetThreadId();
+    std::lock_guard<std::mutex> lock(buffers_mu_);
+    ThreadBuffer* buffer = nullptr;
+    for (const std::unique_ptr<ThreadBuffer>& b : buffers_) {
+        if (b->tid == tid) {
+            buffer = b.get();
+        }
+    }
+    if (!buffer) {
+        buffers_.emplace_back(new ThreadBuffer());
+        buffer = buffers_.back().get();
+        buffer->tid = tid;
+        buffer->events.reset(new Event[buffer_size_]);
+    }
+    g_cached_emitter_id = id_;
+    g_cached_buffer = buffer;
+    return buffer;
+}
+
+void ChromeTracingEmitter::AddEvent(const Event& event) {
+    ThreadBuffer* buffer = GetThreadBuffer();
+    const int64_t head = buffer->head.load(std::memory_order_relaxed);
+    const int64_t tail = buffer->tail.load(std::memory_order_acquire);
+    if (head - tail >= buffer_size_) {
+        buffer->num_dropped.fetch_add(1, std::memory_order_relaxed);
+        if (!stream_filename_.empty()) {
+            return;
+        }
+        // Nobody consumes events until `Emit` so the oldest one can
+        // be overwritten.
+        buffer->tail.store(tail + 1, std::memory_order_relaxed);
+    }
+    buffer->events[head & (buffer_size_ - 1)] = event;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void ChromeTracingEmitter::AddCompleteEvent(
+        int category, int name, Clock::time_point start_time, Clock::time_point end_time, int pc, int64_t flops) {
+    AddEvent(Event{InNsecs(start_time - base_time_), InNsecs(end_time - start_time), flops, category, name, pc, 'X'});
+}
+
+void ChromeTracingEmitter::AddCounterEvent(int name, int64_t value) {
+    AddEvent(Event{InNsecs(Clock::now() - base_time_), value, 0, -1, name, -1, 'C'});
+}
 
-        if (!is_first) {
-            ofs << ",\n";
+void ChromeTracingEmitter::WriteEvents(std::ostream& os) {
+    std::lock_guard<std::mutex> names_lock(names_mu_);
+    std::lock_guard<std::mutex> buffers_lock(buffers_mu_);
+    os << std::fixed << std::setprecision(3);
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers_) {
+        const int64_t head = buffer->head.load(std::memory_order_acquire);
+        for (int64_t i = buffer->tail.load(std::memory_order_relaxed); i < head; ++i) {
+            const Event& event = buffer->events[i & (buffer_size_ - 1)];
+            if (!is_first_event_) {
+                os << ",\n";
+            }
+            is_first_event_ = false;
+            os << "{";
+            if (event.category >= 0) {
+                os << "\"cat\":\"" << names_[event.category] << "\",";
+            }
+            os << "\"name\":\"" << names_[event.name] << "\",";
+            os << "\"ph\":\"" << event.phase << "\",";
+            os << "\"ts\":" << event.start_ns * 1e-3 << ",";
+            if (event.phase == 'X') {
+                os << "\"dur\":" << event.value * 1e-3 << ",";
+            }
+            os << "\"pid\":1,";
+            os << "\"tid\":" << buffer->tid;
+            if (event.phase == 'C') {
+                os << ",\"args\":{\"value\":" << event.value << "}";
+            } else if (event.pc >= 0 || event.flops > 0) {
+                os << ",\"args\":{";
+                if (event.pc >= 0) {
+                    os << "\"pc\":" << event.pc;
+                }
+                if (event.flops > 0) {
+                    os << (event.pc >= 0 ? "," : "") << "\"flops\":" << event.flops;
+                }
+                os << "}";
+            }
+            os << "}";
         }
-        is_first = false;
-        ofs << "{";
-        ofs << "\"cat\":\"" << event->category << "\",";
-        ofs << "\"name\":\"" << event->name << "\",";
-        ofs << "\"ts\":" << ts << ",";
-        ofs << "\"dur\":" << dur << ",";
-        ofs << "\"tid\":1,";
-        ofs << "\"pid\":1,";
-        if (event->pc >= 0) {
-            ofs << "\"args\":{\"pc\":" << event->pc << "},";
+        buffer->tail.store(head, std::memory_order_release);
+    }
+}
+
+void ChromeTracingEmitter::StartStreaming(const std::string& output_filename, int interval_ms) {
+    CHECK(stream_filename_.empty()) << "Already streaming to " << stream_filename_;
+    CHECK(buffers_.empty()) << "Streaming must start before events are added";
+    stream_.open(output_filename);
+    CHECK(stream_) << "Failed to open " << output_filename;
+    stream_ << "[\n";
+    stream_filename_ = output_filename;
+    flusher_ = std::thread([this, interval_ms]() { FlushMain(interval_ms); });
+}
+
+void ChromeTracingEmitter::FlushMain(int interval_ms) {
+    std::unique_lock<std::mutex> lock(flusher_mu_);
+    while (!done_) {
+        flusher_cond_.wait_for(lock, std::chrono::milliseconds(interval_ms), [this]() { return done_; });
+        WriteEvents(stream_);
+        stream_.flush();
+    }
+}
+
+void ChromeTracingEmitter::Emit(const std::string& output_filename) {
+    if (!stream_filename_.empty()) {
+        CHECK_EQ(stream_filename_, output_filename);
+        if (!flusher_.joinable()) {
+            return;
         }
-        if (event->flops > 0) {
-            ofs << "\"args\":{\"flops\":" << event->flops << "},";
+        {
+            std::lock_guard<std::mutex> lock(flusher_mu_);
+            done_ = true;
         }
-        ofs << "\"ph\":\"X\"";
-        ofs << "}";
+        flusher_cond_.notify_all();
+        flusher_.join();
+        WriteEvents(stream_);
+        stream_ << "\n]\n";
+        stream_.close();
+        return;
+    }
+
+    std::ofstream ofs(output_filename);
+    CHECK(ofs) << "Failed to open " << output_filename;
+    ofs << "[\n";
+    is_first_event_ = true;
+    WriteEvents(ofs);
+    ofs << "\n]\n";
+}
+
+int64_t ChromeTracingEmitter::num_dropped_events() const {
+    std::lock_guard<std::mutex> lock(buffers_mu_);
+    int64_t num_dropped = 0;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers_) {
+        num_dropped += buffer->num_dropped.load(std::memory_order_relaxed);
+    }
+    return num_dropped;
+}
+
+ChromeTracingEmitter::ScopedEvent::ScopedEvent(
+        ChromeTracingEmitter* chrome_tracing, const std::string& category, const std::string& name, int pc, int64_t flops)
+    : chrome_tracing_(chrome_tracing), category_(-1), name_(-1), pc_(pc), flops_(flops) {
+    if (chrome_tracing_) {
+        category_ = chrome_tracing_->Intern(category);
+        name_ = chrome_tracing_->Intern(name);
+        start_time_ = Clock::now();
+    }
+}
+
+ChromeTracingEmitter::ScopedEvent::ScopedEvent(ChromeTracingEmitter* chrome_tracing, int category, int name, int pc, int64_t flops)
+    : chrome_tracing_(chrome_tracing), category_(category), name_(name), pc_(pc), flops_(flops) {
+    if (chrome_tracing_) {
+        start_time_ = Clock::now();
+    }
+}
+
+ChromeTracingEmitter::ScopedEvent::~ScopedEvent() {
+    if (chrome_tracing_) {
+        chrome_tracing_->AddCompleteEvent(category_, name_, start_time_, Clock::now(), pc_, flops_);
     }
-    ofs << "]\n";
 }
 
 }  // namespace runtime
@@ -2,47 +2,132 @@
 
 #include <stdint.h>
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace chainer_compiler {
 namespace runtime {
 
+// Records events in the format of chrome://tracing.
+//
+// Each thread which adds events has its own ring buffer of a fixed
+// size so adding an event takes neither a lock nor an allocation.
+// Names of events are interned to integer IDs. When streaming is
+// enabled, a background thread periodically writes buffered events to
+// the output file, so arbitrarily long runs can be traced with bounded
+// memory. Otherwise, the oldest events are overwritten when a buffer
+// is full and `Emit` writes the remaining events.
 class ChromeTracingEmitter {
 public:
-    struct Event {
-        Event(const std::string& c, const std::string& n, int p, int64_t f);
-        void Finish();
-        std::string category;
-        std::string name;
-        int pc;
-        int64_t flops;
-        std::chrono::system_clock::time_point start_time;
-        std::chrono::system_clock::time_point end_time;
-    };
+    typedef std::chrono::steady_clock Clock;
 
     class ScopedEvent {
     public:
         explicit ScopedEvent(
                 ChromeTracingEmitter* chrome_tracing, const std::string& category, const std::string& name, int pc = -1, int64_t flops = 0);
+        // Takes IDs returned by `Intern`, which is faster.
+        ScopedEvent(ChromeTracingEmitter* chrome_tracing, int category, int name, int pc = -1, int64_t flops = 0);
         ~ScopedEvent();
 
     private:
-        Event* event_;
+        ChromeTracingEmitter* chrome_tracing_;
+        int category_;
+        int name_;
+        int pc_;
+        int64_t flops_;
+        Clock::time_point start_time_;
     };
 
-    ChromeTracingEmitter();
+    // `buffer_size` is the number of events kept for each thread,
+    // which is rounded up to a power of two.
+    explicit ChromeTracingEmitter(int buffer_size = 1 << 16);
+    ~ChromeTracingEmitter();
+
+    // A unique ID of this emitter, which is never reused even after
+    // the emitter is destroyed. Can be used to cache interned IDs.
+    uint64_t id() const {
+        return id_;
+    }
+
+    // Returns the ID of `name`. Thread-safe.
+    int Intern(const std::string& name);
 
-    // Takes the ownership of `event`.
-    void AddEvent(Event* event);
+    void AddCompleteEvent(int category, int name, Clock::time_point start_time, Clock::time_point end_time, int pc = -1, int64_t flops = 0);
 
-    void Emit(const std::string& output_filename) const;
+    // Records a value such as memory usage, which is shown as a graph.
+    void AddCounterEvent(int name, int64_t value);
+
+    // Starts writing events to `output_filename` every `interval_ms`.
+    // Must be called before any event is added. Events which do not
+    // fit in the buffer of a thread between two flushes are dropped.
+    void StartStreaming(const std::string& output_filename, int interval_ms = 1000);
+
+    // Writes all events to `output_filename`. When streaming, this
+    // writes the remaining events and closes the stream, and
+    // `output_filename` must be the one passed to `StartStreaming`.
+    // Must not be called while other threads are adding events.
+    void Emit(const std::string& output_filename);
+
+    int64_t num_dropped_events() const;
 
 private:
-    std::vector<std::unique_ptr<Event>> events_;
-    std::chrono::system_clock::time_point base_time_;
+    ChromeTracingEmitter(const ChromeTracingEmitter&) = delete;
+    ChromeTracingEmitter& operator=(const ChromeTracingEmitter&) = delete;
+
+    struct Event {
+        int64_t start_ns;
+        // The duration for complete events and the value for counters.
+        int64_t value;
+        int64_t flops;
+        int32_t category;
+        int32_t name;
+        int32_t pc;
+        char phase;
+    };
+
+    // A single-producer single-consumer ring buffer. `head` and `tail`
+    // are the total numbers of produced and consumed events.
+    struct ThreadBuffer {
+        int64_t tid;
+        std::unique_ptr<Event[]> events;
+        std::atomic<int64_t> head{0};
+        std::atomic<int64_t> tail{0};
+        std::atomic<int64_t> num_dropped{0};
+    };
+
+    ThreadBuffer* GetThreadBuffer();
+    void AddEvent(const Event& event);
+    void WriteEvents(std::ostream& os);
+    void FlushMain(int interval_ms);
+
+    const uint64_t id_;
+    const int buffer_size_;
+    const Clock::time_point base_time_;
+
+    std::mutex names_mu_;
+    std::map<std::string, int> name_ids_;
+    std::deque<std::string> names_;
+
+    mutable std::mutex buffers_mu_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+
+    // Set only when streaming.
+    std::string stream_filename_;
+    std::ofstream stream_;
+    bool is_first_event_{true};
+    std::thread flusher_;
+    std::mutex flusher_mu_;
+    std::condition_variable flusher_cond_;
+    bool done_{false};
 };
 
 }  // namespace runtime
@@ -0,0 +1,98 @@
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <runtime/chrome_tracing.h>
+
+namespace chainer_compiler {
+namespace runtime {
+namespace {
+
+std::string GetTempFilename(const std::string& basename) {
+    const char* tmpdir = std::getenv("TMPDIR");
+    return std::string(tmpdir ? tmpdir : "/tmp") + "/" + basename;
+}
+
+std::string ReadFile(const std::string& filename) {
+    std::ifstream ifs(filename);
+    std::ostringstream oss;
+    oss << ifs.rdbuf();
+    return oss.str();
+}
+
+int CountOccurrences(const std::string& str, const std::string& pattern) {
+    int count = 0;
+    for (size_t pos = str.find(pattern); pos != std::string::npos; pos = str.find(pattern, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+TEST(ChromeTracingTest, Emit) {
+    ChromeTracingEmitter chrome_tracing;
+    {
+        ChromeTracingEmitter::ScopedEvent se(&chrome_tracing, "Test", "Foo\"", 3, 42);
+    }
+    chrome_tracing.AddCounterEvent(chrome_tracing.Intern("Memory"), 1000);
+
+    const std::string filename = GetTempFilename("chrome_tracing_test_emit.json");
+    chrome_tracing.Emit(filename);
+    const std::string json = ReadFile(filename);
+    EXPECT_EQ('[', json[0]);
+    EXPECT_NE(std::string::npos, json.find("\"cat\":\"Test\",\"name\":\"Foo\\\"\",\"ph\":\"X\""));
+    EXPECT_NE(std::string::npos, json.find("\"args\":{\"pc\":3,\"flops\":42}"));
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"Memory\",\"ph\":\"C\""));
+    EXPECT_NE(std::string::npos, json.find("\"args\":{\"value\":1000}"));
+    EXPECT_EQ(0, chrome_tracing.num_dropped_events());
+}
+
+TEST(ChromeTracingTest, RingBuffer) {
+    ChromeTracingEmitter chrome_tracing(4);
+    const int name = chrome_tracing.Intern("Counter");
+    for (int i = 0; i < 10; ++i) {
+        chrome_tracing.AddCounterEvent(name, i);
+    }
+    EXPECT_EQ(6, chrome_tracing.num_dropped_events());
+
+    const std::string filename = GetTempFilename("chrome_tracing_test_ring.json");
+    chrome_tracing.Emit(filename);
+    const std::string json = ReadFile(filename);
+    // Only the latest events are kept.
+    EXPECT_EQ(4, CountOccurrences(json, "\"ph\":\"C\""));
+    EXPECT_EQ(std::string::npos, json.find("\"value\":5}"));
+    EXPECT_NE(std::string::npos, json.find("\"value\":6}"));
+}
+
+TEST(ChromeTracingTest, StreamFromThreads) {
+    const std::string filename = GetTempFilename("chrome_tracing_test_stream.json");
+    ChromeTracingEmitter chrome_tracing;
+    chrome_tracing.StartStreaming(filename, 1);
+    const int category = chrome_tracing.Intern("Test");
+    const int name = chrome_tracing.Intern("Event");
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&chrome_tracing, category, name]() {
+            for (int i = 0; i < 1000; ++i) {
+                ChromeTracingEmitter::ScopedEvent se(&chrome_tracing, category, name);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    chrome_tracing.Emit(filename);
+
+    const std::string json = ReadFile(filename);
+    EXPECT_EQ(4000, CountOccurrences(json, "\"name\":\"Event\"") + chrome_tracing.num_dropped_events());
+    EXPECT_EQ("]\n", json.substr(json.size() - 2));
+}
+
+}  // namespace
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -1,6 +1,11 @@
 #include "runtime/chxvm.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <iomanip>
+#include <mutex>
 #include <numeric>
 #include <sstream>
 
@@ -9,15 +14,21 @@
 #endif  // CHAINER_COMPILER_ENABLE_NVTX
 
 #include <chainerx/array.h>
+#include <chainerx/backprop_mode.h>
+#include <chainerx/context.h>
+#include <chainerx/device.h>
 
 #include <common/log.h>
 #include <common/strutil.h>
 #include <runtime/chrome_tracing.h>
 #include <runtime/chxvm.pb.h>
+#include <runtime/chxvm_dataflow.h>
 #include <runtime/chxvm_op.h>
+#include <runtime/chxvm_profiler.h>
 #include <runtime/chxvm_state.h>
 #include <runtime/meminfo.h>
 #include <runtime/npy.h>
+#include <runtime/thread_pool.h>
 
 #define RANGE(x) (x).begin(), (x).end()
 
@@ -34,6 +45,8 @@ struct ChxVMInputDesc {
 
 namespace {
 
+std::atomic<uint64_t> g_next_chxvm_id{1};
+
 void CheckType(ChxVMState* st, const ChxVMOp* op) {
     const ChxVMInstructionProto& inst = op->instruction();
     if (inst.output_names().empty()) {
@@ -62,6 +75,27 @@ void CheckType(ChxVMState* st, const ChxVMOp* op) {
     }
 }
 
+std::vector<int> GetVariableIds(const ChxVMValueProto& value) {
+    switch (value.type()) {
+        case ChxVMValueProto::ARRAY:
+        case ChxVMValueProto::OPTIONAL_ARRAY:
+            return {value.array()};
+        case ChxVMValueProto::ARRAY_LIST:
+            return std::vector<int>(RANGE(value.array_list()));
+        case ChxVMValueProto::SEQUENCE:
+            return {value.sequence()};
+        case ChxVMValueProto::OPAQUE:
+            return {value.opaque()};
+        case ChxVMValueProto::SHAPE:
+            return {value.shape()};
+        case ChxVMValueProto::SCALAR:
+        case ChxVMValueProto::OPTIONAL_SCALAR:
+            return {value.scalar()};
+        default:
+            return {};
+    }
+}
+
 int64_t InMbs(int64_t bytes) {
     return bytes / 1000 / 1000;
 }
@@ -90,6 +124,87 @@ void DumpOutput(ChxVMState* st, const ChxVMOp* op, const std::string& output_dir
     }
 }
 
+void RunOp(ChxVMState* st, ChxVMOp* op) {
+    if (st->needs_debug_run()) {
+        op->RunDebug(st);
+    } else {
+        op->Run(st);
+    }
+}
+
+}  // namespace
+
+// Per-run data for instruction hooks.
+struct ChxVM::RunContext {
+    // Counters of instructions if the profiler is enabled.
+    ChxVMProfiler::Stats* profile{nullptr};
+    // Interned names of instructions if chrome tracing is enabled.
+    const int* trace_names{nullptr};
+    int trace_category{-1};
+    int trace_memory{-1};
+};
+
+namespace {
+
+void RunInstruction(ChxVMState* st, ChxVMOp* op, int pc, const ChxVM::RunContext& ctx) {
+    const ChxVMOptions& options = st->options();
+    ChxVMProfiler::Stats* profile = ctx.profile ? &ctx.profile[pc] : nullptr;
+    ChxVMProfiler::Clock::time_point start_time;
+    if (profile) {
+        start_time = ChxVMProfiler::Clock::now();
+    }
+    {
+        ChromeTracingEmitter::ScopedEvent se(
+                options.chrome_tracing, ctx.trace_category, ctx.trace_names ? ctx.trace_names[pc] : -1, pc, op->instruction().flops());
+#ifdef CHAINER_COMPILER_ENABLE_NVTX
+        nvtxRangePush(op->name().c_str());
+#endif
+        if (options.catch_exception) {
+            try {
+                RunOp(st, op);
+            } catch (...) {
+                std::cerr << "Exception in " << op->debug_info() << std::endl;
+                throw;
+            }
+        } else {
+            RunOp(st, op);
+        }
+#ifdef CHAINER_COMPILER_ENABLE_NVTX
+        nvtxRangePop();
+#endif
+    }
+
+    if (profile) {
+        const int64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(ChxVMProfiler::Clock::now() - start_time).count();
+        ChxVMProfiler::Record(profile, elapsed_ns, st->GetAllocatedBytes(op->instruction()));
+    }
+
+    if (options.check_types) {
+        CheckType(st, op);
+    }
+
+    if (!options.dump_outputs_dir.empty()) {
+        DumpOutput(st, op, options.dump_outputs_dir);
+    }
+}
+
+// Returns true if any option needs to do something for each
+// instruction in addition to `RunDebug`.
+bool NeedsInstructionHooks(const ChxVMOptions& options) {
+#ifdef CHAINER_COMPILER_ENABLE_NVTX
+    return true;
+#else
+    return options.chrome_tracing != nullptr || options.profiler != nullptr || options.check_types || !options.dump_outputs_dir.empty() ||
+           options.dump_memory_usage;
+#endif
+}
+
+// Options which need the program order or a consistent snapshot of
+// all variables are not supported by the parallel executor.
+bool CanRunInParallel(const ChxVMOptions& options) {
+    return options.trace_level == 0 && !options.dump_memory_usage;
+}
+
 }  // namespace
 
 ChxVMOptions::ChxVMOptions() {
@@ -100,14 +215,25 @@ ChxVMOptions::ChxVMOptions() {
     verbose_ops.resize(num_ops);
 }
 
-ChxVM::ChxVM(const ChxVMProgramProto& program) {
+ChxVM::ChxVM(const ChxVMProgramProto& program) : id_(g_next_chxvm_id++) {
+    // All variable IDs in the program must be in the variable table
+    // because ChxVMState does not check them in release builds.
     num_variables_ = 0;
     for (const ChxVMInstructionProto& inst : program.instructions()) {
         for (int output : inst.outputs()) {
             num_variables_ = std::max(num_variables_, output + 1);
+            if (output >= 0) output_indices_.push_back(output);
+        }
+        for (const ChxVMValueProto& input : inst.inputs()) {
+            for (int id : GetVariableIds(input)) {
+                num_variables_ = std::max(num_variables_, id + 1);
+            }
         }
     }
 
+    std::sort(output_indices_.begin(), output_indices_.end());
+    output_indices_.erase(std::unique(output_indices_.begin(), output_indices_.end()), output_indices_.end());
+
     for (const ChxVMInstructionProto& inst : program.instructions()) {
         ChxVMOp* op = MakeChxVMOp(inst);
         program_.emplace_back(op);
@@ -121,15 +247,38 @@ ChxVM::ChxVM(const ChxVMProgramProto& program) {
         chainerx::Shape shape(type.shape().begin(), type.shape().end());
         input_descs_.emplace_back(new ChxVMInputDesc(name, dtype, shape));
     }
+
+    arena_size_ = program.arena_size();
+
+    dataflow_.reset(new ChxVMDataflowGraph(program_, num_variables_));
 }
 
 ChxVM::~ChxVM() {
 }
 
 std::unique_ptr<ChxVMState> ChxVM::Prepare(const InOuts& program_inputs, const ChxVMOptions& options) {
+    for (const std::unique_ptr<ChxVMInputDesc>& input : input_descs_) {
+        CHECK(program_inputs.count(input->name)) << "Input '" << input->name << "' not found";
+    }
+    auto state = std::make_unique<ChxVMState>(options, num_variables_, InOuts());
+    // The memory plan and in-place updates assume the program order so
+    // they cannot be used by the parallel executor.
+    if (options.num_threads <= 1) {
+        state->set_arena_size(arena_size_);
+        state->set_inplace_enabled(true);
+    } else if (CanRunInParallel(options)) {
+        state->set_thread_pool(GetThreadPool(options.num_threads));
+    }
+    BindInputs(state.get(), program_inputs);
+    return state;
+}
+
+void ChxVM::BindInputs(ChxVMState* state, const InOuts& program_inputs) {
     for (const std::unique_ptr<ChxVMInputDesc>& input : input_descs_) {
         auto found = program_inputs.find(input->name);
-        CHECK(found != program_inputs.end()) << "Input '" << input->name << "' not found";
+        if (found == program_inputs.end()) {
+            continue;
+        }
         const ChxVMVar& var = *found->second;
         if (var.IsArray()) {
             const chainerx::Array& a = var.GetArray();
@@ -142,7 +291,9 @@ std::unique_ptr<ChxVMState> ChxVM::Prepare(const InOuts& program_inputs, const C
             CHECK_EQ(static_cast<int>(input->dtype), 0) << "Input '" << input->name << "' must be a tensor";
         }
     }
-    return std::make_unique<ChxVMState>(options, num_variables_, program_inputs);
+    for (const auto& p : program_inputs) {
+        state->BindInput(p.first, p.second);
+    }
 }
 
 InOuts ChxVM::Run(const InOuts& program_inputs, const ChxVMOptions& options) {
@@ -152,44 +303,41 @@ InOuts ChxVM::Run(const InOuts& program_inputs, const ChxVMOptions& options) {
 }
 
 void ChxVM::Run(ChxVMState* state) {
-    state->SetProgram(&program_);
+    state->SetProgram(&program_, &output_indices_);
+    state->Reset();
     const ChxVMOptions& options = state->options();
+    RunContext ctx;
+    if (options.profiler) {
+        ctx.profile = options.profiler->BeginRun(id_, program_);
+    }
+    if (options.chrome_tracing) {
+        InternTraceNames(options.chrome_tracing, &ctx);
+    }
+    if (state->thread_pool()) {
+        RunParallel(state, ctx);
+        return;
+    }
+
+    if (!NeedsInstructionHooks(options) && !state->needs_debug_run()) {
+        RunFast(state);
+        return;
+    }
+
     int64_t peak_used_mbs = 0, peak_total_mbs = 0;
 
     while (true) {
         int pc = state->pc();
         if (pc >= program_.size()) break;
 
-        ChxVMOp* op = program_[pc].get();
-
-        {
-            ChromeTracingEmitter::ScopedEvent se(options.chrome_tracing, "ChxVM", op->name(), pc, op->instruction().flops());
-#ifdef CHAINER_COMPILER_ENABLE_NVTX
-            nvtxRangePush(op->name().c_str());
-#endif
-            if (options.catch_exception) {
-                try {
-                    op->Run(state);
-                } catch (...) {
-                    std::cerr << "Exception in " << op->debug_info() << std::endl;
-                    throw;
-                }
-            } else {
-                op->Run(state);
-            }
-#ifdef CHAINER_COMPILER_ENABLE_NVTX
-            nvtxRangePop();
-#endif
-        }
+        RunInstruction(state, program_[pc].get(), pc, ctx);
 
         state->set_pc(state->pc() + 1);
 
-        if (options.check_types) {
-            CheckType(state, op);
-        }
-
-        if (!options.dump_outputs_dir.empty()) {
-            DumpOutput(state, op, options.dump_outputs_dir);
+        if (options.chrome_tracing && options.base_memory_usage >= 0) {
+            auto usage = GetMemoryUsageInBytes();
+            if (usage.has_value()) {
+                options.chrome_tracing->AddCounterEvent(ctx.trace_memory, usage->first - options.base_memory_usage);
+            }
         }
 
         if (options.dump_memory_usage) {
@@ -218,5 +366,130 @@ void ChxVM::Run(ChxVMState* state) {
     }
 }
 
+void ChxVM::InternTraceNames(ChromeTracingEmitter* chrome_tracing, RunContext* ctx) {
+    if (trace_emitter_id_ != chrome_tracing->id()) {
+        trace_emitter_id_ = chrome_tracing->id();
+        trace_names_.clear();
+        for (const std::unique_ptr<ChxVMOp>& op : program_) {
+            trace_names_.push_back(chrome_tracing->Intern(op->name()));
+        }
+        trace_category_ = chrome_tracing->Intern("ChxVM");
+        trace_memory_ = chrome_tracing->Intern("Memory");
+    }
+    ctx->trace_names = trace_names_.data();
+    ctx->trace_category = trace_category_;
+    ctx->trace_memory = trace_memory_;
+}
+
+void ChxVM::RunFast(ChxVMState* state) {
+    const int num_insts = program_.size();
+    const std::unique_ptr<ChxVMOp>* ops = program_.data();
+    try {
+        for (int pc = state->pc(); pc < num_insts; pc = state->pc() + 1) {
+            state->set_pc(pc);
+            ops[pc]->Run(state);
+        }
+    } catch (...) {
+        if (state->options().catch_exception) {
+            std::cerr << "Exception in " << ops[state->pc()]->debug_info() << std::endl;
+        }
+        throw;
+    }
+    state->set_pc(num_insts);
+}
+
+ThreadPool* ChxVM::GetThreadPool(int num_threads) {
+    std::lock_guard<std::mutex> lock(thread_pools_mu_);
+    std::unique_ptr<ThreadPool>& thread_pool = thread_pools_[num_threads];
+    if (!thread_pool) {
+        thread_pool.reset(new ThreadPool(num_threads));
+    }
+    return thread_pool.get();
+}
+
+void ChxVM::RunParallel(ChxVMState* state, const RunContext& ctx) {
+    ThreadPool* thread_pool = state->thread_pool();
+
+    // ChainerX keeps the default context, device, and backprop mode
+    // per thread.
+    chainerx::Context* context = &chainerx::GetDefaultContext();
+    chainerx::Device* device = &chainerx::GetDefaultDevice();
+    const bool is_backprop_required = chainerx::IsBackpropRequired();
+
+    for (const ChxVMDataflowGraph::Segment& segment : dataflow_->segments()) {
+        if (segment.sequential) {
+            state->set_pc(segment.begin);
+            while (state->pc() < segment.end) {
+                int pc = state->pc();
+                RunInstruction(state, program_[pc].get(), pc, ctx);
+                state->set_pc(state->pc() + 1);
+            }
+            CHECK_EQ(segment.end, state->pc());
+            continue;
+        }
+
+        const int num_insts = segment.end - segment.begin;
+        std::unique_ptr<std::atomic<int>[]> num_waits(new std::atomic<int>[num_insts]);
+        for (int pc = segment.begin; pc < segment.end; ++pc) {
+            num_waits[pc - segment.begin] = dataflow_->num_predecessors(pc);
+        }
+
+        std::mutex mu;
+        std::condition_variable cond;
+        int num_remaining = num_insts;
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+
+        std::function<void(int)> run_task = [&](int pc) {
+            if (!failed) {
+                chainerx::SetDefaultContext(context);
+                chainerx::SetDefaultDevice(device);
+                try {
+                    // Each instruction is run by a single task so
+                    // its counters are not shared between threads.
+                    if (is_backprop_required) {
+                        RunInstruction(state, program_[pc].get(), pc, ctx);
+                    } else {
+                        chainerx::NoBackpropModeScope no_backprop;
+                        RunInstruction(state, program_[pc].get(), pc, ctx);
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mu);
+                    if (!failed) error = std::current_exception();
+                    failed = true;
+                }
+            }
+
+            // Successors are released even after a failure so all
+            // tasks of this segment finish.
+            for (int succ : dataflow_->successors(pc)) {
+                if (--num_waits[succ - segment.begin] == 0) {
+                    thread_pool->Submit([&run_task, succ]() { run_task(succ); });
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mu);
+            if (--num_remaining == 0) {
+                cond.notify_all();
+            }
+        };
+
+        for (int pc = segment.begin; pc < segment.end; ++pc) {
+            if (dataflow_->num_predecessors(pc) == 0) {
+                thread_pool->Submit([&run_task, pc]() { run_task(pc); });
+            }
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mu);
+            cond.wait(lock, [&num_remaining]() { return num_remaining == 0; });
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        state->set_pc(segment.end);
+    }
+}
+
 }  // namespace runtime
 }  // namespace chainer_compiler
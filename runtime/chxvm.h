@@ -2,7 +2,9 @@
 
 #include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -19,9 +21,12 @@ namespace chainer_compiler {
 namespace runtime {
 
 class ChromeTracingEmitter;
+class ChxVMDataflowGraph;
 class ChxVMOp;
+class ChxVMProfiler;
 class ChxVMState;
 class ChxVMVar;
+class ThreadPool;
 
 typedef std::map<std::string, std::shared_ptr<ChxVMVar>> InOuts;
 
@@ -53,9 +58,20 @@ public:
 
     ChromeTracingEmitter* chrome_tracing{nullptr};
 
+    // Elapsed times of instructions are accumulated to `profiler`
+    // when it is set. The profiler must outlive runs with this option.
+    ChxVMProfiler* profiler{nullptr};
+
     std::string dump_outputs_dir;
 
     std::map<std::string, CustomOpFunc> custom_op_funcs;
+
+    // The number of threads to run independent instructions in
+    // parallel. Regions with jumps are still executed sequentially.
+    // The parallel executor is disabled when trace_level > 0 or memory
+    // usage dump is enabled. Arrays planned by the memory planner are
+    // allocated separately when num_threads > 1.
+    int num_threads{1};
 };
 
 class ChxVMInputDesc;
@@ -65,21 +81,65 @@ public:
     explicit ChxVM(const ChxVMProgramProto& program);
     ~ChxVM();
 
+    // Creates a state which can be run repeatedly by `Run(state)`.
+    // For each run after the first one, inputs must be bound again by
+    // `BindInputs`. Variables of the previous run are released when
+    // the next run starts while options and the arena for planned
+    // arrays are reused.
     std::unique_ptr<ChxVMState> Prepare(const InOuts& program_inputs, const ChxVMOptions& options);
+    void BindInputs(ChxVMState* state, const InOuts& program_inputs);
+
     InOuts Run(const InOuts& program_inputs, const ChxVMOptions& options);
     void Run(ChxVMState* state);
 
+    // A unique ID of this program, which is never reused even after
+    // this ChxVM is destroyed.
+    uint64_t id() const {
+        return id_;
+    }
+
     int num_variables() const {
         return num_variables_;
     }
 
+    int64_t arena_size() const {
+        return arena_size_;
+    }
+
+    struct RunContext;
+
 private:
     ChxVM(const ChxVM&) = delete;
     ChxVM& operator=(const ChxVM&) = delete;
 
+    // Returns the thread pool for `num_threads` workers. Pools are
+    // created by `Prepare` and kept until this ChxVM is destroyed so
+    // concurrent runs can share them.
+    ThreadPool* GetThreadPool(int num_threads);
+
+    // Runs the program without any per-instruction hooks such as
+    // traces and checks.
+    void RunFast(ChxVMState* state);
+    void RunParallel(ChxVMState* state, const RunContext& ctx);
+    // Interned names are cached for the last emitter.
+    void InternTraceNames(ChromeTracingEmitter* chrome_tracing, RunContext* ctx);
+
+    const uint64_t id_;
     std::vector<std::unique_ptr<ChxVMOp>> program_;
     std::vector<std::unique_ptr<ChxVMInputDesc>> input_descs_;
     int num_variables_;
+    // Sorted IDs of variables which are outputs of any instruction.
+    std::vector<int> output_indices_;
+    int64_t arena_size_;
+
+    std::unique_ptr<ChxVMDataflowGraph> dataflow_;
+    std::mutex thread_pools_mu_;
+    std::map<int, std::unique_ptr<ThreadPool>> thread_pools_;
+
+    uint64_t trace_emitter_id_{0};
+    std::vector<int> trace_names_;
+    int trace_category_{-1};
+    int trace_memory_{-1};
 };
 
 }  // namespace runtime
@@ -0,0 +1,205 @@
+#include "runtime/chxvm_dataflow.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include <common/log.h>
+#include <runtime/chxvm.pb.h>
+#include <runtime/chxvm_op.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+bool IsJump(ChxVMInstructionProto::Op op) {
+    return op == ChxVMInstructionProto::Jmp || op == ChxVMInstructionProto::JmpTrue || op == ChxVMInstructionProto::JmpFalse;
+}
+
+// Ops which update their inputs in-place.
+bool IsInPlace(ChxVMInstructionProto::Op op) {
+    switch (op) {
+        case ChxVMInstructionProto::Free:
+        case ChxVMInstructionProto::SequenceClear:
+        case ChxVMInstructionProto::SequenceAppend:
+        case ChxVMInstructionProto::SequencePop:
+        case ChxVMInstructionProto::SequenceMove:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Ops which touch a state shared by the whole program (e.g., the
+// input/output maps of ChxVMState or the Python interpreter). They
+// are executed in the program order.
+bool HasSideEffect(ChxVMInstructionProto::Op op) {
+    switch (op) {
+        case ChxVMInstructionProto::In:
+        case ChxVMInstructionProto::Out:
+        case ChxVMInstructionProto::Print:
+        case ChxVMInstructionProto::DoSomething:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void CollectInputIds(const ChxVMInstructionProto& inst, std::vector<int>* ids) {
+    for (const ChxVMValueProto& input : inst.inputs()) {
+        switch (input.type()) {
+            case ChxVMValueProto::ARRAY:
+                ids->push_back(input.array());
+                break;
+            case ChxVMValueProto::ARRAY_LIST:
+                ids->insert(ids->end(), input.array_list().begin(), input.array_list().end());
+                break;
+            case ChxVMValueProto::SEQUENCE:
+                ids->push_back(input.sequence());
+                break;
+            case ChxVMValueProto::OPAQUE:
+                ids->push_back(input.opaque());
+                break;
+            case ChxVMValueProto::SHAPE:
+                ids->push_back(input.shape());
+                break;
+            case ChxVMValueProto::SCALAR:
+                ids->push_back(input.scalar());
+                break;
+            default:
+                break;
+        }
+    }
+    ids->erase(std::remove_if(ids->begin(), ids->end(), [](int id) { return id < 0; }), ids->end());
+}
+
+}  // namespace
+
+ChxVMDataflowGraph::ChxVMDataflowGraph(const std::vector<std::unique_ptr<ChxVMOp>>& program, int num_variables)
+    : successors_(program.size()), num_predecessors_(program.size()) {
+    BuildSegments(program);
+    for (const Segment& segment : segments_) {
+        if (segment.sequential) {
+            critical_path_length_ += segment.end - segment.begin;
+        } else {
+            BuildDependencies(program, segment, num_variables);
+        }
+    }
+}
+
+void ChxVMDataflowGraph::BuildSegments(const std::vector<std::unique_ptr<ChxVMOp>>& program) {
+    const int num_insts = program.size();
+
+    // Regions [begin, end) which may be executed by jumps.
+    std::vector<std::pair<int, int>> regions;
+    for (int pc = 0; pc < num_insts; ++pc) {
+        const ChxVMInstructionProto& inst = program[pc]->instruction();
+        if (!IsJump(inst.op())) continue;
+        CHECK_LT(0, inst.inputs_size());
+        const int target = inst.inputs(inst.inputs_size() - 1).i();
+        const int begin = std::max(0, std::min(pc, target));
+        const int end = std::min(num_insts, std::max(pc, target) + 1);
+        regions.emplace_back(begin, end);
+    }
+    std::sort(regions.begin(), regions.end());
+
+    std::vector<std::pair<int, int>> merged;
+    for (const auto& region : regions) {
+        if (!merged.empty() && region.first <= merged.back().second) {
+            merged.back().second = std::max(merged.back().second, region.second);
+        } else {
+            merged.push_back(region);
+        }
+    }
+
+    int pc = 0;
+    for (const auto& region : merged) {
+        if (pc < region.first) {
+            segments_.push_back(Segment{pc, region.first, false});
+        }
+        segments_.push_back(Segment{region.first, region.second, true});
+        pc = region.second;
+    }
+    if (pc < num_insts) {
+        segments_.push_back(Segment{pc, num_insts, false});
+    }
+}
+
+void ChxVMDataflowGraph::BuildDependencies(
+        const std::vector<std::unique_ptr<ChxVMOp>>& program, const Segment& segment, int num_variables) {
+    // A pseudo variable which serializes ops with side effects.
+    const int side_effect_id = num_variables;
+    std::vector<int> last_writer(num_variables + 1, -1);
+    std::vector<std::vector<int>> readers(num_variables + 1);
+    std::vector<int> depth(segment.end - segment.begin, 0);
+    int max_depth = 0;
+    // The last instruction of each stream and of each ID.
+    std::map<int, int> last_in_stream;
+    std::map<int64_t, int> last_of_id;
+
+    for (int pc = segment.begin; pc < segment.end; ++pc) {
+        const ChxVMInstructionProto& inst = program[pc]->instruction();
+        std::vector<int> reads;
+        CollectInputIds(inst, &reads);
+        std::vector<int> writes;
+        for (int id : inst.outputs()) {
+            if (id >= 0) writes.push_back(id);
+        }
+        if (IsInPlace(inst.op())) {
+            writes.insert(writes.end(), reads.begin(), reads.end());
+        }
+        if (inst.inplace_input() >= 0) {
+            const ChxVMValueProto& input = inst.inputs(inst.inplace_input());
+            if (input.type() == ChxVMValueProto::ARRAY && input.array() >= 0) writes.push_back(input.array());
+        }
+        if (HasSideEffect(inst.op())) {
+            reads.push_back(side_effect_id);
+            writes.push_back(side_effect_id);
+        }
+
+        std::set<int> preds;
+        for (int id : reads) {
+            CHECK_GT(last_writer.size(), id) << program[pc]->debug_info();
+            if (last_writer[id] >= 0) preds.insert(last_writer[id]);
+        }
+        for (int id : writes) {
+            CHECK_GT(last_writer.size(), id) << program[pc]->debug_info();
+            if (last_writer[id] >= 0) preds.insert(last_writer[id]);
+            preds.insert(readers[id].begin(), readers[id].end());
+        }
+        if (inst.stream() >= 0) {
+            auto found = last_in_stream.find(inst.stream());
+            if (found != last_in_stream.end()) preds.insert(found->second);
+            last_in_stream[inst.stream()] = pc;
+        }
+        for (int64_t id : inst.wait_ids()) {
+            auto found = last_of_id.find(id);
+            if (found != last_of_id.end()) preds.insert(found->second);
+        }
+        if (inst.has_id()) last_of_id[inst.id()] = pc;
+        preds.erase(pc);
+
+        int d = 0;
+        for (int pred : preds) {
+            successors_[pred].push_back(pc);
+            d = std::max(d, depth[pred - segment.begin]);
+        }
+        num_predecessors_[pc] = preds.size();
+        depth[pc - segment.begin] = d + 1;
+        max_depth = std::max(max_depth, d + 1);
+
+        for (int id : reads) {
+            readers[id].push_back(pc);
+        }
+        for (int id : writes) {
+            last_writer[id] = pc;
+            readers[id].clear();
+        }
+    }
+
+    critical_path_length_ += max_depth;
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace chainer_compiler {
+namespace runtime {
+
+class ChxVMOp;
+
+// Dependencies between instructions of a ChxVM program, derived from
+// the inputs and outputs of each instruction. Used by the parallel
+// executor of ChxVM. Instructions of a stream (see --num_streams) also
+// depend on the previous instruction of the stream and on ones in
+// `wait_ids`.
+//
+// The program is split into segments. Instructions in a parallel
+// segment may run in any order which respects `predecessors`. A
+// sequential segment covers a region reachable by jump instructions
+// and is executed by the ordinary pc-based loop.
+class ChxVMDataflowGraph {
+public:
+    struct Segment {
+        int begin;
+        int end;
+        bool sequential;
+    };
+
+    ChxVMDataflowGraph(const std::vector<std::unique_ptr<ChxVMOp>>& program, int num_variables);
+
+    const std::vector<Segment>& segments() const {
+        return segments_;
+    }
+
+    // Instructions which must wait for the instruction at `pc`. Only
+    // instructions in the same parallel segment are listed.
+    const std::vector<int>& successors(int pc) const {
+        return successors_[pc];
+    }
+
+    int num_predecessors(int pc) const {
+        return num_predecessors_[pc];
+    }
+
+    // The length of the longest dependency chain over all parallel
+    // segments plus the number of instructions in sequential segments.
+    int critical_path_length() const {
+        return critical_path_length_;
+    }
+
+private:
+    void BuildSegments(const std::vector<std::unique_ptr<ChxVMOp>>& program);
+    void BuildDependencies(const std::vector<std::unique_ptr<ChxVMOp>>& program, const Segment& segment, int num_variables);
+
+    std::vector<Segment> segments_;
+    std::vector<std::vector<int>> successors_;
+    std::vector<int> num_predecessors_;
+    int critical_path_length_{0};
+};
+
+}  // namespace runtime
+}  // namespace chainer_compiler
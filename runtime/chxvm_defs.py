@@ -225,6 +225,12 @@ CHX_OPS = [
      [Array('x'), Array('w'), OptionalArray('b'), Int('n_batch_axes')],
      ['y']),
     ('LinearGradWeight', [Array('x'), Array('gy')], ['gw']),
+    ('LinearActivation',
+     [Array('x'), Array('w'), OptionalArray('b'), String('activation')],
+     ['y']),
+    ('LinearActivationGradWeight',
+     [Array('x'), Array('gy'), Array('y'), String('activation')],
+     ['gw', 'gz']),
 
     ('Conv',
      [Array('x'), Array('w'), OptionalArray('b'),
@@ -240,6 +246,40 @@ CHX_OPS = [
      [Array('w'), Array('x'), Array('gy'),
       Ints('strides'), Ints('pads'), Int('group')],
      ['y']),
+    ('FusedConv',
+     [Array('x'), Array('w'), OptionalArray('b'), OptionalArray('z'),
+      Ints('strides'), Ints('pads'), Int('group'), String('auto_pad'),
+      String('activation'), Float('alpha'), Float('min'), Float('max')],
+     ['y']),
+    # Ops with weights packed by PackConvWeight or PackMatrixWeight.
+    ('PackedConv',
+     [Array('x'), Opaque('packed'), OptionalArray('b'), OptionalArray('z'),
+      Ints('strides'), Ints('pads'), Int('group'),
+      String('activation'), Float('alpha'), Float('min'), Float('max')],
+     ['y']),
+    ('PackedLinear',
+     [Array('x'), Opaque('packed'), OptionalArray('b'), Int('n_batch_axes'),
+      String('activation')],
+     ['y']),
+    # Ops on images in NHWC or NCHW<B>c. See ChainerLayoutConv in
+    # compiler/gen_node.py for the layouts of weights.
+    ('LayoutConvert',
+     [Array('x'), String('src_layout'), String('dst_layout'),
+      Int('channels')],
+     ['y']),
+    ('LayoutConv',
+     [Array('x'), Array('w'), OptionalArray('b'), OptionalArray('z'),
+      Ints('strides'), Ints('pads'), Int('group'), String('layout'),
+      String('activation'), Float('alpha'), Float('min'), Float('max')],
+     ['y']),
+    ('LayoutMaxPool',
+     [Array('x'), Ints('kernel_shape'), Ints('strides'), Ints('pads'),
+      Int('cover_all'), String('layout')],
+     ['y']),
+    ('LayoutAveragePool',
+     [Array('x'), Ints('kernel_shape'), Ints('strides'), Ints('pads'),
+      Int('count_include_pad'), String('layout')],
+     ['y']),
 
     ('Relu', [Array('x')], ['y']),
     ('ReluGrad', [Array('x'), Array('gy')], ['gx']),
@@ -411,6 +451,10 @@ CHX_OPS = [
      [ArrayList('inputs'), Int('num_outputs'),
       String('code'), Int('fusion_id')],
      [ArrayList('outputs')]),
+    ('ElementWiseInterpreter',
+     [ArrayList('inputs'), Int('num_outputs'), IntValues('program'),
+      Doubles('constants'), Int('num_registers'), Int('dtype')],
+     [ArrayList('outputs')]),
 
     ('Where', [Array('condition'), Array('x'), Array('y')], [Array('output')]),
 
@@ -451,6 +495,10 @@ CHX_CUSTOM_FIELD_OPS = [
      [ArrayList('inputs'), Int('num_outputs'),
       String('dso_filename'), String('func_name'), Ints('output_shape')],
      [ArrayList('outputs')]),
+    ('ElementWiseCpu',
+     [ArrayList('inputs'), Int('num_outputs'),
+      String('dso_filename'), Int('dtype')],
+     [ArrayList('outputs')]),
     ('NGraph',
      [ArrayList('inputs'), String('onnx'), String('backend')],
      [ArrayList('outputs')]),
@@ -458,6 +506,13 @@ CHX_CUSTOM_FIELD_OPS = [
      [ArrayList('inputs'), String('model_path'), String('device'),
       Strings('output_names')],
      [ArrayList('outputs')]),
+    # Weights are packed once and cached while the same parameter
+    # arrays are fed.
+    ('PackConvWeight',
+     [Array('w'), Ints('input_shape'), Ints('strides'), Ints('pads'),
+      Int('group')],
+     [Opaque('packed')]),
+    ('PackMatrixWeight', [Array('w'), Int('trans')], [Opaque('packed')]),
 ]
 
 CHX_SEQ_OPS = [
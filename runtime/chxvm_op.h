@@ -15,7 +15,11 @@ public:
     explicit ChxVMOp(const ChxVMInstructionProto& inst);
     virtual ~ChxVMOp() = default;
 
+    // Runs the instruction without any traces or checks.
     virtual void Run(ChxVMState* state) = 0;
+    // Runs the instruction with traces and checks enabled by the
+    // options of `state`.
+    virtual void RunDebug(ChxVMState* state) = 0;
 
     const ChxVMInstructionProto& instruction() const {
         return inst_;
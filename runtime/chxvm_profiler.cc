@@ -0,0 +1,217 @@
+#include "runtime/chxvm_profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include <common/log.h>
+#include <common/strutil.h>
+#include <runtime/chxvm.pb.h>
+#include <runtime/chxvm_op.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+int GetBucket(int64_t ns) {
+    if (ns <= 0) {
+        return 0;
+    }
+    // ns = m * 2^e where 0.5 <= m < 1.
+    int e;
+    const double m = std::frexp(static_cast<double>(ns), &e);
+    const int sub = static_cast<int>((m * 2 - 1) * ChxVMProfiler::kNumSubBuckets);
+    return std::min((e - 1) * ChxVMProfiler::kNumSubBuckets + sub, ChxVMProfiler::kNumBuckets - 1);
+}
+
+// Returns the middle of the range of `bucket`.
+int64_t GetBucketValue(int bucket) {
+    const int e = bucket / ChxVMProfiler::kNumSubBuckets;
+    const int sub = bucket % ChxVMProfiler::kNumSubBuckets;
+    return static_cast<int64_t>(std::ldexp(1.0 + (sub + 0.5) / ChxVMProfiler::kNumSubBuckets, e));
+}
+
+double InUsecs(int64_t ns) {
+    return ns * 1e-3;
+}
+
+void WriteStatsJSON(const ChxVMProfiler::Stats& stats, std::ostream& os) {
+    os << "\"count\":" << stats.count << ",";
+    os << "\"total_us\":" << InUsecs(stats.total_ns) << ",";
+    os << "\"mean_us\":" << (stats.count ? InUsecs(stats.total_ns) / stats.count : 0) << ",";
+    os << "\"p50_us\":" << InUsecs(stats.GetPercentileNs(0.5)) << ",";
+    os << "\"p99_us\":" << InUsecs(stats.GetPercentileNs(0.99)) << ",";
+    os << "\"allocated_bytes\":" << stats.allocated_bytes << ",";
+    os << "\"flops\":" << stats.flops << ",";
+    os << "\"gflops_per_sec\":" << (stats.total_ns ? static_cast<double>(stats.flops) / stats.total_ns : 0);
+}
+
+template <class Entry>
+void SortByTotalTime(std::vector<Entry>* entries) {
+    std::stable_sort(entries->begin(), entries->end(), [](const Entry& a, const Entry& b) {
+        return a.second->total_ns > b.second->total_ns;
+    });
+}
+
+}  // namespace
+
+constexpr int ChxVMProfiler::kNumSubBuckets;
+constexpr int ChxVMProfiler::kNumBuckets;
+
+void ChxVMProfiler::Stats::Add(const Stats& other) {
+    count += other.count;
+    total_ns += other.total_ns;
+    allocated_bytes += other.allocated_bytes;
+    flops += other.flops;
+    histogram.resize(kNumBuckets);
+    for (size_t i = 0; i < other.histogram.size(); ++i) {
+        histogram[i] += other.histogram[i];
+    }
+}
+
+int64_t ChxVMProfiler::Stats::GetPercentileNs(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    const int64_t rank = std::max<int64_t>(1, static_cast<int64_t>(std::ceil(p * count)));
+    int64_t seen = 0;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        seen += histogram[i];
+        if (seen >= rank) {
+            return GetBucketValue(i);
+        }
+    }
+    return GetBucketValue(kNumBuckets - 1);
+}
+
+ChxVMProfiler::ChxVMProfiler() {
+}
+
+ChxVMProfiler::~ChxVMProfiler() {
+}
+
+ChxVMProfiler::Stats* ChxVMProfiler::BeginRun(uint64_t program_id, const std::vector<std::unique_ptr<ChxVMOp>>& program) {
+    ++num_runs_;
+    for (const std::unique_ptr<ProgramStats>& stats : programs_) {
+        if (stats->program_id == program_id) {
+            CHECK_EQ(program.size(), stats->insts.size());
+            return stats->insts.data();
+        }
+    }
+
+    std::unique_ptr<ProgramStats> stats(new ProgramStats());
+    stats->program_id = program_id;
+    stats->insts.resize(program.size());
+    for (size_t pc = 0; pc < program.size(); ++pc) {
+        const ChxVMOp& op = *program[pc];
+        stats->infos.push_back(InstructionInfo{ChxVMInstructionProto::Op_Name(op.op()), op.name(), op.debug_info()});
+        stats->insts[pc].histogram.resize(kNumBuckets);
+        stats->insts[pc].flops_per_call = op.instruction().flops();
+    }
+    programs_.push_back(std::move(stats));
+    return programs_.back()->insts.data();
+}
+
+void ChxVMProfiler::Record(Stats* stats, int64_t elapsed_ns, int64_t allocated_bytes) {
+    ++stats->count;
+    stats->total_ns += elapsed_ns;
+    stats->allocated_bytes += allocated_bytes;
+    stats->flops += stats->flops_per_call;
+    ++stats->histogram[GetBucket(elapsed_ns)];
+}
+
+void ChxVMProfiler::Reset() {
+    num_runs_ = 0;
+    for (const std::unique_ptr<ProgramStats>& stats : programs_) {
+        for (Stats& inst : stats->insts) {
+            inst.count = 0;
+            inst.total_ns = 0;
+            inst.allocated_bytes = 0;
+            inst.flops = 0;
+            std::fill(inst.histogram.begin(), inst.histogram.end(), 0);
+        }
+    }
+}
+
+std::map<std::string, ChxVMProfiler::Stats> ChxVMProfiler::GetOpStats() const {
+    std::map<std::string, Stats> op_stats;
+    for (const std::unique_ptr<ProgramStats>& stats : programs_) {
+        for (size_t pc = 0; pc < stats->insts.size(); ++pc) {
+            if (stats->insts[pc].count) {
+                op_stats[stats->infos[pc].op_type].Add(stats->insts[pc]);
+            }
+        }
+    }
+    return op_stats;
+}
+
+void ChxVMProfiler::Show(std::ostream& os, int max_rows) const {
+    const std::map<std::string, Stats> op_stats = GetOpStats();
+    std::vector<std::pair<std::string, const Stats*>> ops;
+    int64_t total_ns = 0;
+    for (const auto& p : op_stats) {
+        ops.emplace_back(p.first, &p.second);
+        total_ns += p.second.total_ns;
+    }
+    SortByTotalTime(&ops);
+
+    os << "Profile of " << num_runs_ << " runs (times in usec)\n";
+    os << std::left << std::setw(24) << "op" << std::right << std::setw(10) << "count" << std::setw(14) << "total" << std::setw(8)
+       << "%" << std::setw(12) << "mean" << std::setw(12) << "p50" << std::setw(12) << "p99" << std::setw(12) << "GFLOPs/s" << "\n";
+    for (size_t i = 0; i < ops.size() && i < static_cast<size_t>(max_rows); ++i) {
+        const Stats& s = *ops[i].second;
+        os << std::left << std::setw(24) << ops[i].first << std::right << std::setw(10) << s.count << std::setw(14)
+           << static_cast<int64_t>(InUsecs(s.total_ns)) << std::setw(8) << std::fixed << std::setprecision(1)
+           << (total_ns ? 100.0 * s.total_ns / total_ns : 0) << std::setw(12) << InUsecs(s.total_ns) / s.count << std::setw(12)
+           << InUsecs(s.GetPercentileNs(0.5)) << std::setw(12) << InUsecs(s.GetPercentileNs(0.99)) << std::setw(12)
+           << (s.total_ns ? static_cast<double>(s.flops) / s.total_ns : 0) << "\n";
+        os.unsetf(std::ios::fixed);
+    }
+}
+
+std::string ChxVMProfiler::ToJSON() const {
+    std::ostringstream oss;
+    oss << "{\"num_runs\":" << num_runs_ << ",";
+
+    const std::map<std::string, Stats> op_stats = GetOpStats();
+    std::vector<std::pair<std::string, const Stats*>> ops;
+    for (const auto& p : op_stats) {
+        ops.emplace_back(p.first, &p.second);
+    }
+    SortByTotalTime(&ops);
+    oss << "\"ops\":[";
+    for (size_t i = 0; i < ops.size(); ++i) {
+        if (i) oss << ",";
+        oss << "\n{\"op\":\"" << ops[i].first << "\",";
+        WriteStatsJSON(*ops[i].second, oss);
+        oss << "}";
+    }
+    oss << "],";
+
+    std::vector<std::pair<const InstructionInfo*, const Stats*>> insts;
+    for (const std::unique_ptr<ProgramStats>& stats : programs_) {
+        for (size_t pc = 0; pc < stats->insts.size(); ++pc) {
+            if (stats->insts[pc].count) {
+                insts.emplace_back(&stats->infos[pc], &stats->insts[pc]);
+            }
+        }
+    }
+    SortByTotalTime(&insts);
+    oss << "\"instructions\":[";
+    for (size_t i = 0; i < insts.size(); ++i) {
+        const InstructionInfo& info = *insts[i].first;
+        if (i) oss << ",";
+        oss << "\n{\"op\":\"" << info.op_type << "\",";
+        oss << "\"name\":\"" << EscapeJSON(info.name) << "\",";
+        oss << "\"debug_info\":\"" << EscapeJSON(info.debug_info) << "\",";
+        WriteStatsJSON(*insts[i].second, oss);
+        oss << "}";
+    }
+    oss << "]}";
+    return oss.str();
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
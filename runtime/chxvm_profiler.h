@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace chainer_compiler {
+namespace runtime {
+
+class ChxVMOp;
+
+// Aggregates elapsed times of ChxVM instructions across runs. Counters
+// are allocated when a program is run for the first time so recording
+// an instruction does not allocate memory.
+//
+// A profiler can be shared by multiple programs (e.g., forward and
+// backward) but must not be used by runs of different programs at the
+// same time.
+class ChxVMProfiler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // Elapsed times are recorded in a histogram with 8 buckets per
+    // power of two, so percentiles are accurate within about 6%.
+    static constexpr int kNumSubBuckets = 8;
+    static constexpr int kNumBuckets = 40 * kNumSubBuckets;
+
+    struct Stats {
+        void Add(const Stats& other);
+        int64_t GetPercentileNs(double p) const;
+
+        int64_t count{0};
+        int64_t total_ns{0};
+        // The total size of output arrays which do not share buffers
+        // with inputs.
+        int64_t allocated_bytes{0};
+        int64_t flops{0};
+        std::vector<uint32_t> histogram;
+        // FLOPs of a single execution. Only for instructions.
+        int64_t flops_per_call{0};
+    };
+
+    ChxVMProfiler();
+    ~ChxVMProfiler();
+
+    // Returns counters for each instruction of `program`, whose
+    // unique ID is `program_id` (see ChxVM::id).
+    Stats* BeginRun(uint64_t program_id, const std::vector<std::unique_ptr<ChxVMOp>>& program);
+
+    static void Record(Stats* stats, int64_t elapsed_ns, int64_t allocated_bytes);
+
+    // Clears all counters, e.g., after warm-up runs.
+    void Reset();
+
+    int64_t num_runs() const {
+        return num_runs_;
+    }
+
+    // Statistics aggregated by op types, e.g., "Conv".
+    std::map<std::string, Stats> GetOpStats() const;
+
+    // Shows the slowest op types and instructions.
+    void Show(std::ostream& os, int max_rows = 20) const;
+
+    // Returns a JSON object which has statistics of op types and
+    // instructions sorted by their total elapsed times.
+    std::string ToJSON() const;
+
+private:
+    struct InstructionInfo {
+        std::string op_type;
+        std::string name;
+        std::string debug_info;
+    };
+
+    struct ProgramStats {
+        // Information of instructions is copied so reports can be
+        // made after the program is destroyed.
+        uint64_t program_id;
+        std::vector<InstructionInfo> infos;
+        std::vector<Stats> insts;
+    };
+
+    std::vector<std::unique_ptr<ProgramStats>> programs_;
+    int64_t num_runs_{0};
+};
+
+}  // namespace runtime
+}  // namespace chainer_compiler
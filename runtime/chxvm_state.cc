@@ -2,6 +2,7 @@
 
 #include <map>
 
+#include <chainerx/routines/creation.h>
 #include <chainerx/routines/logic.h>
 #include <chainerx/routines/manipulation.h>
 #include <chainerx/routines/reduction.h>
@@ -16,19 +17,16 @@ namespace chainer_compiler {
 namespace runtime {
 
 ChxVMState::ChxVMState(const ChxVMOptions& options, int num_variables, const InOuts& inputs)
-    : pc_(0), variables_(num_variables), inputs_(inputs), options_(options) {
+    : pc_(0),
+      variables_(num_variables),
+      inputs_(inputs),
+      options_(options),
+      needs_debug_run_(options.trace_level > 0 || options.check_nans || options.check_infs) {
 }
 
 ChxVMState::~ChxVMState() {
 }
 
-chainerx::Array ChxVMState::GetArray(int index) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
-    CHECK(variables_[index].get());
-    return variables_[index]->GetArray();
-}
-
 absl::optional<chainerx::Array> ChxVMState::GetOptionalArray(int index) {
     if (index < 0) return absl::nullopt;
     return GetArray(index);
@@ -46,38 +44,31 @@ void ChxVMState::SetArrayList(const std::vector<int>& index, const std::vector<c
 }
 
 ChxVMSequence* ChxVMState::CreateSequence(int index) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
-    variables_[index].reset(new ChxVMVar(std::make_shared<ChxVMSequence>()));
+    DCHECK_LE(0, index);
+    DCHECK_GT(variables_.size(), index);
+    StoreVar(index, new ChxVMVar(std::make_shared<ChxVMSequence>()));
     return GetSequence(index);
 }
 
 ChxVMSequence* ChxVMState::GetSequence(int index) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
+    DCHECK_LE(0, index);
+    DCHECK_GT(variables_.size(), index);
     CHECK(variables_[index].get());
     return variables_[index]->GetSequence();
 }
 
 const ChxVMOpaque& ChxVMState::GetOpaque(int index) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
+    DCHECK_LE(0, index);
+    DCHECK_GT(variables_.size(), index);
     CHECK(variables_[index].get());
     return *variables_[index]->GetOpaque();
 }
 
 void ChxVMState::SetOpaque(int index, ChxVMOpaque* opaque) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
+    DCHECK_LE(0, index);
+    DCHECK_GT(variables_.size(), index);
     CHECK(!variables_[index].get());
-    variables_[index].reset(new ChxVMVar(opaque));
-}
-
-ChxVMVar* ChxVMState::GetVar(int index) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
-    CHECK(variables_[index].get());
-    return variables_[index].get();
+    StoreVar(index, new ChxVMVar(opaque));
 }
 
 absl::optional<ChxVMVar*> ChxVMState::GetOptionalVar(int index) {
@@ -86,29 +77,29 @@ absl::optional<ChxVMVar*> ChxVMState::GetOptionalVar(int index) {
 }
 
 void ChxVMState::SetVar(int index, const ChxVMVar& var) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
+    DCHECK_LE(0, index);
+    DCHECK_GT(variables_.size(), index);
     CHECK(!variables_[index].get());
-    variables_[index].reset(new ChxVMVar(var));
+    StoreVar(index, new ChxVMVar(var));
 }
 
 const chainerx::Shape& ChxVMState::GetShape(int index) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
+    DCHECK_LE(0, index);
+    DCHECK_GT(variables_.size(), index);
     CHECK(variables_[index].get());
     return variables_[index]->GetShape();
 }
 
 void ChxVMState::SetShape(int index, chainerx::Shape s) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
+    DCHECK_LE(0, index);
+    DCHECK_GT(variables_.size(), index);
     CHECK(!variables_[index].get());
-    variables_[index].reset(new ChxVMVar(s));
+    StoreVar(index, new ChxVMVar(s));
 }
 
 const StrictScalar& ChxVMState::GetScalar(int index) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
+    DCHECK_LE(0, index);
+    DCHECK_GT(variables_.size(), index);
     CHECK(variables_[index].get());
     return variables_[index]->GetScalar();
 }
@@ -128,10 +119,10 @@ int64_t ChxVMState::GetOptionalInt(int index, int64_t default_value) {
 }
 
 void ChxVMState::SetScalar(int index, StrictScalar s) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
+    DCHECK_LE(0, index);
+    DCHECK_GT(variables_.size(), index);
     CHECK(!variables_[index].get());
-    variables_[index].reset(new ChxVMVar(s));
+    StoreVar(index, new ChxVMVar(s));
 }
 
 std::string ChxVMState::GetVarString(int index) {
@@ -169,32 +160,58 @@ std::string ChxVMState::GetVarListString(const std::vector<int>& indices) {
 }
 
 void ChxVMState::SetArray(int index, const chainerx::Array& value) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
+    DCHECK_LE(0, index);
+    DCHECK_GT(variables_.size(), index);
     CHECK(!variables_[index].get());
-    variables_[index].reset(new ChxVMVar(value));
+    StoreVar(index, new ChxVMVar(value));
+    ++num_array_outputs_;
 }
 
 void ChxVMState::FreeVar(int index) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
+    DCHECK_LE(0, index);
+    DCHECK_GT(variables_.size(), index);
     CHECK(variables_[index].get()) << index;
     variables_[index].reset();
 }
 
 void ChxVMState::Input(const std::string& name, int index) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
+    DCHECK_LE(0, index);
+    DCHECK_GT(variables_.size(), index);
     CHECK(!variables_[index].get()) << index;
     auto found = inputs_.find(name);
     CHECK(found != inputs_.end()) << "Input value not exist: " << name;
-    variables_[index].reset(new ChxVMVar(*found->second.get()));
+    StoreVar(index, new ChxVMVar(*found->second.get()));
     inputs_.erase(found);
 }
 
+void ChxVMState::BindInput(const std::string& name, const std::shared_ptr<ChxVMVar>& var) {
+    inputs_[name] = var;
+}
+
+void ChxVMState::Reset() {
+    if (output_indices_) {
+        for (int index : *output_indices_) {
+            variables_[index].reset();
+        }
+    } else {
+        for (std::unique_ptr<ChxVMVar>& var : variables_) {
+            var.reset();
+        }
+    }
+    outputs_.clear();
+    pc_ = 0;
+    num_array_outputs_ = 0;
+    num_arena_outputs_ = 0;
+    num_inplace_outputs_ = 0;
+}
+
+void ChxVMState::StoreVar(int index, ChxVMVar* var) {
+    variables_[index].reset(var);
+}
+
 void ChxVMState::Output(const std::string& name, int index) {
-    CHECK_LE(0, index) << index;
-    CHECK_GT(variables_.size(), index) << index;
+    DCHECK_LE(0, index);
+    DCHECK_GT(variables_.size(), index);
     CHECK(variables_[index].get()) << index;
     CHECK(outputs_.emplace(name, std::shared_ptr<ChxVMVar>(new ChxVMVar(*variables_[index]))).second) << "Duplicated output name: " << name;
 }
@@ -299,5 +316,89 @@ int64_t ChxVMState::GetTotalVariableSize() const {
     return total_size;
 }
 
+int64_t ChxVMState::GetAllocatedBytes(const ChxVMInstructionProto& inst) const {
+    // Program inputs are owned by the caller.
+    if (inst.op() == ChxVMInstructionProto::In) {
+        return 0;
+    }
+    auto get_buffer = [this](int id) -> void* {
+        if (id < 0 || id >= static_cast<int>(variables_.size()) || !variables_[id] || !variables_[id]->IsArray()) {
+            return nullptr;
+        }
+        return variables_[id]->GetArray().data().get();
+    };
+    // Instructions have only a few inputs and outputs, so buffers are
+    // compared one by one instead of building a set for each step.
+    auto is_input_buffer = [&inst, &get_buffer](void* buffer) {
+        for (const ChxVMValueProto& value : inst.inputs()) {
+            switch (value.type()) {
+                case ChxVMValueProto::ARRAY:
+                case ChxVMValueProto::OPTIONAL_ARRAY:
+                    if (get_buffer(value.array()) == buffer) return true;
+                    break;
+                case ChxVMValueProto::ARRAY_LIST:
+                    for (int id : value.array_list()) {
+                        if (get_buffer(id) == buffer) return true;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        return false;
+    };
+
+    int64_t allocated = 0;
+    for (int i = 0; i < inst.outputs_size(); ++i) {
+        void* buffer = get_buffer(inst.outputs(i));
+        if (!buffer || (arena_.has_value() && buffer == arena_->data().get()) || is_input_buffer(buffer)) {
+            continue;
+        }
+        bool is_counted = false;
+        for (int j = 0; j < i; ++j) {
+            if (get_buffer(inst.outputs(j)) == buffer) is_counted = true;
+        }
+        if (!is_counted) {
+            allocated += variables_[inst.outputs(i)]->GetArray().GetNBytes();
+        }
+    }
+    return allocated;
+}
+
+absl::optional<chainerx::Array> ChxVMState::GetPlannedOutput(
+        const ChxVMInstructionProto& inst, int index, const chainerx::Shape& shape, chainerx::Dtype dtype, chainerx::Device& device) {
+    if (arena_size_ == 0 || index >= inst.output_offsets_size()) {
+        return absl::nullopt;
+    }
+    const int64_t offset = inst.output_offsets(index);
+    if (offset < 0) {
+        return absl::nullopt;
+    }
+    const ChxVMTypeProto& type = inst.output_types(index);
+    if (static_cast<chainerx::Dtype>(type.dtype()) != dtype || chainerx::Shape(type.shape().begin(), type.shape().end()) != shape) {
+        return absl::nullopt;
+    }
+
+    if (!arena_.has_value()) {
+        arena_ = chainerx::Empty({arena_size_}, chainerx::Dtype::kUInt8, device);
+    } else if (&arena_->device() != &device) {
+        return absl::nullopt;
+    }
+    CHECK_LE(offset + shape.GetTotalSize() * chainerx::GetItemSize(dtype), arena_size_) << inst.DebugString();
+    ++num_arena_outputs_;
+    return chainerx::FromData(shape, dtype, arena_->data(), absl::nullopt /* strides */, offset, device);
+}
+
+bool ChxVMState::CanOverwriteInput(const ChxVMInstructionProto& inst, int index, const chainerx::Array& input) {
+    if (!inplace_enabled_ || inst.inplace_input() != index) {
+        return false;
+    }
+    if (!input.IsContiguous() || input.IsBackpropRequired(chainerx::AnyGraph{})) {
+        return false;
+    }
+    ++num_inplace_outputs_;
+    return true;
+}
+
 }  // namespace runtime
 }  // namespace chainer_compiler
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <stack>
 #include <string>
 #include <vector>
@@ -8,6 +9,7 @@
 
 #include <chainerx/array.h>
 
+#include <common/log.h>
 #include <runtime/chxvm.h>
 #include <runtime/chxvm.pb.h>
 #include <runtime/chxvm_var.h>
@@ -17,6 +19,7 @@ namespace runtime {
 
 struct ChxVMOptions;
 class ChxVMVar;
+class ThreadPool;
 
 class ChxVMState {
 public:
@@ -30,7 +33,11 @@ public:
         pc_ = pc;
     }
 
-    chainerx::Array GetArray(int index);
+    // Variable IDs are validated when ChxVM decodes the program so
+    // accessors of variables check them only in debug builds.
+    const chainerx::Array& GetArray(int index) {
+        return GetVar(index)->GetArray();
+    }
     absl::optional<chainerx::Array> GetOptionalArray(int index);
     void SetArray(int index, const chainerx::Array& value);
     void FreeVar(int index);
@@ -44,7 +51,13 @@ public:
     const ChxVMOpaque& GetOpaque(int index);
     void SetOpaque(int index, ChxVMOpaque* opaque);
 
-    ChxVMVar* GetVar(int index);
+    ChxVMVar* GetVar(int index) {
+        DCHECK_LE(0, index);
+        DCHECK_GT(variables_.size(), index);
+        ChxVMVar* var = variables_[index].get();
+        CHECK(var) << index;
+        return var;
+    }
     absl::optional<ChxVMVar*> GetOptionalVar(int index);
     void SetVar(int index, const ChxVMVar& var);
 
@@ -62,6 +75,17 @@ public:
     void Input(const std::string& name, int index);
     void Output(const std::string& name, int index);
 
+    // Binds `var` to the input `name` for the next run. Like inputs
+    // given to the constructor, the binding is consumed by the `In`
+    // instruction so it must be bound again for each run.
+    void BindInput(const std::string& name, const std::shared_ptr<ChxVMVar>& var);
+
+    // Releases variables and outputs of the previous run so the state
+    // can be run again. This takes time proportional to the number of
+    // variables the program may set. Options, the variable table, and
+    // the arena are kept.
+    void Reset();
+
     const InOuts& GetOutputs() {
         return std::move(outputs_);
     }
@@ -85,24 +109,96 @@ public:
     bool check_infs() const {
         return options_.check_infs;
     }
+    // Returns true if instructions must be run by `RunDebug` to show
+    // traces or check outputs.
+    bool needs_debug_run() const {
+        return needs_debug_run_;
+    }
 
     void ShowVariableStatus() const;
 
-    void SetProgram(const std::vector<std::unique_ptr<ChxVMOp>>* program) {
+    // `output_indices` are the variables the program may set, which
+    // are released by `Reset`. Without them, `Reset` scans the whole
+    // variable table.
+    void SetProgram(const std::vector<std::unique_ptr<ChxVMOp>>* program, const std::vector<int>* output_indices) {
         program_ = program;
+        output_indices_ = output_indices;
     }
 
     int64_t GetTotalVariableSize() const;
 
+    // The thread pool of the parallel executor, which is owned by
+    // ChxVM. Null if instructions are run sequentially.
+    ThreadPool* thread_pool() const {
+        return thread_pool_;
+    }
+    void set_thread_pool(ThreadPool* thread_pool) {
+        thread_pool_ = thread_pool;
+    }
+
+    // Returns the total size of output arrays of `inst` which share
+    // buffers with neither its input arrays nor the arena. Must be
+    // called right after `inst` is run.
+    int64_t GetAllocatedBytes(const ChxVMInstructionProto& inst) const;
+
+    // Enables the arena for arrays planned by the memory planner. The
+    // arena is allocated when the first planned output is requested.
+    void set_arena_size(int64_t arena_size) {
+        arena_size_ = arena_size;
+    }
+
+    // Returns a view of the arena for the `index`-th output of `inst`
+    // if the memory planner assigned an offset to it and the planned
+    // type matches `shape`, `dtype`, and `device`.
+    absl::optional<chainerx::Array> GetPlannedOutput(
+            const ChxVMInstructionProto& inst, int index, const chainerx::Shape& shape, chainerx::Dtype dtype, chainerx::Device& device);
+
+    // Enables ops marked by the compiler to write their outputs to
+    // the buffers of dying inputs.
+    void set_inplace_enabled(bool enabled) {
+        inplace_enabled_ = enabled;
+    }
+
+    // Returns true if the first output of `inst` may be written to
+    // `input`, the `index`-th input of `inst`.
+    bool CanOverwriteInput(const ChxVMInstructionProto& inst, int index, const chainerx::Array& input);
+
+    // The number of arrays set to variables.
+    int64_t num_array_outputs() const {
+        return num_array_outputs_;
+    }
+    // The number of arrays carved from the arena.
+    int64_t num_arena_outputs() const {
+        return num_arena_outputs_;
+    }
+    // The number of arrays written to the buffers of their inputs.
+    int64_t num_inplace_outputs() const {
+        return num_inplace_outputs_;
+    }
+
 private:
     void ReportInvalidInOuts(const std::vector<int>& inputs, const std::vector<int>& outputs);
 
+    void StoreVar(int index, ChxVMVar* var);
+
     int pc_;
     std::vector<std::unique_ptr<ChxVMVar>> variables_;
     InOuts inputs_;
     InOuts outputs_;
     ChxVMOptions options_;
-    const std::vector<std::unique_ptr<ChxVMOp>>* program_;
+    bool needs_debug_run_;
+    const std::vector<std::unique_ptr<ChxVMOp>>* program_{nullptr};
+    const std::vector<int>* output_indices_{nullptr};
+    ThreadPool* thread_pool_{nullptr};
+
+    int64_t arena_size_{0};
+    absl::optional<chainerx::Array> arena_;
+    // Counters are atomic as the parallel executor sets variables from
+    // its worker threads.
+    std::atomic<int64_t> num_array_outputs_{0};
+    std::atomic<int64_t> num_arena_outputs_{0};
+    bool inplace_enabled_{false};
+    std::atomic<int64_t> num_inplace_outputs_{0};
 };
 
 }  // namespace runtime
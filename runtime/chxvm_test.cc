@@ -1,8 +1,10 @@
 #include <iostream>
+#include <limits>
 
 #include <gtest/gtest.h>
 
 #include <chainerx/array.h>
+#include <chainerx/backprop_mode.h>
 #include <chainerx/numeric.h>
 #include <chainerx/routines/creation.h>
 #include <chainerx/testing/array.h>
@@ -13,7 +15,12 @@
 #include <compiler/gen_chxvm_codegen.h>
 #include <runtime/chxvm.h>
 #include <runtime/chxvm.pb.h>
+#include <runtime/chxvm_dataflow.h>
+#include <runtime/chxvm_op.h>
+#include <runtime/chxvm_profiler.h>
+#include <runtime/chxvm_state.h>
 #include <runtime/chxvm_var.h>
+#include <runtime/elementwise_bytecode.h>
 
 namespace chainer_compiler {
 namespace runtime {
@@ -40,6 +47,444 @@ TEST(ChxVMTest, Run) {
     EXPECT_ARRAY_EQ(e, outputs["out"]->GetArray());
 }
 
+TEST(ChxVMTest, RunBoundState) {
+    chainerx::testing::ContextSession sess;
+
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "in1");
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(1), "in2");
+    chxvm::AddMulOp(&program, chxvm::ChxVMValue(2), 0, 1);
+    chxvm::AddFreeOp(&program, 0);
+    chxvm::AddFreeOp(&program, 1);
+    chxvm::AddOutOp(&program, "out", 2);
+    chxvm::AddFreeOp(&program, 2);
+
+    ChxVM chxvm(program);
+    chainerx::Array in1 = chainerx::Eye(2, absl::nullopt, absl::nullopt, chainerx::Dtype::kFloat32);
+    InOuts inputs;
+    inputs.emplace("in1", std::shared_ptr<ChxVMVar>(new ChxVMVar(in1)));
+    inputs.emplace("in2", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::OnesLike(in1))));
+    std::unique_ptr<ChxVMState> state(chxvm.Prepare(inputs, ChxVMOptions()));
+
+    for (int i = 1; i <= 3; ++i) {
+        if (i > 1) {
+            InOuts rebound;
+            rebound.emplace("in1", inputs["in1"]);
+            rebound.emplace("in2", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::FullLike(in1, i))));
+            chxvm.BindInputs(state.get(), rebound);
+        }
+        chxvm.Run(state.get());
+        InOuts outputs = state->GetOutputs();
+        ASSERT_EQ(1, outputs.size());
+        chainerx::Array e = chainerx::testing::BuildArray({2, 2}).WithData<float>({1.0f * i, 0, 0, 1.0f * i});
+        EXPECT_ARRAY_EQ(e, outputs["out"]->GetArray());
+    }
+}
+
+TEST(ChxVMTest, RunParallel) {
+    chainerx::testing::ContextSession sess;
+
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "in1");
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(1), "in2");
+    chxvm::AddAddOp(&program, chxvm::ChxVMValue(2), 0, 1);
+    chxvm::AddMulOp(&program, chxvm::ChxVMValue(3), 0, 1);
+    chxvm::AddFreeOp(&program, 0);
+    chxvm::AddFreeOp(&program, 1);
+    chxvm::AddSubOp(&program, chxvm::ChxVMValue(4), 2, 3);
+    chxvm::AddFreeOp(&program, 2);
+    chxvm::AddFreeOp(&program, 3);
+    chxvm::AddOutOp(&program, "out", 4);
+
+    ChxVM chxvm(program);
+    ChxVMOptions options;
+    options.num_threads = 4;
+    for (int i = 0; i < 10; ++i) {
+        InOuts inputs;
+        chainerx::Array in1 = chainerx::Eye(2, absl::nullopt, absl::nullopt, chainerx::Dtype::kFloat32);
+        inputs.emplace("in1", std::shared_ptr<ChxVMVar>(new ChxVMVar(in1)));
+        inputs.emplace("in2", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::OnesLike(in1))));
+        InOuts outputs = chxvm.Run(inputs, options);
+        ASSERT_EQ(1, outputs.count("out"));
+        chainerx::Array e = chainerx::testing::BuildArray({2, 2}).WithData<float>({1, 1, 1, 1});
+        EXPECT_ARRAY_EQ(e, outputs["out"]->GetArray());
+    }
+}
+
+TEST(ChxVMTest, RunParallelNoBackprop) {
+    chainerx::testing::ContextSession sess;
+
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "in1");
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(1), "in2");
+    chxvm::AddAddOp(&program, chxvm::ChxVMValue(2), 0, 1);
+    chxvm::AddMulOp(&program, chxvm::ChxVMValue(3), 0, 1);
+    chxvm::AddSubOp(&program, chxvm::ChxVMValue(4), 2, 3);
+    chxvm::AddOutOp(&program, "out", 4);
+
+    ChxVM chxvm(program);
+    ChxVMOptions options;
+    options.num_threads = 4;
+    chainerx::Array in1 = chainerx::Eye(2, absl::nullopt, absl::nullopt, chainerx::Dtype::kFloat32);
+    in1.RequireGrad();
+    InOuts inputs;
+    inputs.emplace("in1", std::shared_ptr<ChxVMVar>(new ChxVMVar(in1)));
+    inputs.emplace("in2", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::OnesLike(in1))));
+
+    {
+        InOuts outputs = chxvm.Run(inputs, options);
+        EXPECT_TRUE(outputs["out"]->GetArray().IsBackpropRequired());
+    }
+    {
+        // Worker threads inherit the backprop mode of the caller.
+        chainerx::NoBackpropModeScope no_backprop;
+        InOuts outputs = chxvm.Run(inputs, options);
+        EXPECT_FALSE(outputs["out"]->GetArray().IsBackpropRequired());
+    }
+}
+
+TEST(ChxVMTest, PlannedOutputBackprop) {
+    chainerx::testing::ContextSession sess;
+
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "in1");
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(1), "in2");
+    chxvm::AddAddOp(&program, chxvm::ChxVMValue(2), 0, 1);
+    chxvm::AddOutOp(&program, "out", 2);
+    ChxVMInstructionProto* add = program.mutable_instructions(2);
+    ChxVMTypeProto* type = add->add_output_types();
+    type->set_dtype(static_cast<int>(chainerx::Dtype::kFloat32));
+    type->add_shape(2);
+    type->add_shape(2);
+    add->add_output_offsets(0);
+    program.set_arena_size(16);
+
+    ChxVM chxvm(program);
+    chainerx::Array in1 = chainerx::Eye(2, absl::nullopt, absl::nullopt, chainerx::Dtype::kFloat32);
+    in1.RequireGrad();
+    InOuts inputs;
+    inputs.emplace("in1", std::shared_ptr<ChxVMVar>(new ChxVMVar(in1)));
+    inputs.emplace("in2", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::OnesLike(in1))));
+
+    {
+        // Arena buffers written by raw kernels are not connected to graphs.
+        std::unique_ptr<ChxVMState> state(chxvm.Prepare(inputs, ChxVMOptions()));
+        chxvm.Run(state.get());
+        EXPECT_EQ(0, state->num_arena_outputs());
+        EXPECT_TRUE(state->GetOutputs().at("out")->GetArray().IsBackpropRequired());
+    }
+    {
+        chainerx::NoBackpropModeScope no_backprop;
+        std::unique_ptr<ChxVMState> state(chxvm.Prepare(inputs, ChxVMOptions()));
+        chxvm.Run(state.get());
+        EXPECT_EQ(1, state->num_arena_outputs());
+        chainerx::Array e = chainerx::testing::BuildArray({2, 2}).WithData<float>({2, 1, 1, 2});
+        EXPECT_ARRAY_EQ(e, state->GetOutputs().at("out")->GetArray());
+    }
+}
+
+TEST(ChxVMTest, RunBoundStateParallel) {
+    chainerx::testing::ContextSession sess;
+
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "in1");
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(1), "in2");
+    chxvm::AddAddOp(&program, chxvm::ChxVMValue(2), 0, 1);
+    chxvm::AddMulOp(&program, chxvm::ChxVMValue(3), 0, 1);
+    chxvm::AddSubOp(&program, chxvm::ChxVMValue(4), 2, 3);
+    chxvm::AddOutOp(&program, "out", 4);
+
+    ChxVM chxvm(program);
+    ChxVMOptions options;
+    options.num_threads = 4;
+    chainerx::Array in1 = chainerx::Eye(2, absl::nullopt, absl::nullopt, chainerx::Dtype::kFloat32);
+    InOuts inputs;
+    inputs.emplace("in1", std::shared_ptr<ChxVMVar>(new ChxVMVar(in1)));
+    inputs.emplace("in2", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::OnesLike(in1))));
+    std::unique_ptr<ChxVMState> state(chxvm.Prepare(inputs, options));
+
+    // Variables are not freed by the program so `Reset` must release
+    // all of them which were set by worker threads.
+    for (int i = 0; i < 10; ++i) {
+        if (i > 0) chxvm.BindInputs(state.get(), inputs);
+        chxvm.Run(state.get());
+        EXPECT_EQ(3, state->num_array_outputs());
+        InOuts outputs = state->GetOutputs();
+        ASSERT_EQ(1, outputs.count("out"));
+        chainerx::Array e = chainerx::testing::BuildArray({2, 2}).WithData<float>({1, 1, 1, 1});
+        EXPECT_ARRAY_EQ(e, outputs["out"]->GetArray());
+    }
+}
+
+TEST(ChxVMTest, Profile) {
+    chainerx::testing::ContextSession sess;
+
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "in1");
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(1), "in2");
+    chxvm::AddAddOp(&program, chxvm::ChxVMValue(2), 0, 1);
+    chxvm::AddMulOp(&program, chxvm::ChxVMValue(3), 2, 1);
+    chxvm::AddIdentityOp(&program, chxvm::ChxVMValue(4), 3);
+    chxvm::AddOutOp(&program, "out", 4);
+
+    ChxVM chxvm(program);
+    ChxVMProfiler profiler;
+    ChxVMOptions options;
+    options.profiler = &profiler;
+    chainerx::Array in1 = chainerx::Eye(2, absl::nullopt, absl::nullopt, chainerx::Dtype::kFloat32);
+    InOuts inputs;
+    inputs.emplace("in1", std::shared_ptr<ChxVMVar>(new ChxVMVar(in1)));
+    inputs.emplace("in2", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::OnesLike(in1))));
+    for (int i = 0; i < 3; ++i) {
+        chxvm.Run(inputs, options);
+    }
+    EXPECT_EQ(3, profiler.num_runs());
+
+    std::map<std::string, ChxVMProfiler::Stats> op_stats = profiler.GetOpStats();
+    ASSERT_EQ(1, op_stats.count("Add"));
+    const ChxVMProfiler::Stats& add = op_stats["Add"];
+    EXPECT_EQ(3, add.count);
+    EXPECT_LE(add.GetPercentileNs(0.5), add.GetPercentileNs(0.99));
+    // Each Add allocates a float32[2, 2].
+    EXPECT_EQ(3 * 16, add.allocated_bytes);
+    // Identity returns a view of its input.
+    EXPECT_EQ(0, op_stats["Identity"].allocated_bytes);
+    // Program inputs are not counted as allocations.
+    EXPECT_EQ(6, op_stats["In"].count);
+    EXPECT_EQ(0, op_stats["In"].allocated_bytes);
+
+    const std::string json = profiler.ToJSON();
+    EXPECT_NE(std::string::npos, json.find("\"op\":\"Mul\""));
+
+    profiler.Reset();
+    EXPECT_EQ(0, profiler.num_runs());
+    EXPECT_EQ(0, profiler.GetOpStats().size());
+}
+
+TEST(ChxVMTest, ProfileProgramsInTurn) {
+    chainerx::testing::ContextSession sess;
+
+    ChxVMProfiler profiler;
+    ChxVMOptions options;
+    options.profiler = &profiler;
+    chainerx::Array in1 = chainerx::Eye(2, absl::nullopt, absl::nullopt, chainerx::Dtype::kFloat32);
+    InOuts inputs;
+    inputs.emplace("in1", std::shared_ptr<ChxVMVar>(new ChxVMVar(in1)));
+
+    // Programs of the same size may be allocated at the same address
+    // after the previous one is destroyed.
+    for (bool is_relu : {true, false}) {
+        ChxVMProgramProto program;
+        chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "in1");
+        if (is_relu) {
+            chxvm::AddReluOp(&program, chxvm::ChxVMValue(1), 0);
+        } else {
+            chxvm::AddSigmoidOp(&program, chxvm::ChxVMValue(1), 0);
+        }
+        chxvm::AddOutOp(&program, "out", 1);
+        std::unique_ptr<ChxVM> chxvm(new ChxVM(program));
+        chxvm->Run(inputs, options);
+    }
+
+    std::map<std::string, ChxVMProfiler::Stats> op_stats = profiler.GetOpStats();
+    EXPECT_EQ(1, op_stats["Relu"].count);
+    EXPECT_EQ(1, op_stats["Sigmoid"].count);
+}
+
+TEST(ChxVMTest, DataflowGraph) {
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "in1");
+    chxvm::AddReluOp(&program, chxvm::ChxVMValue(1), 0);
+    chxvm::AddSigmoidOp(&program, chxvm::ChxVMValue(2), 0);
+    chxvm::AddFreeOp(&program, 0);
+    chxvm::AddJmpOp(&program, 5);
+    chxvm::AddNegOp(&program, chxvm::ChxVMValue(3), 1);
+    chxvm::AddAddOp(&program, chxvm::ChxVMValue(4), 1, 2);
+
+    std::vector<std::unique_ptr<ChxVMOp>> ops;
+    for (const ChxVMInstructionProto& inst : program.instructions()) {
+        ops.emplace_back(MakeChxVMOp(inst));
+    }
+    ChxVMDataflowGraph dataflow(ops, 5);
+
+    ASSERT_EQ(3, dataflow.segments().size());
+    EXPECT_FALSE(dataflow.segments()[0].sequential);
+    EXPECT_EQ(0, dataflow.segments()[0].begin);
+    EXPECT_EQ(4, dataflow.segments()[0].end);
+    EXPECT_TRUE(dataflow.segments()[1].sequential);
+    EXPECT_EQ(4, dataflow.segments()[1].begin);
+    EXPECT_EQ(6, dataflow.segments()[1].end);
+
+    // Relu and Sigmoid only depend on In and Free waits for both.
+    EXPECT_EQ(0, dataflow.num_predecessors(0));
+    EXPECT_EQ(1, dataflow.num_predecessors(1));
+    EXPECT_EQ(1, dataflow.num_predecessors(2));
+    EXPECT_EQ(3, dataflow.num_predecessors(3));
+    EXPECT_EQ(3, dataflow.successors(0).size());
+}
+
+TEST(ChxVMTest, DataflowGraphStreams) {
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "in1");
+    chxvm::AddReluOp(&program, chxvm::ChxVMValue(1), 0);
+    chxvm::AddSigmoidOp(&program, chxvm::ChxVMValue(2), 0);
+    chxvm::AddNegOp(&program, chxvm::ChxVMValue(3), 0);
+    chxvm::AddTanhOp(&program, chxvm::ChxVMValue(4), 0);
+    const std::vector<int> streams = {-1, 0, 1, 0, 0};
+    for (int pc = 0; pc < program.instructions_size(); ++pc) {
+        ChxVMInstructionProto* inst = program.mutable_instructions(pc);
+        inst->set_id(pc + 1);
+        inst->set_stream(streams[pc]);
+    }
+    // Tanh waits for Sigmoid in the other stream.
+    program.mutable_instructions(4)->add_wait_ids(3);
+
+    std::vector<std::unique_ptr<ChxVMOp>> ops;
+    for (const ChxVMInstructionProto& inst : program.instructions()) {
+        ops.emplace_back(MakeChxVMOp(inst));
+    }
+    ChxVMDataflowGraph dataflow(ops, 5);
+
+    ASSERT_EQ(1, dataflow.segments().size());
+    EXPECT_EQ(0, dataflow.num_predecessors(0));
+    EXPECT_EQ(1, dataflow.num_predecessors(1));
+    EXPECT_EQ(1, dataflow.num_predecessors(2));
+    // Neg runs after Relu in the same stream.
+    EXPECT_EQ(2, dataflow.num_predecessors(3));
+    EXPECT_EQ(3, dataflow.num_predecessors(4));
+    EXPECT_EQ(4, dataflow.critical_path_length());
+}
+
+TEST(ChxVMTest, ElementWiseInterpreter) {
+    chainerx::testing::ContextSession sess;
+
+    // Relu(x * s + y) with broadcasted `s` and `y`. Registers are
+    // x, y, s, the output, and a temporary value.
+    const int64_t kMul = static_cast<int64_t>(BytecodeOp::kMul);
+    const int64_t kAdd = static_cast<int64_t>(BytecodeOp::kAdd);
+    const int64_t kRelu = static_cast<int64_t>(BytecodeOp::kRelu);
+    const std::vector<int64_t> bytecode = {kMul, 4, 0, 2, -1, kAdd, 4, 4, 1, -1, kRelu, 3, 4, -1, -1};
+
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "x");
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(1), "y");
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(2), "s");
+    std::vector<chxvm::ChxVMValue> outs = {chxvm::ChxVMValue(3)};
+    chxvm::AddElementWiseInterpreterOp(
+            &program, outs, {0, 1, 2}, 1, bytecode, {}, 5, static_cast<int>(chainerx::Dtype::kFloat32));
+    chxvm::AddOutOp(&program, "out", 3);
+
+    ChxVM chxvm(program);
+    InOuts inputs;
+    chainerx::Array x = chainerx::testing::BuildArray({2, 3}).WithData<float>({1, -2, 3, -4, 5, -6});
+    chainerx::Array y = chainerx::testing::BuildArray({3}).WithData<float>({1, 1, 1});
+    inputs.emplace("x", std::shared_ptr<ChxVMVar>(new ChxVMVar(x)));
+    inputs.emplace("y", std::shared_ptr<ChxVMVar>(new ChxVMVar(y)));
+    inputs.emplace("s", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::Full({}, 2.0f, chainerx::Dtype::kFloat32))));
+    InOuts outputs = chxvm.Run(inputs, ChxVMOptions());
+    ASSERT_EQ(1, outputs.count("out"));
+    chainerx::Array e = chainerx::testing::BuildArray({2, 3}).WithData<float>({3, 0, 7, 0, 11, 0});
+    EXPECT_ARRAY_EQ(e, outputs["out"]->GetArray());
+}
+
+TEST(ChxVMTest, ElementWiseInterpreterRows) {
+    chainerx::testing::ContextSession sess;
+
+    // x - ReduceMax(x, axes=[-1]) + b with a row `b`. Registers are
+    // x, b, the output, and a temporary value.
+    const int64_t kReduceMax = static_cast<int64_t>(BytecodeOp::kReduceMax);
+    const int64_t kSub = static_cast<int64_t>(BytecodeOp::kSub);
+    const int64_t kAdd = static_cast<int64_t>(BytecodeOp::kAdd);
+    const std::vector<int64_t> bytecode = {kReduceMax, 3, 0, -1, -1, kSub, 3, 0, 3, -1, kAdd, 2, 3, 1, -1};
+
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "x");
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(1), "b");
+    std::vector<chxvm::ChxVMValue> outs = {chxvm::ChxVMValue(2)};
+    chxvm::AddElementWiseInterpreterOp(&program, outs, {0, 1}, 1, bytecode, {}, 4, static_cast<int>(chainerx::Dtype::kFloat32));
+    chxvm::AddOutOp(&program, "out", 2);
+
+    ChxVM chxvm(program);
+    InOuts inputs;
+    chainerx::Array x = chainerx::testing::BuildArray({2, 3}).WithData<float>({1, 5, 3, -2, -4, 0});
+    chainerx::Array b = chainerx::testing::BuildArray({3}).WithData<float>({1, 2, 3});
+    inputs.emplace("x", std::shared_ptr<ChxVMVar>(new ChxVMVar(x)));
+    inputs.emplace("b", std::shared_ptr<ChxVMVar>(new ChxVMVar(b)));
+    InOuts outputs = chxvm.Run(inputs, ChxVMOptions());
+    ASSERT_EQ(1, outputs.count("out"));
+    chainerx::Array e = chainerx::testing::BuildArray({2, 3}).WithData<float>({-3, 2, 1, -1, -2, 3});
+    EXPECT_ARRAY_EQ(e, outputs["out"]->GetArray());
+}
+
+TEST(ChxVMTest, LayoutConv) {
+    chainerx::testing::ContextSession sess;
+
+    // Converts an NCHW image with 3 channels to NCHW8c, runs a 1x1
+    // convolution which doubles each channel, and converts it back.
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "x");
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(1), "w");
+    chxvm::AddLayoutConvertOp(&program, chxvm::ChxVMValue(2), 0, "NCHW", "NCHW8c", 0);
+    chxvm::AddLayoutConvOp(
+            &program,
+            chxvm::ChxVMValue(3),
+            2,
+            1,
+            -1,
+            -1,
+            {1, 1},
+            {0, 0, 0, 0},
+            1,
+            "NCHW8c",
+            "",
+            0.01f,
+            -std::numeric_limits<float>::infinity(),
+            std::numeric_limits<float>::infinity());
+    chxvm::AddLayoutConvertOp(&program, chxvm::ChxVMValue(4), 3, "NCHW8c", "NCHW", 3);
+    chxvm::AddOutOp(&program, "blocked", 2);
+    chxvm::AddOutOp(&program, "out", 4);
+
+    ChxVM chxvm(program);
+    InOuts inputs;
+    chainerx::Array x = chainerx::testing::BuildArray({1, 3, 1, 2}).WithData<float>({1, 2, 3, 4, 5, 6});
+    std::vector<float> w(64);
+    for (int i = 0; i < 8; ++i) w[i * 8 + i] = 2;
+    inputs.emplace("x", std::shared_ptr<ChxVMVar>(new ChxVMVar(x)));
+    inputs.emplace("w", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::testing::BuildArray({1, 1, 1, 1, 8, 8}).WithData<float>(w))));
+    InOuts outputs = chxvm.Run(inputs, ChxVMOptions());
+    ASSERT_EQ(1, outputs.count("out"));
+    chainerx::Array blocked = outputs["blocked"]->GetArray();
+    EXPECT_EQ(chainerx::Shape({1, 1, 1, 2, 8}), blocked.shape());
+    chainerx::Array e = chainerx::testing::BuildArray({1, 3, 1, 2}).WithData<float>({2, 4, 6, 8, 10, 12});
+    EXPECT_ARRAY_EQ(e, outputs["out"]->GetArray());
+}
+
+TEST(ChxVMTest, PackedLinear) {
+    chainerx::testing::ContextSession sess;
+
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "x");
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(1), "w");
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(2), "b");
+    chxvm::AddPackMatrixWeightOp(&program, chxvm::ChxVMValue(3), 1, 1);
+    chxvm::AddPackedLinearOp(&program, chxvm::ChxVMValue(4), 0, 3, 2, 1, "Relu");
+    chxvm::AddOutOp(&program, "y", 4);
+
+    ChxVM chxvm(program);
+    InOuts inputs;
+    chainerx::Array w = chainerx::testing::BuildArray({3, 2}).WithData<float>({1, 0, 0, 1, 1, -1});
+    inputs.emplace("w", std::shared_ptr<ChxVMVar>(new ChxVMVar(w)));
+    inputs.emplace("b", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::testing::BuildArray({3}).WithData<float>({0, 1, -10}))));
+    // The weight packed by the first run is reused by the second one.
+    for (int i = 0; i < 2; ++i) {
+        chainerx::Array x = chainerx::testing::BuildArray({2, 2}).WithData<float>({1.0f + i, 2, 3, 4});
+        inputs["x"] = std::shared_ptr<ChxVMVar>(new ChxVMVar(x));
+        InOuts outputs = chxvm.Run(inputs, ChxVMOptions());
+        chainerx::Array e = chainerx::testing::BuildArray({2, 3}).WithData<float>({1.0f + i, 3, 0, 3, 5, 0});
+        EXPECT_ARRAY_EQ(e, outputs["y"]->GetArray());
+    }
+}
+
 }  // namespace
 }  // namespace runtime
 }  // namespace chainer_compiler
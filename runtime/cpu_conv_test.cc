@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <chainerx/array.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/routines/linalg.h>
+#include <chainerx/routines/manipulation.h>
+#include <chainerx/testing/array_check.h>
+#include <chainerx/testing/context_session.h>
+
+#include <runtime/chainerx_util.h>
+#include <runtime/ops/cpu_conv.h>
+
+namespace chainer_compiler {
+namespace runtime {
+namespace {
+
+struct ConvTestCase {
+    int64_t in_channels;
+    int64_t out_channels;
+    int64_t group;
+    int64_t kernel;
+    int64_t stride;
+    int64_t pad;
+};
+
+const ConvTestCase kConvTestCases[] = {
+        {3, 5, 1, 3, 1, 1},
+        {17, 19, 1, 3, 1, 1},
+        {16, 20, 1, 3, 1, 0},
+        {8, 12, 1, 1, 1, 0},
+        {6, 9, 3, 3, 2, 1},
+        {5, 5, 5, 3, 1, 1},
+        {4, 8, 4, 5, 2, 2},
+        {3, 70, 1, 7, 2, 3},
+        // The depth of the GEMM is larger than a block of panels.
+        {300, 7, 1, 1, 1, 0},
+};
+
+chainerx::Array Random(const chainerx::Shape& shape) {
+    return SlowRandom(shape).AsType(chainerx::Dtype::kFloat64);
+}
+
+// Compares the engine with ChainerX on odd image sizes so tiles of
+// the GEMM and Winograd have remainders.
+TEST(CpuConvTest, CompareWithChainerX) {
+    chainerx::testing::ContextSession sess;
+
+    for (const ConvTestCase& c : kConvTestCases) {
+        const Int64StackVector strides{c.stride, c.stride};
+        const Int64StackVector pads{c.pad, c.pad};
+        const chainerx::Array x = Random({2, c.in_channels, 11, 9});
+        const chainerx::Array w = Random({c.out_channels, c.in_channels / c.group, c.kernel, c.kernel});
+        const chainerx::Array b = Random({c.out_channels});
+        const chainerx::Shape y_shape = GetConvOutputShape(x.shape(), w.shape(), strides, pads);
+        const ConvShape shape = MakeConvShape(x.shape(), w.shape(), y_shape, strides, pads, c.group);
+        SCOPED_TRACE(shape.ToString());
+
+        const chainerx::Array expected = GroupedConv(x, w, b, strides, pads, c.group, "NOTSET");
+        for (ConvAlgorithm algorithm :
+             {ConvAlgorithm::kIm2col, ConvAlgorithm::kDirect1x1, ConvAlgorithm::kWinograd, ConvAlgorithm::kDepthwise}) {
+            if (!IsConvAlgorithmSupported(shape, algorithm)) continue;
+            SCOPED_TRACE(GetConvAlgorithmName(algorithm));
+            chainerx::Array y = chainerx::Empty(y_shape, x.dtype(), x.device());
+            CpuConv(x, w, b, shape, algorithm, y);
+            EXPECT_ARRAY_ALL_CLOSE(expected, y);
+        }
+
+        const chainerx::Array gy = Random(y_shape);
+        chainerx::Array gw = chainerx::Empty(w.shape(), w.dtype(), w.device());
+        CpuConvGradWeight(x, gy, shape, gw);
+        EXPECT_ARRAY_ALL_CLOSE(GroupedConvGradWeight(w, x, gy, strides, pads, c.group), gw);
+
+        const Int64StackVector out_size{x.shape()[2], x.shape()[3]};
+        chainerx::Array gx = chainerx::Empty(x.shape(), x.dtype(), x.device());
+        CpuConvTranspose(gy, w, absl::nullopt, shape, gx);
+        EXPECT_ARRAY_ALL_CLOSE(GroupedConvTranspose(gy, w, absl::nullopt, strides, pads, out_size, c.group), gx);
+    }
+}
+
+TEST(CpuConvTest, PackedFilter) {
+    chainerx::testing::ContextSession sess;
+
+    for (const ConvTestCase& c : kConvTestCases) {
+        const Int64StackVector strides{c.stride, c.stride};
+        const Int64StackVector pads{c.pad, c.pad};
+        const chainerx::Array x = Random({2, c.in_channels, 11, 9});
+        const chainerx::Array w = Random({c.out_channels, c.in_channels / c.group, c.kernel, c.kernel});
+        const chainerx::Array b = Random({c.out_channels});
+        const chainerx::Shape y_shape = GetConvOutputShape(x.shape(), w.shape(), strides, pads);
+        const ConvShape shape = MakeConvShape(x.shape(), w.shape(), y_shape, strides, pads, c.group);
+        SCOPED_TRACE(shape.ToString());
+
+        const chainerx::Array expected = GroupedConv(x, w, b, strides, pads, c.group, "NOTSET");
+        // Filters for kDepthwise are not packed and run by CpuConv.
+        for (ConvAlgorithm algorithm : {ConvAlgorithm::kIm2col, ConvAlgorithm::kWinograd, ConvAlgorithm::kDepthwise}) {
+            if (!IsConvAlgorithmSupported(shape, algorithm)) continue;
+            SCOPED_TRACE(GetConvAlgorithmName(algorithm));
+            const PackedFilter filter = PackFilter(w, c.group, algorithm);
+            EXPECT_EQ(algorithm != ConvAlgorithm::kDepthwise, filter.panels.has_value());
+            chainerx::Array y = chainerx::Empty(y_shape, x.dtype(), x.device());
+            CpuConvPacked(x, filter, b, shape, y);
+            EXPECT_ARRAY_ALL_CLOSE(expected, y);
+        }
+    }
+}
+
+TEST(CpuConvTest, PackedMatrix) {
+    chainerx::testing::ContextSession sess;
+
+    // (rows, depth, units) with remainders of panels and blocks.
+    const int64_t cases[][3] = {{1, 784, 10}, {7, 300, 33}, {64, 513, 5}, {3, 17, 100}};
+    for (const auto& c : cases) {
+        for (bool trans : {false, true}) {
+            SCOPED_TRACE(testing::Message() << c[0] << "x" << c[1] << "x" << c[2] << (trans ? " trans" : ""));
+            const chainerx::Array x = Random({c[0], c[1]});
+            const chainerx::Array w = trans ? Random({c[2], c[1]}) : Random({c[1], c[2]});
+            const PackedMatrix matrix = PackMatrix(w, trans);
+            ASSERT_TRUE(matrix.panels.has_value());
+            EXPECT_EQ(c[1], matrix.depth);
+            EXPECT_EQ(c[2], matrix.units);
+            chainerx::Array y = chainerx::Empty({c[0], c[2]}, x.dtype(), x.device());
+            CpuMatMulPacked(x, matrix, y);
+            EXPECT_ARRAY_ALL_CLOSE(chainerx::Dot(x, trans ? chainerx::Transpose(w) : w), y);
+        }
+    }
+}
+
+TEST(CpuConvTest, ChooseAlgorithm) {
+    const Int64StackVector strides{1, 1};
+    const Int64StackVector no_pads{0, 0};
+    const Int64StackVector pads{1, 1};
+    const ConvShape pointwise = MakeConvShape({1, 64, 56, 56}, {64, 64, 1, 1}, {1, 64, 56, 56}, strides, no_pads, 1);
+    const ConvShape winograd = MakeConvShape({1, 64, 56, 56}, {64, 64, 3, 3}, {1, 64, 56, 56}, strides, pads, 1);
+    const ConvShape depthwise = MakeConvShape({1, 64, 56, 56}, {64, 1, 3, 3}, {1, 64, 56, 56}, strides, pads, 64);
+    const ConvShape small = MakeConvShape({1, 3, 224, 224}, {8, 3, 3, 3}, {1, 8, 224, 224}, strides, pads, 1);
+    EXPECT_EQ(ConvAlgorithm::kDirect1x1, ChooseConvAlgorithm(pointwise));
+    EXPECT_EQ(ConvAlgorithm::kWinograd, ChooseConvAlgorithm(winograd));
+    EXPECT_EQ(ConvAlgorithm::kDepthwise, ChooseConvAlgorithm(depthwise));
+    EXPECT_EQ(ConvAlgorithm::kIm2col, ChooseConvAlgorithm(small));
+
+    // Entries of the tuning table override the heuristic unless they
+    // do not support the shape.
+    const ConvAlgorithm saved_winograd = SetConvTuningEntry(winograd, ConvAlgorithm::kIm2col);
+    EXPECT_EQ(ConvAlgorithm::kIm2col, ChooseConvAlgorithm(winograd));
+    const ConvAlgorithm saved_small = SetConvTuningEntry(small, ConvAlgorithm::kWinograd);
+    EXPECT_EQ(ConvAlgorithm::kWinograd, ChooseConvAlgorithm(small));
+    const ConvAlgorithm saved_pointwise = SetConvTuningEntry(pointwise, ConvAlgorithm::kDepthwise);
+    EXPECT_EQ(ConvAlgorithm::kDirect1x1, ChooseConvAlgorithm(pointwise));
+
+    // Restore the global table for other tests.
+    EXPECT_EQ(ConvAlgorithm::kDepthwise, SetConvTuningEntry(pointwise, saved_pointwise));
+    EXPECT_EQ(ConvAlgorithm::kWinograd, SetConvTuningEntry(small, saved_small));
+    EXPECT_EQ(ConvAlgorithm::kIm2col, SetConvTuningEntry(winograd, saved_winograd));
+    EXPECT_EQ(ConvAlgorithm::kWinograd, ChooseConvAlgorithm(winograd));
+    EXPECT_EQ(ConvAlgorithm::kIm2col, ChooseConvAlgorithm(small));
+}
+
+}  // namespace
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,62 @@
+// Bytecode for fusion groups of element-wise operations, which is
+// interpreted by ElementWiseInterpreterOp without a JIT compiler.
+//
+// An instruction consists of `kBytecodeInstructionSize` integers: an
+// opcode, a destination register, and three source registers (-1 if
+// unused). Each register holds a tile of elements. Registers are
+// numbered as follows:
+//
+//   [0, num_inputs): inputs of the group
+//   [num_inputs, num_inputs + num_outputs): outputs of the group
+//   [.., .. + num_constants): constants, which are broadcasted
+//   [.., num_registers): temporary values
+//
+// Reductions and normalizations (kReduce* and k*Softmax) work on rows,
+// i.e., segments of the last axis of outputs. A tile of a program
+// which contains them consists of whole rows, and a reduced value is
+// broadcasted to its row so following element-wise operations can
+// use it as is.
+
+#pragma once
+
+#include <cstdint>
+
+namespace chainer_compiler {
+namespace runtime {
+
+enum class BytecodeOp {
+    kCopy = 0,
+    kNeg,
+    kRelu,
+    kSqrt,
+    kExp,
+    kTanh,
+    kSigmoid,
+    kLog,
+    kAdd,
+    kSub,
+    kMul,
+    kDiv,
+    kPow,
+    // dst = min(max(src0, src1), src2).
+    kClip,
+    // dst = src0 ? src1 : src2.
+    kWhere,
+    // Row-wise operations.
+    kReduceSum,
+    kReduceSumSquare,
+    kReduceMean,
+    kReduceMax,
+    kSoftmax,
+    kLogSoftmax,
+    kNumOps,
+};
+
+constexpr int kBytecodeInstructionSize = 5;
+
+inline bool IsRowwiseBytecodeOp(int64_t op) {
+    return op >= static_cast<int64_t>(BytecodeOp::kReduceSum) && op < static_cast<int64_t>(BytecodeOp::kNumOps);
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -107,6 +107,7 @@ def gen_gen_chxvm_ops_h():
             rettype = 'void'
         lines.append('%s RunImpl(%s);' % (rettype, ', '.join(args)))
         lines.append('virtual void Run(ChxVMState* st) override;')
+        lines.append('virtual void RunDebug(ChxVMState* st) override;')
 
         lines.append('private:')
         for inp in op.inputs:
@@ -150,6 +151,84 @@ namespace runtime {
 ''')
 
 
+# Emits code which reads inputs, calls RunImpl, and sets outputs. For
+# ops with multiple outputs, `trace_line` is emitted after each output.
+def gen_run_body(op, lines, trace_line=None):
+    if op.typed:
+        args = ['st']
+
+        # TODO(hamaji): Remove this code by removing null gradients.
+        conds = []
+        for typ, name in op.inputs:
+            if typ in ARG_TYPES and typ != ARRAY_LIST:
+                conds.append('(%s >= 0 && st->GetVar(%s)->IsNull())' %
+                             (name, name))
+        if conds:
+            lines.append('if (%s) {' % (' || '.join(conds)))
+            lines.append('WARN_ONCE("%s skipped due to null gradients");' %
+                         op.name)
+            for typ, oname in op.outputs:
+                if typ in ARG_TYPES and typ != ARRAY_LIST:
+                    lines.append('st->SetVar(%s, ChxVMVar());' % oname)
+            lines.append('return;')
+            lines.append('}')
+
+        for typ, name in op.inputs:
+            if typ == ARRAY:
+                args.append('st->GetArray(%s)' % name)
+            elif typ == OPTIONAL_ARRAY:
+                args.append('st->GetOptionalArray(%s)' % name)
+            elif typ == ARRAY_LIST:
+                args.append('st->GetArrayList(%s)' % name)
+            elif typ == SEQUENCE:
+                args.append('*st->GetSequence(%s)' % name)
+            elif typ == OPAQUE:
+                args.append('st->GetOpaque(%s)' % name)
+            elif typ == SHAPE:
+                args.append('st->GetShape(%s)' % name)
+            elif typ == SCALAR:
+                args.append('st->GetScalar(%s)' % name)
+            elif typ == OPTIONAL_SCALAR:
+                args.append('st->GetOptionalScalar(%s)' % name)
+
+        outputs = []
+        for output in op.outputs:
+            typ, name = output
+            if typ == SEQUENCE:
+                args.append('st->CreateSequence(%s)' % name)
+            else:
+                outputs.append(output)
+
+        call = 'RunImpl(%s)' % ', '.join(args)
+        if len(outputs) == 1:
+            typ, name = outputs[0]
+            if typ == ARRAY_LIST:
+                lines.append('st->SetArrayList(%s, %s);' % (name, call))
+            elif typ == OPAQUE:
+                lines.append('st->SetOpaque(%s, %s);' % (name, call))
+            elif typ == SHAPE:
+                lines.append('st->SetShape(%s, %s);' % (name, call))
+            elif typ == SCALAR:
+                lines.append('st->SetScalar(%s, %s);' % (name, call))
+            else:
+                lines.append('st->SetArray(%s, %s);' % (name, call))
+        elif outputs:
+            lines.append('auto r_ = ' + call + ';')
+            for i, (typ, output) in enumerate(outputs):
+                # TODO(hamaji): Revisit optional outputs.
+                if typ == OPAQUE:
+                    lines.append('if (%s >= 0) st->SetOpaque(%s, std::get<%d>(r_));' % (output, output, i))
+                    lines.append('else delete std::get<%d>(r_);' % i)
+                else:
+                    lines.append('if (%s >= 0) st->SetArray(%s, std::get<%d>(r_));' % (output, output, i))
+                if trace_line:
+                    lines.append(trace_line)
+        else:
+            lines.append(call + ';')
+    else:
+        lines.append('RunImpl(st);')
+
+
 def gen_gen_chxvm_ops_cc():
     lines = []
 
@@ -189,8 +268,13 @@ def gen_gen_chxvm_ops_cc():
 
         lines.append('}')
 
-        # Emit Run.
+        # Emit Run, which is the fast path without any traces or checks.
         lines.append('void %sOp::Run(ChxVMState* st) {' % op.name)
+        gen_run_body(op, lines)
+        lines.append('}')
+
+        # Emit RunDebug.
+        lines.append('void %sOp::RunDebug(ChxVMState* st) {' % op.name)
 
         lines.append('if (st->trace_level() && !debug_info().empty()) '
                      'std::cerr << "# " << debug_info() << std::endl;')
@@ -236,78 +320,7 @@ def gen_gen_chxvm_ops_cc():
             line += ';'
             lines.append(line)
 
-        if op.typed:
-            args = ['st']
-
-            # TODO(hamaji): Remove this code by removing null gradients.
-            conds = []
-            for typ, name in op.inputs:
-                if typ in ARG_TYPES and typ != ARRAY_LIST:
-                    conds.append('(%s >= 0 && st->GetVar(%s)->IsNull())' %
-                                 (name, name))
-            if conds:
-                lines.append('if (%s) {' % (' || '.join(conds)))
-                lines.append('WARN_ONCE("%s skipped due to null gradients");' %
-                             op.name)
-                for typ, oname in op.outputs:
-                    if typ in ARG_TYPES and typ != ARRAY_LIST:
-                        lines.append('st->SetVar(%s, ChxVMVar());' % oname)
-                lines.append('return;')
-                lines.append('}')
-
-            for typ, name in op.inputs:
-                if typ == ARRAY:
-                    args.append('st->GetArray(%s)' % name)
-                elif typ == OPTIONAL_ARRAY:
-                    args.append('st->GetOptionalArray(%s)' % name)
-                elif typ == ARRAY_LIST:
-                    args.append('st->GetArrayList(%s)' % name)
-                elif typ == SEQUENCE:
-                    args.append('*st->GetSequence(%s)' % name)
-                elif typ == OPAQUE:
-                    args.append('st->GetOpaque(%s)' % name)
-                elif typ == SHAPE:
-                    args.append('st->GetShape(%s)' % name)
-                elif typ == SCALAR:
-                    args.append('st->GetScalar(%s)' % name)
-                elif typ == OPTIONAL_SCALAR:
-                    args.append('st->GetOptionalScalar(%s)' % name)
-
-            outputs = []
-            for output in op.outputs:
-                typ, name = output
-                if typ == SEQUENCE:
-                    args.append('st->CreateSequence(%s)' % name)
-                else:
-                    outputs.append(output)
-
-            call = 'RunImpl(%s)' % ', '.join(args)
-            if len(outputs) == 1:
-                typ, name = outputs[0]
-                if typ == ARRAY_LIST:
-                    lines.append('st->SetArrayList(%s, %s);' % (name, call))
-                elif typ == OPAQUE:
-                    lines.append('st->SetOpaque(%s, %s);' % (name, call))
-                elif typ == SHAPE:
-                    lines.append('st->SetShape(%s, %s);' % (name, call))
-                elif typ == SCALAR:
-                    lines.append('st->SetScalar(%s, %s);' % (name, call))
-                else:
-                    lines.append('st->SetArray(%s, %s);' % (name, call))
-            elif outputs:
-                lines.append('auto r_ = ' + call + ';')
-                for i, (typ, output) in enumerate(outputs):
-                    # TODO(hamaji): Revisit optional outputs.
-                    if typ == OPAQUE:
-                        lines.append('if (%s >= 0) st->SetOpaque(%s, std::get<%d>(r_));' % (output, output, i))
-                        lines.append('else delete std::get<%d>(r_);' % i)
-                    else:
-                        lines.append('if (%s >= 0) st->SetArray(%s, std::get<%d>(r_));' % (output, output, i))
-                    lines.append(line)
-            else:
-                lines.append(call + ';')
-        else:
-            lines.append('RunImpl(st);')
+        gen_run_body(op, lines, line)
 
         line = 'if (st->trace_level()) std::cerr'
         for typ, name in op.outputs:
@@ -1,5 +1,7 @@
 #include <limits>
 
+#include <chainerx/kernels/arithmetic.h>
+#include <chainerx/kernels/hyperbolic.h>
 #include <chainerx/kernels/misc.h>
 #include <chainerx/routines/activation.h>
 #include <chainerx/routines/creation.h>
@@ -12,17 +14,29 @@
 
 #include <common/log.h>
 #include <runtime/chainerx_util.h>
+#include <runtime/chxvm_state.h>
 #include <runtime/gen_chxvm_ops.h>
 
 namespace chainer_compiler {
 namespace runtime {
 
 chainerx::Array ReluOp::RunImpl(ChxVMState* st, const chainerx::Array& x) {
+    if (st->CanOverwriteInput(inst_, 0, x)) {
+        x.device().backend().CallKernel<chainerx::IfLessElseASSAKernel>(x, chainerx::Scalar(0.0), chainerx::Scalar(0.0), x, x);
+        return x;
+    }
     return chainerx::Relu(x);
 }
 
 chainerx::Array ReluGradOp::RunImpl(ChxVMState* st, const chainerx::Array& x, const chainerx::Array& gy) {
-    chainerx::Array out = chainerx::EmptyLike(x, x.device());
+    chainerx::Array out;
+    if (x.shape() == gy.shape() && x.dtype() == gy.dtype() && st->CanOverwriteInput(inst_, 1, gy)) {
+        out = gy;
+    } else if (x.shape() == gy.shape() && x.dtype() == gy.dtype() && st->CanOverwriteInput(inst_, 0, x)) {
+        out = x;
+    } else {
+        out = chainerx::EmptyLike(x, x.device());
+    }
     double eps;
     // TODO(hamaji): Use IsLessElseSAAS once it is added.
     if (x.dtype() == chainerx::Dtype::kFloat16) {
@@ -59,10 +73,23 @@ chainerx::Array EluOp::RunImpl(ChxVMState* st, const chainerx::Array& x) {
 }
 
 chainerx::Array TanhOp::RunImpl(ChxVMState* st, const chainerx::Array& a) {
+    if (IsFloat(a.dtype()) && st->CanOverwriteInput(inst_, 0, a)) {
+        a.device().backend().CallKernel<chainerx::TanhKernel>(a, a);
+        return a;
+    }
     return chainerx::Tanh(a);
 }
 
 chainerx::Array SigmoidOp::RunImpl(ChxVMState* st, const chainerx::Array& a) {
+    if (IsFloat(a.dtype()) && st->CanOverwriteInput(inst_, 0, a)) {
+        // sigmoid(x) = tanh(x / 2) / 2 + 1 / 2
+        chainerx::Backend& backend = a.device().backend();
+        backend.CallKernel<chainerx::MultiplyASKernel>(a, chainerx::Scalar(0.5), a);
+        backend.CallKernel<chainerx::TanhKernel>(a, a);
+        backend.CallKernel<chainerx::MultiplyASKernel>(a, chainerx::Scalar(0.5), a);
+        backend.CallKernel<chainerx::AddASKernel>(a, chainerx::Scalar(0.5), a);
+        return a;
+    }
     return Sigmoid(a);
 }
 
@@ -1,14 +1,300 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <chainerx/kernels/connection.h>
+#include <chainerx/kernels/linalg.h>
+#include <chainerx/routines/activation.h>
 #include <chainerx/routines/connection.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/routines/hyperbolic.h>
+#include <chainerx/routines/indexing.h>
 #include <chainerx/routines/linalg.h>
+#include <chainerx/routines/logic.h>
 #include <chainerx/routines/manipulation.h>
+#include <chainerx/routines/misc.h>
 
 #include <common/log.h>
 #include <runtime/chainerx_util.h>
+#include <runtime/chxvm_state.h>
 #include <runtime/gen_chxvm_ops.h>
+#include <runtime/ops/cpu_conv.h>
+#include <runtime/ops/fused_activation.h>
 
 namespace chainer_compiler {
 namespace runtime {
 
+namespace {
+
+// Applies the bias, the residual, and the activation to `num_samples`
+// contiguous samples of the output in place.
+template <FusedActivation kActivation, typename T>
+void ApplyEpilogueImpl(
+        T* y, const T* b, const T* z, int64_t num_samples, int64_t num_channels, int64_t spatial_size, const Epilogue& ep) {
+    if (spatial_size == 1 && !z) {
+        // The output of Linear.
+        for (int64_t n = 0; n < num_samples; ++n) {
+            T* yp = y + n * num_channels;
+            if (b) {
+                for (int64_t c = 0; c < num_channels; ++c) {
+                    yp[c] = Activate<kActivation>(yp[c] + b[c], ep);
+                }
+            } else {
+                for (int64_t c = 0; c < num_channels; ++c) {
+                    yp[c] = Activate<kActivation>(yp[c], ep);
+                }
+            }
+        }
+        return;
+    }
+
+    for (int64_t n = 0; n < num_samples; ++n) {
+        for (int64_t c = 0; c < num_channels; ++c) {
+            const int64_t offset = (n * num_channels + c) * spatial_size;
+            T* yp = y + offset;
+            const T bias = b ? b[c] : 0;
+            if (z) {
+                const T* zp = z + offset;
+                for (int64_t i = 0; i < spatial_size; ++i) {
+                    yp[i] = Activate<kActivation>(yp[i] + bias + zp[i], ep);
+                }
+            } else {
+                for (int64_t i = 0; i < spatial_size; ++i) {
+                    yp[i] = Activate<kActivation>(yp[i] + bias, ep);
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+void ApplyEpilogue(
+        T* y, const T* b, const T* z, int64_t num_samples, int64_t num_channels, int64_t spatial_size, const Epilogue& ep) {
+    DispatchActivation(ep.activation, [&](auto act) {
+        ApplyEpilogueImpl<decltype(act)::value>(y, b, z, num_samples, num_channels, spatial_size, ep);
+    });
+}
+
+chainerx::Array ApplyActivation(const chainerx::Array& y, const Epilogue& ep) {
+    switch (ep.activation) {
+        case FusedActivation::kNone:
+            return y;
+        case FusedActivation::kRelu:
+            return chainerx::Relu(y);
+        case FusedActivation::kLeakyRelu:
+            return chainerx::Where(y >= chainerx::Zeros({}, y.dtype(), y.device()), y, ep.alpha * y);
+        case FusedActivation::kSigmoid:
+            return chainerx::Sigmoid(y);
+        case FusedActivation::kTanh:
+            return chainerx::Tanh(y);
+        case FusedActivation::kClip:
+            return chainerx::Minimum(chainerx::Maximum(y, ep.min), ep.max);
+    }
+    CHECK(false);
+    return y;
+}
+
+chainerx::Array ApplyActivationGrad(const chainerx::Array& y, const chainerx::Array& gy, FusedActivation activation) {
+    switch (activation) {
+        case FusedActivation::kNone:
+            return gy;
+        case FusedActivation::kRelu:
+            return chainerx::Where(y > chainerx::Zeros({}, y.dtype(), y.device()), gy, 0);
+        case FusedActivation::kSigmoid:
+            return gy * y * (1 - y);
+        case FusedActivation::kTanh:
+            return gy * (1 - y * y);
+        default:
+            CHECK(false) << "Gradient of the fused activation is not supported";
+    }
+    return gy;
+}
+
+// Returns the pointer to the first element of a contiguous array,
+// which may be a view with an offset (e.g., a planned output).
+template <typename T>
+T* ContiguousData(const chainerx::Array& a) {
+    return reinterpret_cast<T*>(static_cast<char*>(a.raw_data()) + a.offset());
+}
+
+// The size of output samples computed at once. The epilogue is
+// applied while they are still in cache.
+constexpr int64_t kEpilogueTileBytes = 512 * 1024;
+
+bool IsNativeFloat(const chainerx::Array& x) {
+    return IsNativeDevice(&x.device()) && (x.dtype() == chainerx::Dtype::kFloat32 || x.dtype() == chainerx::Dtype::kFloat64);
+}
+
+chainerx::Array GetOutputArray(
+        ChxVMState* st, const ChxVMInstructionProto& inst, int index, const chainerx::Shape& shape, const chainerx::Array& like) {
+    if (absl::optional<chainerx::Array> planned = st->GetPlannedOutput(inst, index, shape, like.dtype(), like.device())) {
+        return *planned;
+    }
+    return chainerx::Empty(shape, like.dtype(), like.device());
+}
+
+template <typename T>
+void LinearActivationImpl(
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& b,
+        const Epilogue& ep,
+        const chainerx::Array& y) {
+    const int64_t batch_size = y.shape()[0];
+    const int64_t num_units = y.shape()[1];
+    const int64_t tile_size = std::max<int64_t>(1, kEpilogueTileBytes / std::max<int64_t>(1, num_units * y.GetItemSize()));
+    const chainerx::Array wt = chainerx::Transpose(w);
+    const T* bp = b.has_value() ? ContiguousData<const T>(*b) : nullptr;
+    for (int64_t start = 0; start < batch_size; start += tile_size) {
+        const int64_t end = std::min(batch_size, start + tile_size);
+        chainerx::Array xt = x.At({chainerx::Slice(start, end)});
+        chainerx::Array yt = y.At({chainerx::Slice(start, end)});
+        x.device().backend().CallKernel<chainerx::DotKernel>(xt, wt, yt);
+        ApplyEpilogue<T>(ContiguousData<T>(y) + start * num_units, bp, nullptr, end - start, num_units, 1, ep);
+    }
+}
+
+// Runs ConvTranspose by the CPU convolution engine, or returns nullopt
+// if the engine does not support it or backprop is required.
+// `out_size` is empty or spatial dimensions of the output.
+absl::optional<chainerx::Array> RunCpuConvTranspose(
+        ChxVMState* st,
+        const ChxVMInstructionProto& inst,
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& b,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        const Int64StackVector& out_size,
+        int group) {
+    if (!CanUseCpuConv(x, w, b, strides, pads) || IsAnyBackpropRequired({x, w, b})) return absl::nullopt;
+    chainerx::Shape y_shape{x.shape()[0], w.shape()[1] * group};
+    for (size_t i = 0; i < pads.size(); ++i) {
+        y_shape.push_back(out_size.empty() ? strides[i] * (x.shape()[2 + i] - 1) + w.shape()[2 + i] - pads[i] * 2 : out_size[i]);
+    }
+    // The shape of the convolution whose input gradient is `y`.
+    const ConvShape shape = MakeConvShape(y_shape, w.shape(), x.shape(), strides, pads, group);
+    chainerx::Array y = GetOutputArray(st, inst, 0, y_shape, x);
+    CpuConvTranspose(x, w, b, shape, y);
+    return y;
+}
+
+// Runs `conv` on tiles of samples of `x` into the contiguous `y` and
+// applies the epilogue to each tile while it is in cache.
+void RunConvWithEpilogue(
+        const chainerx::Array& x,
+        const absl::optional<chainerx::Array>& b,
+        const absl::optional<chainerx::Array>& z,
+        const Epilogue& ep,
+        const chainerx::Array& y,
+        const std::function<void(const chainerx::Array& xt, const chainerx::Array& yt)>& conv) {
+    CHECK(y.IsContiguous());
+    absl::optional<chainerx::Array> bc, zc;
+    if (b.has_value()) bc = chainerx::AsContiguous(*b);
+    if (z.has_value()) zc = chainerx::AsContiguous(*z);
+
+    const chainerx::Dtype dtype = x.dtype();
+    const int64_t batch_size = y.shape()[0];
+    const int64_t num_channels = y.shape()[1];
+    const int64_t sample_size = y.GetTotalSize() / std::max<int64_t>(batch_size, 1);
+    const int64_t spatial_size = sample_size / std::max<int64_t>(num_channels, 1);
+    const int64_t tile_size = std::max<int64_t>(1, kEpilogueTileBytes / std::max<int64_t>(1, sample_size * y.GetItemSize()));
+
+    for (int64_t start = 0; start < batch_size; start += tile_size) {
+        const int64_t end = std::min(batch_size, start + tile_size);
+        conv(x.At({chainerx::Slice(start, end)}), y.At({chainerx::Slice(start, end)}));
+
+        const int64_t offset = start * sample_size;
+        if (dtype == chainerx::Dtype::kFloat32) {
+            ApplyEpilogue<float>(
+                    ContiguousData<float>(y) + offset,
+                    bc.has_value() ? ContiguousData<const float>(*bc) : nullptr,
+                    zc.has_value() ? ContiguousData<const float>(*zc) + offset : nullptr,
+                    end - start,
+                    num_channels,
+                    spatial_size,
+                    ep);
+        } else {
+            ApplyEpilogue<double>(
+                    ContiguousData<double>(y) + offset,
+                    bc.has_value() ? ContiguousData<const double>(*bc) : nullptr,
+                    zc.has_value() ? ContiguousData<const double>(*zc) + offset : nullptr,
+                    end - start,
+                    num_channels,
+                    spatial_size,
+                    ep);
+        }
+    }
+}
+
+// A weight packed by PackConvWeight or PackMatrixWeight.
+template <typename T>
+class PackedWeight : public ChxVMOpaque {
+public:
+    explicit PackedWeight(std::shared_ptr<const T> packed) : packed_(packed) {
+        std::vector<chainerx::Array> arrays{packed_->w};
+        if (packed_->panels.has_value()) arrays.push_back(*packed_->panels);
+        SetRetainedArrays(arrays);
+    }
+    virtual ~PackedWeight() = default;
+
+    const T& packed() const {
+        return *packed_;
+    }
+
+    std::string ToString() const override {
+        return "PackedWeight";
+    }
+
+    std::string DebugString() const override {
+        std::ostringstream oss;
+        oss << "PackedWeight(" << packed_->w.shape() << (packed_->panels.has_value() ? ")" : " unpacked)");
+        return oss.str();
+    }
+
+private:
+    std::shared_ptr<const T> packed_;
+};
+
+// Keeps the weight packed from the last parameter array. Parameters
+// are fed as the same arrays to every run, so they are packed only
+// once. In-place updates of parameters are not noticed.
+template <typename T>
+class PackedWeightCache {
+public:
+    std::shared_ptr<const T> Get(const chainerx::Array& w, const std::function<T()>& pack) {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (!packed_ || !IsSameArray(packed_->w, w)) {
+            packed_ = std::make_shared<const T>(pack());
+        }
+        return packed_;
+    }
+
+private:
+    static bool IsSameArray(const chainerx::Array& a, const chainerx::Array& b) {
+        return a.data() == b.data() && a.offset() == b.offset() && a.shape() == b.shape() && a.strides() == b.strides() &&
+               a.dtype() == b.dtype() && &a.device() == &b.device();
+    }
+
+    std::mutex mu_;
+    std::shared_ptr<const T> packed_;
+};
+
+template <FusedActivation kActivation, typename T>
+void ActivationGradImpl(const T* y, const T* gy, T* gz, int64_t size) {
+    for (int64_t i = 0; i < size; ++i) {
+        gz[i] = ActivateGrad<kActivation>(y[i], gy[i]);
+    }
+}
+
+}  // namespace
+
 chainerx::Array LinearOp::RunImpl(
         ChxVMState* st, const chainerx::Array& x, const chainerx::Array& w, const absl::optional<chainerx::Array>& b) {
     return chainerx::Linear(x, w, b, n_batch_axes);
@@ -21,29 +307,304 @@ chainerx::Array LinearGradWeightOp::RunImpl(ChxVMState* st, const chainerx::Arra
     return chainerx::Dot(chainerx::Transpose(gym), xm);
 }
 
+chainerx::Array LinearActivationOp::RunImpl(
+        ChxVMState* st, const chainerx::Array& x, const chainerx::Array& w, const absl::optional<chainerx::Array>& b) {
+    const Epilogue ep{ParseActivation(activation), 0, 0, 0};
+    const chainerx::Dtype dtype = x.dtype();
+    if (!IsNativeFloat(x) || x.ndim() != 2 || w.ndim() != 2 || w.dtype() != dtype || (b.has_value() && b->dtype() != dtype) ||
+        IsAnyBackpropRequired({x, w, b})) {
+        return ApplyActivation(chainerx::Linear(x, w, b), ep);
+    }
+
+    chainerx::Array y = GetOutputArray(st, inst_, 0, {x.shape()[0], w.shape()[0]}, x);
+    CHECK(y.IsContiguous());
+    absl::optional<chainerx::Array> bc;
+    if (b.has_value()) bc = chainerx::AsContiguous(*b);
+    if (dtype == chainerx::Dtype::kFloat32) {
+        LinearActivationImpl<float>(x, w, bc, ep, y);
+    } else {
+        LinearActivationImpl<double>(x, w, bc, ep, y);
+    }
+    return y;
+}
+
+std::tuple<chainerx::Array, chainerx::Array> LinearActivationGradWeightOp::RunImpl(
+        ChxVMState* st, const chainerx::Array& x, const chainerx::Array& gy, const chainerx::Array& y) {
+    const FusedActivation act = ParseActivation(activation);
+    CHECK(act != FusedActivation::kLeakyRelu && act != FusedActivation::kClip) << "Unsupported activation: " << activation;
+    chainerx::Array gz;
+    if (IsNativeFloat(gy) && y.dtype() == gy.dtype() && y.shape() == gy.shape() && !IsAnyBackpropRequired({gy, y})) {
+        const chainerx::Array gyc = chainerx::AsContiguous(gy);
+        const chainerx::Array yc = chainerx::AsContiguous(y);
+        gz = chainerx::Empty(gy.shape(), gy.dtype(), gy.device());
+        DispatchActivation(act, [&](auto a) {
+            if (gy.dtype() == chainerx::Dtype::kFloat32) {
+                ActivationGradImpl<decltype(a)::value>(
+                        ContiguousData<const float>(yc), ContiguousData<const float>(gyc), ContiguousData<float>(gz), gz.GetTotalSize());
+            } else {
+                ActivationGradImpl<decltype(a)::value>(
+                        ContiguousData<const double>(yc), ContiguousData<const double>(gyc), ContiguousData<double>(gz), gz.GetTotalSize());
+            }
+        });
+    } else {
+        gz = ApplyActivationGrad(y, gy, act);
+    }
+
+    chainerx::Array gzt = chainerx::Transpose(gz);
+    chainerx::Shape gw_shape{gz.shape()[1], x.shape()[1]};
+    if (x.dtype() == gz.dtype() && !IsAnyBackpropRequired({x, gz})) {
+        if (absl::optional<chainerx::Array> gw = st->GetPlannedOutput(inst_, 0, gw_shape, gz.dtype(), gz.device())) {
+            gz.device().backend().CallKernel<chainerx::DotKernel>(gzt, x, *gw);
+            return std::make_tuple(*gw, gz);
+        }
+    }
+    return std::make_tuple(chainerx::Dot(gzt, x), gz);
+}
+
 chainerx::Array ConvOp::RunImpl(
         ChxVMState* st, const chainerx::Array& x, const chainerx::Array& w, const absl::optional<chainerx::Array>& b) {
     Int64StackVector comp_strides = ComplementStride(strides, x);
     Int64StackVector comp_pads = ComplementPad(pads, x);
+    // Raw kernels do not connect their outputs to graphs.
+    const bool requires_backprop = IsAnyBackpropRequired({x, w, b});
+
+    if (!requires_backprop && auto_pad == "NOTSET" && CanUseCpuConv(x, w, b, comp_strides, comp_pads)) {
+        const chainerx::Shape y_shape = GetConvOutputShape(x.shape(), w.shape(), comp_strides, comp_pads);
+        const ConvShape shape = MakeConvShape(x.shape(), w.shape(), y_shape, comp_strides, comp_pads, group);
+        const ConvAlgorithm algorithm = ChooseConvAlgorithm(shape);
+        if (algorithm != ConvAlgorithm::kChainerX) {
+            chainerx::Array y = GetOutputArray(st, inst_, 0, y_shape, x);
+            CpuConv(x, w, b, shape, algorithm, y);
+            return y;
+        }
+    }
+
+    if (!requires_backprop && group == 1 && auto_pad == "NOTSET" && x.dtype() == w.dtype() &&
+        (!b.has_value() || b->dtype() == x.dtype())) {
+        const chainerx::Shape y_shape = GetConvOutputShape(x.shape(), w.shape(), comp_strides, comp_pads);
+        if (absl::optional<chainerx::Array> y = st->GetPlannedOutput(inst_, 0, y_shape, x.dtype(), x.device())) {
+            return x.device().backend().CallKernel<chainerx::ConvKernel>(
+                    x, w, b, comp_strides, comp_pads, false /* cover_all */, x.dtype(), *y);
+        }
+    }
 
     return GroupedConv(x, w, b, comp_strides, comp_pads, group, auto_pad);
 }
 
+chainerx::Array FusedConvOp::RunImpl(
+        ChxVMState* st,
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& b,
+        const absl::optional<chainerx::Array>& z) {
+    Int64StackVector comp_strides = ComplementStride(strides, x);
+    Int64StackVector comp_pads = ComplementPad(pads, x);
+    const Epilogue ep{ParseActivation(activation), alpha, min, max};
+
+    const chainerx::Shape y_shape = GetConvOutputShape(x.shape(), w.shape(), comp_strides, comp_pads);
+
+    // The CPU convolution engine also runs grouped convolutions.
+    ConvAlgorithm algorithm = ConvAlgorithm::kChainerX;
+    if (auto_pad == "NOTSET" && CanUseCpuConv(x, w, b, comp_strides, comp_pads)) {
+        algorithm = ChooseConvAlgorithm(MakeConvShape(x.shape(), w.shape(), y_shape, comp_strides, comp_pads, group));
+    }
+
+    const chainerx::Dtype dtype = x.dtype();
+    const bool is_native = (group == 1 || algorithm != ConvAlgorithm::kChainerX) && auto_pad == "NOTSET" && IsNativeFloat(x) &&
+                           w.dtype() == dtype && (!b.has_value() || b->dtype() == dtype) &&
+                           (!z.has_value() || (z->dtype() == dtype && z->shape() == y_shape)) && !IsAnyBackpropRequired({x, w, b, z});
+    if (!is_native) {
+        chainerx::Array y = GroupedConv(x, w, b, comp_strides, comp_pads, group, auto_pad);
+        if (z.has_value()) {
+            y = y + *z;
+        }
+        return ApplyActivation(y, ep);
+    }
+
+    chainerx::Array y = GetOutputArray(st, inst_, 0, y_shape, x);
+    RunConvWithEpilogue(x, b, z, ep, y, [&](const chainerx::Array& xt, const chainerx::Array& yt) {
+        if (algorithm == ConvAlgorithm::kChainerX) {
+            x.device().backend().CallKernel<chainerx::ConvKernel>(
+                    xt, w, absl::nullopt, comp_strides, comp_pads, false /* cover_all */, dtype, yt);
+        } else {
+            CpuConv(xt, w, absl::nullopt, MakeConvShape(xt.shape(), w.shape(), yt.shape(), comp_strides, comp_pads, group), algorithm, yt);
+        }
+    });
+    return y;
+}
+
+class PackConvWeightOp::PackConvWeightImpl {
+public:
+    PackedWeightCache<PackedFilter> cache;
+};
+
+void PackConvWeightOp::InitImpl() {
+    impl_ = new PackConvWeightImpl();
+}
+
+PackConvWeightOp::~PackConvWeightOp() {
+    delete impl_;
+}
+
+ChxVMOpaque* PackConvWeightOp::RunImpl(ChxVMState* st, const chainerx::Array& w) {
+    std::shared_ptr<const PackedFilter> packed = impl_->cache.Get(w, [this, &w]() {
+        // Filters are packed for the algorithm chosen for the input
+        // shape inferred by the compiler.
+        ConvAlgorithm algorithm = ConvAlgorithm::kIm2col;
+        if (input_shape.size() == 4 && w.ndim() == 4 && strides.size() == 2 && pads.size() == 2) {
+            const chainerx::Shape x_shape(input_shape.begin(), input_shape.end());
+            const chainerx::Shape y_shape = GetConvOutputShape(x_shape, w.shape(), strides, pads);
+            algorithm = ChooseConvAlgorithm(MakeConvShape(x_shape, w.shape(), y_shape, strides, pads, group));
+        }
+        return PackFilter(w, group, algorithm);
+    });
+    return new PackedWeight<PackedFilter>(packed);
+}
+
+class PackMatrixWeightOp::PackMatrixWeightImpl {
+public:
+    PackedWeightCache<PackedMatrix> cache;
+};
+
+void PackMatrixWeightOp::InitImpl() {
+    impl_ = new PackMatrixWeightImpl();
+}
+
+PackMatrixWeightOp::~PackMatrixWeightOp() {
+    delete impl_;
+}
+
+ChxVMOpaque* PackMatrixWeightOp::RunImpl(ChxVMState* st, const chainerx::Array& w) {
+    return new PackedWeight<PackedMatrix>(impl_->cache.Get(w, [this, &w]() { return PackMatrix(w, trans); }));
+}
+
+chainerx::Array PackedConvOp::RunImpl(
+        ChxVMState* st,
+        const chainerx::Array& x,
+        const ChxVMOpaque& packed,
+        const absl::optional<chainerx::Array>& b,
+        const absl::optional<chainerx::Array>& z) {
+    const PackedFilter& filter = dynamic_cast<const PackedWeight<PackedFilter>&>(packed).packed();
+    const chainerx::Array& w = filter.w;
+    const Int64StackVector comp_strides = ComplementStride(strides, x);
+    const Int64StackVector comp_pads = ComplementPad(pads, x);
+    const Epilogue ep{ParseActivation(activation), alpha, min, max};
+
+    const chainerx::Shape y_shape = GetConvOutputShape(x.shape(), w.shape(), comp_strides, comp_pads);
+    bool use_panels = filter.panels.has_value() && CanUseCpuConv(x, w, b, comp_strides, comp_pads) &&
+                      (!z.has_value() || (z->dtype() == x.dtype() && z->shape() == y_shape)) && !IsAnyBackpropRequired({x, w, b, z});
+    if (use_panels) {
+        const ConvShape shape = MakeConvShape(x.shape(), w.shape(), y_shape, comp_strides, comp_pads, group);
+        use_panels = IsConvAlgorithmSupported(shape, filter.algorithm);
+    }
+    if (!use_panels) {
+        chainerx::Array y = GroupedConv(x, w, b, comp_strides, comp_pads, group, "NOTSET");
+        if (z.has_value()) {
+            y = y + *z;
+        }
+        return ApplyActivation(y, ep);
+    }
+
+    chainerx::Array y = GetOutputArray(st, inst_, 0, y_shape, x);
+    RunConvWithEpilogue(x, b, z, ep, y, [&](const chainerx::Array& xt, const chainerx::Array& yt) {
+        CpuConvPacked(xt, filter, absl::nullopt, MakeConvShape(xt.shape(), w.shape(), yt.shape(), comp_strides, comp_pads, group), yt);
+    });
+    return y;
+}
+
+chainerx::Array PackedLinearOp::RunImpl(
+        ChxVMState* st, const chainerx::Array& x, const ChxVMOpaque& packed, const absl::optional<chainerx::Array>& b) {
+    const PackedMatrix& matrix = dynamic_cast<const PackedWeight<PackedMatrix>&>(packed).packed();
+    const Epilogue ep{ParseActivation(activation), 0, 0, 0};
+    CHECK_LE(0, n_batch_axes);
+    CHECK_LE(n_batch_axes, x.ndim());
+    chainerx::Shape y_shape(x.shape().begin(), x.shape().begin() + n_batch_axes);
+    const int64_t num_rows = y_shape.GetTotalSize();
+    y_shape.push_back(matrix.units);
+    CHECK_EQ(num_rows * matrix.depth, x.GetTotalSize()) << x.shape() << " vs " << matrix.w.shape();
+    const chainerx::Array xm = x.Reshape({num_rows, matrix.depth});
+
+    const chainerx::Dtype dtype = x.dtype();
+    const bool use_panels = matrix.panels.has_value() && IsNativeFloat(x) && matrix.w.dtype() == dtype &&
+                            (!b.has_value() || (b->dtype() == dtype && b->shape() == chainerx::Shape{matrix.units})) &&
+                            !IsAnyBackpropRequired({x, matrix.w, b});
+    if (!use_panels) {
+        chainerx::Array y = chainerx::Dot(xm, matrix.trans ? chainerx::Transpose(matrix.w) : matrix.w);
+        if (b.has_value()) {
+            y = y + *b;
+        }
+        return ApplyActivation(y.Reshape(y_shape), ep);
+    }
+
+    chainerx::Array y = GetOutputArray(st, inst_, 0, y_shape, x);
+    CpuMatMulPacked(xm, matrix, y.Reshape({num_rows, matrix.units}));
+    if (b.has_value() || ep.activation != FusedActivation::kNone) {
+        absl::optional<chainerx::Array> bc;
+        if (b.has_value()) bc = chainerx::AsContiguous(*b);
+        if (dtype == chainerx::Dtype::kFloat32) {
+            ApplyEpilogue<float>(
+                    ContiguousData<float>(y),
+                    bc.has_value() ? ContiguousData<const float>(*bc) : nullptr,
+                    nullptr,
+                    num_rows,
+                    matrix.units,
+                    1,
+                    ep);
+        } else {
+            ApplyEpilogue<double>(
+                    ContiguousData<double>(y),
+                    bc.has_value() ? ContiguousData<const double>(*bc) : nullptr,
+                    nullptr,
+                    num_rows,
+                    matrix.units,
+                    1,
+                    ep);
+        }
+    }
+    return y;
+}
+
 chainerx::Array ConvTransposeOp::RunImpl(
         ChxVMState* st, const chainerx::Array& x, const chainerx::Array& w, const absl::optional<chainerx::Array>& b) {
-    return GroupedConvTranspose(x, w, b, ComplementStride(strides, x), ComplementPad(pads, x), output_shape, group);
+    const Int64StackVector comp_strides = ComplementStride(strides, x);
+    const Int64StackVector comp_pads = ComplementPad(pads, x);
+    if (absl::optional<chainerx::Array> y = RunCpuConvTranspose(st, inst_, x, w, b, comp_strides, comp_pads, output_shape, group)) {
+        return *y;
+    }
+    return GroupedConvTranspose(x, w, b, comp_strides, comp_pads, output_shape, group);
 }
 
 chainerx::Array ConvTransposeWithDynamicShapeOp::RunImpl(
         ChxVMState* st, const chainerx::Array& x, const chainerx::Array& w, const chainerx::Shape& shape) {
     chainerx::StackVector<int64_t, chainerx::kMaxNdim> out_size(shape.begin() + 2, shape.end());
-    return GroupedConvTranspose(x, w, absl::nullopt, ComplementStride(strides, x), ComplementPad(pads, x), out_size, group);
+    const Int64StackVector comp_strides = ComplementStride(strides, x);
+    const Int64StackVector comp_pads = ComplementPad(pads, x);
+    if (absl::optional<chainerx::Array> y = RunCpuConvTranspose(st, inst_, x, w, absl::nullopt, comp_strides, comp_pads, out_size, group)) {
+        return *y;
+    }
+    return GroupedConvTranspose(x, w, absl::nullopt, comp_strides, comp_pads, out_size, group);
 }
 
 chainerx::Array ConvGradWeightOp::RunImpl(ChxVMState* st, const chainerx::Array& w, const chainerx::Array& x, const chainerx::Array& gy) {
     // TODO(hamaji): Remove `w` from the input of ConvGradWeight. We
     // only need its shape.
-    return GroupedConvGradWeight(w, x, gy, ComplementStride(strides, x), ComplementPad(pads, x), group);
+    const Int64StackVector comp_strides = ComplementStride(strides, x);
+    const Int64StackVector comp_pads = ComplementPad(pads, x);
+    // Raw kernels do not connect their outputs to graphs.
+    const bool requires_backprop = IsAnyBackpropRequired({x, gy});
+    if (!requires_backprop && CanUseCpuConv(x, gy, absl::nullopt, comp_strides, comp_pads) && w.dtype() == x.dtype() && w.ndim() == 4) {
+        const ConvShape shape = MakeConvShape(x.shape(), w.shape(), gy.shape(), comp_strides, comp_pads, group);
+        chainerx::Array gw = GetOutputArray(st, inst_, 0, w.shape(), x);
+        CpuConvGradWeight(x, gy, shape, gw);
+        return gw;
+    }
+    if (!requires_backprop && group == 1) {
+        if (absl::optional<chainerx::Array> gw = st->GetPlannedOutput(inst_, 0, w.shape(), w.dtype(), x.device())) {
+            return x.device().backend().CallKernel<chainerx::ConvGradWeightKernel>(
+                    w.dtype(), w.shape(), x, gy, comp_strides, comp_pads, false /* cover_all */, *gw);
+        }
+    }
+    return GroupedConvGradWeight(w, x, gy, comp_strides, comp_pads, group);
 }
 
 }  // namespace runtime
@@ -0,0 +1,1003 @@
+#include "runtime/ops/cpu_conv.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#include <omp.h>
+#endif
+
+#include <chainerx/routines/creation.h>
+
+#include <common/log.h>
+#include <common/strutil.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+// The register tile of the GEMM micro kernel. The kMr x kNr
+// accumulators are kept in vector registers.
+constexpr int kMr = 4;
+constexpr int kNr = 16;
+// The depth of packed panels, which keeps a packed strip of B in L1.
+constexpr int64_t kKc = 256;
+// The size of the im2col buffer of each thread.
+constexpr int64_t kColTileBytes = 512 * 1024;
+// The number of 2x2 output tiles transformed together by Winograd.
+constexpr int64_t kWinogradTiles = 64;
+
+int64_t CeilDiv(int64_t a, int64_t b) {
+    return (a + b - 1) / b;
+}
+
+int GetNumThreads() {
+#if CHAINER_COMPILER_ENABLE_OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Returns the number of output pixels processed by a task so `num_jobs`
+// independent images are split into at least as many tasks as threads.
+int64_t GetPixelTile(int64_t num_pixels, int64_t num_jobs, int64_t max_tile) {
+    const int64_t splits = CeilDiv(GetNumThreads(), std::max<int64_t>(1, num_jobs));
+    const int64_t tile = CeilDiv(CeilDiv(num_pixels, splits), kNr) * kNr;
+    return std::max<int64_t>(1, std::min({tile, max_tile, num_pixels}));
+}
+
+template <typename T>
+void MicroKernel(int64_t kc, const T* a, const T* b, T* c, int64_t ldc, int64_t rows, int64_t cols) {
+    T acc[kMr][kNr] = {};
+    // With the column loop outside, GCC -O3 keeps `acc` in registers
+    // and vectorizes the loop over rows of it.
+    for (int64_t p = 0; p < kc; ++p) {
+        const T* ap = a + p * kMr;
+        const T* bp = b + p * kNr;
+        for (int j = 0; j < kNr; ++j) {
+            const T bv = bp[j];
+            for (int i = 0; i < kMr; ++i) {
+                acc[i][j] += ap[i] * bv;
+            }
+        }
+    }
+    if (rows == kMr && cols == kNr) {
+        for (int i = 0; i < kMr; ++i) {
+            for (int j = 0; j < kNr; ++j) {
+                c[i * ldc + j] += acc[i][j];
+            }
+        }
+    } else {
+        for (int64_t i = 0; i < rows; ++i) {
+            for (int64_t j = 0; j < cols; ++j) {
+                c[i * ldc + j] += acc[i][j];
+            }
+        }
+    }
+}
+
+// Returns the number of elements of a matrix with `num_rows` rows and
+// `depth` columns packed by PackPanels<R>.
+template <int R>
+int64_t GetPackedSize(int64_t num_rows, int64_t depth) {
+    return CeilDiv(num_rows, R) * R * depth;
+}
+
+// Packs rows [r0, r0 + R) and columns [k0, k0 + kc) of the matrix at
+// a[r * rs + p * cs] to `out` column by column. Rows out of the
+// `num_rows` rows of the matrix are filled with zeros.
+template <int R, typename T>
+void PackPanel(const T* a, int64_t rs, int64_t cs, int64_t num_rows, int64_t r0, int64_t k0, int64_t kc, T* out) {
+    for (int64_t p = 0; p < kc; ++p) {
+        const T* ap = a + (k0 + p) * cs;
+        for (int i = 0; i < R; ++i) {
+            const int64_t row = r0 + i;
+            out[p * R + i] = row < num_rows ? ap[row * rs] : 0;
+        }
+    }
+}
+
+// Packs all panels of R rows of a matrix in the order Gemm reads them,
+// i.e., the panels of each block of kKc columns are contiguous.
+template <int R, typename T>
+void PackPanels(const T* a, int64_t rs, int64_t cs, int64_t num_rows, int64_t depth, T* out) {
+    const int64_t num_panels = CeilDiv(num_rows, R);
+    for (int64_t k0 = 0; k0 < depth; k0 += kKc) {
+        const int64_t kc = std::min(kKc, depth - k0);
+        for (int64_t panel = 0; panel < num_panels; ++panel) {
+            PackPanel<R>(a, rs, cs, num_rows, panel * R, k0, kc, out + num_panels * R * k0 + panel * kc * R);
+        }
+    }
+}
+
+// An operand of Gemm, which is a matrix whose elements are at
+// data[i * rs + j * cs], or panels packed ahead by PackPanels: kMr
+// rows of A or kNr columns of B.
+template <typename T>
+struct GemmOperand {
+    const T* data;
+    int64_t rs;
+    int64_t cs;
+    bool is_packed;
+};
+
+template <typename T>
+GemmOperand<T> Strided(const T* data, int64_t rs, int64_t cs) {
+    return GemmOperand<T>{data, rs, cs, false};
+}
+
+template <typename T>
+GemmOperand<T> Packed(const T* data) {
+    return GemmOperand<T>{data, 0, 0, true};
+}
+
+// C (m x n) = A (m x k) * B (k x n), or C += A * B if `accumulate`.
+// Transposed operands are passed by their strides. Panels of kMr rows
+// of A and strips of kNr columns of B are packed with zeros at their
+// ends before they are multiplied unless they are packed already.
+// Strips are distributed to threads if `parallel`.
+template <typename T>
+void Gemm(
+        int64_t m,
+        int64_t n,
+        int64_t k,
+        const GemmOperand<T>& a,
+        const GemmOperand<T>& b,
+        T* c,
+        int64_t ldc,
+        bool accumulate,
+        bool parallel) {
+    if (!accumulate) {
+        for (int64_t i = 0; i < m; ++i) {
+            std::fill(c + i * ldc, c + i * ldc + n, T(0));
+        }
+    }
+    const int64_t num_panels = CeilDiv(m, kMr);
+    const int64_t num_strips = CeilDiv(n, kNr);
+    std::vector<T> packed_a(a.is_packed ? 0 : num_panels * kMr * std::min(k, kKc));
+    for (int64_t k0 = 0; k0 < k; k0 += kKc) {
+        const int64_t kc = std::min(kKc, k - k0);
+        const T* pa = a.is_packed ? a.data + num_panels * kMr * k0 : packed_a.data();
+        if (!a.is_packed) {
+            for (int64_t panel = 0; panel < num_panels; ++panel) {
+                PackPanel<kMr>(a.data, a.rs, a.cs, m, panel * kMr, k0, kc, &packed_a[panel * kc * kMr]);
+            }
+        }
+
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for schedule(static) if (parallel)
+#endif
+        for (int64_t strip = 0; strip < num_strips; ++strip) {
+            T buf[kKc * kNr];
+            const int64_t j0 = strip * kNr;
+            const int64_t cols = std::min<int64_t>(kNr, n - j0);
+            const T* pb = buf;
+            if (b.is_packed) {
+                pb = b.data + num_strips * kNr * k0 + strip * kc * kNr;
+            } else {
+                PackPanel<kNr>(b.data, b.cs, b.rs, n, j0, k0, kc, buf);
+            }
+            for (int64_t panel = 0; panel < num_panels; ++panel) {
+                const int64_t i0 = panel * kMr;
+                MicroKernel(kc, pa + panel * kc * kMr, pb, c + i0 * ldc + j0, ldc, std::min<int64_t>(kMr, m - i0), cols);
+            }
+        }
+    }
+    (void)parallel;
+}
+
+// Copies patches of `channels` channels of the image `x` for output
+// pixels [p0, p0 + num_pixels) to `col`, whose rows are (c, kh, kw).
+template <typename T>
+void Im2Col(const T* x, const ConvShape& s, int64_t channels, int64_t p0, int64_t num_pixels, T* col) {
+    for (int64_t c = 0; c < channels; ++c) {
+        const T* xc = x + c * s.in_h * s.in_w;
+        for (int64_t kh = 0; kh < s.kernel_h; ++kh) {
+            for (int64_t kw = 0; kw < s.kernel_w; ++kw) {
+                T* row = col + ((c * s.kernel_h + kh) * s.kernel_w + kw) * num_pixels;
+                int64_t oh = p0 / s.out_w;
+                int64_t ow = p0 % s.out_w;
+                for (int64_t j = 0; j < num_pixels; ++j) {
+                    const int64_t ih = oh * s.stride_h - s.pad_h + kh;
+                    const int64_t iw = ow * s.stride_w - s.pad_w + kw;
+                    row[j] = (ih >= 0 && ih < s.in_h && iw >= 0 && iw < s.in_w) ? xc[ih * s.in_w + iw] : 0;
+                    if (++ow == s.out_w) {
+                        ow = 0;
+                        ++oh;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Adds `col` for all output pixels to `channels` channels of the
+// image `x`, which is the reverse of Im2Col.
+template <typename T>
+void Col2Im(const T* col, const ConvShape& s, int64_t channels, T* x) {
+    const int64_t out_size = s.out_h * s.out_w;
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int64_t c = 0; c < channels; ++c) {
+        T* xc = x + c * s.in_h * s.in_w;
+        for (int64_t kh = 0; kh < s.kernel_h; ++kh) {
+            for (int64_t kw = 0; kw < s.kernel_w; ++kw) {
+                const T* row = col + ((c * s.kernel_h + kh) * s.kernel_w + kw) * out_size;
+                for (int64_t oh = 0; oh < s.out_h; ++oh) {
+                    const int64_t ih = oh * s.stride_h - s.pad_h + kh;
+                    if (ih < 0 || ih >= s.in_h) continue;
+                    for (int64_t ow = 0; ow < s.out_w; ++ow) {
+                        const int64_t iw = ow * s.stride_w - s.pad_w + kw;
+                        if (iw < 0 || iw >= s.in_w) continue;
+                        xc[ih * s.in_w + iw] += row[oh * s.out_w + ow];
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Runs GEMMs of weights and tiles of im2col buffers. Tiles of all
+// images and groups are distributed to threads. 1x1 convolutions
+// without strides and paddings use the input as the im2col buffer.
+// `packed_w` has panels of weights of each group if not null.
+template <typename T>
+void ConvIm2col(const T* x, const T* w, const T* packed_w, T* y, const ConvShape& s, bool is_direct) {
+    const int64_t in_group = s.in_channels / s.group;
+    const int64_t out_group = s.out_channels / s.group;
+    const int64_t patch = in_group * s.kernel_h * s.kernel_w;
+    const int64_t in_size = s.in_h * s.in_w;
+    const int64_t out_size = s.out_h * s.out_w;
+    const int64_t max_tile = is_direct ? 1024 : std::max<int64_t>(kNr, kColTileBytes / sizeof(T) / patch / kNr * kNr);
+    const int64_t tile = GetPixelTile(out_size, s.batch * s.group, max_tile);
+    const int64_t num_tiles = CeilDiv(out_size, tile);
+    const int64_t num_tasks = s.batch * s.group * num_tiles;
+
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel
+#endif
+    {
+        std::vector<T> col(is_direct ? 0 : patch * tile);
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (int64_t task = 0; task < num_tasks; ++task) {
+            const int64_t p0 = task % num_tiles * tile;
+            const int64_t g = task / num_tiles % s.group;
+            const int64_t n = task / num_tiles / s.group;
+            const int64_t num_pixels = std::min(tile, out_size - p0);
+            const T* xg = x + (n * s.in_channels + g * in_group) * in_size;
+            T* yg = y + (n * s.out_channels + g * out_group) * out_size + p0;
+            const GemmOperand<T> wg = packed_w ? Packed(packed_w + g * GetPackedSize<kMr>(out_group, patch))
+                                               : Strided(w + g * out_group * patch, patch, 1);
+            if (is_direct) {
+                Gemm(out_group, num_pixels, patch, wg, Strided(xg + p0, in_size, 1), yg, out_size, false, false);
+            } else {
+                Im2Col(xg, s, in_group, p0, num_pixels, col.data());
+                Gemm(out_group, num_pixels, patch, wg, Strided<T>(col.data(), num_pixels, 1), yg, out_size, false, false);
+            }
+        }
+    }
+}
+
+// Transforms 3x3 kernels to 4x4 ones by U = G g G^T. `u` is stored as
+// (16, K, C) so each of the 16 elements is a GEMM.
+template <typename T>
+std::vector<T> TransformWinogradWeight(const T* w, int64_t out_channels, int64_t in_channels) {
+    std::vector<T> u(16 * out_channels * in_channels);
+    for (int64_t k = 0; k < out_channels; ++k) {
+        for (int64_t c = 0; c < in_channels; ++c) {
+            const T* g = w + (k * in_channels + c) * 9;
+            T gg[4][3];
+            for (int j = 0; j < 3; ++j) {
+                gg[0][j] = g[j];
+                gg[1][j] = (g[j] + g[3 + j] + g[6 + j]) / 2;
+                gg[2][j] = (g[j] - g[3 + j] + g[6 + j]) / 2;
+                gg[3][j] = g[6 + j];
+            }
+            for (int i = 0; i < 4; ++i) {
+                const T r[4] = {gg[i][0], (gg[i][0] + gg[i][1] + gg[i][2]) / 2, (gg[i][0] - gg[i][1] + gg[i][2]) / 2, gg[i][2]};
+                for (int j = 0; j < 4; ++j) {
+                    u[((i * 4 + j) * out_channels + k) * in_channels + c] = r[j];
+                }
+            }
+        }
+    }
+    return u;
+}
+
+// Winograd F(2x2, 3x3) for 3x3 convolutions without strides. Blocks of
+// 2x2 output tiles are transformed to 16 GEMMs of (K, C) x (C, tiles).
+// `packed_u` has panels of the 16 elements of transformed kernels if
+// not null.
+template <typename T>
+void ConvWinograd(const T* x, const T* w, const T* packed_u, T* y, const ConvShape& s) {
+    const int64_t in_channels = s.in_channels;
+    const int64_t out_channels = s.out_channels;
+    const std::vector<T> u = packed_u ? std::vector<T>() : TransformWinogradWeight(w, out_channels, in_channels);
+    const int64_t tiles_w = CeilDiv(s.out_w, 2);
+    const int64_t num_tiles = CeilDiv(s.out_h, 2) * tiles_w;
+    const int64_t block = std::min(kWinogradTiles, CeilDiv(num_tiles, CeilDiv(GetNumThreads(), s.batch)));
+    const int64_t num_blocks = CeilDiv(num_tiles, block);
+    const int64_t num_tasks = s.batch * num_blocks;
+
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel
+#endif
+    {
+        std::vector<T> v(16 * in_channels * block);
+        std::vector<T> m(16 * out_channels * block);
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (int64_t task = 0; task < num_tasks; ++task) {
+            const int64_t n = task / num_blocks;
+            const int64_t t0 = task % num_blocks * block;
+            const int64_t nt = std::min(block, num_tiles - t0);
+
+            // V = B^T d B.
+            for (int64_t c = 0; c < in_channels; ++c) {
+                const T* xc = x + (n * in_channels + c) * s.in_h * s.in_w;
+                for (int64_t t = 0; t < nt; ++t) {
+                    const int64_t ih0 = (t0 + t) / tiles_w * 2 - s.pad_h;
+                    const int64_t iw0 = (t0 + t) % tiles_w * 2 - s.pad_w;
+                    T d[4][4];
+                    for (int i = 0; i < 4; ++i) {
+                        const int64_t ih = ih0 + i;
+                        for (int j = 0; j < 4; ++j) {
+                            const int64_t iw = iw0 + j;
+                            d[i][j] = (ih >= 0 && ih < s.in_h && iw >= 0 && iw < s.in_w) ? xc[ih * s.in_w + iw] : 0;
+                        }
+                    }
+                    T bd[4][4];
+                    for (int j = 0; j < 4; ++j) {
+                        bd[0][j] = d[0][j] - d[2][j];
+                        bd[1][j] = d[1][j] + d[2][j];
+                        bd[2][j] = d[2][j] - d[1][j];
+                        bd[3][j] = d[1][j] - d[3][j];
+                    }
+                    for (int i = 0; i < 4; ++i) {
+                        const T r[4] = {bd[i][0] - bd[i][2], bd[i][1] + bd[i][2], bd[i][2] - bd[i][1], bd[i][1] - bd[i][3]};
+                        for (int j = 0; j < 4; ++j) {
+                            v[((i * 4 + j) * in_channels + c) * nt + t] = r[j];
+                        }
+                    }
+                }
+            }
+
+            for (int e = 0; e < 16; ++e) {
+                const GemmOperand<T> ue = packed_u ? Packed(packed_u + e * GetPackedSize<kMr>(out_channels, in_channels))
+                                                   : Strided(&u[e * out_channels * in_channels], in_channels, 1);
+                Gemm(out_channels,
+                     nt,
+                     in_channels,
+                     ue,
+                     Strided<T>(&v[e * in_channels * nt], nt, 1),
+                     &m[e * out_channels * nt],
+                     nt,
+                     false,
+                     false);
+            }
+
+            // Y = A^T M A.
+            for (int64_t k = 0; k < out_channels; ++k) {
+                T* yk = y + (n * out_channels + k) * s.out_h * s.out_w;
+                for (int64_t t = 0; t < nt; ++t) {
+                    T mm[4][4];
+                    for (int e = 0; e < 16; ++e) {
+                        mm[e / 4][e % 4] = m[(e * out_channels + k) * nt + t];
+                    }
+                    T am[2][4];
+                    for (int j = 0; j < 4; ++j) {
+                        am[0][j] = mm[0][j] + mm[1][j] + mm[2][j];
+                        am[1][j] = mm[1][j] - mm[2][j] - mm[3][j];
+                    }
+                    const int64_t oh0 = (t0 + t) / tiles_w * 2;
+                    const int64_t ow0 = (t0 + t) % tiles_w * 2;
+                    for (int i = 0; i < 2; ++i) {
+                        if (oh0 + i >= s.out_h) break;
+                        T* yrow = yk + (oh0 + i) * s.out_w + ow0;
+                        yrow[0] = am[i][0] + am[i][1] + am[i][2];
+                        if (ow0 + 1 < s.out_w) yrow[1] = am[i][1] - am[i][2] - am[i][3];
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Returns the range of output columns [*begin, *end) which read input
+// columns in [0, in_w) at the kernel offset `kw`.
+void GetValidColumns(const ConvShape& s, int64_t kw, int64_t* begin, int64_t* end) {
+    const int64_t lo = s.pad_w - kw;
+    *begin = lo <= 0 ? 0 : CeilDiv(lo, s.stride_w);
+    const int64_t hi = s.in_w - 1 + s.pad_w - kw;
+    *end = hi < 0 ? 0 : std::min(s.out_w, hi / s.stride_w + 1);
+}
+
+// Convolves each plane with its own kernel. The inner loop runs over
+// contiguous output columns.
+template <typename T>
+void ConvDepthwise(const T* x, const T* w, T* y, const ConvShape& s) {
+    const int64_t multiplier = s.out_channels / s.in_channels;
+    const int64_t num_planes = s.batch * s.out_channels;
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int64_t plane = 0; plane < num_planes; ++plane) {
+        const int64_t n = plane / s.out_channels;
+        const int64_t k = plane % s.out_channels;
+        const T* xc = x + (n * s.in_channels + k / multiplier) * s.in_h * s.in_w;
+        const T* wk = w + k * s.kernel_h * s.kernel_w;
+        T* yk = y + plane * s.out_h * s.out_w;
+        std::fill(yk, yk + s.out_h * s.out_w, T(0));
+        for (int64_t kw = 0; kw < s.kernel_w; ++kw) {
+            int64_t begin, end;
+            GetValidColumns(s, kw, &begin, &end);
+            if (begin >= end) continue;
+            for (int64_t oh = 0; oh < s.out_h; ++oh) {
+                T* yrow = yk + oh * s.out_w + begin;
+                for (int64_t kh = 0; kh < s.kernel_h; ++kh) {
+                    const int64_t ih = oh * s.stride_h - s.pad_h + kh;
+                    if (ih < 0 || ih >= s.in_h) continue;
+                    const T wv = wk[kh * s.kernel_w + kw];
+                    const T* xp = xc + ih * s.in_w + begin * s.stride_w - s.pad_w + kw;
+                    if (s.stride_w == 1) {
+                        for (int64_t i = 0; i < end - begin; ++i) {
+                            yrow[i] += wv * xp[i];
+                        }
+                    } else {
+                        for (int64_t i = 0; i < end - begin; ++i) {
+                            yrow[i] += wv * xp[i * s.stride_w];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+void AddBias(T* y, const T* b, int64_t batch, int64_t channels, int64_t size) {
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int64_t plane = 0; plane < batch * channels; ++plane) {
+        const T bias = b[plane % channels];
+        T* yp = y + plane * size;
+        for (int64_t i = 0; i < size; ++i) {
+            yp[i] += bias;
+        }
+    }
+}
+
+template <typename T>
+void ConvGradWeightDepthwise(const T* x, const T* gy, T* gw, const ConvShape& s) {
+    const int64_t multiplier = s.out_channels / s.in_channels;
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int64_t k = 0; k < s.out_channels; ++k) {
+        T* gwk = gw + k * s.kernel_h * s.kernel_w;
+        for (int64_t kh = 0; kh < s.kernel_h; ++kh) {
+            for (int64_t kw = 0; kw < s.kernel_w; ++kw) {
+                int64_t begin, end;
+                GetValidColumns(s, kw, &begin, &end);
+                T sum = 0;
+                for (int64_t n = 0; n < s.batch; ++n) {
+                    const T* xc = x + (n * s.in_channels + k / multiplier) * s.in_h * s.in_w;
+                    const T* gyk = gy + (n * s.out_channels + k) * s.out_h * s.out_w;
+                    for (int64_t oh = 0; oh < s.out_h; ++oh) {
+                        const int64_t ih = oh * s.stride_h - s.pad_h + kh;
+                        if (ih < 0 || ih >= s.in_h) continue;
+                        const T* xp = xc + ih * s.in_w + begin * s.stride_w - s.pad_w + kw;
+                        const T* gyp = gyk + oh * s.out_w + begin;
+                        for (int64_t i = 0; i < end - begin; ++i) {
+                            sum += gyp[i] * xp[i * s.stride_w];
+                        }
+                    }
+                }
+                gwk[kh * s.kernel_w + kw] = sum;
+            }
+        }
+    }
+}
+
+// gw = sum of gy * im2col(x)^T over images and tiles of pixels.
+template <typename T>
+void ConvGradWeightImpl(const T* x, const T* gy, T* gw, const ConvShape& s) {
+    const int64_t in_group = s.in_channels / s.group;
+    const int64_t out_group = s.out_channels / s.group;
+    if (in_group == 1 && s.group > 1) {
+        ConvGradWeightDepthwise(x, gy, gw, s);
+        return;
+    }
+
+    const int64_t patch = in_group * s.kernel_h * s.kernel_w;
+    const int64_t out_size = s.out_h * s.out_w;
+    const int64_t tile = std::min(out_size, std::max<int64_t>(kNr, kColTileBytes / sizeof(T) / patch));
+    std::fill(gw, gw + s.out_channels * patch, T(0));
+    std::vector<T> col(patch * tile);
+    for (int64_t n = 0; n < s.batch; ++n) {
+        for (int64_t g = 0; g < s.group; ++g) {
+            const T* xg = x + (n * s.in_channels + g * in_group) * s.in_h * s.in_w;
+            const T* gyg = gy + (n * s.out_channels + g * out_group) * out_size;
+            for (int64_t p0 = 0; p0 < out_size; p0 += tile) {
+                const int64_t num_pixels = std::min(tile, out_size - p0);
+                Im2Col(xg, s, in_group, p0, num_pixels, col.data());
+                Gemm(out_group,
+                     patch,
+                     num_pixels,
+                     Strided(gyg + p0, out_size, 1),
+                     Strided<T>(col.data(), 1, num_pixels),
+                     gw + g * out_group * patch,
+                     patch,
+                     true,
+                     true);
+            }
+        }
+    }
+}
+
+// y = col2im(w^T * x) for each image and group, where `x` is the
+// output of the forward convolution and `y` is its input.
+template <typename T>
+void ConvTransposeImpl(const T* x, const T* w, T* y, const ConvShape& s) {
+    const int64_t in_group = s.in_channels / s.group;
+    const int64_t out_group = s.out_channels / s.group;
+    const int64_t patch = in_group * s.kernel_h * s.kernel_w;
+    const int64_t in_size = s.in_h * s.in_w;
+    const int64_t out_size = s.out_h * s.out_w;
+    std::fill(y, y + s.batch * s.in_channels * in_size, T(0));
+    std::vector<T> col(patch * out_size);
+    for (int64_t n = 0; n < s.batch; ++n) {
+        for (int64_t g = 0; g < s.group; ++g) {
+            const T* xg = x + (n * s.out_channels + g * out_group) * out_size;
+            Gemm(patch,
+                 out_size,
+                 out_group,
+                 Strided(w + g * out_group * patch, 1, patch),
+                 Strided(xg, out_size, 1),
+                 col.data(),
+                 out_size,
+                 false,
+                 true);
+            Col2Im(col.data(), s, in_group, y + (n * s.in_channels + g * in_group) * in_size);
+        }
+    }
+}
+
+template <typename T>
+T* GetData(const chainerx::Array& a) {
+    return reinterpret_cast<T*>(static_cast<char*>(a.raw_data()) + a.offset());
+}
+
+template <typename T>
+void AddBias(const chainerx::Array& y, const absl::optional<chainerx::Array>& b, int64_t batch, int64_t channels, int64_t size) {
+    if (!b.has_value()) return;
+    const chainerx::Array bc = chainerx::AsContiguous(*b);
+    AddBias(GetData<T>(y), GetData<const T>(bc), batch, channels, size);
+}
+
+// Runs the convolution with panels packed by PackFilter if `packed`
+// has a value.
+template <typename T>
+void RunConv(
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& packed,
+        const ConvShape& s,
+        ConvAlgorithm algorithm,
+        const chainerx::Array& y) {
+    const T* xp = GetData<const T>(x);
+    const T* wp = GetData<const T>(w);
+    const T* pp = packed.has_value() ? GetData<const T>(*packed) : nullptr;
+    T* yp = GetData<T>(y);
+    switch (algorithm) {
+        case ConvAlgorithm::kIm2col:
+            ConvIm2col(xp, wp, pp, yp, s, false);
+            break;
+        case ConvAlgorithm::kDirect1x1:
+            ConvIm2col(xp, wp, pp, yp, s, true);
+            break;
+        case ConvAlgorithm::kWinograd:
+            ConvWinograd(xp, wp, pp, yp, s);
+            break;
+        case ConvAlgorithm::kDepthwise:
+            ConvDepthwise(xp, wp, yp, s);
+            break;
+        default:
+            CHECK(false) << "Unexpected algorithm: " << GetConvAlgorithmName(algorithm);
+    }
+}
+
+// Packs filters of each group for the GEMM of im2col, or transformed
+// kernels for Winograd.
+template <typename T>
+void PackFilterImpl(const T* w, const chainerx::Shape& w_shape, int64_t group, ConvAlgorithm algorithm, T* out) {
+    const int64_t out_channels = w_shape[0];
+    const int64_t in_group = w_shape[1];
+    if (algorithm == ConvAlgorithm::kWinograd) {
+        const std::vector<T> u = TransformWinogradWeight(w, out_channels, in_group);
+        const int64_t size = GetPackedSize<kMr>(out_channels, in_group);
+        for (int e = 0; e < 16; ++e) {
+            PackPanels<kMr>(&u[e * out_channels * in_group], in_group, 1, out_channels, in_group, out + e * size);
+        }
+        return;
+    }
+    const int64_t out_group = out_channels / group;
+    const int64_t patch = in_group * w_shape[2] * w_shape[3];
+    for (int64_t g = 0; g < group; ++g) {
+        PackPanels<kMr>(w + g * out_group * patch, patch, 1, out_group, patch, out + g * GetPackedSize<kMr>(out_group, patch));
+    }
+}
+
+int64_t GetPackedFilterSize(const chainerx::Shape& w_shape, int64_t group, ConvAlgorithm algorithm) {
+    if (algorithm == ConvAlgorithm::kWinograd) {
+        return 16 * GetPackedSize<kMr>(w_shape[0], w_shape[1]);
+    }
+    return group * GetPackedSize<kMr>(w_shape[0] / group, w_shape[1] * w_shape[2] * w_shape[3]);
+}
+
+// Runs GEMMs of bands of rows of `x` in parallel when the columns of
+// the packed matrix are too few to keep threads busy.
+template <typename T>
+void MatMulPackedImpl(const T* x, const T* panels, T* y, int64_t m, int64_t n, int64_t k) {
+    const int num_threads = GetNumThreads();
+    const int64_t band = CeilDiv(n, kNr) >= num_threads ? m : CeilDiv(CeilDiv(m, num_threads), kMr) * kMr;
+    const int64_t num_bands = CeilDiv(m, std::max<int64_t>(1, band));
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for schedule(static) if (num_bands > 1)
+#endif
+    for (int64_t i = 0; i < num_bands; ++i) {
+        const int64_t i0 = i * band;
+        Gemm(std::min(band, m - i0), n, k, Strided(x + i0 * k, k, 1), Packed(panels), y + i0 * n, n, false, num_bands == 1);
+    }
+}
+
+bool IsPackable(const chainerx::Array& w) {
+    return IsNativeDevice(&w.device()) && (w.dtype() == chainerx::Dtype::kFloat32 || w.dtype() == chainerx::Dtype::kFloat64);
+}
+
+bool IsDepthwise(const ConvShape& s) {
+    return s.group > 1 && s.group == s.in_channels && s.out_channels % s.in_channels == 0;
+}
+
+struct ConvTuningTable {
+    std::mutex mu;
+    std::map<std::string, ConvAlgorithm> entries;
+};
+
+void LoadConvTuningTableInto(const std::string& filename, ConvTuningTable* table) {
+    std::ifstream ifs(filename);
+    CHECK(ifs) << "Failed to open " << filename;
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream iss(line);
+        std::string key, name;
+        CHECK(iss >> key >> name) << "Invalid line in " << filename << ": " << line;
+        std::lock_guard<std::mutex> lock(table->mu);
+        table->entries[key] = ParseConvAlgorithm(name);
+    }
+}
+
+ConvTuningTable* GetConvTuningTable() {
+    static ConvTuningTable* table = [] {
+        ConvTuningTable* t = new ConvTuningTable();
+        if (const char* filename = std::getenv("CHAINER_COMPILER_CONV_TUNING_TABLE")) {
+            LoadConvTuningTableInto(filename, t);
+        }
+        return t;
+    }();
+    return table;
+}
+
+ConvAlgorithm GetForcedConvAlgorithm() {
+    static const ConvAlgorithm algorithm = [] {
+        const char* name = std::getenv("CHAINER_COMPILER_CONV_ALGORITHM");
+        return name ? ParseConvAlgorithm(name) : ConvAlgorithm::kAuto;
+    }();
+    return algorithm;
+}
+
+}  // namespace
+
+const char* GetConvAlgorithmName(ConvAlgorithm algorithm) {
+    switch (algorithm) {
+        case ConvAlgorithm::kAuto:
+            return "auto";
+        case ConvAlgorithm::kChainerX:
+            return "chainerx";
+        case ConvAlgorithm::kIm2col:
+            return "im2col";
+        case ConvAlgorithm::kDirect1x1:
+            return "direct1x1";
+        case ConvAlgorithm::kWinograd:
+            return "winograd";
+        case ConvAlgorithm::kDepthwise:
+            return "depthwise";
+    }
+    CHECK(false);
+    return nullptr;
+}
+
+ConvAlgorithm ParseConvAlgorithm(const std::string& name) {
+    for (ConvAlgorithm algorithm : {ConvAlgorithm::kAuto,
+                                    ConvAlgorithm::kChainerX,
+                                    ConvAlgorithm::kIm2col,
+                                    ConvAlgorithm::kDirect1x1,
+                                    ConvAlgorithm::kWinograd,
+                                    ConvAlgorithm::kDepthwise}) {
+        if (name == GetConvAlgorithmName(algorithm)) return algorithm;
+    }
+    CHECK(false) << "Unknown convolution algorithm: " << name;
+    return ConvAlgorithm::kAuto;
+}
+
+std::string ConvShape::ToString() const {
+    return JoinString(
+            std::vector<int64_t>{
+                    batch, in_channels, out_channels, group, in_h, in_w, kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w},
+            ",");
+}
+
+int64_t ConvShape::GetFlops() const {
+    return 2 * batch * out_channels * out_h * out_w * (in_channels / group) * kernel_h * kernel_w;
+}
+
+ConvShape MakeConvShape(
+        const chainerx::Shape& x_shape,
+        const chainerx::Shape& w_shape,
+        const chainerx::Shape& y_shape,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int64_t group) {
+    CHECK_EQ(4UL, x_shape.size());
+    CHECK_EQ(4UL, w_shape.size());
+    CHECK_EQ(4UL, y_shape.size());
+    CHECK_EQ(2UL, strides.size());
+    CHECK_EQ(2UL, pads.size());
+    return ConvShape{x_shape[0],
+                     x_shape[1],
+                     w_shape[0],
+                     group,
+                     x_shape[2],
+                     x_shape[3],
+                     w_shape[2],
+                     w_shape[3],
+                     strides[0],
+                     strides[1],
+                     pads[0],
+                     pads[1],
+                     y_shape[2],
+                     y_shape[3]};
+}
+
+chainerx::Shape GetConvOutputShape(
+        const chainerx::Shape& x_shape, const chainerx::Shape& w_shape, const Int64StackVector& strides, const Int64StackVector& pads) {
+    chainerx::Shape y_shape{x_shape[0], w_shape[0]};
+    for (size_t i = 0; i < pads.size(); ++i) {
+        y_shape.push_back((x_shape[2 + i] + pads[i] * 2 - w_shape[2 + i]) / strides[i] + 1);
+    }
+    return y_shape;
+}
+
+bool CanUseCpuConv(
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& b,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads) {
+    const chainerx::Dtype dtype = x.dtype();
+    if (!IsCpuConvEnabled() || !IsNativeDevice(&x.device())) return false;
+    if (dtype != chainerx::Dtype::kFloat32 && dtype != chainerx::Dtype::kFloat64) return false;
+    if (strides.size() != 2 || pads.size() != 2) return false;
+    return x.ndim() == 4 && w.ndim() == 4 && w.dtype() == dtype && (!b.has_value() || b->dtype() == dtype);
+}
+
+bool IsConvAlgorithmSupported(const ConvShape& s, ConvAlgorithm algorithm) {
+    switch (algorithm) {
+        case ConvAlgorithm::kAuto:
+        case ConvAlgorithm::kChainerX:
+        case ConvAlgorithm::kIm2col:
+            return true;
+        case ConvAlgorithm::kDirect1x1:
+            return s.kernel_h == 1 && s.kernel_w == 1 && s.stride_h == 1 && s.stride_w == 1 && s.pad_h == 0 && s.pad_w == 0;
+        case ConvAlgorithm::kWinograd:
+            return s.group == 1 && s.kernel_h == 3 && s.kernel_w == 3 && s.stride_h == 1 && s.stride_w == 1;
+        case ConvAlgorithm::kDepthwise:
+            return IsDepthwise(s);
+    }
+    return false;
+}
+
+ConvAlgorithm ChooseConvAlgorithm(const ConvShape& s) {
+    const ConvAlgorithm forced = GetForcedConvAlgorithm();
+    if (forced != ConvAlgorithm::kAuto && IsConvAlgorithmSupported(s, forced)) return forced;
+
+    ConvTuningTable* table = GetConvTuningTable();
+    {
+        std::lock_guard<std::mutex> lock(table->mu);
+        auto found = table->entries.find(s.ToString());
+        if (found != table->entries.end() && found->second != ConvAlgorithm::kAuto && IsConvAlgorithmSupported(s, found->second)) {
+            return found->second;
+        }
+    }
+
+    if (IsDepthwise(s)) return ConvAlgorithm::kDepthwise;
+    if (IsConvAlgorithmSupported(s, ConvAlgorithm::kDirect1x1)) return ConvAlgorithm::kDirect1x1;
+    // The transforms do not pay off for narrow layers or tiny images.
+    if (IsConvAlgorithmSupported(s, ConvAlgorithm::kWinograd) && s.in_channels >= 16 && s.out_channels >= 16 && s.out_h * s.out_w >= 64) {
+        return ConvAlgorithm::kWinograd;
+    }
+    return ConvAlgorithm::kIm2col;
+}
+
+bool IsCpuConvEnabled() {
+    return GetForcedConvAlgorithm() != ConvAlgorithm::kChainerX;
+}
+
+ConvAlgorithm SetConvTuningEntry(const ConvShape& shape, ConvAlgorithm algorithm) {
+    ConvTuningTable* table = GetConvTuningTable();
+    std::lock_guard<std::mutex> lock(table->mu);
+    auto inserted = table->entries.emplace(shape.ToString(), algorithm);
+    if (inserted.second) return ConvAlgorithm::kAuto;
+    const ConvAlgorithm previous = inserted.first->second;
+    inserted.first->second = algorithm;
+    return previous;
+}
+
+void LoadConvTuningTable(const std::string& filename) {
+    LoadConvTuningTableInto(filename, GetConvTuningTable());
+}
+
+void CpuConv(
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& b,
+        const ConvShape& shape,
+        ConvAlgorithm algorithm,
+        const chainerx::Array& y) {
+    CHECK(y.IsContiguous());
+    if (algorithm == ConvAlgorithm::kAuto) algorithm = ChooseConvAlgorithm(shape);
+    CHECK(IsConvAlgorithmSupported(shape, algorithm)) << GetConvAlgorithmName(algorithm) << " does not support " << shape.ToString();
+    const chainerx::Array xc = chainerx::AsContiguous(x);
+    const chainerx::Array wc = chainerx::AsContiguous(w);
+    const int64_t out_size = shape.out_h * shape.out_w;
+    if (x.dtype() == chainerx::Dtype::kFloat32) {
+        RunConv<float>(xc, wc, absl::nullopt, shape, algorithm, y);
+        AddBias<float>(y, b, shape.batch, shape.out_channels, out_size);
+    } else {
+        RunConv<double>(xc, wc, absl::nullopt, shape, algorithm, y);
+        AddBias<double>(y, b, shape.batch, shape.out_channels, out_size);
+    }
+}
+
+void CpuConvGradWeight(const chainerx::Array& x, const chainerx::Array& gy, const ConvShape& shape, const chainerx::Array& gw) {
+    CHECK(gw.IsContiguous());
+    const chainerx::Array xc = chainerx::AsContiguous(x);
+    const chainerx::Array gyc = chainerx::AsContiguous(gy);
+    if (x.dtype() == chainerx::Dtype::kFloat32) {
+        ConvGradWeightImpl(GetData<const float>(xc), GetData<const float>(gyc), GetData<float>(gw), shape);
+    } else {
+        ConvGradWeightImpl(GetData<const double>(xc), GetData<const double>(gyc), GetData<double>(gw), shape);
+    }
+}
+
+void CpuConvTranspose(
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& b,
+        const ConvShape& shape,
+        const chainerx::Array& y) {
+    CHECK(y.IsContiguous());
+    const chainerx::Array xc = chainerx::AsContiguous(x);
+    const chainerx::Array wc = chainerx::AsContiguous(w);
+    const int64_t in_size = shape.in_h * shape.in_w;
+    if (x.dtype() == chainerx::Dtype::kFloat32) {
+        ConvTransposeImpl(GetData<const float>(xc), GetData<const float>(wc), GetData<float>(y), shape);
+        AddBias<float>(y, b, shape.batch, shape.in_channels, in_size);
+    } else {
+        ConvTransposeImpl(GetData<const double>(xc), GetData<const double>(wc), GetData<double>(y), shape);
+        AddBias<double>(y, b, shape.batch, shape.in_channels, in_size);
+    }
+}
+
+PackedFilter PackFilter(const chainerx::Array& w, int64_t group, ConvAlgorithm algorithm) {
+    CHECK_EQ(4, w.ndim());
+    if (algorithm == ConvAlgorithm::kDirect1x1) algorithm = ConvAlgorithm::kIm2col;
+    PackedFilter filter{w, group, algorithm, absl::nullopt};
+    if ((algorithm != ConvAlgorithm::kIm2col && algorithm != ConvAlgorithm::kWinograd) || !IsPackable(w)) return filter;
+    if (algorithm == ConvAlgorithm::kWinograd) {
+        CHECK(group == 1 && w.shape()[2] == 3 && w.shape()[3] == 3) << "Winograd does not support " << w.shape();
+    }
+
+    const chainerx::Array wc = chainerx::AsContiguous(w);
+    chainerx::Array panels = chainerx::Empty({GetPackedFilterSize(w.shape(), group, algorithm)}, w.dtype(), w.device());
+    if (w.dtype() == chainerx::Dtype::kFloat32) {
+        PackFilterImpl(GetData<const float>(wc), w.shape(), group, algorithm, GetData<float>(panels));
+    } else {
+        PackFilterImpl(GetData<const double>(wc), w.shape(), group, algorithm, GetData<double>(panels));
+    }
+    filter.panels = panels;
+    return filter;
+}
+
+void CpuConvPacked(
+        const chainerx::Array& x,
+        const PackedFilter& filter,
+        const absl::optional<chainerx::Array>& b,
+        const ConvShape& shape,
+        const chainerx::Array& y) {
+    if (!filter.panels.has_value()) {
+        CpuConv(x, filter.w, b, shape, ConvAlgorithm::kAuto, y);
+        return;
+    }
+    CHECK(y.IsContiguous());
+    CHECK_EQ(filter.group, shape.group);
+    CHECK_EQ(filter.w.dtype(), x.dtype());
+    ConvAlgorithm algorithm = filter.algorithm;
+    // 1x1 convolutions read the input directly with the same panels.
+    if (algorithm == ConvAlgorithm::kIm2col && IsConvAlgorithmSupported(shape, ConvAlgorithm::kDirect1x1)) {
+        algorithm = ConvAlgorithm::kDirect1x1;
+    }
+    CHECK(IsConvAlgorithmSupported(shape, algorithm)) << GetConvAlgorithmName(algorithm) << " does not support " << shape.ToString();
+    const chainerx::Array xc = chainerx::AsContiguous(x);
+    const int64_t out_size = shape.out_h * shape.out_w;
+    if (x.dtype() == chainerx::Dtype::kFloat32) {
+        RunConv<float>(xc, filter.w, filter.panels, shape, algorithm, y);
+        AddBias<float>(y, b, shape.batch, shape.out_channels, out_size);
+    } else {
+        RunConv<double>(xc, filter.w, filter.panels, shape, algorithm, y);
+        AddBias<double>(y, b, shape.batch, shape.out_channels, out_size);
+    }
+}
+
+PackedMatrix PackMatrix(const chainerx::Array& w, bool trans) {
+    CHECK_EQ(2, w.ndim());
+    const int64_t depth = w.shape()[trans ? 1 : 0];
+    const int64_t units = w.shape()[trans ? 0 : 1];
+    PackedMatrix matrix{w, trans, depth, units, absl::nullopt};
+    if (!IsPackable(w)) return matrix;
+
+    // Columns of W^T or W are packed as rows of panels.
+    const chainerx::Array wc = chainerx::AsContiguous(w);
+    const int64_t rs = trans ? depth : 1;
+    const int64_t cs = trans ? 1 : units;
+    chainerx::Array panels = chainerx::Empty({GetPackedSize<kNr>(units, depth)}, w.dtype(), w.device());
+    if (w.dtype() == chainerx::Dtype::kFloat32) {
+        PackPanels<kNr>(GetData<const float>(wc), rs, cs, units, depth, GetData<float>(panels));
+    } else {
+        PackPanels<kNr>(GetData<const double>(wc), rs, cs, units, depth, GetData<double>(panels));
+    }
+    matrix.panels = panels;
+    return matrix;
+}
+
+void CpuMatMulPacked(const chainerx::Array& x, const PackedMatrix& matrix, const chainerx::Array& y) {
+    CHECK(matrix.panels.has_value());
+    CHECK(y.IsContiguous());
+    CHECK_EQ(2, x.ndim());
+    CHECK_EQ(matrix.depth, x.shape()[1]);
+    CHECK_EQ(matrix.w.dtype(), x.dtype());
+    const chainerx::Array xc = chainerx::AsContiguous(x);
+    const int64_t m = x.shape()[0];
+    if (x.dtype() == chainerx::Dtype::kFloat32) {
+        MatMulPackedImpl(GetData<const float>(xc), GetData<const float>(*matrix.panels), GetData<float>(y), m, matrix.units, matrix.depth);
+    } else {
+        MatMulPackedImpl(
+                GetData<const double>(xc), GetData<const double>(*matrix.panels), GetData<double>(y), m, matrix.units, matrix.depth);
+    }
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
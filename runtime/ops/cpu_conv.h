@@ -0,0 +1,157 @@
+#pragma once
+
+#include <string>
+
+#include <absl/types/optional.h>
+#include <chainerx/array.h>
+
+#include <runtime/chainerx_util.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// Algorithms of the convolution engine for NCHW images on CPU.
+// kChainerX runs convolutions by ChainerX instead.
+enum class ConvAlgorithm { kAuto, kChainerX, kIm2col, kDirect1x1, kWinograd, kDepthwise };
+
+const char* GetConvAlgorithmName(ConvAlgorithm algorithm);
+
+ConvAlgorithm ParseConvAlgorithm(const std::string& name);
+
+// The geometry of a 2D convolution from `in_channels` to
+// `out_channels`. ConvTranspose and ConvGradWeight are described by
+// the shape of the corresponding forward convolution.
+struct ConvShape {
+    int64_t batch;
+    int64_t in_channels;
+    int64_t out_channels;
+    int64_t group;
+    int64_t in_h;
+    int64_t in_w;
+    int64_t kernel_h;
+    int64_t kernel_w;
+    int64_t stride_h;
+    int64_t stride_w;
+    int64_t pad_h;
+    int64_t pad_w;
+    int64_t out_h;
+    int64_t out_w;
+
+    // The key in tuning tables.
+    std::string ToString() const;
+
+    int64_t GetFlops() const;
+};
+
+ConvShape MakeConvShape(
+        const chainerx::Shape& x_shape,
+        const chainerx::Shape& w_shape,
+        const chainerx::Shape& y_shape,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int64_t group);
+
+// Returns the output shape of a convolution without `auto_pad`.
+chainerx::Shape GetConvOutputShape(
+        const chainerx::Shape& x_shape, const chainerx::Shape& w_shape, const Int64StackVector& strides, const Int64StackVector& pads);
+
+// Returns true if the engine can run a 2D convolution on `x` and `w`
+// (and `b`), i.e., they are float32 or float64 arrays on the native
+// device and `pads` are symmetric.
+bool CanUseCpuConv(
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& b,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads);
+
+bool IsConvAlgorithmSupported(const ConvShape& shape, ConvAlgorithm algorithm);
+
+// Returns the algorithm in the tuning table for `shape`, or the one
+// chosen by a heuristic. CHAINER_COMPILER_CONV_ALGORITHM forces an
+// algorithm for all shapes it supports, and
+// CHAINER_COMPILER_CONV_TUNING_TABLE specifies a file generated by
+// `conv_bench --tune`.
+ConvAlgorithm ChooseConvAlgorithm(const ConvShape& shape);
+
+// Returns false if CHAINER_COMPILER_CONV_ALGORITHM is "chainerx".
+bool IsCpuConvEnabled();
+
+// Adds an entry to the tuning table. Entries in the file are loaded
+// before the first lookup. Returns the previous algorithm for `shape`,
+// or kAuto if there was none, so the entry can be restored. An entry of
+// kAuto is ignored by ChooseConvAlgorithm.
+ConvAlgorithm SetConvTuningEntry(const ConvShape& shape, ConvAlgorithm algorithm);
+
+void LoadConvTuningTable(const std::string& filename);
+
+// Computes y = Conv(x, w) + b into the contiguous `y`.
+void CpuConv(
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& b,
+        const ConvShape& shape,
+        ConvAlgorithm algorithm,
+        const chainerx::Array& y);
+
+// Computes the gradient of the weight from `x` and `gy` into the
+// contiguous `gw`.
+void CpuConvGradWeight(const chainerx::Array& x, const chainerx::Array& gy, const ConvShape& shape, const chainerx::Array& gw);
+
+// Computes ConvTranspose of `x`, which is the gradient of the input of
+// the convolution `shape` from its output, into the contiguous `y`.
+void CpuConvTranspose(
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& b,
+        const ConvShape& shape,
+        const chainerx::Array& y);
+
+// A filter rearranged ahead into the panels the GEMM of the engine
+// reads, so constant filters are not packed at every call. Panels are
+// of filters of each group for kIm2col, which also serve kDirect1x1,
+// or of the 16 elements of transformed kernels for kWinograd. Filters
+// for other algorithms are not packed.
+struct PackedFilter {
+    // The original filter.
+    chainerx::Array w;
+    int64_t group;
+    ConvAlgorithm algorithm;
+    absl::optional<chainerx::Array> panels;
+};
+
+// Packs `w` for `algorithm`. Filters on other devices or of other
+// dtypes are not packed.
+PackedFilter PackFilter(const chainerx::Array& w, int64_t group, ConvAlgorithm algorithm);
+
+// Computes y = Conv(x, w) + b into the contiguous `y` with the panels
+// of `filter`, or like CpuConv if it is not packed.
+void CpuConvPacked(
+        const chainerx::Array& x,
+        const PackedFilter& filter,
+        const absl::optional<chainerx::Array>& b,
+        const ConvShape& shape,
+        const chainerx::Array& y);
+
+// The weight of y = x W^T (if `trans`) or y = x W rearranged into
+// strips of columns the GEMM of the engine reads.
+struct PackedMatrix {
+    // The original weight.
+    chainerx::Array w;
+    bool trans;
+    // The number of rows and columns of W^T or W.
+    int64_t depth;
+    int64_t units;
+    absl::optional<chainerx::Array> panels;
+};
+
+// Packs the 2D `w`. Weights on other devices or of other dtypes are
+// not packed.
+PackedMatrix PackMatrix(const chainerx::Array& w, bool trans);
+
+// Computes the product of the 2D `x` and the packed `matrix` into the
+// contiguous `y`.
+void CpuMatMulPacked(const chainerx::Array& x, const PackedMatrix& matrix, const chainerx::Array& y);
+
+}  // namespace runtime
+}  // namespace chainer_compiler
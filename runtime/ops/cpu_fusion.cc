@@ -0,0 +1,139 @@
+#include <dlfcn.h>
+
+#include <chainerx/array.h>
+#include <chainerx/dtype.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/shape.h>
+
+#include <common/log.h>
+#include <runtime/chainerx_util.h>
+#include <runtime/gen_chxvm_ops.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+// See compiler/cpu_fusion_builder.h for the signature.
+typedef void (*FusionFunc)(int64_t rows, int64_t cols, const void* const* inputs, const int64_t* input_strides, void* const* outputs);
+
+const char* kFusionFuncName = "chainer_compiler_fusion";
+
+char* GetRawData(const chainerx::Array& a) {
+    return static_cast<char*>(a.raw_data()) + a.offset();
+}
+
+}  // namespace
+
+class ElementWiseCpuOp::ElementWiseCpuImpl {
+public:
+    void* handle{nullptr};
+    FusionFunc fn{nullptr};
+};
+
+void ElementWiseCpuOp::InitImpl() {
+    impl_ = new ElementWiseCpuImpl();
+    impl_->handle = dlopen(dso_filename.c_str(), RTLD_NOW | RTLD_LOCAL);
+    CHECK(impl_->handle) << "Failed to load " << dso_filename << ": " << dlerror();
+    impl_->fn = reinterpret_cast<FusionFunc>(dlsym(impl_->handle, kFusionFuncName));
+    CHECK(impl_->fn) << "No " << kFusionFuncName << " in " << dso_filename;
+}
+
+ElementWiseCpuOp::~ElementWiseCpuOp() {
+    if (impl_->handle) dlclose(impl_->handle);
+    delete impl_;
+}
+
+std::vector<chainerx::Array> ElementWiseCpuOp::RunImpl(
+        chainer_compiler::runtime::ChxVMState* st, const std::vector<chainerx::Array>& orig_inputs) {
+    CHECK(!orig_inputs.empty());
+    chainerx::Device& device = orig_inputs[0].device();
+    CHECK(IsNativeDevice(&device)) << "ElementWiseCpu runs only on CPU: " << device.name();
+    const chainerx::Dtype dtype = static_cast<chainerx::Dtype>(this->dtype);
+    const int64_t item_size = chainerx::GetItemSize(dtype);
+
+    chainerx::Shape shape = orig_inputs[0].shape();
+    for (const chainerx::Array& input : orig_inputs) {
+        CHECK_EQ(dtype, input.dtype());
+        shape = chainerx::internal::BroadcastShapes(shape, input.shape());
+    }
+
+    // Broadcasted inputs are not copied. Their broadcasted axes have
+    // zero strides.
+    std::vector<chainerx::Array> inputs;
+    for (chainerx::Array input : orig_inputs) {
+        if (shape != input.shape()) {
+            input = input.BroadcastTo(shape);
+        }
+        inputs.push_back(input);
+    }
+
+    // Axes of size one are dropped and an axis is merged to the next
+    // one if all inputs are contiguous between them. Outputs are
+    // always contiguous.
+    std::vector<int64_t> dims;
+    std::vector<std::vector<int64_t>> strides(inputs.size());
+    for (int i = 0; i < shape.ndim(); ++i) {
+        if (shape[i] == 1) continue;
+        bool mergeable = !dims.empty();
+        for (size_t j = 0; j < inputs.size() && mergeable; ++j) {
+            const int64_t stride = inputs[j].strides()[i] / item_size;
+            mergeable = strides[j].back() == stride * shape[i];
+        }
+        if (mergeable) {
+            dims.back() *= shape[i];
+        } else {
+            dims.push_back(shape[i]);
+        }
+        for (size_t j = 0; j < inputs.size(); ++j) {
+            const int64_t stride = inputs[j].strides()[i] / item_size;
+            if (mergeable) {
+                strides[j].back() = stride;
+            } else {
+                strides[j].push_back(stride);
+            }
+        }
+    }
+
+    // The generated function processes the last two axes. Leading
+    // axes are iterated here.
+    const int ndim = dims.size();
+    const int64_t rows = ndim >= 2 ? dims[ndim - 2] : 1;
+    const int64_t cols = ndim >= 1 ? dims[ndim - 1] : 1;
+    std::vector<int64_t> func_strides;
+    for (const std::vector<int64_t>& s : strides) {
+        func_strides.push_back(ndim >= 2 ? s[ndim - 2] : 0);
+        func_strides.push_back(ndim >= 1 ? s[ndim - 1] : 0);
+    }
+    int64_t num_slices = 1;
+    for (int i = 0; i < ndim - 2; ++i) {
+        num_slices *= dims[i];
+    }
+
+    std::vector<chainerx::Array> outputs;
+    for (int i = 0; i < num_outputs; ++i) {
+        outputs.push_back(chainerx::Empty(shape, dtype, device));
+    }
+
+    std::vector<const void*> input_ptrs(inputs.size());
+    std::vector<void*> output_ptrs(outputs.size());
+    for (int64_t slice = 0; slice < num_slices; ++slice) {
+        for (size_t j = 0; j < inputs.size(); ++j) {
+            int64_t offset = 0;
+            int64_t index = slice;
+            for (int i = ndim - 3; i >= 0; --i) {
+                offset += index % dims[i] * strides[j][i];
+                index /= dims[i];
+            }
+            input_ptrs[j] = GetRawData(inputs[j]) + offset * item_size;
+        }
+        for (size_t j = 0; j < outputs.size(); ++j) {
+            output_ptrs[j] = GetRawData(outputs[j]) + slice * rows * cols * item_size;
+        }
+        impl_->fn(rows, cols, input_ptrs.data(), func_strides.data(), output_ptrs.data());
+    }
+    return outputs;
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
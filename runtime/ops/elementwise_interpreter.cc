@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <chainerx/array.h>
+#include <chainerx/dtype.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/shape.h>
+
+#include <common/log.h>
+#include <runtime/chainerx_util.h>
+#include <runtime/elementwise_bytecode.h>
+#include <runtime/gen_chxvm_ops.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+// Registers of 4K elements fit in L1 or L2 cache together.
+constexpr int64_t kTileSize = 4096;
+
+template <typename T>
+T* GetData(const chainerx::Array& a) {
+    return reinterpret_cast<T*>(static_cast<char*>(a.raw_data()) + a.offset());
+}
+
+template <typename T, typename Fn>
+inline void Unary(T* d, const T* a, int64_t n, Fn fn) {
+    for (int64_t i = 0; i < n; ++i) d[i] = fn(a[i]);
+}
+
+template <typename T, typename Fn>
+inline void Binary(T* d, const T* a, const T* b, int64_t n, Fn fn) {
+    for (int64_t i = 0; i < n; ++i) d[i] = fn(a[i], b[i]);
+}
+
+// Reduces each row of `cols` elements and broadcasts the result to
+// the row.
+template <typename T, typename Fn>
+inline void ReduceRows(T* d, const T* a, int64_t n, int64_t cols, T init, Fn fn, T scale) {
+    for (int64_t row = 0; row < n; row += cols) {
+        T acc = init;
+        for (int64_t i = row; i < row + cols; ++i) acc = fn(acc, a[i]);
+        std::fill(d + row, d + row + cols, acc * scale);
+    }
+}
+
+// Computes (Log)Softmax of each row while it is in cache.
+template <typename T>
+inline void SoftmaxRows(T* d, const T* a, int64_t n, int64_t cols, bool is_log) {
+    for (int64_t row = 0; row < n; row += cols) {
+        const T* x = a + row;
+        T* y = d + row;
+        const T max = *std::max_element(x, x + cols);
+        T sum = 0;
+        if (is_log) {
+            for (int64_t i = 0; i < cols; ++i) sum += std::exp(x[i] - max);
+            const T log_sum = max + std::log(sum);
+            for (int64_t i = 0; i < cols; ++i) y[i] = x[i] - log_sum;
+        } else {
+            for (int64_t i = 0; i < cols; ++i) {
+                y[i] = std::exp(x[i] - max);
+                sum += y[i];
+            }
+            const T inv_sum = T(1) / sum;
+            for (int64_t i = 0; i < cols; ++i) y[i] *= inv_sum;
+        }
+    }
+}
+
+template <typename T>
+void RunTile(const std::vector<int64_t>& program, T* const* regs, int64_t n, int64_t cols) {
+    for (size_t pc = 0; pc < program.size(); pc += kBytecodeInstructionSize) {
+        T* d = regs[program[pc + 1]];
+        const T* a = regs[program[pc + 2]];
+        const T* b = program[pc + 3] >= 0 ? regs[program[pc + 3]] : nullptr;
+        const T* c = program[pc + 4] >= 0 ? regs[program[pc + 4]] : nullptr;
+        switch (static_cast<BytecodeOp>(program[pc])) {
+            case BytecodeOp::kCopy:
+                std::copy(a, a + n, d);
+                break;
+            case BytecodeOp::kNeg:
+                Unary(d, a, n, [](T x) { return -x; });
+                break;
+            case BytecodeOp::kRelu:
+                Unary(d, a, n, [](T x) { return x > T(0) ? x : T(0); });
+                break;
+            case BytecodeOp::kSqrt:
+                Unary(d, a, n, [](T x) { return std::sqrt(x); });
+                break;
+            case BytecodeOp::kExp:
+                Unary(d, a, n, [](T x) { return std::exp(x); });
+                break;
+            case BytecodeOp::kTanh:
+                Unary(d, a, n, [](T x) { return std::tanh(x); });
+                break;
+            case BytecodeOp::kSigmoid:
+                Unary(d, a, n, [](T x) { return T(1) / (T(1) + std::exp(-x)); });
+                break;
+            case BytecodeOp::kLog:
+                Unary(d, a, n, [](T x) { return std::log(x); });
+                break;
+            case BytecodeOp::kAdd:
+                Binary(d, a, b, n, [](T x, T y) { return x + y; });
+                break;
+            case BytecodeOp::kSub:
+                Binary(d, a, b, n, [](T x, T y) { return x - y; });
+                break;
+            case BytecodeOp::kMul:
+                Binary(d, a, b, n, [](T x, T y) { return x * y; });
+                break;
+            case BytecodeOp::kDiv:
+                Binary(d, a, b, n, [](T x, T y) { return x / y; });
+                break;
+            case BytecodeOp::kPow:
+                // Variances in normalizations are computed by x ** 2.
+                Binary(d, a, b, n, [](T x, T y) { return y == T(2) ? x * x : std::pow(x, y); });
+                break;
+            case BytecodeOp::kClip:
+                for (int64_t i = 0; i < n; ++i) d[i] = std::min(std::max(a[i], b[i]), c[i]);
+                break;
+            case BytecodeOp::kWhere:
+                for (int64_t i = 0; i < n; ++i) d[i] = a[i] != T(0) ? b[i] : c[i];
+                break;
+            case BytecodeOp::kReduceSum:
+                ReduceRows(d, a, n, cols, T(0), [](T acc, T x) { return acc + x; }, T(1));
+                break;
+            case BytecodeOp::kReduceSumSquare:
+                ReduceRows(d, a, n, cols, T(0), [](T acc, T x) { return acc + x * x; }, T(1));
+                break;
+            case BytecodeOp::kReduceMean:
+                ReduceRows(d, a, n, cols, T(0), [](T acc, T x) { return acc + x; }, T(1) / cols);
+                break;
+            case BytecodeOp::kReduceMax:
+                ReduceRows(d, a, n, cols, -std::numeric_limits<T>::infinity(), [](T acc, T x) { return std::max(acc, x); }, T(1));
+                break;
+            case BytecodeOp::kSoftmax:
+                SoftmaxRows(d, a, n, cols, false);
+                break;
+            case BytecodeOp::kLogSoftmax:
+                SoftmaxRows(d, a, n, cols, true);
+                break;
+            default:
+                CHECK(false) << "Unknown bytecode op: " << program[pc];
+        }
+    }
+}
+
+// Runs `program` over tiles of `tile_size` elements. If `cols` is
+// positive, tiles consist of rows of `cols` elements and inputs of
+// `cols` elements are repeated for each row.
+template <typename T>
+void Interpret(
+        const std::vector<int64_t>& program,
+        const std::vector<double>& constants,
+        int num_registers,
+        const std::vector<chainerx::Array>& inputs,
+        const std::vector<chainerx::Array>& outputs,
+        int64_t size,
+        int64_t cols) {
+    const int num_inputs = inputs.size();
+    const int num_outputs = outputs.size();
+    const int num_constants = constants.size();
+    const int first_temp = num_inputs + num_outputs + num_constants;
+    const int64_t tile_size = cols > 0 ? std::max<int64_t>(1, kTileSize / cols) * cols : kTileSize;
+    const int64_t num_tiles = (size + tile_size - 1) / tile_size;
+
+    // Inputs which are not broadcasted by tiles have the same shape
+    // as outputs.
+    std::vector<const T*> input_ptrs;
+    for (const chainerx::Array& input : inputs) {
+        input_ptrs.push_back(GetData<T>(input));
+    }
+
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel if (num_tiles > 1)
+#endif
+    {
+        // Tiles of broadcasted inputs, constants, and temporary values.
+        std::vector<T> buf((num_inputs + num_registers - first_temp + num_constants) * tile_size);
+        std::vector<T*> regs(num_registers);
+        T* next = buf.data();
+        auto fill = [&next, tile_size](T value) {
+            std::fill(next, next + tile_size, value);
+            next += tile_size;
+            return next - tile_size;
+        };
+        auto repeat = [&next, tile_size, cols](const T* row) {
+            for (int64_t i = 0; i < tile_size; i += cols) std::copy(row, row + cols, next + i);
+            next += tile_size;
+            return next - tile_size;
+        };
+        for (int i = 0; i < num_inputs; ++i) {
+            const int64_t input_size = inputs[i].GetTotalSize();
+            if (input_size == size) continue;
+            if (input_size == 1) {
+                regs[i] = fill(*input_ptrs[i]);
+            } else {
+                CHECK_EQ(cols, input_size);
+                regs[i] = repeat(input_ptrs[i]);
+            }
+        }
+        for (int i = 0; i < num_constants; ++i) {
+            regs[num_inputs + num_outputs + i] = fill(static_cast<T>(constants[i]));
+        }
+        for (int i = first_temp; i < num_registers; ++i) {
+            regs[i] = next;
+            next += tile_size;
+        }
+
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (int64_t tile = 0; tile < num_tiles; ++tile) {
+            const int64_t begin = tile * tile_size;
+            const int64_t n = std::min(tile_size, size - begin);
+            for (int i = 0; i < num_inputs; ++i) {
+                if (inputs[i].GetTotalSize() == size) regs[i] = const_cast<T*>(input_ptrs[i]) + begin;
+            }
+            for (int i = 0; i < num_outputs; ++i) {
+                regs[num_inputs + i] = GetData<T>(outputs[i]) + begin;
+            }
+            RunTile(program, regs.data(), n, cols);
+        }
+    }
+}
+
+}  // namespace
+
+std::vector<chainerx::Array> ElementWiseInterpreterOp::RunImpl(
+        chainer_compiler::runtime::ChxVMState* st, const std::vector<chainerx::Array>& orig_inputs) {
+    CHECK(!orig_inputs.empty());
+    chainerx::Device& device = orig_inputs[0].device();
+    CHECK(IsNativeDevice(&device)) << "ElementWiseInterpreter runs only on CPU: " << device.name();
+    const chainerx::Dtype dtype = static_cast<chainerx::Dtype>(this->dtype);
+
+    chainerx::Shape shape = orig_inputs[0].shape();
+    for (const chainerx::Array& input : orig_inputs) {
+        shape = chainerx::internal::BroadcastShapes(shape, input.shape());
+    }
+
+    // Programs with row-wise operations are run over whole rows.
+    int64_t cols = 0;
+    for (size_t pc = 0; pc < program.size(); pc += kBytecodeInstructionSize) {
+        if (IsRowwiseBytecodeOp(program[pc])) {
+            CHECK_LT(0, shape.ndim());
+            cols = shape.back();
+        }
+    }
+    auto is_row = [cols](const chainerx::Array& input) {
+        return cols > 0 && input.GetTotalSize() == cols && input.ndim() > 0 && input.shape().back() == cols;
+    };
+
+    // Scalars and rows (e.g., scales of normalizations) are
+    // broadcasted to tiles by the interpreter. Other inputs are
+    // broadcasted, converted (e.g., conditions of Where), and made
+    // contiguous beforehand.
+    std::vector<chainerx::Array> inputs;
+    for (chainerx::Array input : orig_inputs) {
+        if (input.GetTotalSize() != 1 && !is_row(input) && shape != input.shape()) {
+            input = input.BroadcastTo(shape);
+        }
+        if (input.dtype() != dtype) {
+            input = input.AsType(dtype);
+        }
+        inputs.push_back(chainerx::AsContiguous(input));
+    }
+
+    std::vector<chainerx::Array> outputs;
+    for (int i = 0; i < num_outputs; ++i) {
+        outputs.push_back(chainerx::Empty(shape, dtype, device));
+    }
+
+    const int64_t size = shape.GetTotalSize();
+    if (size == 0) return outputs;
+    switch (dtype) {
+        case chainerx::Dtype::kFloat32:
+            Interpret<float>(program, constants, num_registers, inputs, outputs, size, cols);
+            break;
+        case chainerx::Dtype::kFloat64:
+            Interpret<double>(program, constants, num_registers, inputs, outputs, size, cols);
+            break;
+        default:
+            CHECK(false) << "Unsupported dtype for ElementWiseInterpreter: " << dtype;
+    }
+    return outputs;
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
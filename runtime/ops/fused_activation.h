@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <type_traits>
+
+#include <common/log.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// Activations fused into FusedConv, LayoutConv, and LinearActivation.
+enum class FusedActivation { kNone, kRelu, kLeakyRelu, kSigmoid, kTanh, kClip };
+
+inline FusedActivation ParseActivation(const std::string& activation) {
+    if (activation.empty()) return FusedActivation::kNone;
+    if (activation == "Relu") return FusedActivation::kRelu;
+    if (activation == "LeakyRelu") return FusedActivation::kLeakyRelu;
+    if (activation == "Sigmoid") return FusedActivation::kSigmoid;
+    if (activation == "Tanh") return FusedActivation::kTanh;
+    if (activation == "Clip") return FusedActivation::kClip;
+    CHECK(false) << "Unknown activation: " << activation;
+    return FusedActivation::kNone;
+}
+
+struct Epilogue {
+    FusedActivation activation;
+    double alpha;
+    double min;
+    double max;
+};
+
+template <FusedActivation kActivation, typename T>
+inline T Activate(T v, const Epilogue& ep) {
+    switch (kActivation) {
+        case FusedActivation::kNone:
+            return v;
+        case FusedActivation::kRelu:
+            return v < 0 ? 0 : v;
+        case FusedActivation::kLeakyRelu:
+            return v < 0 ? static_cast<T>(ep.alpha) * v : v;
+        case FusedActivation::kSigmoid:
+            return 1 / (1 + std::exp(-v));
+        case FusedActivation::kTanh:
+            return std::tanh(v);
+        case FusedActivation::kClip:
+            return std::min(std::max(v, static_cast<T>(ep.min)), static_cast<T>(ep.max));
+    }
+    return v;
+}
+
+// Computes the gradient of the input of the activation from its
+// output `y` and the gradient `gy`.
+template <FusedActivation kActivation, typename T>
+inline T ActivateGrad(T y, T gy) {
+    switch (kActivation) {
+        case FusedActivation::kNone:
+            return gy;
+        case FusedActivation::kRelu:
+            return y > 0 ? gy : 0;
+        case FusedActivation::kSigmoid:
+            return gy * y * (1 - y);
+        case FusedActivation::kTanh:
+            return gy * (1 - y * y);
+        default:
+            break;
+    }
+    return gy;
+}
+
+// Calls `fn` with `std::integral_constant` of `activation` so the
+// activation is resolved at compile time in inner loops.
+template <typename Fn>
+void DispatchActivation(FusedActivation activation, Fn&& fn) {
+    switch (activation) {
+        case FusedActivation::kNone:
+            fn(std::integral_constant<FusedActivation, FusedActivation::kNone>());
+            break;
+        case FusedActivation::kRelu:
+            fn(std::integral_constant<FusedActivation, FusedActivation::kRelu>());
+            break;
+        case FusedActivation::kLeakyRelu:
+            fn(std::integral_constant<FusedActivation, FusedActivation::kLeakyRelu>());
+            break;
+        case FusedActivation::kSigmoid:
+            fn(std::integral_constant<FusedActivation, FusedActivation::kSigmoid>());
+            break;
+        case FusedActivation::kTanh:
+            fn(std::integral_constant<FusedActivation, FusedActivation::kTanh>());
+            break;
+        case FusedActivation::kClip:
+            fn(std::integral_constant<FusedActivation, FusedActivation::kClip>());
+            break;
+    }
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
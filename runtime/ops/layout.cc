@@ -0,0 +1,444 @@
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <chainerx/array.h>
+#include <chainerx/kernels/linalg.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/routines/manipulation.h>
+
+#include <common/log.h>
+#include <runtime/chainerx_util.h>
+#include <runtime/gen_chxvm_ops.h>
+#include <runtime/ops/fused_activation.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+// Returns B of "NCHW<B>c", or 0 for "NHWC".
+int64_t GetBlockSize(const std::string& layout) {
+    if (layout == "NHWC") return 0;
+    CHECK(layout.size() > 5 && layout.compare(0, 4, "NCHW") == 0 && layout.back() == 'c') << "Unknown layout: " << layout;
+    return std::stoll(layout.substr(4, layout.size() - 5));
+}
+
+// An image in NHWC or NCHW<B>c seen as (N, CB, H, W, L), i.e., NHWC
+// is a single block of all channels.
+struct LayoutImage {
+    int64_t batch;
+    int64_t blocks;
+    int64_t height;
+    int64_t width;
+    int64_t lanes;
+};
+
+LayoutImage GetLayoutImage(const chainerx::Array& x, const std::string& layout) {
+    const chainerx::Shape& s = x.shape();
+    if (GetBlockSize(layout) == 0) {
+        CHECK_EQ(4, x.ndim()) << layout;
+        return {s[0], 1, s[1], s[2], s[3]};
+    }
+    CHECK_EQ(5, x.ndim()) << layout;
+    return {s[0], s[1], s[2], s[3], s[4]};
+}
+
+chainerx::Array EmptyLayoutImage(const LayoutImage& image, const std::string& layout, const chainerx::Array& like) {
+    chainerx::Shape shape{image.batch, image.blocks, image.height, image.width, image.lanes};
+    if (GetBlockSize(layout) == 0) shape = {image.batch, image.height, image.width, image.lanes};
+    return chainerx::Empty(shape, like.dtype(), like.device());
+}
+
+int64_t GetOutputSize(int64_t size, int64_t kernel, int64_t stride, int64_t pad_begin, int64_t pad_end, bool cover_all) {
+    return (size + pad_begin + pad_end - kernel + (cover_all ? stride - 1 : 0)) / stride + 1;
+}
+
+template <typename T>
+T* GetData(const chainerx::Array& a) {
+    return reinterpret_cast<T*>(static_cast<char*>(a.raw_data()) + a.offset());
+}
+
+// Applies the bias, the residual, and the activation to `num_pixels`
+// pixels of `lanes` channels.
+template <FusedActivation kActivation, typename T>
+void ApplyEpilogueImpl(T* y, const T* b, const T* z, int64_t num_pixels, int64_t lanes, const Epilogue& ep) {
+    for (int64_t i = 0; i < num_pixels; ++i) {
+        T* yp = y + i * lanes;
+        const T* zp = z ? z + i * lanes : nullptr;
+        for (int64_t l = 0; l < lanes; ++l) {
+            T v = yp[l];
+            if (b) v += b[l];
+            if (zp) v += zp[l];
+            yp[l] = Activate<kActivation>(v, ep);
+        }
+    }
+}
+
+template <typename T>
+void ApplyEpilogue(T* y, const T* b, const T* z, int64_t num_pixels, int64_t lanes, const Epilogue& ep) {
+    if (!b && !z && ep.activation == FusedActivation::kNone) return;
+    DispatchActivation(ep.activation, [&](auto act) { ApplyEpilogueImpl<decltype(act)::value>(y, b, z, num_pixels, lanes, ep); });
+}
+
+template <typename T>
+struct ConvArgs {
+    const T* x;
+    const T* w;
+    const T* b;
+    const T* z;
+    T* y;
+    LayoutImage in;
+    LayoutImage out;
+    int64_t kernel_h;
+    int64_t kernel_w;
+    int64_t stride_h;
+    int64_t stride_w;
+    int64_t pad_t;
+    int64_t pad_l;
+    Epilogue ep;
+};
+
+// Output pixels computed together, so each row of weights is loaded
+// once for them. Accumulators of these pixels fit in registers.
+constexpr int kPixelTile = 6;
+
+// Computes `kLanes` output channels from `co` of `num_pixels` pixels
+// from `ow` in the row `oh`. `zeros` is used for paddings.
+template <typename T, int kLanes>
+void ConvTile(const ConvArgs<T>& a, const T* zeros, int64_t n, int64_t kb, int64_t co, int64_t oh, int64_t ow, int64_t num_pixels) {
+    const LayoutImage& in = a.in;
+    const LayoutImage& out = a.out;
+    T acc[kPixelTile][kLanes] = {};
+    for (int64_t cb = 0; cb < in.blocks; ++cb) {
+        for (int64_t kh = 0; kh < a.kernel_h; ++kh) {
+            const int64_t ih = oh * a.stride_h - a.pad_t + kh;
+            if (ih < 0 || ih >= in.height) continue;
+            const T* x_row = a.x + ((n * in.blocks + cb) * in.height + ih) * in.width * in.lanes;
+            for (int64_t kw = 0; kw < a.kernel_w; ++kw) {
+                const T* xs[kPixelTile];
+                for (int i = 0; i < kPixelTile; ++i) {
+                    const int64_t iw = (ow + i) * a.stride_w - a.pad_l + kw;
+                    xs[i] = i < num_pixels && iw >= 0 && iw < in.width ? x_row + iw * in.lanes : zeros;
+                }
+                const T* wp = a.w + (((kb * in.blocks + cb) * a.kernel_h + kh) * a.kernel_w + kw) * in.lanes * out.lanes + co;
+                for (int64_t ci = 0; ci < in.lanes; ++ci) {
+                    const T* wr = wp + ci * out.lanes;
+                    for (int i = 0; i < kPixelTile; ++i) {
+                        const T xv = xs[i][ci];
+                        for (int l = 0; l < kLanes; ++l) acc[i][l] += xv * wr[l];
+                    }
+                }
+            }
+        }
+    }
+
+    T* yp = a.y + (((n * out.blocks + kb) * out.height + oh) * out.width + ow) * out.lanes + co;
+    for (int i = 0; i < num_pixels; ++i) {
+        std::copy(acc[i], acc[i] + kLanes, yp + i * out.lanes);
+    }
+}
+
+// Direct convolution. The innermost loop runs over contiguous output
+// channels of a block, which are vectorized.
+template <typename T>
+void ConvImpl(const ConvArgs<T>& a) {
+    const LayoutImage& out = a.out;
+    const std::vector<T> zeros(a.in.lanes);
+    const int64_t num_rows = out.batch * out.blocks * out.height;
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int64_t row = 0; row < num_rows; ++row) {
+        const int64_t oh = row % out.height;
+        const int64_t kb = row / out.height % out.blocks;
+        const int64_t n = row / out.height / out.blocks;
+        // Weights of a tile of channels are reused for the whole row.
+        int64_t co = 0;
+        auto run = [&](auto lanes) {
+            for (int64_t ow = 0; ow < out.width; ow += kPixelTile) {
+                ConvTile<T, decltype(lanes)::value>(a, zeros.data(), n, kb, co, oh, ow, std::min<int64_t>(kPixelTile, out.width - ow));
+            }
+            co += decltype(lanes)::value;
+        };
+        while (co + 16 <= out.lanes) run(std::integral_constant<int, 16>());
+        while (co + 8 <= out.lanes) run(std::integral_constant<int, 8>());
+        while (co < out.lanes) run(std::integral_constant<int, 1>());
+
+        const int64_t offset = row * out.width * out.lanes;
+        ApplyEpilogue(a.y + offset, a.b ? a.b + kb * out.lanes : nullptr, a.z ? a.z + offset : nullptr, out.width, out.lanes, a.ep);
+    }
+}
+
+// Depthwise convolution with weights of (CB, KH, KW, L).
+template <typename T>
+void DepthwiseConvImpl(const ConvArgs<T>& a) {
+    const LayoutImage& in = a.in;
+    const LayoutImage& out = a.out;
+    const int64_t num_rows = out.batch * out.blocks * out.height;
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int64_t row = 0; row < num_rows; ++row) {
+        const int64_t oh = row % out.height;
+        const int64_t cb = row / out.height % out.blocks;
+        const int64_t n = row / out.height / out.blocks;
+        T* y_row = a.y + row * out.width * out.lanes;
+        std::fill(y_row, y_row + out.width * out.lanes, T(0));
+        for (int64_t kh = 0; kh < a.kernel_h; ++kh) {
+            const int64_t ih = oh * a.stride_h - a.pad_t + kh;
+            if (ih < 0 || ih >= in.height) continue;
+            const T* x_row = a.x + ((n * in.blocks + cb) * in.height + ih) * in.width * in.lanes;
+            for (int64_t kw = 0; kw < a.kernel_w; ++kw) {
+                const T* wp = a.w + ((cb * a.kernel_h + kh) * a.kernel_w + kw) * out.lanes;
+                for (int64_t ow = 0; ow < out.width; ++ow) {
+                    const int64_t iw = ow * a.stride_w - a.pad_l + kw;
+                    if (iw < 0 || iw >= in.width) continue;
+                    const T* xp = x_row + iw * in.lanes;
+                    T* yp = y_row + ow * out.lanes;
+                    for (int64_t l = 0; l < out.lanes; ++l) yp[l] += xp[l] * wp[l];
+                }
+            }
+        }
+        const T* z_row = a.z ? a.z + row * out.width * out.lanes : nullptr;
+        ApplyEpilogue(y_row, a.b ? a.b + cb * out.lanes : nullptr, z_row, out.width, out.lanes, a.ep);
+    }
+}
+
+template <typename T>
+void PoolImpl(
+        const chainerx::Array& x,
+        const chainerx::Array& y,
+        const LayoutImage& in,
+        const LayoutImage& out,
+        const Int64StackVector& kernel_shape,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        bool is_max,
+        bool count_include_pad) {
+    const T* xd = GetData<T>(x);
+    T* yd = GetData<T>(y);
+    const int64_t num_rows = out.batch * out.blocks * out.height;
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int64_t row = 0; row < num_rows; ++row) {
+        const int64_t oh = row % out.height;
+        const int64_t nb = row / out.height;
+        const int64_t h0 = oh * strides[0] - pads[0];
+        const int64_t h_begin = std::max<int64_t>(h0, 0);
+        const int64_t h_end = std::min<int64_t>(h0 + kernel_shape[0], in.height);
+        for (int64_t ow = 0; ow < out.width; ++ow) {
+            const int64_t w0 = ow * strides[1] - pads[1];
+            const int64_t w_begin = std::max<int64_t>(w0, 0);
+            const int64_t w_end = std::min<int64_t>(w0 + kernel_shape[1], in.width);
+            T* yp = yd + (row * out.width + ow) * out.lanes;
+            std::fill(yp, yp + out.lanes, is_max ? -std::numeric_limits<T>::infinity() : T(0));
+            for (int64_t ih = h_begin; ih < h_end; ++ih) {
+                for (int64_t iw = w_begin; iw < w_end; ++iw) {
+                    const T* xp = xd + ((nb * in.height + ih) * in.width + iw) * in.lanes;
+                    if (is_max) {
+                        for (int64_t l = 0; l < out.lanes; ++l) yp[l] = std::max(yp[l], xp[l]);
+                    } else {
+                        for (int64_t l = 0; l < out.lanes; ++l) yp[l] += xp[l];
+                    }
+                }
+            }
+            if (!is_max) {
+                const int64_t count = count_include_pad ? kernel_shape[0] * kernel_shape[1] : (h_end - h_begin) * (w_end - w_begin);
+                const T scale = T(1) / std::max<int64_t>(count, 1);
+                for (int64_t l = 0; l < out.lanes; ++l) yp[l] *= scale;
+            }
+        }
+    }
+}
+
+chainerx::Array RunLayoutPool(
+        const chainerx::Array& x_orig,
+        const std::string& layout,
+        const Int64StackVector& kernel_shape,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        bool cover_all,
+        bool is_max,
+        bool count_include_pad) {
+    CHECK(IsNativeDevice(&x_orig.device())) << "Layout ops run only on CPU: " << x_orig.device().name();
+    CHECK_EQ(2, kernel_shape.size());
+    const chainerx::Array x = chainerx::AsContiguous(x_orig);
+    const LayoutImage in = GetLayoutImage(x, layout);
+    LayoutImage out = in;
+    out.height = GetOutputSize(in.height, kernel_shape[0], strides[0], pads[0], pads[2], cover_all);
+    out.width = GetOutputSize(in.width, kernel_shape[1], strides[1], pads[1], pads[3], cover_all);
+    chainerx::Array y = EmptyLayoutImage(out, layout, x);
+    switch (x.dtype()) {
+        case chainerx::Dtype::kFloat32:
+            PoolImpl<float>(x, y, in, out, kernel_shape, strides, pads, is_max, count_include_pad);
+            break;
+        case chainerx::Dtype::kFloat64:
+            PoolImpl<double>(x, y, in, out, kernel_shape, strides, pads, is_max, count_include_pad);
+            break;
+        default:
+            CHECK(false) << "Unsupported dtype for layout ops: " << x.dtype();
+    }
+    return y;
+}
+
+}  // namespace
+
+chainerx::Array LayoutConvertOp::RunImpl(ChxVMState* st, const chainerx::Array& x) {
+    if (src_layout == "NCHW") {
+        CHECK_EQ(4, x.ndim());
+        const int64_t block = GetBlockSize(dst_layout);
+        if (block == 0) return chainerx::AsContiguous(chainerx::Transpose(x, chainerx::Axes{0, 2, 3, 1}));
+
+        // Channels are padded by zeros.
+        const chainerx::Shape& s = x.shape();
+        chainerx::Array padded = x;
+        if (s[1] % block) {
+            const chainerx::Shape pad_shape{s[0], block - s[1] % block, s[2], s[3]};
+            padded = chainerx::Concatenate({x, chainerx::Zeros(pad_shape, x.dtype(), x.device())}, 1);
+        }
+        padded = padded.Reshape({s[0], padded.shape()[1] / block, block, s[2], s[3]});
+        return chainerx::AsContiguous(chainerx::Transpose(padded, chainerx::Axes{0, 1, 3, 4, 2}));
+    }
+
+    CHECK_EQ("NCHW", dst_layout);
+    const int64_t block = GetBlockSize(src_layout);
+    if (block == 0) {
+        CHECK_EQ(4, x.ndim());
+        return chainerx::AsContiguous(chainerx::Transpose(x, chainerx::Axes{0, 3, 1, 2}));
+    }
+    CHECK_EQ(5, x.ndim());
+    const chainerx::Shape& s = x.shape();
+    chainerx::Array y = chainerx::AsContiguous(chainerx::Transpose(x, chainerx::Axes{0, 1, 4, 2, 3}));
+    y = y.Reshape({s[0], s[1] * s[4], s[2], s[3]});
+    if (channels > 0 && channels < y.shape()[1]) {
+        y = chainerx::AsContiguous(y.At({chainerx::Slice(), chainerx::Slice(0, channels)}));
+    }
+    return y;
+}
+
+chainerx::Array LayoutConvOp::RunImpl(
+        ChxVMState* st,
+        const chainerx::Array& x_orig,
+        const chainerx::Array& w_orig,
+        const absl::optional<chainerx::Array>& b,
+        const absl::optional<chainerx::Array>& z) {
+    CHECK(IsNativeDevice(&x_orig.device())) << "Layout ops run only on CPU: " << x_orig.device().name();
+    const chainerx::Dtype dtype = x_orig.dtype();
+    CHECK_EQ(dtype, w_orig.dtype());
+    const chainerx::Array x = chainerx::AsContiguous(x_orig);
+    const chainerx::Array w = chainerx::AsContiguous(w_orig);
+    const LayoutImage in = GetLayoutImage(x, layout);
+    const bool is_depthwise = group > 1;
+
+    // Weights are (KB, CB, KH, KW, Lin, Lout) or (CB, KH, KW, L).
+    const chainerx::Shape& ws = w.shape();
+    LayoutImage out = in;
+    int64_t kernel_h, kernel_w;
+    if (is_depthwise) {
+        CHECK_EQ(4, w.ndim());
+        CHECK_EQ(in.blocks, ws[0]);
+        CHECK_EQ(in.lanes, ws[3]);
+        kernel_h = ws[1];
+        kernel_w = ws[2];
+    } else {
+        CHECK_EQ(6, w.ndim());
+        CHECK_EQ(in.blocks, ws[1]);
+        CHECK_EQ(in.lanes, ws[4]);
+        out.blocks = ws[0];
+        out.lanes = ws[5];
+        kernel_h = ws[2];
+        kernel_w = ws[3];
+    }
+    out.height = GetOutputSize(in.height, kernel_h, strides[0], pads[0], pads[2], false);
+    out.width = GetOutputSize(in.width, kernel_w, strides[1], pads[1], pads[3], false);
+
+    chainerx::Array y = EmptyLayoutImage(out, layout, x);
+    absl::optional<chainerx::Array> bc, zc;
+    if (b.has_value()) {
+        bc = chainerx::AsContiguous(b->AsType(dtype));
+        CHECK_EQ(out.blocks * out.lanes, bc->GetTotalSize());
+    }
+    if (z.has_value()) {
+        zc = chainerx::AsContiguous(z->AsType(dtype));
+        CHECK_EQ(y.shape(), zc->shape());
+    }
+    const Epilogue ep{ParseActivation(activation), alpha, min, max};
+
+    // 1x1 Conv in NHWC is a matrix multiplication of pixels and weights.
+    const bool is_pointwise = !is_depthwise && kernel_h == 1 && kernel_w == 1 && strides[0] == 1 && strides[1] == 1 &&
+                              std::all_of(pads.begin(), pads.end(), [](int64_t p) { return p == 0; });
+    if (is_pointwise && in.blocks == 1 && out.blocks == 1) {
+        const int64_t num_pixels = in.batch * in.height * in.width;
+        const chainerx::Array x2 = x.Reshape({num_pixels, in.lanes});
+        const chainerx::Array w2 = w.Reshape({in.lanes, out.lanes});
+        chainerx::Array y2 = y.Reshape({num_pixels, out.lanes});
+        x.device().backend().CallKernel<chainerx::DotKernel>(x2, w2, y2);
+        if (dtype == chainerx::Dtype::kFloat32) {
+            ApplyEpilogue<float>(
+                    GetData<float>(y),
+                    bc.has_value() ? GetData<const float>(*bc) : nullptr,
+                    zc.has_value() ? GetData<const float>(*zc) : nullptr,
+                    num_pixels,
+                    out.lanes,
+                    ep);
+        } else {
+            ApplyEpilogue<double>(
+                    GetData<double>(y),
+                    bc.has_value() ? GetData<const double>(*bc) : nullptr,
+                    zc.has_value() ? GetData<const double>(*zc) : nullptr,
+                    num_pixels,
+                    out.lanes,
+                    ep);
+        }
+        return y;
+    }
+
+    auto run = [&](auto* type) {
+        using T = typename std::remove_pointer<decltype(type)>::type;
+        ConvArgs<T> args{GetData<const T>(x),
+                         GetData<const T>(w),
+                         bc.has_value() ? GetData<const T>(*bc) : nullptr,
+                         zc.has_value() ? GetData<const T>(*zc) : nullptr,
+                         GetData<T>(y),
+                         in,
+                         out,
+                         kernel_h,
+                         kernel_w,
+                         strides[0],
+                         strides[1],
+                         pads[0],
+                         pads[1],
+                         ep};
+        if (is_depthwise) {
+            DepthwiseConvImpl(args);
+        } else {
+            ConvImpl(args);
+        }
+    };
+    switch (dtype) {
+        case chainerx::Dtype::kFloat32:
+            run(static_cast<float*>(nullptr));
+            break;
+        case chainerx::Dtype::kFloat64:
+            run(static_cast<double*>(nullptr));
+            break;
+        default:
+            CHECK(false) << "Unsupported dtype for layout ops: " << dtype;
+    }
+    return y;
+}
+
+chainerx::Array LayoutMaxPoolOp::RunImpl(ChxVMState* st, const chainerx::Array& x) {
+    return RunLayoutPool(x, layout, kernel_shape, strides, pads, cover_all, true, false);
+}
+
+chainerx::Array LayoutAveragePoolOp::RunImpl(ChxVMState* st, const chainerx::Array& x) {
+    return RunLayoutPool(x, layout, kernel_shape, strides, pads, false, false, count_include_pad);
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -1,3 +1,5 @@
+#include <chainerx/kernels/arithmetic.h>
+#include <chainerx/kernels/misc.h>
 #include <chainerx/routines/activation.h>
 #include <chainerx/routines/arithmetic.h>
 #include <chainerx/routines/connection.h>
@@ -13,6 +15,7 @@
 
 #include <common/log.h>
 #include <runtime/chainerx_util.h>
+#include <runtime/chxvm_state.h>
 #include <runtime/gen_chxvm_ops.h>
 
 #include <numeric>
@@ -48,19 +51,72 @@ std::tuple<chainerx::Array, chainerx::Array> CoerceBinary(const chainerx::Array&
     return std::tie(ax, bx);
 }
 
+// Returns the output buffer assigned by the memory planner if `a` and
+// `b` can be computed by an element-wise kernel without broadcasting
+// or type coercion, and neither of them requires backprop.
+absl::optional<chainerx::Array> GetPlannedBinaryOutput(
+        ChxVMState* st, const ChxVMInstructionProto& inst, const chainerx::Array& a, const chainerx::Array& b) {
+    if (a.dtype() != b.dtype() || a.shape() != b.shape() || &a.device() != &b.device()) {
+        return absl::nullopt;
+    }
+    if (IsAnyBackpropRequired({a, b})) {
+        return absl::nullopt;
+    }
+    return st->GetPlannedOutput(inst, 0, a.shape(), a.dtype(), a.device());
+}
+
+// Returns an input to which the output of an element-wise binary op
+// can be written. The other input must not require backprop either.
+absl::optional<chainerx::Array> GetInPlaceBinaryOutput(
+        ChxVMState* st, const ChxVMInstructionProto& inst, const chainerx::Array& a, const chainerx::Array& b) {
+    if (a.dtype() != b.dtype() || a.shape() != b.shape() || &a.device() != &b.device()) {
+        return absl::nullopt;
+    }
+    if (IsAnyBackpropRequired({a, b})) {
+        return absl::nullopt;
+    }
+    if (st->CanOverwriteInput(inst, 0, a)) {
+        return a;
+    }
+    if (st->CanOverwriteInput(inst, 1, b)) {
+        return b;
+    }
+    return absl::nullopt;
+}
+
 }  // namespace
 
 chainerx::Array AddOp::RunImpl(ChxVMState* st, const chainerx::Array& a, const chainerx::Array& b) {
+    if (absl::optional<chainerx::Array> c = GetInPlaceBinaryOutput(st, inst_, a, b)) {
+        a.device().backend().CallKernel<chainerx::AddKernel>(a, b, *c);
+        return *c;
+    }
+    if (absl::optional<chainerx::Array> c = GetPlannedBinaryOutput(st, inst_, a, b)) {
+        a.device().backend().CallKernel<chainerx::AddKernel>(a, b, *c);
+        return *c;
+    }
     auto t = CoerceBinary(a, b);
     return std::get<0>(t) + std::get<1>(t);
 }
 
 chainerx::Array SubOp::RunImpl(ChxVMState* st, const chainerx::Array& a, const chainerx::Array& b) {
+    if (absl::optional<chainerx::Array> c = GetPlannedBinaryOutput(st, inst_, a, b)) {
+        a.device().backend().CallKernel<chainerx::SubtractKernel>(a, b, *c);
+        return *c;
+    }
     auto t = CoerceBinary(a, b);
     return std::get<0>(t) - std::get<1>(t);
 }
 
 chainerx::Array MulOp::RunImpl(ChxVMState* st, const chainerx::Array& a, const chainerx::Array& b) {
+    if (absl::optional<chainerx::Array> c = GetInPlaceBinaryOutput(st, inst_, a, b)) {
+        a.device().backend().CallKernel<chainerx::MultiplyKernel>(a, b, *c);
+        return *c;
+    }
+    if (absl::optional<chainerx::Array> c = GetPlannedBinaryOutput(st, inst_, a, b)) {
+        a.device().backend().CallKernel<chainerx::MultiplyKernel>(a, b, *c);
+        return *c;
+    }
     auto t = CoerceBinary(a, b);
     return std::get<0>(t) * std::get<1>(t);
 }
@@ -158,6 +214,12 @@ chainerx::Array CeilOp::RunImpl(ChxVMState* st, const chainerx::Array& x) {
 }
 
 chainerx::Array ClipOp::RunImpl(ChxVMState* st, const chainerx::Array& x) {
+    if (IsFloat(x.dtype()) && st->CanOverwriteInput(inst_, 0, x)) {
+        chainerx::Device& device = x.device();
+        device.backend().CallKernel<chainerx::IfLessElseASSAKernel>(x, min, min, x, x);
+        device.backend().CallKernel<chainerx::IfGreaterElseASSAKernel>(x, max, max, x, x);
+        return x;
+    }
     return chainerx::Minimum(chainerx::Maximum(x, min), max);
 }
 
@@ -0,0 +1,97 @@
+#include "runtime/thread_pool.h"
+
+#include <common/log.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+thread_local const ThreadPool* g_current_pool = nullptr;
+thread_local int g_current_worker = -1;
+
+}  // namespace
+
+ThreadPool::ThreadPool(int num_threads) {
+    CHECK_LT(0, num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+        workers_.emplace_back(new Worker());
+    }
+    for (int i = 0; i < num_threads; ++i) {
+        workers_[i]->thread = std::thread([this, i]() { WorkerMain(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        done_ = true;
+    }
+    cond_.notify_all();
+    for (const std::unique_ptr<Worker>& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+int ThreadPool::GetWorkerIndex() const {
+    return g_current_pool == this ? g_current_worker : -1;
+}
+
+void ThreadPool::Submit(Task task) {
+    int index = GetWorkerIndex();
+    if (index < 0) {
+        index = next_worker_.fetch_add(1) % num_threads();
+    }
+    {
+        Worker* worker = workers_[index].get();
+        std::lock_guard<std::mutex> lock(worker->mu);
+        worker->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        ++num_pending_;
+    }
+    cond_.notify_one();
+}
+
+bool ThreadPool::PopOwn(int index, Task* task) {
+    Worker* worker = workers_[index].get();
+    std::lock_guard<std::mutex> lock(worker->mu);
+    if (worker->tasks.empty()) return false;
+    *task = std::move(worker->tasks.back());
+    worker->tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::Steal(int index, Task* task) {
+    const int n = num_threads();
+    for (int i = 1; i < n; ++i) {
+        Worker* victim = workers_[(index + i) % n].get();
+        std::lock_guard<std::mutex> lock(victim->mu);
+        if (victim->tasks.empty()) continue;
+        *task = std::move(victim->tasks.front());
+        victim->tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::WorkerMain(int index) {
+    g_current_pool = this;
+    g_current_worker = index;
+    while (true) {
+        Task task;
+        if (PopOwn(index, &task) || Steal(index, &task)) {
+            --num_pending_;
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mu_);
+        cond_.wait(lock, [this]() { return done_ || num_pending_ > 0; });
+        if (done_ && num_pending_ == 0) break;
+    }
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// A work-stealing thread pool. Each worker owns a deque of tasks.
+// Tasks submitted from a worker go to the back of its own deque and
+// are popped in LIFO order, which keeps producer/consumer chains of
+// instructions on the same core. Idle workers steal from the front of
+// other workers' deques.
+class ThreadPool {
+public:
+    typedef std::function<void()> Task;
+
+    explicit ThreadPool(int num_threads);
+    ~ThreadPool();
+
+    int num_threads() const {
+        return static_cast<int>(workers_.size());
+    }
+
+    // Enqueues `task`. When called from a worker thread of this pool,
+    // the task is pushed to the deque of the calling worker.
+    void Submit(Task task);
+
+    // Returns the index of the current worker thread in this pool, or
+    // -1 if the caller is not a worker of this pool.
+    int GetWorkerIndex() const;
+
+private:
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    struct Worker {
+        std::mutex mu;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void WorkerMain(int index);
+    bool PopOwn(int index, Task* task);
+    bool Steal(int index, Task* task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::mutex mu_;
+    std::condition_variable cond_;
+    std::atomic<int64_t> num_pending_{0};
+    std::atomic<int> next_worker_{0};
+    bool done_{false};
+};
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+#
+# Compares the compilation time of run_onnx with different sets of
+# flags.
+#
+# Usage:
+#
+# $ ./scripts/gen_large_tests_oc.py
+# $ ./scripts/bench_compile.py out/large_oc_backprop_* \
+#     --config '' --config '--onnx_shape_inference'
+# $ ./scripts/bench_compile.py out/large_oc_backprop_* \
+#     --config '' --config '--pattern_rewrite_full_scan'
+#
+# Each config is a string of extra flags for run_onnx. Models are
+# compiled `-n` times with `--compile_only --backprop` and the best
+# "Compile elapsed" reported by run_onnx is shown.
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+
+def run(args, test_dir, config):
+    cmd = [os.path.join(args.build_dir, 'tools/run_onnx'),
+           '--test', test_dir, '--compile_only']
+    if args.backprop:
+        cmd.append('--backprop')
+    cmd += config.split()
+    cmd += args.extra_flags.split()
+    if args.verbose:
+        print(' '.join(cmd), file=sys.stderr)
+    output = subprocess.check_output(cmd, stderr=subprocess.STDOUT)
+    output = output.decode('utf-8')
+    m = re.search(r'^Compile elapsed: (\d+(\.\d+)?)', output, re.MULTILINE)
+    if not m:
+        sys.stderr.write(output)
+        raise RuntimeError('No compile time found for %s' % ' '.join(cmd))
+    return float(m.group(1)), output
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark compilation')
+    parser.add_argument('test_dirs', nargs='+',
+                        help='ONNX test directories')
+    parser.add_argument('--config', action='append', default=None,
+                        help='Extra flags for run_onnx (can be repeated)')
+    parser.add_argument('--extra_flags', default='',
+                        help='Flags which are passed for all configs')
+    parser.add_argument('--build_dir', '-b', default='build')
+    parser.add_argument('--repeat', '-n', type=int, default=3)
+    parser.add_argument('--no_backprop', dest='backprop',
+                        action='store_false')
+    parser.add_argument('--show_log', action='store_true')
+    parser.add_argument('--verbose', action='store_true')
+    args = parser.parse_args()
+
+    configs = args.config or ['']
+    for test_dir in args.test_dirs:
+        print(test_dir)
+        base = None
+        for config in configs:
+            elapsed = None
+            for _ in range(args.repeat):
+                e, output = run(args, test_dir, config)
+                if args.show_log:
+                    sys.stderr.write(output)
+                elapsed = e if elapsed is None else min(elapsed, e)
+            if base is None:
+                base = elapsed
+            print('  %-40s %10.3f msec (x%.2f)' %
+                  (config or '(default)', elapsed, base / elapsed))
+
+
+if __name__ == '__main__':
+    main()
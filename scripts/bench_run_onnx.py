@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+#
+# Compares the speed of run_onnx with different sets of flags.
+#
+# Usage:
+#
+# $ ./scripts/bench_run_onnx.py out/backprop_test_resnet50 \
+#     out/ch2o_model_GoogleNet_with_loss \
+#     --config '' --config '--threads 2' --config '--threads 4'
+#
+# Each config is a string of extra flags for run_onnx. Models are
+# run with `-I` iterations and the average elapsed time reported by
+# run_onnx (excluding the first warm-up iteration) is shown.
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+
+def run(args, test_dir, config):
+    cmd = [os.path.join(args.build_dir, 'tools/run_onnx'),
+           '--test', test_dir, '-I', str(args.iterations)]
+    cmd += config.split()
+    cmd += args.extra_flags.split()
+    if args.verbose:
+        print(' '.join(cmd), file=sys.stderr)
+    output = subprocess.check_output(cmd, stderr=subprocess.STDOUT)
+    output = output.decode('utf-8')
+    m = re.search(r'^Average elapsed: (\d+(\.\d+)?)', output, re.MULTILINE)
+    if not m:
+        sys.stderr.write(output)
+        raise RuntimeError('No elapsed time found for %s' % ' '.join(cmd))
+    return float(m.group(1)), output
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark run_onnx')
+    parser.add_argument('test_dirs', nargs='+',
+                        help='ONNX test directories')
+    parser.add_argument('--config', action='append', default=None,
+                        help='Extra flags for run_onnx (can be repeated)')
+    parser.add_argument('--extra_flags', default='',
+                        help='Flags which are passed for all configs')
+    parser.add_argument('--build_dir', '-b', default='build')
+    parser.add_argument('--iterations', '-I', type=int, default=10)
+    parser.add_argument('--show_log', action='store_true')
+    parser.add_argument('--verbose', action='store_true')
+    args = parser.parse_args()
+
+    configs = args.config or ['']
+    for test_dir in args.test_dirs:
+        print(test_dir)
+        base = None
+        for config in configs:
+            elapsed, output = run(args, test_dir, config)
+            if args.show_log:
+                sys.stderr.write(output)
+            if base is None:
+                base = elapsed
+            print('  %-40s %10.3f msec (x%.2f)' %
+                  (config or '(default)', elapsed, base / elapsed))
+
+
+if __name__ == '__main__':
+    main()
@@ -25,6 +25,7 @@ TESTS = [
     Generator('model', 'Alex'),
     Generator('model', 'Resnet_with_loss'),
     Generator('model', 'MyLSTM'),
+    Generator('model', 'TransformerBlock'),
 
     Generator('model', 'EspNet_VGG2L'),
     Generator('model', 'EspNet_BLSTM'),
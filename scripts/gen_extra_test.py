@@ -1044,6 +1044,57 @@ def gen_const_prop_use_twice_test(test_name):
     gb.gen_test()
 
 
+def gen_lstm_cell_test(test_name):
+    # Element-wise operations in an LSTM cell, which are fused into
+    # a single group.
+    gb = onnx_script.GraphBuilder(test_name)
+    shape = (64, 1024)
+    a = np.random.normal(size=shape).astype(np.float32)
+    i = np.random.normal(size=shape).astype(np.float32)
+    f = np.random.normal(size=shape).astype(np.float32)
+    o = np.random.normal(size=shape).astype(np.float32)
+    c = np.random.normal(size=shape).astype(np.float32)
+
+    def sigmoid(x):
+        return 1 / (1 + np.exp(-x))
+
+    new_c = sigmoid(f) * c + sigmoid(i) * np.tanh(a)
+    h = sigmoid(o) * np.tanh(new_c)
+
+    a_v = gb.input('a', a)
+    i_v = gb.input('i', i)
+    f_v = gb.input('f', f)
+    o_v = gb.input('o', o)
+    c_v = gb.input('c', c)
+    new_c_v = gb.Add([gb.Mul([gb.Sigmoid([f_v]), c_v]),
+                      gb.Mul([gb.Sigmoid([i_v]), gb.Tanh([a_v])])])
+    h_v = gb.Mul([gb.Sigmoid([o_v]), gb.Tanh([new_c_v])])
+    gb.output(new_c_v, new_c)
+    gb.output(h_v, h)
+    gb.gen_test()
+
+
+def gen_gelu_test(test_name):
+    # GELU by the approximation with tanh after a bias.
+    gb = onnx_script.GraphBuilder(test_name)
+    x = np.random.normal(size=(64, 3072)).astype(np.float32)
+    b = np.random.normal(size=(3072,)).astype(np.float32)
+    xb = x + b
+    y = 0.5 * xb * (1 + np.tanh(np.sqrt(2 / np.pi) *
+                                (xb + 0.044715 * xb * xb * xb)))
+
+    x_v = gb.input('x', x)
+    b_v = gb.input('b', b)
+    xb_v = gb.Add([x_v, b_v])
+    cube_v = gb.Mul([gb.Mul([xb_v, xb_v]), xb_v])
+    t_v = gb.Add([xb_v, gb.Mul([cube_v, gb.const(0.044715, np.float32)])])
+    t_v = gb.Tanh([gb.Mul([t_v, gb.const(np.sqrt(2 / np.pi), np.float32)])])
+    t_v = gb.Add([t_v, gb.const(1, np.float32)])
+    y_v = gb.Mul([gb.Mul([xb_v, t_v]), gb.const(0.5, np.float32)])
+    gb.output(y_v, y)
+    gb.gen_test()
+
+
 class TestCase(test_case.TestCase):
     def __init__(self, name, func, **kwargs):
         super(TestCase, self).__init__('out', name, **kwargs)
@@ -1137,6 +1188,9 @@ def get_tests():
     test('extra_test_sentiment_bigru',
          sentiment.gen_rnn_sentiment_test('BiGRU'), rtol=2.5)
 
+    test('extra_test_lstm_cell', gen_lstm_cell_test)
+    test('extra_test_gelu', gen_gelu_test)
+
     test('extra_test_generic_len', gen_generic_len_test)
     test('extra_test_generic_getitem', gen_generic_getitem_test)
     test('extra_test_generic_getslice', gen_generic_getslice_test)
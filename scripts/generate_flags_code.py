@@ -14,6 +14,10 @@ FLAGS = {
         'type': 'bool',
         'doc': 'Skip dtype/shape inference.'
     },
+    'onnx_shape_inference': {
+        'type': 'bool',
+        'doc': 'Infer shapes of the whole graph by ONNX instead of the native shape inference.'
+    },
     'use_cuda': {
         'type': 'bool',
         'doc': 'Use CUDA specific ops.'
@@ -22,10 +26,38 @@ FLAGS = {
         'type': 'bool',
         'doc': 'Fuse consecutive element-wise operations.'
     },
+    'fusion_launch_cost': {
+        'type': 'int',
+        'doc': 'The estimated overhead of running an op in bytes of memory traffic, which the fusion planner saves by fusing ops. (default: 16384)'
+    },
+    'fusion_max_live_mb': {
+        'type': 'int',
+        'doc': 'Do not grow a fusion group if its inputs and outputs exceed this size (in MB, unlimited by default).'
+    },
+    'skip_fusion_recompute': {
+        'type': 'bool',
+        'doc': 'Do not duplicate constants and cheap element-wise ops into fusion groups instead of passing their outputs between groups.'
+    },
     'use_nvrtc': {
         'type': 'bool',
         'doc': 'Use NVRTC to execute fused operations.'
     },
+    'use_fusion_interpreter': {
+        'type': 'bool',
+        'doc': 'Execute fused element-wise operations on CPU by a tiled bytecode interpreter, which needs no compiler at runtime.'
+    },
+    'use_cpu_codegen': {
+        'type': 'bool',
+        'doc': 'Compile fused element-wise operations into native code for CPU.'
+    },
+    'cpu_codegen_fast_math': {
+        'type': 'bool',
+        'doc': 'Vectorize exp, tanh, erf, etc. in --use_cpu_codegen by -ffast-math. NaNs and infinities may not be preserved.'
+    },
+    'cpu_codegen_cache_dir': {
+        'type': 'std::string',
+        'doc': 'The directory to cache shared objects generated by --use_cpu_codegen. It must be owned by the user and not writable by others. (default: $XDG_CACHE_HOME/chainer_compiler/cpu_fusion or $HOME/.cache/chainer_compiler/cpu_fusion)'
+    },
 
     'use_tvm': {
         'type': 'bool',
@@ -75,6 +107,10 @@ FLAGS = {
         'type': 'int',
         'doc': 'Enables ChainerX VM trace during constant propagation.'
     },
+    'max_folded_constant_elements': {
+        'type': 'int',
+        'doc': 'Constant folding does not create constants larger than this (1M elements by default, negative for unlimited).'
+    },
     'reset_shape': {
         'type': 'bool',
         'doc': 'Reset all shapes.'
@@ -84,6 +120,57 @@ FLAGS = {
         'doc': 'Reset output shapes.'
     },
 
+    'skip_cse': {
+        'type': 'bool',
+        'doc': 'Do not eliminate common subexpressions.'
+    },
+
+    'pattern_rewrite_full_scan': {
+        'type': 'bool',
+        'doc': 'Revisit all nodes after each round of merges and simplifications instead of only nodes around rewrites.'
+    },
+    'skip_fused_conv': {
+        'type': 'bool',
+        'doc': 'Do not fuse Conv with following bias, residual Add, and activation into ChainerFusedConv.'
+    },
+    'skip_fused_linear': {
+        'type': 'bool',
+        'doc': 'Do not fuse Gemm and ChainerLinear with following activations into ChainerFusedLinear.'
+    },
+    'layout': {
+        'type': 'std::string',
+        'doc': 'Run regions of Conv, pooling, and element-wise ops for inference on CPU in the layout: NHWC, NCHW8c, NCHW16c, or auto.'
+    },
+    'skip_inplace_ops': {
+        'type': 'bool',
+        'doc': 'Do not let element-wise ops overwrite inputs which die at them.'
+    },
+    'plan_memory': {
+        'type': 'bool',
+        'doc': 'Assign offsets in a preallocated arena to statically shaped intermediate arrays.'
+    },
+    'prepack_weights': {
+        'type': 'bool',
+        'doc': 'Pack constant weights of Conv, Gemm, MatMul, and Linear for the CPU engine once at the first run.'
+    },
+
+    'scheduler': {
+        'type': 'std::string',
+        'doc': 'The scheduler of nodes: naive, greedy, or search, which searches the order with the lowest peak memory. (default: greedy)'
+    },
+    'scheduler_time_budget_ms': {
+        'type': 'int',
+        'doc': 'The time budget of --scheduler=search for each graph in milliseconds. (default: 1000)'
+    },
+    'num_streams': {
+        'type': 'int',
+        'doc': 'Partition ops of the main graph into this number of streams, which are run in parallel by --threads.'
+    },
+    'stream_peak_increase_percent': {
+        'type': 'int',
+        'doc': 'Allow streams to increase the simulated peak memory of the sequential order by this percentage. (default: 0)'
+    },
+
     'dump_after_inference': {
         'type': 'bool',
         'doc': 'Dump the ONNX graph after inference'
@@ -121,6 +208,10 @@ FLAGS = {
         'type': 'int',
         'doc': 'Memory budget of GT policy (in MB)'
     },
+    'computation_order_memory_limit': {
+        'type': 'int',
+        'doc': 'Peak memory limit for --computation_order=auto (in MB)'
+    },
 }
 
 
@@ -49,6 +49,10 @@ parser.add_argument('--failed', action='store_true',
 parser.add_argument('--failure_log', default='out/failed_tests.log',
                     help='The file where names of failed tests are stored')
 parser.add_argument('--fuse', action='store_true', help='Enable fusion')
+parser.add_argument('--cpu_codegen', action='store_true',
+                    help='Compile fused operations for CPU (with --fuse)')
+parser.add_argument('--fusion_interpreter', action='store_true',
+                    help='Interpret fused operations on CPU (with --fuse)')
 parser.add_argument('--ngraph', action='store_true', help='Enable nGraph')
 parser.add_argument('--computation_order', default=None,
                     help='Force setting --computation_order flag')
@@ -860,6 +864,10 @@ def main():
             test_case.args.append('--fuse_operations')
             if is_gpu:
                 test_case.args.append('--use_nvrtc')
+            elif args.cpu_codegen:
+                test_case.args.append('--use_cpu_codegen')
+            elif args.fusion_interpreter:
+                test_case.args.append('--use_fusion_interpreter')
         if args.ngraph:
             test_case.args.append('--fuse_operations')
             test_case.args.append('--use_ngraph')
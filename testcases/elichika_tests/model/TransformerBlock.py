@@ -0,0 +1,56 @@
+# coding: utf-8
+
+import chainer
+import chainer.functions as F
+import chainer.links as L
+
+
+class TransformerBlock(chainer.Chain):
+
+    def __init__(self, n_units):
+        super(TransformerBlock, self).__init__()
+        with self.init_scope():
+            self.lq = L.Linear(n_units, n_units)
+            self.lk = L.Linear(n_units, n_units)
+            self.lv = L.Linear(n_units, n_units)
+            self.lo = L.Linear(n_units, n_units)
+            self.l1 = L.Linear(n_units, n_units * 4)
+            self.l2 = L.Linear(n_units * 4, n_units)
+
+    def forward(self, x):
+        # Single-head self-attention over a sequence `x` of
+        # (length, n_units) with the scale for n_units=64.
+        q = self.lq(x)
+        k = self.lk(x)
+        v = self.lv(x)
+        a = F.softmax(F.matmul(q, F.swapaxes(k, 0, 1)) * 0.125)
+        h = x + self.lo(F.matmul(a, v))
+
+        # Layer normalization decomposed into element-wise ops and
+        # reductions.
+        d = h - F.mean(h, axis=1, keepdims=True)
+        h = d / F.sqrt(F.mean(d * d, axis=1, keepdims=True) + 1e-5)
+
+        y = h + self.l2(F.relu(self.l1(h)))
+        d = y - F.mean(y, axis=1, keepdims=True)
+        y = d / F.sqrt(F.mean(d * d, axis=1, keepdims=True) + 1e-5)
+        return y
+
+
+from chainer_compiler.elichika import testtools
+import numpy as np
+
+
+def main():
+    np.random.seed(314)
+
+    n_units = 64
+    length = 128
+    model = TransformerBlock(n_units)
+
+    x = np.random.rand(length, n_units).astype(np.float32)
+    testtools.generate_testcase(model, [x])
+
+
+if __name__ == '__main__':
+    main()
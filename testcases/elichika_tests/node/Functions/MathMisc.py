@@ -102,6 +102,14 @@ class Log(chainer.Chain):
         y1 = F.log(x)
         return y1
 
+class Sqrt(chainer.Chain):
+    def __init__(self):
+        super(Sqrt,self).__init__()
+
+    def forward(self, x):
+        y1 = F.sqrt(x)
+        return y1
+
 # ======================================
 from chainer_compiler.elichika import testtools
 import numpy as np
@@ -122,6 +130,7 @@ def main():
     testtools.generate_testcase(ArcTan(), [x], subname='arctan')
     testtools.generate_testcase(Exp(), [x], subname='exp')
     testtools.generate_testcase(Log(), [x], subname='log')
+    testtools.generate_testcase(Sqrt(), [x], subname='sqrt')
 
 if __name__ == '__main__':
     main()
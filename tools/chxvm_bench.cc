@@ -0,0 +1,109 @@
+// Measures the dispatch overhead of the ChxVM interpreter by running a
+// long chain of instructions on tiny arrays.
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <chainerx/array.h>
+#include <chainerx/context.h>
+#include <chainerx/routines/creation.h>
+
+#include <common/log.h>
+#include <compiler/chxvm/chxvm_value.h>
+#include <compiler/gen_chxvm_codegen.h>
+#include <runtime/chrome_tracing.h>
+#include <runtime/chxvm.h>
+#include <runtime/chxvm.pb.h>
+#include <runtime/chxvm_state.h>
+#include <runtime/chxvm_var.h>
+
+#include <tools/cmdline.h>
+
+namespace chainer_compiler {
+namespace runtime {
+namespace {
+
+// y = ((x op x) op x) op ... with `Free` after each use of a
+// temporary value.
+void BuildChain(const std::string& op, int length, ChxVMProgramProto* program) {
+    chxvm::AddInOp(program, chxvm::ChxVMValue(0), "x");
+    int prev = 0;
+    for (int i = 0; i < length; ++i) {
+        const int id = i + 1;
+        if (op == "add") {
+            chxvm::AddAddOp(program, chxvm::ChxVMValue(id), prev, 0);
+        } else if (op == "relu") {
+            chxvm::AddReluOp(program, chxvm::ChxVMValue(id), prev);
+        } else if (op == "identity") {
+            chxvm::AddIdentityOp(program, chxvm::ChxVMValue(id), prev);
+        } else {
+            QFAIL() << "Unknown op: " << op;
+        }
+        if (prev) {
+            chxvm::AddFreeOp(program, prev);
+        }
+        prev = id;
+    }
+    chxvm::AddOutOp(program, "y", prev);
+    chxvm::AddFreeOp(program, prev);
+}
+
+void RunMain(int argc, char** argv) {
+    cmdline::parser args;
+    args.add<std::string>("op", '\0', "The op in the chain (add, relu, or identity)", false, "add");
+    args.add<int>("length", 'n', "The number of ops in the chain", false, 1000);
+    args.add<int>("iterations", 'I', "The number of runs", false, 1000);
+    args.add("check_nans", '\0', "Run with NaN checks to measure the slow path");
+    args.add<std::string>("chrome_tracing", '\0', "Stream chrome tracing events to this file to measure the tracing overhead", false);
+    args.parse_check(argc, argv);
+
+    chainerx::Context ctx;
+    chainerx::ContextScope ctx_scope(ctx);
+
+    ChxVMProgramProto program;
+    BuildChain(args.get<std::string>("op"), args.get<int>("length"), &program);
+    ChxVM chxvm(program);
+
+    ChxVMOptions options;
+    options.check_nans = args.exist("check_nans");
+    std::unique_ptr<ChromeTracingEmitter> chrome_tracing;
+    if (!args.get<std::string>("chrome_tracing").empty()) {
+        chrome_tracing.reset(new ChromeTracingEmitter());
+        chrome_tracing->StartStreaming(args.get<std::string>("chrome_tracing"));
+        options.chrome_tracing = chrome_tracing.get();
+    }
+
+    std::shared_ptr<ChxVMVar> x(new ChxVMVar(chainerx::Full({1}, 1.0f, chainerx::Dtype::kFloat32)));
+    InOuts inputs = {{"x", x}};
+    std::unique_ptr<ChxVMState> state(chxvm.Prepare(inputs, options));
+    // Warm up.
+    chxvm.Run(state.get());
+
+    const int iterations = args.get<int>("iterations");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        chxvm.BindInputs(state.get(), inputs);
+        chxvm.Run(state.get());
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    const double elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    const int64_t num_insts = static_cast<int64_t>(program.instructions_size()) * iterations;
+    std::cout << "Instructions: " << program.instructions_size() << std::endl;
+    std::cout << "Elapsed per run: " << elapsed_ns / iterations / 1000 << " usec" << std::endl;
+    std::cout << "Elapsed per instruction: " << elapsed_ns / num_insts << " nsec" << std::endl;
+    if (chrome_tracing) {
+        chrome_tracing->Emit(args.get<std::string>("chrome_tracing"));
+        std::cout << "Dropped trace events: " << chrome_tracing->num_dropped_events() << std::endl;
+    }
+}
+
+}  // namespace
+}  // namespace runtime
+}  // namespace chainer_compiler
+
+int main(int argc, char** argv) {
+    chainer_compiler::runtime::RunMain(argc, argv);
+}
@@ -0,0 +1,115 @@
+// Measures the compile time and the simulated peak memory of
+// computation order policies on synthetic graphs which have as many
+// nodes as ResNet152 or long unrolled RNNs.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <chainerx/context.h>
+
+#include <common/log.h>
+#include <common/strutil.h>
+#include <compiler/computation_order/core.h>
+#include <compiler/flags.h>
+#include <compiler/gradient_with_order.h>
+#include <compiler/graph.h>
+#include <compiler/memory_simulator.h>
+#include <compiler/node.h>
+#include <compiler/onnx.h>
+#include <compiler/shape_inference.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+#include <tools/cmdline.h>
+
+namespace chainer_compiler {
+namespace runtime {
+namespace {
+
+// Builds a chain of residual blocks, h = h + Relu(Relu(h)), or a
+// plain chain of Relu with about `num_nodes` nodes.
+void BuildGraph(const std::string& kind, int num_nodes, Graph* graph) {
+    const Type type(Dtype::kFloat32, {32, 256});
+    Value* h = graph->AddInputValue("x", type);
+    int id = 0;
+    auto new_value = [graph, &type, &id]() { return graph->AddValue(StrCat("v", id++), type); };
+    if (kind == "resnet") {
+        for (int i = 0; i + 3 <= num_nodes; i += 3) {
+            Value* a = new_value();
+            Value* b = new_value();
+            Value* c = new_value();
+            graph->AddNode(Node::kRelu, {h}, {a});
+            graph->AddNode(Node::kRelu, {a}, {b});
+            graph->AddNode(Node::kAdd, {h, b}, {c});
+            h = c;
+        }
+    } else if (kind == "chain") {
+        for (int i = 0; i < num_nodes; ++i) {
+            Value* a = new_value();
+            graph->AddNode(Node::kRelu, {h}, {a});
+            h = a;
+        }
+    } else {
+        QFAIL() << "Unknown graph: " << kind;
+    }
+    graph->AddNode(Node::kIdentity, {h}, {graph->AddOutputValue("y", type)});
+}
+
+// Returns the simulated peak memory of `graph` with gradient nodes
+// added in the order of `orders`.
+int64_t SimulatePeak(const Graph& graph, const std::vector<Order>& orders) {
+    onnx::GraphProto xgraph;
+    graph.ToONNX(&xgraph);
+    Graph training_graph(xgraph);
+    CHECK(AddGradientNodesForTrainingWithOrders(&training_graph, orders));
+    InferAllShapes(&training_graph);
+    return SimulateMemoryUsage(training_graph).peak;
+}
+
+void RunMain(int argc, char** argv) {
+    cmdline::parser args;
+    args.add<std::string>("graph", '\0', "The shape of graphs (resnet or chain)", false, "resnet");
+    args.add<std::string>("nodes", 'n', "Comma separated numbers of nodes", false, "1000,10000,50000");
+    args.add<std::string>("policy", '\0', "Comma separated policies of computation order", false, "chen");
+    args.add<int>("chen_budget", '\0', "Memory budget of Chen's policy (in MB)", false, 0);
+    args.add<int>("gt_budget", '\0', "Memory budget of GT policy (in MB). The peak of chen is used if it is run before", false, 0);
+    args.parse_check(argc, argv);
+    g_chen_budget = args.get<int>("chen_budget");
+
+    chainerx::Context ctx;
+    chainerx::ContextScope ctx_scope(ctx);
+
+    for (const std::string& nodes : SplitString(args.get<std::string>("nodes"), ",")) {
+        Graph graph("bench");
+        BuildGraph(args.get<std::string>("graph"), std::stoi(nodes), &graph);
+
+        g_gt_budget = args.get<int>("gt_budget");
+        for (const std::string& policy : SplitString(args.get<std::string>("policy"), ",")) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            const std::vector<Order> orders = GetComputationOrder(graph, policy);
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+            int num_recomputes = -static_cast<int>(graph.nodes().size());
+            for (const Order& order : orders) {
+                if (order.kind == Order::kComputeForward) ++num_recomputes;
+            }
+            const int64_t peak = SimulatePeak(graph, orders);
+            if (policy == "chen" && !args.get<int>("gt_budget")) {
+                g_gt_budget = (peak + 999999) / 1000000;
+            }
+            const double elapsed_ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+            std::cout << "Policy: " << policy << " Nodes: " << graph.nodes().size() << " Recomputes: " << num_recomputes
+                      << " Peak: " << peak / 1000000.0 << " MB Elapsed: " << elapsed_ms << " msec" << std::endl;
+        }
+    }
+}
+
+}  // namespace
+}  // namespace runtime
+}  // namespace chainer_compiler
+
+int main(int argc, char** argv) {
+    chainer_compiler::runtime::RunMain(argc, argv);
+}
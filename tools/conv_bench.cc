@@ -0,0 +1,188 @@
+// Compares algorithms of the CPU convolution engine with ChainerX on
+// convolutions of ResNet50 and MobileNet, and optionally writes the
+// fastest algorithm of each shape to a tuning table.
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <chainerx/array.h>
+#include <chainerx/context.h>
+#include <chainerx/routines/creation.h>
+
+#include <common/log.h>
+#include <common/strutil.h>
+#include <runtime/chainerx_util.h>
+#include <runtime/ops/cpu_conv.h>
+
+#include <tools/cmdline.h>
+
+namespace chainer_compiler {
+namespace runtime {
+namespace {
+
+struct ConvConfig {
+    const char* model;
+    int64_t in_channels;
+    int64_t out_channels;
+    int64_t group;
+    int64_t size;
+    int64_t kernel;
+    int64_t stride;
+    int64_t pad;
+};
+
+// Distinct convolutions of ResNet50 and MobileNet for 224x224 images.
+const ConvConfig kConfigs[] = {
+        {"resnet50", 3, 64, 1, 224, 7, 2, 3},
+        {"resnet50", 64, 64, 1, 56, 1, 1, 0},
+        {"resnet50", 64, 64, 1, 56, 3, 1, 1},
+        {"resnet50", 64, 256, 1, 56, 1, 1, 0},
+        {"resnet50", 256, 64, 1, 56, 1, 1, 0},
+        {"resnet50", 256, 128, 1, 56, 1, 1, 0},
+        {"resnet50", 128, 128, 1, 56, 3, 2, 1},
+        {"resnet50", 256, 512, 1, 56, 1, 2, 0},
+        {"resnet50", 128, 512, 1, 28, 1, 1, 0},
+        {"resnet50", 512, 128, 1, 28, 1, 1, 0},
+        {"resnet50", 128, 128, 1, 28, 3, 1, 1},
+        {"resnet50", 512, 256, 1, 28, 1, 1, 0},
+        {"resnet50", 256, 256, 1, 28, 3, 2, 1},
+        {"resnet50", 256, 1024, 1, 14, 1, 1, 0},
+        {"resnet50", 1024, 256, 1, 14, 1, 1, 0},
+        {"resnet50", 256, 256, 1, 14, 3, 1, 1},
+        {"resnet50", 1024, 512, 1, 14, 1, 1, 0},
+        {"resnet50", 512, 512, 1, 14, 3, 2, 1},
+        {"resnet50", 512, 2048, 1, 7, 1, 1, 0},
+        {"resnet50", 2048, 512, 1, 7, 1, 1, 0},
+        {"resnet50", 512, 512, 1, 7, 3, 1, 1},
+        {"mobilenet", 3, 32, 1, 224, 3, 2, 1},
+        {"mobilenet", 32, 32, 32, 112, 3, 1, 1},
+        {"mobilenet", 32, 64, 1, 112, 1, 1, 0},
+        {"mobilenet", 64, 64, 64, 112, 3, 2, 1},
+        {"mobilenet", 64, 128, 1, 56, 1, 1, 0},
+        {"mobilenet", 128, 128, 128, 56, 3, 1, 1},
+        {"mobilenet", 128, 128, 1, 56, 1, 1, 0},
+        {"mobilenet", 128, 128, 128, 56, 3, 2, 1},
+        {"mobilenet", 128, 256, 1, 28, 1, 1, 0},
+        {"mobilenet", 256, 256, 256, 28, 3, 1, 1},
+        {"mobilenet", 256, 256, 1, 28, 1, 1, 0},
+        {"mobilenet", 256, 256, 256, 28, 3, 2, 1},
+        {"mobilenet", 256, 512, 1, 14, 1, 1, 0},
+        {"mobilenet", 512, 512, 512, 14, 3, 1, 1},
+        {"mobilenet", 512, 512, 1, 14, 1, 1, 0},
+        {"mobilenet", 512, 512, 512, 14, 3, 2, 1},
+        {"mobilenet", 512, 1024, 1, 7, 1, 1, 0},
+        {"mobilenet", 1024, 1024, 1024, 7, 3, 1, 1},
+        {"mobilenet", 1024, 1024, 1, 7, 1, 1, 0},
+};
+
+// Returns the average elapsed time of `fn` in milliseconds.
+double Measure(int iterations, const std::function<void()>& fn) {
+    // Warm up.
+    fn();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0 / iterations;
+}
+
+void Report(const std::string& op, const std::string& algorithm, const ConvShape& shape, double msec) {
+    std::cout << std::setw(16) << op << std::setw(12) << algorithm << std::setw(10) << std::fixed << std::setprecision(3) << msec << " msec"
+              << std::setw(10) << std::setprecision(2) << shape.GetFlops() / msec / 1e6 << " GFLOPS" << std::endl;
+}
+
+void RunMain(int argc, char** argv) {
+    cmdline::parser args;
+    args.add<std::string>("model", '\0', "Convolutions to run (resnet50, mobilenet, or all)", false, "all");
+    args.add<std::string>(
+            "algorithms", '\0', "Comma separated algorithms to compare", false, "chainerx,im2col,direct1x1,winograd,depthwise");
+    args.add<int>("batchsize", 'B', "Batch size", false, 1);
+    args.add<int>("iterations", 'I', "The number of runs of each convolution", false, 10);
+    args.add("backward", '\0', "Also compare ConvGradWeight and ConvTranspose");
+    args.add<std::string>("tune", '\0', "Write the fastest forward algorithm of each shape to this tuning table", false);
+    args.parse_check(argc, argv);
+
+    chainerx::Context ctx;
+    chainerx::ContextScope ctx_scope(ctx);
+
+    std::vector<ConvAlgorithm> algorithms;
+    for (const std::string& name : SplitString(args.get<std::string>("algorithms"), ",")) {
+        algorithms.push_back(ParseConvAlgorithm(name));
+    }
+    const std::string model = args.get<std::string>("model");
+    const int iterations = args.get<int>("iterations");
+    const int64_t batch_size = args.get<int>("batchsize");
+
+    std::ofstream tuning_table;
+    if (!args.get<std::string>("tune").empty()) {
+        tuning_table.open(args.get<std::string>("tune"));
+        CHECK(tuning_table) << "Failed to open " << args.get<std::string>("tune");
+        tuning_table << "# Generated by conv_bench" << std::endl;
+    }
+
+    for (const ConvConfig& config : kConfigs) {
+        if (model != "all" && model != config.model) continue;
+
+        const Int64StackVector strides{config.stride, config.stride};
+        const Int64StackVector pads{config.pad, config.pad};
+        const chainerx::Array x = SlowRandom({batch_size, config.in_channels, config.size, config.size});
+        const chainerx::Array w = SlowRandom({config.out_channels, config.in_channels / config.group, config.kernel, config.kernel});
+        const chainerx::Shape y_shape = GetConvOutputShape(x.shape(), w.shape(), strides, pads);
+        const ConvShape shape = MakeConvShape(x.shape(), w.shape(), y_shape, strides, pads, config.group);
+        const chainerx::Array y = chainerx::Empty(y_shape, x.dtype(), x.device());
+        const chainerx::Array gy = SlowRandom(y_shape);
+        std::cout << config.model << " " << shape.ToString() << " (auto: " << GetConvAlgorithmName(ChooseConvAlgorithm(shape)) << ")"
+                  << std::endl;
+
+        ConvAlgorithm best = ConvAlgorithm::kAuto;
+        double best_msec = 0;
+        for (ConvAlgorithm algorithm : algorithms) {
+            if (!IsConvAlgorithmSupported(shape, algorithm)) continue;
+            double msec;
+            if (algorithm == ConvAlgorithm::kChainerX) {
+                msec = Measure(iterations, [&]() { GroupedConv(x, w, absl::nullopt, strides, pads, config.group, "NOTSET"); });
+            } else {
+                msec = Measure(iterations, [&]() { CpuConv(x, w, absl::nullopt, shape, algorithm, y); });
+            }
+            Report("Conv", GetConvAlgorithmName(algorithm), shape, msec);
+            if (best == ConvAlgorithm::kAuto || msec < best_msec) {
+                best = algorithm;
+                best_msec = msec;
+            }
+        }
+        if (tuning_table.is_open() && best != ConvAlgorithm::kAuto) {
+            tuning_table << shape.ToString() << " " << GetConvAlgorithmName(best) << std::endl;
+        }
+
+        if (args.exist("backward")) {
+            Report("ConvGradWeight",
+                   "chainerx",
+                   shape,
+                   Measure(iterations, [&]() { GroupedConvGradWeight(w, x, gy, strides, pads, config.group); }));
+            const chainerx::Array gw = chainerx::Empty(w.shape(), w.dtype(), w.device());
+            Report("ConvGradWeight", "engine", shape, Measure(iterations, [&]() { CpuConvGradWeight(x, gy, shape, gw); }));
+
+            const Int64StackVector out_size{config.size, config.size};
+            Report("ConvTranspose",
+                   "chainerx",
+                   shape,
+                   Measure(iterations, [&]() { GroupedConvTranspose(gy, w, absl::nullopt, strides, pads, out_size, config.group); }));
+            const chainerx::Array gx = chainerx::Empty(x.shape(), x.dtype(), x.device());
+            Report("ConvTranspose", "engine", shape, Measure(iterations, [&]() { CpuConvTranspose(gy, w, absl::nullopt, shape, gx); }));
+        }
+    }
+}
+
+}  // namespace
+}  // namespace runtime
+}  // namespace chainer_compiler
+
+int main(int argc, char** argv) {
+    chainer_compiler::runtime::RunMain(argc, argv);
+}
@@ -42,6 +42,8 @@
 #include <runtime/chrome_tracing.h>
 #include <runtime/chxvm.h>
 #include <runtime/chxvm.pb.h>
+#include <runtime/chxvm_profiler.h>
+#include <runtime/chxvm_state.h>
 #include <runtime/chxvm_var.h>
 #include <runtime/meminfo.h>
 
@@ -319,8 +321,14 @@ public:
         chxvm_opts_.dump_memory_usage = args_.exist("trace");
         chxvm_opts_.base_memory_usage = initial_used_bytes_;
         chxvm_opts_.dump_outputs_dir = args_.get<std::string>("dump_outputs_dir");
+        chxvm_opts_.num_threads = args_.get<int>("threads");
         if (!args_.get<std::string>("chrome_tracing").empty()) {
             chxvm_opts_.chrome_tracing = new ChromeTracingEmitter();
+            chxvm_opts_.chrome_tracing->StartStreaming(args_.get<std::string>("chrome_tracing"));
+        }
+        if (args_.exist("profile")) {
+            profiler_.reset(new ChxVMProfiler());
+            chxvm_opts_.profiler = profiler_.get();
         }
 
         params_ = LoadParams(model->graph());
@@ -362,6 +370,11 @@ public:
                 pc++;
             }
         }
+        if (chxvm_prog.arena_size()) {
+            LOG() << "Memory plan: arena=" << chxvm_prog.arena_size() << " bytes naive peak=" << chxvm_prog.naive_peak_size()
+                  << " bytes" << std::endl;
+        }
+
         const std::string out_chxvm = args_.get<std::string>("out_chxvm");
         if (!out_chxvm.empty()) {
             std::ofstream ofs(out_chxvm);
@@ -380,7 +393,7 @@ public:
 
     InOuts Run(const InOuts& inputs) {
         if (trace_level()) std::cerr << "Running ChxVM..." << std::endl;
-        InOuts outputs = chxvm_->Run(inputs, chxvm_opts_);
+        InOuts outputs = RunChxVM(chxvm_.get(), inputs);
         MaybeShowGPUMemory();
         if (chxvm_bp_.get()) {
             if (trace_level()) std::cerr << "Running ChxVM for backward..." << std::endl;
@@ -401,7 +414,7 @@ public:
                 }
                 CHECK(bp_inputs.emplace(input_name, value).second) << name;
             }
-            InOuts bp_outputs = chxvm_bp_->Run(bp_inputs, chxvm_opts_);
+            InOuts bp_outputs = RunChxVM(chxvm_bp_.get(), bp_inputs);
             MaybeShowGPUMemory();
             for (auto& p : bp_outputs) {
                 outputs.emplace(p);
@@ -417,11 +430,23 @@ public:
         return params_;
     }
 
+    ChxVMProfiler* profiler() const {
+        return profiler_.get();
+    }
+
 private:
     int trace_level() const {
         return args_.exist("verbose") ? 2 : args_.exist("trace") ? 1 : 0;
     }
 
+    InOuts RunChxVM(ChxVM* chxvm, const InOuts& inputs) {
+        std::unique_ptr<ChxVMState> state(chxvm->Prepare(inputs, chxvm_opts_));
+        chxvm->Run(state.get());
+        LOG() << "Array outputs: total=" << state->num_array_outputs() << " from_arena=" << state->num_arena_outputs()
+              << " inplace=" << state->num_inplace_outputs() << std::endl;
+        return state->GetOutputs();
+    }
+
     void MaybeShowGPUMemory() const {
         if (initial_used_bytes_ >= 0) {
             size_t used_bytes = GetUsedMemory() - initial_used_bytes_;
@@ -435,6 +460,7 @@ private:
     const cmdline::parser& args_;
     std::unique_ptr<ChxVM> chxvm_;
     ChxVMOptions chxvm_opts_;
+    std::unique_ptr<ChxVMProfiler> profiler_;
     InOuts params_;
     const int64_t initial_used_bytes_;
     int64_t param_bytes_;
@@ -561,7 +587,9 @@ void RunMain(const std::vector<std::string>& argv) {
     args.add<std::string>("out_chxvm", '\0', "Output ChxVM program", false);
     args.add<std::string>("dump_outputs_dir", '\0', "Dump each output of ChxVM ops to this directory", false);
     args.add<std::string>("report_json", '\0', "Dump report in a JSON", false);
+    args.add("profile", '\0', "Aggregate elapsed times of ChxVM ops and show the slowest ones");
     args.add<int>("iterations", 'I', "The number of iteartions", false, 1);
+    args.add<int>("threads", '\0', "The number of threads to run independent ChxVM ops in parallel", false, 1);
     args.add<double>("rtol", '\0', "rtol of AllClose", false, 1e-4);
     args.add<double>("atol", '\0', "atol of AllClose", false, 1e-6);
     args.add("equal_nan", '\0', "Treats NaN equal");
@@ -676,7 +704,11 @@ void RunMain(const std::vector<std::string>& argv) {
         test_cases.swap(new_test_cases);
     }
 
+    std::chrono::system_clock::time_point compile_start = std::chrono::system_clock::now();
     ModelRunner model_runner(args, initial_used_bytes, &model);
+    std::chrono::system_clock::time_point compile_end = std::chrono::system_clock::now();
+    LOG() << "Compile elapsed: " << std::chrono::duration_cast<std::chrono::microseconds>(compile_end - compile_start).count() * 0.001
+          << " msec" << std::endl;
 
     if (args.exist("compile_only")) return;
 
@@ -727,6 +759,7 @@ void RunMain(const std::vector<std::string>& argv) {
 
         // The first iteration is for warm up.
         if (test_case != test_cases.front()) total_elapsed += elapsed;
+        if (test_case == test_cases.front() && iterations > 1 && model_runner.profiler()) model_runner.profiler()->Reset();
         if (best_elapsed == 0 || best_elapsed > elapsed) best_elapsed = elapsed;
         elapsed_times.push_back(elapsed);
     }
@@ -752,11 +785,19 @@ void RunMain(const std::vector<std::string>& argv) {
         }
     }
 
+    if (model_runner.profiler()) {
+        model_runner.profiler()->Show(std::cerr);
+    }
+
     const std::string& report_json = args.get<std::string>("report_json");
     if (!report_json.empty()) {
         std::ofstream ofs(report_json);
         // TODO(hamaji): Output more information using nlohmann/json.
-        ofs << "{\"elapsed_times\": [ " << JoinString(MapToString(elapsed_times, [](double t) { return StrCat(t); })) << " ]}";
+        ofs << "{\"elapsed_times\": [ " << JoinString(MapToString(elapsed_times, [](double t) { return StrCat(t); })) << " ]";
+        if (model_runner.profiler()) {
+            ofs << ", \"profile\": " << model_runner.profiler()->ToJSON();
+        }
+        ofs << "}";
     }
 }
 
@@ -1,6 +1,7 @@
 #include "tools/train_imagenet.h"
 
 #include <chrono>
+#include <memory>
 #include <set>
 
 #include <compiler/onnx.h>
@@ -159,13 +160,24 @@ void RunMain(const std::vector<std::string>& argv) {
     ImageNetIterator train_iter(args.rest()[1], 3, batch_size, mean, height, width);
     train_iter.Start();
 
+    // Events are streamed to the file so long runs can be traced.
+    std::unique_ptr<ChromeTracingEmitter> chrome_tracing;
+    int memory_counter = -1;
+    if (!args.get<std::string>("chrome_tracing").empty()) {
+        chrome_tracing.reset(new ChromeTracingEmitter());
+        chrome_tracing->StartStreaming(args.get<std::string>("chrome_tracing"));
+        memory_counter = chrome_tracing->Intern("Memory");
+    }
+
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
     LOG() << "Start training!" << std::endl;
     int iter_count = 0;
     int max_iterations = args.get<int>("iterations");
     for (; !max_iterations || iter_count < max_iterations; ++iter_count) {
-        if (!args.get<std::string>("chrome_tracing").empty() && iter_count % args.get<int>("chrome_tracing_frequency") == 1) {
-            chxvm_opts.chrome_tracing = new ChromeTracingEmitter();
+        if (chrome_tracing && iter_count % args.get<int>("chrome_tracing_frequency") == 1) {
+            chxvm_opts.chrome_tracing = chrome_tracing.get();
+        } else {
+            chxvm_opts.chrome_tracing = nullptr;
         }
 
         InOuts inputs;
@@ -229,16 +241,20 @@ void RunMain(const std::vector<std::string>& argv) {
         std::cout << train_iter.GetStatus() << " loss=" << loss << " elapsed=" << elapsed << "ms";
         if (initial_used_bytes >= 0) {
             size_t used_bytes = GetUsedMemory() - initial_used_bytes;
+            if (chxvm_opts.chrome_tracing) {
+                chxvm_opts.chrome_tracing->AddCounterEvent(memory_counter, used_bytes);
+            }
             size_t param_mbs = param_bytes / 1000 / 1000;
             size_t used_mbs = used_bytes / 1000 / 1000;
             std::cout << " param=" << param_mbs << "MB used=" << used_mbs << "MB";
         }
         std::cout << std::endl;
+    }
 
-        if (chxvm_opts.chrome_tracing) {
-            chxvm_opts.chrome_tracing->Emit(args.get<std::string>("chrome_tracing"));
-            delete chxvm_opts.chrome_tracing;
-            chxvm_opts.chrome_tracing = nullptr;
+    if (chrome_tracing) {
+        chrome_tracing->Emit(args.get<std::string>("chrome_tracing"));
+        if (chrome_tracing->num_dropped_events()) {
+            std::cerr << "Dropped " << chrome_tracing->num_dropped_events() << " trace events" << std::endl;
         }
     }
 